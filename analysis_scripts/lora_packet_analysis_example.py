@@ -17,6 +17,11 @@ spotter_configs = [
     SpotterConfigSet(channel_number=5, flt_data_file='/PATH_TO/2024-04-12_LoRa_test_data/SPOT-31188C_ch5_0024_FLT.csv'),
 ]
 
+'''
+The same loss and corruption figures and CSV files, much faster on long runs, without the plots:
+util_pkt_analyzer -r All6SpotterTest.log -s 0:SPOT-31193C_ch0_0025_FLT.csv -s 1:SPOT-31099C_ch1_0038_FLT.csv ...
+'''
+
 receiver_df = parse_receiver_log(receiver_log_file)
 
 spotter_dataframes = load_spotter_data(spotter_configs)
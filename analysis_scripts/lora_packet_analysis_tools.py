@@ -6,6 +6,11 @@ import pandas as pd
 from tqdm import tqdm
 from typing import NamedTuple, List
 
+try:
+    import rx_log_native
+except ImportError:
+    rx_log_native = None
+
 
 class SpotterConfigSet(NamedTuple):
     channel_number: int
@@ -19,6 +24,11 @@ class SpotterConfigSet(NamedTuple):
 def parse_receiver_log(receiver_log_path: str) -> pd.DataFrame:
     # Parse the receiver log file
     print("Parsing receiver data...")
+    if rx_log_native is not None and rx_log_native.available():
+        log_df = rx_log_native.receiver_dataframe(receiver_log_path)
+        print(f"\tParsed {len(log_df)} packets")
+        return log_df
+
     log_data = []
     with open(receiver_log_path, 'r') as file:
         total_lines = sum(1 for line in file if line.startswith('#'))  # Count the lines that will be processed
@@ -53,6 +63,9 @@ def load_spotter_data(spotter_configs: List[SpotterConfigSet]) -> List[pd.DataFr
 
 
 def determine_packet_loss(spotter_dataframes: List[pd.DataFrame], receiver_dataframe: pd.DataFrame):
+    '''
+    util_pkt_analyzer does the same match natively, with the same outputs, for runs too long for pandas.
+    '''
     merged_dfs = []
     for spotter_df in spotter_dataframes:
         channel = spotter_df['channel_number'].iloc[0]
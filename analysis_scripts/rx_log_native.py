@@ -0,0 +1,90 @@
+'''
+Native reader of receiver logs and captures of the server output stream.
+
+The log is memory mapped and parsed by librx_log.so (built in util_pkt_analyzer) straight into NumPy arrays
+allocated here, the DataFrame is then built on those arrays without copying them.
+Set RX_LOG_LIB to the path of the library if it is not in util_pkt_analyzer next to this directory.
+'''
+
+import ctypes
+import os
+from typing import Dict, Tuple
+
+import numpy as np
+import pandas as pd
+
+_LIB_NAME = 'librx_log.so'
+
+# column name, dtype, in the order of the arguments of rx_log_fill()
+COLUMNS = [
+    ('channel_number', np.int64),
+    ('signal_stage', np.int64),
+    ('epoch_time', np.float64),
+    ('outx', np.int64),
+    ('outy', np.int64),
+    ('outz', np.int64),
+    ('lat', np.float64),
+    ('lon', np.float64),
+    ('rx_utc', np.float64),
+]
+
+
+def _load_library():
+    here = os.path.dirname(os.path.abspath(__file__))
+    candidates = [os.environ.get('RX_LOG_LIB'),
+                  os.path.join(here, '..', 'util_pkt_analyzer', _LIB_NAME),
+                  _LIB_NAME]
+    for path in candidates:
+        if not path:
+            continue
+        try:
+            lib = ctypes.CDLL(path)
+        except OSError:
+            continue
+        lib.rx_log_open.argtypes = [ctypes.c_char_p]
+        lib.rx_log_open.restype = ctypes.c_void_p
+        lib.rx_log_lines.argtypes = [ctypes.c_void_p]
+        lib.rx_log_lines.restype = ctypes.c_long
+        lib.rx_log_fill.argtypes = [ctypes.c_void_p, ctypes.c_long] + [ctypes.c_void_p] * len(COLUMNS) + [ctypes.POINTER(ctypes.c_long)]
+        lib.rx_log_fill.restype = ctypes.c_long
+        lib.rx_log_close.argtypes = [ctypes.c_void_p]
+        lib.rx_log_close.restype = None
+        return lib
+    return None
+
+
+_lib = _load_library()
+
+
+def available() -> bool:
+    return _lib is not None
+
+
+def read_receiver_log(receiver_log_path: str) -> Tuple[Dict[str, np.ndarray], int]:
+    '''
+    Parse the packet lines of a log into columns, see COLUMNS. lat, lon and rx_utc are NaN where the lines do not have them.
+    Returns the columns and the number of malformed lines skipped.
+    '''
+    if _lib is None:
+        raise OSError(f"{_LIB_NAME} not found, build util_pkt_analyzer or set RX_LOG_LIB")
+    log = _lib.rx_log_open(os.fsencode(receiver_log_path))
+    if not log:
+        raise OSError(f"impossible to open {receiver_log_path}")
+    try:
+        size = _lib.rx_log_lines(log)
+        columns = {name: np.empty(size, dtype=dtype) for name, dtype in COLUMNS}
+        nb_bad = ctypes.c_long(0)
+        nb = _lib.rx_log_fill(log, size, *[columns[name].ctypes.data for name, _ in COLUMNS], ctypes.byref(nb_bad))
+    finally:
+        _lib.rx_log_close(log)
+    return {name: column[:nb] for name, column in columns.items()}, nb_bad.value
+
+
+def receiver_dataframe(receiver_log_path: str) -> pd.DataFrame:
+    '''
+    Same DataFrame as the text parser of parse_receiver_log(), the columns are not copied.
+    '''
+    columns, nb_bad = read_receiver_log(receiver_log_path)
+    if nb_bad > 0:
+        print(f"\tSkipped {nb_bad} malformed lines")
+    return pd.DataFrame({name: columns[name] for name in ['channel_number', 'signal_stage', 'epoch_time', 'outx', 'outy', 'outz']}, copy=False)
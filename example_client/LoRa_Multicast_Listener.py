@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+
+'''
+Listener of the multicast output of the packet server ("udp_sink" in gateway_conf).
+Each datagram starts with '$SEQ,gateway_id,sequence' followed by whole lines, the same as on the TCP stream.
+Gaps in the sequence numbers of a gateway are lost datagrams, a lower number is a restart of the server.
+'''
+
+import os
+import socket
+import struct
+import sys
+
+GROUP = "239.255.26.1"
+PORT = 2601
+
+if __name__ == "__main__":
+    if len(sys.argv) > 3:
+        sname = os.path.basename(__file__)
+        print(f"Usage: ./{sname} [interface_ip_addr] [group]")
+        sys.exit(1)
+    iface = sys.argv[1] if len(sys.argv) > 1 else "0.0.0.0"
+    group = sys.argv[2] if len(sys.argv) > 2 else GROUP
+
+    # Any number of listeners can share the port
+    skt = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    skt.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    skt.bind(("", PORT))
+    skt.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, struct.pack("4s4s", socket.inet_aton(group), socket.inet_aton(iface)))
+
+    next_seq = {}
+    while True:
+        data = skt.recv(65536).decode(errors="replace")
+        header, _, lines = data.partition("\n")
+        fields = header.split(",")
+        if len(fields) != 3 or fields[0] != "$SEQ":
+            continue
+        gw, seq = fields[1], int(fields[2])
+        if gw in next_seq and seq > next_seq[gw]:
+            print(f"$LOST,{gw},{seq - next_seq[gw]}", flush=True)
+        next_seq[gw] = seq + 1
+        print(lines, end="", flush=True)
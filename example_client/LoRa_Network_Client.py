@@ -4,6 +4,11 @@ import socket
 import sys
 import os
 
+try:
+    import loraclient
+except ImportError:
+    loraclient = None
+
 if __name__ == "__main__":
     # Check that one command line argument was passed
     if len(sys.argv) != 2:
@@ -17,6 +22,16 @@ if __name__ == "__main__":
     # User provided ip address
     ipaddr = sys.argv[1]
 
+    # The client library reads large chunks and splits them natively, it stops on DISCONNECT like the loop below
+    if loraclient is not None and loraclient.available():
+        with loraclient.LoraClient(ipaddr, 2600, reconnect=False) as client:
+            try:
+                while True:
+                    print("\n".join(client.pull_lines()), flush=True)
+            except EOFError:
+                pass
+        sys.exit()
+
     # Open a socket
     with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as skt:
         # Connect to port 2600 of the user specified ip address 
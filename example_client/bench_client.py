@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+
+'''
+Records per second sustained by the example client loop (4 byte reads, string partition) and by the client library,
+against a local server process sending Spotter lines as fast as it can, then DISCONNECT.
+'''
+
+import multiprocessing
+import socket
+import sys
+import time
+
+import loraclient
+
+LINE = b"#2,2,17126961014,-695,743,-16,45.123456789,-1.500000000\n"
+
+
+def serve(lsock, nb_lines, nb_runs):
+    chunk = LINE * 1000
+    for _ in range(nb_runs):
+        conn, _ = lsock.accept()
+        conn.sendall(b"Connected...\n")
+        for _ in range(nb_lines // 1000):
+            conn.sendall(chunk)
+        conn.sendall(b"DISCONNECT\n")
+        conn.close()
+
+
+def example_loop(port):
+    # Same loop as LoRa_Network_Client.py, the lines being counted instead of printed
+    nb = 0
+    with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as skt:
+        skt.connect(("127.0.0.1", port))
+        skt.settimeout(0.1)
+        buff = ""
+        while True:
+            try:
+                buff += skt.recv(4).decode()
+            except socket.timeout:
+                pass
+            if "\n" in buff:
+                pkt, sep, buff = buff.partition("\n")
+                if pkt == "DISCONNECT":
+                    return nb
+                nb += 1
+
+
+def library_lines(port):
+    nb = 0
+    with loraclient.LoraClient("127.0.0.1", port, reconnect=False) as client:
+        try:
+            while True:
+                nb += len(client.pull_lines())
+        except EOFError:
+            return nb
+
+
+def library_records(port):
+    nb = 0
+    with loraclient.LoraClient("127.0.0.1", port, reconnect=False) as client:
+        try:
+            while True:
+                nb += len(client.pull())
+        except EOFError:
+            return nb
+
+
+def main():
+    nb_example = int(sys.argv[1]) if len(sys.argv) > 1 else 50000
+    nb_library = int(sys.argv[2]) if len(sys.argv) > 2 else 2000000
+    if not loraclient.available():
+        print("libloraclient.so not found, build libloraclient first")
+        sys.exit(1)
+
+    runs = [("example client loop", example_loop, nb_example),
+            ("library, pull_lines", library_lines, nb_library),
+            ("library, pull records", library_records, nb_library)]
+    for name, fn, nb_lines in runs:
+        lsock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        lsock.bind(("127.0.0.1", 0))
+        lsock.listen(1)
+        port = lsock.getsockname()[1]
+        server = multiprocessing.Process(target=serve, args=(lsock, nb_lines, 1))
+        server.start()
+        t0 = time.perf_counter()
+        nb = fn(port)
+        dt = time.perf_counter() - t0
+        server.join()
+        lsock.close()
+        print(f"{name:24s} {nb:9d} records in {dt:7.3f} s, {nb / dt:12.0f} records/s")
+
+
+if __name__ == "__main__":
+    main()
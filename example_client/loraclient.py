@@ -0,0 +1,163 @@
+'''
+Python binding of libloraclient, the client library of the LoRa packet server.
+
+The library reads the stream in large chunks, splits it without copy, handles the 'Connected...' and 'DISCONNECT'
+control lines and reconnects with a backoff. Lines are handed over in batches, one string per call.
+Set LORACLIENT_LIB to the path of libloraclient.so if it is not in libloraclient next to this directory.
+'''
+
+import ctypes
+import os
+from typing import Callable, Iterator, List, Tuple
+
+PORT = 2600
+
+LC_REC_LINE = 0
+LC_REC_FRAME = 1
+
+LC_DOWN, LC_CONNECTING, LC_UP, LC_CLOSED = range(4)
+
+_LIB_NAME = 'libloraclient.so'
+
+
+class _Rec(ctypes.Structure):
+    _fields_ = [('data', ctypes.POINTER(ctypes.c_uint8)),
+                ('len', ctypes.c_uint32),
+                ('kind', ctypes.c_uint8),
+                ('type', ctypes.c_uint8)]
+
+
+class _Stats(ctypes.Structure):
+    _fields_ = [('bytes', ctypes.c_uint64),
+                ('lines', ctypes.c_uint64),
+                ('frames', ctypes.c_uint64),
+                ('dropped', ctypes.c_uint64),
+                ('connects', ctypes.c_uint32),
+                ('hellos', ctypes.c_uint32),
+                ('closes', ctypes.c_uint32),
+                ('resyncs', ctypes.c_uint32)]
+
+
+_CALLBACK = ctypes.CFUNCTYPE(ctypes.c_int, ctypes.POINTER(_Rec), ctypes.c_void_p)
+
+
+def _load_library():
+    here = os.path.dirname(os.path.abspath(__file__))
+    for path in [os.environ.get('LORACLIENT_LIB'), os.path.join(here, '..', 'libloraclient', _LIB_NAME), _LIB_NAME]:
+        if not path:
+            continue
+        try:
+            lib = ctypes.CDLL(path)
+        except OSError:
+            continue
+        lib.lc_create.argtypes = [ctypes.c_char_p, ctypes.c_uint16]
+        lib.lc_create.restype = ctypes.c_void_p
+        lib.lc_set_backoff.argtypes = [ctypes.c_void_p, ctypes.c_uint, ctypes.c_uint]
+        lib.lc_set_backoff.restype = None
+        lib.lc_state.argtypes = [ctypes.c_void_p]
+        lib.lc_state.restype = ctypes.c_int
+        lib.lc_pull.argtypes = [ctypes.c_void_p, ctypes.POINTER(_Rec), ctypes.c_int, ctypes.c_int]
+        lib.lc_pull.restype = ctypes.c_int
+        lib.lc_run.argtypes = [ctypes.c_void_p, _CALLBACK, ctypes.c_void_p, ctypes.c_int]
+        lib.lc_run.restype = ctypes.c_long
+        lib.lc_pull_lines.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t, ctypes.c_int]
+        lib.lc_pull_lines.restype = ctypes.c_long
+        lib.lc_send.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        lib.lc_send.restype = ctypes.c_int
+        lib.lc_get_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(_Stats)]
+        lib.lc_get_stats.restype = None
+        lib.lc_destroy.argtypes = [ctypes.c_void_p]
+        lib.lc_destroy.restype = None
+        return lib
+    return None
+
+
+_lib = _load_library()
+
+
+def available() -> bool:
+    return _lib is not None
+
+
+class LoraClient:
+    '''
+    Client of the packet server. The connection is made on the first read, and made again when lost.
+    reconnect=False stops at the first 'DISCONNECT' or connection loss instead.
+    '''
+
+    def __init__(self, host: str, port: int = PORT, reconnect: bool = True, backoff_min_ms: int = 100,
+                 backoff_max_ms: int = 10000, batch_bytes: int = 1 << 20):
+        if _lib is None:
+            raise OSError(f"{_LIB_NAME} not found, build libloraclient or set LORACLIENT_LIB")
+        self._c = _lib.lc_create(host.encode(), port)
+        if not self._c:
+            raise MemoryError("lc_create failed")
+        _lib.lc_set_backoff(self._c, backoff_min_ms, backoff_max_ms if reconnect else 0)
+        self._out = ctypes.create_string_buffer(batch_bytes)
+        self._recs = (_Rec * 1024)()
+
+    def close(self):
+        if self._c:
+            _lib.lc_destroy(self._c)
+            self._c = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    @property
+    def state(self) -> int:
+        return _lib.lc_state(self._c)
+
+    def pull_lines(self, timeout_ms: int = -1) -> List[str]:
+        '''
+        Lines received, without their line ending. Empty on timeout, EOFError once closed.
+        '''
+        n = _lib.lc_pull_lines(self._c, self._out, len(self._out), timeout_ms)
+        if n < 0:
+            raise EOFError("connection closed")
+        if n == 0:
+            return []
+        return ctypes.string_at(self._out, n).decode(errors='replace').split('\n')[:-1]
+
+    def lines(self, timeout_ms: int = -1) -> Iterator[str]:
+        '''
+        Every line received, until the connection is closed for good.
+        '''
+        while True:
+            try:
+                batch = self.pull_lines(timeout_ms)
+            except EOFError:
+                return
+            yield from batch
+
+    def pull(self, timeout_ms: int = -1) -> List[Tuple[int, int, bytes]]:
+        '''
+        Records received, lines and binary frames, as (kind, frame type, bytes). EOFError once closed.
+        '''
+        n = _lib.lc_pull(self._c, self._recs, len(self._recs), timeout_ms)
+        if n < 0:
+            raise EOFError("connection closed")
+        return [(r.kind, r.type, ctypes.string_at(r.data, r.len)) for r in self._recs[:n]]
+
+    def run(self, callback: Callable[[int, int, bytes], bool], timeout_ms: int = -1) -> int:
+        '''
+        Call callback(kind, frame type, bytes) with each record, until the timeout or until it returns True.
+        '''
+        def trampoline(rec, ctx):
+            r = rec.contents
+            return 1 if callback(r.kind, r.type, ctypes.string_at(r.data, r.len)) else 0
+        return _lib.lc_run(self._c, _CALLBACK(trampoline), None, timeout_ms)
+
+    def send(self, cmd: str) -> bool:
+        return _lib.lc_send(self._c, cmd.encode()) == 0
+
+    def stats(self) -> dict:
+        s = _Stats()
+        _lib.lc_get_stats(self._c, ctypes.byref(s))
+        return {name: getattr(s, name) for name, _ in _Stats._fields_}
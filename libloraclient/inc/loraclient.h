@@ -0,0 +1,269 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Client of the LoRa packet server. The stream is read in large chunks
+    into a single buffer and split in place into text lines and binary
+    frames, handed over without copy through a batch pull or a callback.
+    The connection is re-established with an exponential backoff, the
+    'Connected...' and 'DISCONNECT' control lines are handled here.
+    Consumers on the gateway itself can read the same lines from the shared
+    memory ring of the server instead, without any system call.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _LORACLIENT_H
+#define _LORACLIENT_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stddef.h>     /* size_t */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LC_SUCCESS          0
+#define LC_ERROR            -1
+
+#define LC_PORT             2600            /* port of the packet server */
+#define LC_BUF_SIZE         (256 * 1024)    /* receive buffer, holds at least one frame of the largest size */
+#define LC_BACKOFF_MIN_MS   100             /* first reconnection delay, doubled at each failure */
+#define LC_BACKOFF_MAX_MS   10000
+
+/* kind of record */
+#define LC_REC_LINE         0   /* text line, '#' packet or '$' report, without its line ending */
+#define LC_REC_FRAME        1   /* binary frame, payload only */
+
+/* connection state */
+#define LC_DOWN             0   /* waiting for the backoff delay to elapse */
+#define LC_CONNECTING       1
+#define LC_UP               2
+#define LC_CLOSED           3   /* server disconnected, reconnection disabled */
+
+/* spotter samples sent as frames, after an 'ENC delta' command */
+#define LC_SPOT_FRAME       1   /* frame type, LORA_FRAME_SPOT */
+#define LC_SPOT_RESYNC      1   /* lc_spot_decode: a frame of the spotter was missed, waiting for its next keyframe */
+#define LC_SPOT_LINE_MAX    128 /* size of a buffer able to hold any line of lc_spot_format */
+
+#define LC_SHM_NAME         "/lora_pkt_server"  /* shared memory ring of the packet server, SHM_RING_NAME */
+#define LC_SHM_BATCH        256                 /* lines copied per lc_shm_pull at most */
+#define LC_SHM_IDLE_US      500                 /* sleep of lc_shm_pull while no line is published */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lc_rec_s
+@brief Record of the stream, in the client buffer, valid until the next call on the client
+*/
+struct lc_rec_s {
+    const uint8_t   *data;
+    uint32_t        len;
+    uint8_t         kind;   /*!> LC_REC_LINE or LC_REC_FRAME */
+    uint8_t         type;   /*!> type of a frame, 0 for a line */
+};
+
+/**
+@struct lc_stats_s
+@brief Counters since the client was created
+*/
+struct lc_stats_s {
+    uint64_t        bytes;      /*!> bytes received */
+    uint64_t        lines;      /*!> lines delivered */
+    uint64_t        frames;     /*!> frames delivered */
+    uint64_t        dropped;    /*!> bytes of lines longer than the buffer, dropped */
+    uint32_t        connects;   /*!> connections established */
+    uint32_t        hellos;     /*!> 'Connected...' lines of the server */
+    uint32_t        closes;     /*!> connections lost or closed by a 'DISCONNECT' line */
+    uint32_t        resyncs;    /*!> spotter frames that could not be decoded, waiting for a keyframe */
+};
+
+/**
+@struct lc_spot_s
+@brief Spotter sample decoded from a frame, the fields of the '#' text line
+*/
+struct lc_spot_s {
+    uint8_t         spotn;
+    uint8_t         type;
+    uint64_t        tenths;     /*!> timestamp, tenths of a second since epoch */
+    int32_t         X;
+    int32_t         Y;
+    int32_t         Z;
+    int8_t          LATD;       /*!> degrees */
+    int32_t         LATM;       /*!> minutes * 100000 */
+    int32_t         LOND;
+    int32_t         LONM;
+    bool            has_utc;    /*!> the server sends the receive time (rx_utc) and is synchronized */
+    int64_t         utc_us;     /*!> gateway receive time, microseconds since epoch */
+};
+
+/**
+@struct lc_shm_stats_s
+@brief Counters of a shared memory reader since it was opened
+*/
+struct lc_shm_stats_s {
+    uint64_t        lines;      /*!> lines delivered */
+    uint64_t        lost;       /*!> lines overwritten by the server before they were read */
+    uint32_t        restarts;   /*!> rings taken over by a new server, reading went on from its first line */
+};
+
+struct lc_client_s; /* opaque, from lc_create */
+
+struct lc_shm_s; /* opaque, from lc_shm_open */
+
+/**
+@brief Function called with each record by lc_run
+@param rec record, valid during the call only
+@param ctx context given to lc_run
+@return non zero to stop lc_run after this record
+*/
+typedef int (*lc_callback)(const struct lc_rec_s *rec, void *ctx);
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Create a client, the connection is made by the first pull
+@param host name or address of the server
+@param port port of the server, LC_PORT for the packet server
+@return the client, NULL if out of memory
+*/
+struct lc_client_s *lc_create(const char *host, uint16_t port);
+
+/**
+@brief Set the delays between reconnection attempts
+@param c client
+@param min_ms first delay, and delay after a 'DISCONNECT' line
+@param max_ms longest delay, 0 to stay closed once the connection is lost
+*/
+void lc_set_backoff(struct lc_client_s *c, unsigned min_ms, unsigned max_ms);
+
+/**
+@brief Get the state of the connection
+@param c client
+@return LC_DOWN, LC_CONNECTING, LC_UP or LC_CLOSED
+*/
+int lc_state(const struct lc_client_s *c);
+
+/**
+@brief Get the records received, waiting for some if there is none
+@param c client
+@param recs filled with the records, valid until the next call on the client
+@param max size of recs
+@param timeout_ms longest wait, negative to wait forever
+@return number of records, 0 on timeout, LC_ERROR once closed with no record left
+*/
+int lc_pull(struct lc_client_s *c, struct lc_rec_s *recs, int max, int timeout_ms);
+
+/**
+@brief Call a function with each record received, until the timeout or until it asks to stop
+@param c client
+@param cb function called
+@param ctx context passed to cb
+@param timeout_ms time to run, negative to run until cb asks to stop or the client is closed
+@return number of records delivered, LC_ERROR if closed before any
+*/
+long lc_run(struct lc_client_s *c, lc_callback cb, void *ctx, int timeout_ms);
+
+/**
+@brief Copy the lines received, each ending with '\n', waiting for some if there is none
+@param c client
+@param out filled with whole lines
+@param size size of out, a longer line is truncated
+@param timeout_ms longest wait, negative to wait forever
+@return number of bytes, 0 on timeout, LC_ERROR once closed with no line left
+
+Meant for bindings, which then split a single string. Spotter frames are
+decoded into their text line, other frames are skipped.
+*/
+long lc_pull_lines(struct lc_client_s *c, char *out, size_t size, int timeout_ms);
+
+/**
+@brief Send a command to the server, e.g. "RELOAD"
+@param c client
+@param cmd command, sent as is
+@return LC_ERROR if not connected or the command could not be sent, LC_SUCCESS else
+*/
+int lc_send(struct lc_client_s *c, const char *cmd);
+
+/**
+@brief Decode a spotter frame, against the former samples of the same spotter on this connection
+@param c client the frame was pulled from
+@param rec record of kind LC_REC_FRAME and type LC_SPOT_FRAME, every such record must be decoded in order
+@param spot filled with the sample
+@return LC_SUCCESS, LC_SPOT_RESYNC if a former frame of the spotter was missed, LC_ERROR if not a valid spotter frame
+
+lc_pull_lines decodes the spotter frames itself and hands out their text lines.
+*/
+int lc_spot_decode(struct lc_client_s *c, const struct lc_rec_s *rec, struct lc_spot_s *spot);
+
+/**
+@brief Format a decoded sample as the '#' text line of the server
+@param spot sample
+@param buf destination buffer, LC_SPOT_LINE_MAX bytes is always enough
+@param len size of the destination buffer
+@return length of the line, line ending included
+*/
+int lc_spot_format(const struct lc_spot_s *spot, char *buf, size_t len);
+
+/**
+@brief Get the counters
+@param c client
+@param stats filled with the counters
+*/
+void lc_get_stats(const struct lc_client_s *c, struct lc_stats_s *stats);
+
+/**
+@brief Close the connection and free the client
+@param c client
+*/
+void lc_destroy(struct lc_client_s *c);
+
+/**
+@brief Map the shared memory ring of a server running on this machine, reading starts with the next line
+@param name shm_open name, LC_SHM_NAME for the packet server
+@return the reader, NULL if the server does not publish in that ring
+*/
+struct lc_shm_s *lc_shm_open(const char *name);
+
+/**
+@brief Copy the lines published, waiting for some if there is none
+@param s reader
+@param recs filled with the lines, valid until the next call on the reader
+@param max size of recs, at most LC_SHM_BATCH lines are copied
+@param timeout_ms longest wait, 0 to return at once, negative to wait forever
+@return number of lines, 0 on timeout, LC_ERROR once the server stopped publishing, to open the ring again
+
+Lines are read without any system call, the reader sleeps LC_SHM_IDLE_US at a
+time while there is no line. Lines overwritten before being read are counted
+as lost, reading goes on with the oldest lines left.
+*/
+int lc_shm_pull(struct lc_shm_s *s, struct lc_rec_s *recs, int max, int timeout_ms);
+
+/**
+@brief Get the counters of a shared memory reader
+@param s reader
+@param stats filled with the counters
+*/
+void lc_shm_get_stats(const struct lc_shm_s *s, struct lc_shm_stats_s *stats);
+
+/**
+@brief Unmap the shared memory ring and free the reader
+@param s reader
+*/
+void lc_shm_close(struct lc_shm_s *s);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
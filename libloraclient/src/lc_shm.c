@@ -0,0 +1,208 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Reader of the shared memory ring of the LoRa packet server, lock-free
+    and without system calls while lines are published
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdlib.h>     /* calloc free */
+#include <time.h>       /* clock_gettime nanosleep */
+#include <unistd.h>     /* close */
+#include <fcntl.h>      /* O_RDONLY */
+#include <sys/mman.h>   /* shm_open mmap */
+#include <sys/stat.h>   /* fstat */
+
+#include "loraclient.h"
+#include "shm_ring.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct lc_shm_s {
+    const struct shm_ring_hdr_s *ring;
+    size_t                      size;       /* bytes mapped */
+    uint32_t                    nb_slot;    /* checked once, the mapping does not grow */
+    uint32_t                    epoch;
+    uint64_t                    next;       /* next line to read */
+    char                        buf[LC_SHM_BATCH][SHM_RING_DATA_MAX];
+    struct lc_shm_stats_s       stats;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* the server lapped the reader, go on half a ring behind it to leave some slack */
+static void skip(struct lc_shm_s *s, uint64_t head) {
+    uint64_t n = (head > s->nb_slot / 2) ? head - s->nb_slot / 2 : 0;
+
+    if (n <= s->next) {
+        n = s->next + 1;
+    }
+    s->stats.lost += n - s->next;
+    s->next = n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int take(struct lc_shm_s *s, struct lc_rec_s *recs, int max) {
+    const struct shm_ring_hdr_s *h = s->ring;
+    uint32_t epoch;
+    uint64_t head;
+    uint16_t len;
+    int nb = 0;
+
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != SHM_RING_MAGIC) {
+        return 0; /* being taken over by a new server */
+    }
+    /* the epoch is set before head is reset, a head of the new server comes with its epoch */
+    epoch = __atomic_load_n(&h->epoch, __ATOMIC_ACQUIRE);
+    head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&h->epoch, __ATOMIC_ACQUIRE) != epoch) {
+        return 0;
+    }
+    if ((epoch != s->epoch) || (head < s->next)) {
+        s->epoch = epoch;
+        s->next = 0;
+        s->stats.restarts++;
+    }
+    while ((nb < max) && (s->next < head)) {
+        if (head - s->next > s->nb_slot) {
+            skip(s, head);
+            continue;
+        }
+        switch (shm_ring_get(h, s->next, s->buf[nb], &len)) {
+            case SHM_RING_OK:
+                recs[nb].data = (const uint8_t *)s->buf[nb];
+                recs[nb].len = len;
+                recs[nb].kind = LC_REC_LINE;
+                recs[nb].type = 0;
+                ++nb;
+                ++s->next;
+                break;
+            case SHM_RING_OVERRUN:
+                head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+                skip(s, head);
+                break;
+            default:
+                return nb; /* cleared by a new server, its epoch is seen next time */
+        }
+    }
+    return nb;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+struct lc_shm_s *lc_shm_open(const char *name) {
+    const struct shm_ring_hdr_s *h;
+    struct lc_shm_s *s;
+    struct stat st;
+    void *m;
+    int fd;
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(struct shm_ring_hdr_s))) {
+        close(fd);
+        return NULL;
+    }
+    m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        return NULL;
+    }
+    h = m;
+    s = calloc(1, sizeof *s);
+    if ((s == NULL) || (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != SHM_RING_MAGIC) || (h->version != SHM_RING_VERSION) ||
+        (h->slot_size != sizeof(struct shm_ring_slot_s)) || (h->nb_slot == 0) || ((h->nb_slot & (h->nb_slot - 1)) != 0) ||
+        (shm_ring_size(h->nb_slot) > (size_t)st.st_size)) {
+        free(s);
+        munmap(m, st.st_size);
+        return NULL;
+    }
+    s->ring = h;
+    s->size = st.st_size;
+    s->nb_slot = h->nb_slot;
+    s->epoch = __atomic_load_n(&h->epoch, __ATOMIC_ACQUIRE);
+    s->next = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+    return s;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lc_shm_pull(struct lc_shm_s *s, struct lc_rec_s *recs, int max, int timeout_ms) {
+    struct timespec idle = { 0, LC_SHM_IDLE_US * 1000 };
+    int64_t end = 0;
+    int nb;
+
+    max = (max > LC_SHM_BATCH) ? LC_SHM_BATCH : max;
+    for (;;) {
+        nb = take(s, recs, max);
+        if (nb > 0) {
+            s->stats.lines += nb;
+            return nb;
+        }
+        if ((__atomic_load_n(&s->ring->alive, __ATOMIC_ACQUIRE) == 0) || (s->ring->nb_slot != s->nb_slot)) {
+            return LC_ERROR;
+        }
+        if (timeout_ms == 0) {
+            return 0;
+        } else if (timeout_ms > 0) {
+            if (end == 0) {
+                end = now_ms() + timeout_ms;
+            } else if (now_ms() >= end) {
+                return 0;
+            }
+        }
+        nanosleep(&idle, NULL);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lc_shm_get_stats(const struct lc_shm_s *s, struct lc_shm_stats_s *stats) {
+    *stats = s->stats;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lc_shm_close(struct lc_shm_s *s) {
+    if (s != NULL) {
+        munmap((void *)s->ring, s->size);
+        free(s);
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,555 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Client of the LoRa packet server, zero copy record splitting and
+    reconnection with backoff
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* snprintf */
+#include <stdlib.h>     /* malloc free */
+#include <string.h>     /* memchr memcpy memmove strlen */
+#include <errno.h>      /* errno */
+#include <time.h>       /* clock_gettime */
+#include <unistd.h>     /* close */
+#include <fcntl.h>      /* fcntl O_NONBLOCK */
+#include <poll.h>       /* poll */
+#include <netdb.h>      /* getaddrinfo */
+#include <sys/socket.h> /* socket connect recv send */
+
+#include "loraclient.h"
+#include "lora_frame.h"
+#include "spot_codec.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define IS_LINE(r, s)   (((r)->len == sizeof(s) - 1) && (memcmp((r)->data, s, sizeof(s) - 1) == 0))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct lc_client_s {
+    char                host[256];
+    char                port[8];
+    int                 fd;
+    int                 state;
+    int64_t             next_try;       /* time of the next connection attempt, in ms */
+    unsigned            backoff;        /* next reconnection delay, in ms */
+    unsigned            backoff_min;
+    unsigned            backoff_max;
+    uint8_t             *buf;
+    size_t              head;           /* first byte not delivered yet */
+    size_t              tail;           /* end of the bytes received */
+    bool                skip;           /* dropping the rest of a line longer than the buffer */
+    struct spot_codec_s spot;           /* predictors of the spotter frames, reset with each connection */
+    struct lc_stats_s   stats;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* complete record at 'pos', returns its size including the line ending, 0 if incomplete */
+static size_t parse_rec(const struct lc_client_s *c, size_t pos, struct lc_rec_s *rec) {
+    const uint8_t *p = c->buf + pos;
+    size_t avail = c->tail - pos;
+    const uint8_t *nl;
+    size_t len;
+
+    if (avail == 0) {
+        return 0;
+    }
+    if (p[0] == LORA_FRAME_MAGIC) {
+        if (avail < LORA_FRAME_HDR_SIZE) {
+            return 0;
+        }
+        len = lora_frame_len(p);
+        if (avail < LORA_FRAME_HDR_SIZE + len) {
+            return 0;
+        }
+        rec->data = p + LORA_FRAME_HDR_SIZE;
+        rec->len = (uint32_t)len;
+        rec->kind = LC_REC_FRAME;
+        rec->type = p[1];
+        return LORA_FRAME_HDR_SIZE + len;
+    }
+    nl = memchr(p, '\n', avail);
+    if (nl == NULL) {
+        return 0;
+    }
+    len = (size_t)(nl - p);
+    rec->data = p;
+    rec->len = (uint32_t)(((len > 0) && (p[len - 1] == '\r')) ? len - 1 : len);
+    rec->kind = LC_REC_LINE;
+    rec->type = 0;
+    return len + 1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void schedule(struct lc_client_s *c, unsigned delay_ms) {
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+    }
+    if (c->backoff_max == 0) {
+        c->state = LC_CLOSED;
+        return;
+    }
+    c->state = LC_DOWN;
+    c->next_try = now_ms() + delay_ms;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* connection lost or closed by the server, a partial record of the old connection must not be glued to the new one */
+static void disconnect(struct lc_client_s *c, bool by_server) {
+    struct lc_rec_s rec;
+    size_t pos = c->head, n;
+
+    while ((n = parse_rec(c, pos, &rec)) > 0) {
+        pos += n;
+    }
+    c->tail = pos;
+    c->skip = false;
+    ++c->stats.closes;
+    if (by_server) {
+        c->backoff = c->backoff_min;
+        schedule(c, c->backoff_min);
+    } else {
+        schedule(c, c->backoff);
+        c->backoff = (2 * c->backoff > c->backoff_max) ? c->backoff_max : 2 * c->backoff;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void start_connect(struct lc_client_s *c) {
+    struct addrinfo hints, *res = NULL;
+    int fd;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(c->host, c->port, &hints, &res) != 0) {
+        disconnect(c, false);
+        return;
+    }
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(res);
+        disconnect(c, false);
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    c->fd = fd;
+    if (connect(fd, res->ai_addr, res->ai_addrlen) == 0) {
+        c->state = LC_UP;
+        ++c->stats.connects;
+        spot_codec_reset(&c->spot, 0);
+    } else if (errno == EINPROGRESS) {
+        c->state = LC_CONNECTING;
+    } else {
+        disconnect(c, false);
+    }
+    freeaddrinfo(res);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* next record for the user, control lines and overlong lines are consumed on the way */
+static size_t next_rec(struct lc_client_s *c, struct lc_rec_s *rec) {
+    const uint8_t *nl;
+    size_t n;
+
+    for (;;) {
+        if (c->skip) {
+            nl = memchr(c->buf + c->head, '\n', c->tail - c->head);
+            c->stats.dropped += ((nl != NULL) ? (size_t)(nl + 1 - c->buf) : c->tail) - c->head;
+            if (nl == NULL) {
+                c->head = c->tail;
+                return 0;
+            }
+            c->head = (size_t)(nl + 1 - c->buf);
+            c->skip = false;
+        }
+        n = parse_rec(c, c->head, rec);
+        if (n == 0) {
+            if ((c->head == 0) && (c->tail == LC_BUF_SIZE)) {
+                c->skip = true; /* a line longer than the buffer, dropped */
+                continue;
+            }
+            return 0;
+        }
+        if (rec->kind == LC_REC_LINE) {
+            if (IS_LINE(rec, "Connected...")) {
+                c->head += n;
+                ++c->stats.hellos;
+                c->backoff = c->backoff_min;
+                continue;
+            } else if (IS_LINE(rec, "DISCONNECT")) {
+                c->head += n;
+                disconnect(c, true);
+                continue;
+            }
+        }
+        return n;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* one step of the connection, waiting up to wait_ms, records delivered before are not valid any more */
+static void do_io(struct lc_client_s *c, int wait_ms) {
+    struct pollfd pfd;
+    int64_t t;
+    ssize_t n;
+    int err = 0;
+    socklen_t errlen = sizeof err;
+
+    switch (c->state) {
+        case LC_DOWN:
+            t = now_ms();
+            if (t < c->next_try) {
+                poll(NULL, 0, ((wait_ms < 0) || (c->next_try - t < wait_ms)) ? (int)(c->next_try - t) : wait_ms);
+                return;
+            }
+            start_connect(c);
+            return;
+
+        case LC_CONNECTING:
+            pfd.fd = c->fd;
+            pfd.events = POLLOUT;
+            if (poll(&pfd, 1, wait_ms) <= 0) {
+                return;
+            }
+            getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &errlen);
+            if (err != 0) {
+                disconnect(c, false);
+            } else {
+                c->state = LC_UP;
+                ++c->stats.connects;
+                spot_codec_reset(&c->spot, 0);
+            }
+            return;
+
+        case LC_UP:
+            /* records of the previous calls are released, make room */
+            if ((c->head > 0) && ((c->head == c->tail) || (c->tail > LC_BUF_SIZE / 2))) {
+                memmove(c->buf, c->buf + c->head, c->tail - c->head);
+                c->tail -= c->head;
+                c->head = 0;
+            }
+            pfd.fd = c->fd;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, wait_ms) <= 0) {
+                return;
+            }
+            n = recv(c->fd, c->buf + c->tail, LC_BUF_SIZE - c->tail, 0);
+            if (n > 0) {
+                c->tail += (size_t)n;
+                c->stats.bytes += (uint64_t)n;
+            } else if ((n == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))) {
+                disconnect(c, false);
+            }
+            return;
+
+        default:
+            return;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int time_left(int64_t deadline, int timeout_ms) {
+    int64_t left;
+
+    if (timeout_ms < 0) {
+        return -1;
+    }
+    left = deadline - now_ms();
+    return (left > 0) ? (int)left : 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* wait for more bytes, false once the time is up with nothing more to parse */
+static bool wait_more(struct lc_client_s *c, int64_t deadline, int *timeout_ms) {
+    struct lc_rec_s rec;
+    int left = time_left(deadline, *timeout_ms);
+
+    if (left != 0) {
+        do_io(c, left);
+        return true;
+    }
+    do_io(c, 0); /* a last look at the socket */
+    if (parse_rec(c, c->head, &rec) == 0) {
+        return false;
+    }
+    *timeout_ms = 0;
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void count(struct lc_client_s *c, const struct lc_rec_s *rec) {
+    if (rec->kind == LC_REC_LINE) {
+        ++c->stats.lines;
+    } else {
+        ++c->stats.frames;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+struct lc_client_s *lc_create(const char *host, uint16_t port) {
+    struct lc_client_s *c;
+
+    c = calloc(1, sizeof *c);
+    if (c == NULL) {
+        return NULL;
+    }
+    c->buf = malloc(LC_BUF_SIZE);
+    if (c->buf == NULL) {
+        free(c);
+        return NULL;
+    }
+    snprintf(c->host, sizeof c->host, "%s", host);
+    snprintf(c->port, sizeof c->port, "%u", (unsigned)port);
+    c->fd = -1;
+    c->state = LC_DOWN;
+    c->next_try = 0; /* right away */
+    c->backoff = c->backoff_min = LC_BACKOFF_MIN_MS;
+    c->backoff_max = LC_BACKOFF_MAX_MS;
+    return c;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lc_set_backoff(struct lc_client_s *c, unsigned min_ms, unsigned max_ms) {
+    c->backoff_min = (min_ms > 0) ? min_ms : 1;
+    c->backoff_max = (max_ms >= c->backoff_min) ? max_ms : ((max_ms == 0) ? 0 : c->backoff_min);
+    c->backoff = c->backoff_min;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lc_state(const struct lc_client_s *c) {
+    return c->state;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lc_pull(struct lc_client_s *c, struct lc_rec_s *recs, int max, int timeout_ms) {
+    int64_t deadline = now_ms() + ((timeout_ms > 0) ? timeout_ms : 0);
+    size_t n;
+    int nb = 0;
+
+    do {
+        while ((nb < max) && ((n = next_rec(c, &recs[nb])) > 0)) {
+            c->head += n;
+            count(c, &recs[nb++]);
+        }
+        if (nb > 0) {
+            return nb;
+        } else if (c->state == LC_CLOSED) {
+            return LC_ERROR;
+        }
+    } while (wait_more(c, deadline, &timeout_ms));
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+long lc_run(struct lc_client_s *c, lc_callback cb, void *ctx, int timeout_ms) {
+    int64_t deadline = now_ms() + ((timeout_ms > 0) ? timeout_ms : 0);
+    struct lc_rec_s rec;
+    long total = 0;
+    size_t n;
+
+    do {
+        /* the buffer is only compacted while waiting, each record stays valid during its call */
+        while ((n = next_rec(c, &rec)) > 0) {
+            c->head += n;
+            count(c, &rec);
+            ++total;
+            if (cb(&rec, ctx) != 0) {
+                return total;
+            }
+        }
+        if (c->state == LC_CLOSED) {
+            return (total > 0) ? total : LC_ERROR;
+        }
+    } while (wait_more(c, deadline, &timeout_ms));
+    return total;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+long lc_pull_lines(struct lc_client_s *c, char *out, size_t size, int timeout_ms) {
+    int64_t deadline = now_ms() + ((timeout_ms > 0) ? timeout_ms : 0);
+    struct lc_rec_s rec;
+    struct lc_spot_s spot;
+    char line[LC_SPOT_LINE_MAX];
+    size_t n, used = 0, len;
+
+    if (size < 2) {
+        return LC_ERROR;
+    }
+    do {
+        while ((n = next_rec(c, &rec)) > 0) {
+            if (rec.kind == LC_REC_FRAME) {
+                /* spotter frames are turned back into their text line, other frames are not for text bindings */
+                if ((rec.type == LC_SPOT_FRAME) && (used > 0) && (used + LC_SPOT_LINE_MAX > size)) {
+                    return (long)used; /* decoded once only, by the next call */
+                }
+                if ((rec.type != LC_SPOT_FRAME) || (lc_spot_decode(c, &rec, &spot) != LC_SUCCESS)) {
+                    c->head += n;
+                    continue;
+                }
+                rec.data = (const uint8_t *)line;
+                rec.len = (uint32_t)lc_spot_format(&spot, line, sizeof line) - 1;
+            }
+            len = rec.len;
+            if (used + len + 1 > size) {
+                if (used > 0) {
+                    return (long)used; /* left for the next call */
+                }
+                len = size - 1;
+            }
+            memcpy(out + used, rec.data, len);
+            used += len;
+            out[used++] = '\n';
+            c->head += n;
+            ++c->stats.lines;
+        }
+        if (used > 0) {
+            return (long)used;
+        } else if (c->state == LC_CLOSED) {
+            return LC_ERROR;
+        }
+    } while (wait_more(c, deadline, &timeout_ms));
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lc_send(struct lc_client_s *c, const char *cmd) {
+    size_t len = strlen(cmd);
+
+    if (c->state != LC_UP) {
+        return LC_ERROR;
+    }
+    if (send(c->fd, cmd, len, MSG_NOSIGNAL) != (ssize_t)len) {
+        return LC_ERROR;
+    }
+    return LC_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lc_spot_decode(struct lc_client_s *c, const struct lc_rec_s *rec, struct lc_spot_s *spot) {
+    struct spot_codec_rec_s r;
+    int i;
+
+    if ((rec->kind != LC_REC_FRAME) || (rec->type != LC_SPOT_FRAME)) {
+        return LC_ERROR;
+    }
+    i = spot_codec_decode(&c->spot, rec->data, rec->len, &r);
+    if (i == SPOT_CODEC_RESYNC) {
+        ++c->stats.resyncs;
+        return LC_SPOT_RESYNC;
+    } else if (i != SPOT_CODEC_OK) {
+        return LC_ERROR;
+    }
+    spot->spotn = r.spotn;
+    spot->type = r.type;
+    spot->tenths = r.tenths;
+    spot->X = r.X;
+    spot->Y = r.Y;
+    spot->Z = r.Z;
+    spot->LATD = r.LATD;
+    spot->LATM = r.LATM;
+    spot->LOND = r.LOND;
+    spot->LONM = r.LONM;
+    spot->has_utc = r.has_utc;
+    spot->utc_us = r.utc_us;
+    return LC_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lc_spot_format(const struct lc_spot_s *spot, char *buf, size_t len) {
+    float latitude, longitude;
+    int n, m;
+
+    /* same computation as the server, for the same digits */
+    latitude = spot->LATD + (spot->LATM / 6000000.0);
+    longitude = spot->LOND + (spot->LONM / 6000000.0);
+    n = snprintf(buf, len, "#%u,%u,%llu,%ld,%ld,%ld,%.9f,%.9f\n", spot->spotn, spot->type, (unsigned long long)spot->tenths,
+                 (long int)spot->X, (long int)spot->Y, (long int)spot->Z, latitude, longitude);
+    if ((n < 0) || ((size_t)n >= len)) {
+        return (int)len - 1;
+    }
+    if (spot->has_utc == true) {
+        m = snprintf(buf + n - 1, len - n + 1, ",%lld.%06lld\n", (long long)(spot->utc_us / 1000000), (long long)(spot->utc_us % 1000000));
+        if ((m > 0) && ((size_t)m < len - n + 1)) {
+            n += m - 1;
+        } else {
+            buf[n - 1] = '\n';
+        }
+    }
+    return n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lc_get_stats(const struct lc_client_s *c, struct lc_stats_s *stats) {
+    *stats = c->stats;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lc_destroy(struct lc_client_s *c) {
+    if (c == NULL) {
+        return;
+    }
+    if (c->fd >= 0) {
+        close(c->fd);
+    }
+    free(c->buf);
+    free(c);
+}
+
+/* --- EOF ------------------------------------------------------------------ */
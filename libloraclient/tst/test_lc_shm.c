@@ -0,0 +1,237 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Shared memory ring between a writer and two reader processes, one of
+    them slow on purpose: lines are published as fast as possible, readers
+    check that every line they get is whole and that the lines they miss
+    are counted as lost. Then the ring is taken over by a new writer, paced
+    so that nothing is lost, and the readers must go on with its lines.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>     /* EXIT_SUCCESS */
+#include <string.h>     /* memcmp */
+#include <time.h>       /* clock_gettime */
+#include <unistd.h>     /* fork pipe read write usleep ftruncate */
+#include <fcntl.h>      /* O_CREAT O_RDWR */
+#include <sys/mman.h>   /* shm_open mmap */
+#include <sys/wait.h>   /* waitpid */
+
+#include "loraclient.h"
+#include "shm_ring.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define RING_NAME       "/test_lc_shm"
+#define NB_FAST         2000000     /* lines published as fast as possible */
+#define NB_PACED        4000        /* lines published by the second writer */
+#define NB_READER       2
+#define SLOW_EVERY      5000        /* the slow reader sleeps 1 ms every N lines */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static double elapsed_s(struct timespec *t0, struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+/* line number n, its length and content drawn from n so that readers can check it */
+static int format_line(char *buf, uint32_t n) {
+    int len = 16 + (int)(n % 100);
+    int i;
+
+    i = sprintf(buf, "#%u,", n);
+    while (i < len) {
+        buf[i] = 'a' + (n + i) % 26;
+        ++i;
+    }
+    return len;
+}
+
+/* read until the server stops, report over the pipe when the last fast line is read */
+static int reader(bool slow, int ready_fd) {
+    struct lc_shm_s *s;
+    struct lc_rec_s recs[64];
+    struct lc_shm_stats_s st;
+    struct timespec t0, t1;
+    char expect[128];
+    uint64_t gaps = 0, gaps_fast = 0, nb_fast = 0;
+    uint32_t n, next = 0, nb_read = 0;
+    bool paced = false;
+    int i, nb, len, nb_err = 0;
+    char c = 0;
+
+    s = lc_shm_open(RING_NAME);
+    if (s == NULL) {
+        printf("ERROR: reader failed to open the ring\n");
+        return 1;
+    }
+    if (write(ready_fd, &c, 1) != 1) {
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while ((nb = lc_shm_pull(s, recs, 64, 10000)) > 0) {
+        for (i = 0; i < nb; ++i) {
+            if (sscanf((const char *)recs[i].data, "#%u,", &n) != 1) {
+                printf("ERROR: unreadable line\n");
+                ++nb_err;
+                continue;
+            }
+            len = format_line(expect, n);
+            if (((int)recs[i].len != len) || (memcmp(recs[i].data, expect, len) != 0)) {
+                printf("ERROR: line %u torn\n", n);
+                ++nb_err;
+            }
+            if ((n < next) && (paced == false)) {
+                /* lines of the new writer */
+                paced = true;
+                gaps_fast = gaps;
+                next = 0;
+            } else if (n < next) {
+                printf("ERROR: line %u after line %u\n", n, next - 1);
+                ++nb_err;
+            }
+            gaps += n - next;
+            next = n + 1;
+            ++nb_read;
+            if ((paced == false) && (n == NB_FAST - 1)) {
+                clock_gettime(CLOCK_MONOTONIC, &t1);
+                nb_fast = nb_read;
+                if (write(ready_fd, &c, 1) != 1) {
+                    return 1;
+                }
+            }
+            if ((slow == true) && ((nb_read % SLOW_EVERY) == 0)) {
+                usleep(1000);
+            }
+        }
+    }
+    lc_shm_get_stats(s, &st);
+    lc_shm_close(s);
+
+    printf("%s reader: %llu of %u fast lines in %.3f s (%.0f lines/s, %llu lost), %u of %u paced lines, %u restart\n",
+           (slow == true) ? "slow" : "fast", (unsigned long long)nb_fast, NB_FAST, elapsed_s(&t0, &t1), nb_fast / elapsed_s(&t0, &t1),
+           (unsigned long long)st.lost, nb_read - (uint32_t)nb_fast, NB_PACED, st.restarts);
+    if ((nb != LC_ERROR) || (paced == false) || (next != NB_PACED) || (st.restarts != 1)) {
+        printf("ERROR: end of the stream not seen\n");
+        ++nb_err;
+    }
+    if ((st.lost != gaps) || (gaps != gaps_fast) || (nb_fast + gaps_fast != NB_FAST) || (st.lines != nb_read)) {
+        printf("ERROR: %llu lines lost counted, %llu missing\n", (unsigned long long)st.lost, (unsigned long long)gaps);
+        ++nb_err;
+    }
+    if ((slow == true) && (st.lost == 0)) {
+        printf("ERROR: the slow reader was never overrun\n");
+        ++nb_err;
+    }
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    struct shm_ring_hdr_s *ring;
+    struct timespec t0, t1;
+    size_t size = shm_ring_size(SHM_RING_NB_SLOT);
+    char line[128];
+    pid_t pid[NB_READER];
+    int ready[2];
+    int fd, i, status;
+    int nb_err = 0;
+    char c;
+
+    /* writer side, as the packet server does it */
+    shm_unlink(RING_NAME);
+    fd = shm_open(RING_NAME, O_CREAT | O_RDWR, 0600);
+    if ((fd < 0) || (ftruncate(fd, size) != 0) || ((ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)) {
+        printf("ERROR: failed to create the shared memory\n");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    shm_ring_init(ring, SHM_RING_NB_SLOT);
+    if (lc_shm_open("/test_lc_shm_none") != NULL) {
+        printf("ERROR: ring opened without a writer\n");
+        ++nb_err;
+    }
+
+    if (pipe(ready) != 0) {
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < NB_READER; ++i) {
+        pid[i] = fork();
+        if (pid[i] == 0) {
+            close(ready[0]);
+            return (reader(i == 1, ready[1]) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    close(ready[1]);
+    for (i = 0; i < NB_READER; ++i) {
+        if (read(ready[0], &c, 1) != 1) {
+            printf("ERROR: reader did not start\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* as fast as possible, the readers get what they can */
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < NB_FAST; ++i) {
+        shm_ring_put(ring, line, format_line(line, i));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("writer: %u lines in %.3f s, %.0f lines/s\n", NB_FAST, elapsed_s(&t0, &t1), NB_FAST / elapsed_s(&t0, &t1));
+    for (i = 0; i < NB_READER; ++i) {
+        if (read(ready[0], &c, 1) != 1) {
+            printf("ERROR: reader did not get the last line\n");
+            ++nb_err;
+        }
+    }
+
+    /* a new writer takes the ring over, slowly enough for the readers */
+    shm_ring_init(ring, SHM_RING_NB_SLOT);
+    for (i = 0; i < NB_PACED; ++i) {
+        shm_ring_put(ring, line, format_line(line, i));
+        if ((i % 64) == 63) {
+            usleep(2000);
+        }
+    }
+    usleep(20000);
+    shm_ring_stop(ring);
+
+    for (i = 0; i < NB_READER; ++i) {
+        waitpid(pid[i], &status, 0);
+        if (!WIFEXITED(status) || (WEXITSTATUS(status) != EXIT_SUCCESS)) {
+            ++nb_err;
+        }
+    }
+    munmap(ring, size);
+    shm_unlink(RING_NAME);
+    printf("%s: %d error(s)\n", (nb_err == 0) ? "PASS" : "FAIL", nb_err);
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
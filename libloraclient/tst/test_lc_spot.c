@@ -0,0 +1,272 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Spotter frames from a local server process: samples of 8 spotters are
+    delta encoded as the packet server does, some frames are withheld on
+    the first connection to check that decoding stops until the next
+    keyframe, the second connection is read as text lines. Reports the
+    bytes per sample, compared to the text lines.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>     /* exit */
+#include <string.h>     /* memcmp */
+#include <math.h>       /* sin */
+#include <unistd.h>     /* fork close write */
+#include <sys/wait.h>   /* waitpid */
+#include <sys/socket.h> /* socket bind listen accept */
+#include <netinet/in.h> /* sockaddr_in */
+#include <arpa/inet.h>  /* htons */
+
+#include "loraclient.h"
+#include "lora_frame.h"
+#include "spot_codec.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_SPOT         8
+#define NB_SAMPLE       200000  /* samples of all spotters, per connection */
+#define DROP_EVERY      97      /* frames withheld on the first connection, as a rate limit would */
+#define STAT_EVERY      1000    /* a text line now and then, as the server does */
+#define CHUNK           8192
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static uint8_t chunk[CHUNK + 128];
+static size_t chunk_len;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void put(int fd, const void *data, size_t len) {
+    if (chunk_len + len > CHUNK) {
+        if (write(fd, chunk, chunk_len) < 0) exit(EXIT_FAILURE);
+        chunk_len = 0;
+    }
+    memcpy(chunk + chunk_len, data, len);
+    chunk_len += len;
+}
+
+static void flush(int fd) {
+    if ((chunk_len > 0) && (write(fd, chunk, chunk_len) < 0)) exit(EXIT_FAILURE);
+    chunk_len = 0;
+}
+
+/* sample n of a spotter: 2 Hz with some late ones, waves of a few meters, position moving now and then */
+static void gen(int spotn, unsigned n, struct spot_codec_rec_s *r) {
+    double t = n * 0.5 + spotn;
+
+    r->spotn = (uint8_t)spotn;
+    r->type = 2;
+    r->tenths = 16000000000ULL + n * 5 + (((n * 7 + spotn) % 13) == 0);
+    r->X = (int32_t)(1200 * sin(t * 0.71) + 300 * sin(t * 1.9));
+    r->Y = (int32_t)(900 * sin(t * 0.63 + 1) + 200 * sin(t * 2.3));
+    r->Z = (int32_t)(1500 * sin(t * 0.52 + 2) + 400 * sin(t * 1.7) + (int)(n % 5) - 2);
+    r->LATD = 45;
+    r->LATM = 740000 + spotn * 1000 + (int32_t)(n / 400);
+    r->LOND = -1;
+    r->LONM = 3000000 + spotn * 1000 - (int32_t)(n / 600);
+    r->has_utc = true;
+    r->utc_us = (int64_t)r->tenths * 100000 + 250000 + (n * 7919) % 90000;
+}
+
+static bool same(const struct lc_spot_s *s, const struct spot_codec_rec_s *r) {
+    return (s->spotn == r->spotn) && (s->type == r->type) && (s->tenths == r->tenths) && (s->X == r->X) && (s->Y == r->Y) &&
+           (s->Z == r->Z) && (s->LATD == r->LATD) && (s->LATM == r->LATM) && (s->LOND == r->LOND) && (s->LONM == r->LONM) &&
+           (s->has_utc == r->has_utc) && (s->utc_us == r->utc_us);
+}
+
+static void to_spot(const struct spot_codec_rec_s *r, struct lc_spot_s *s) {
+    s->spotn = r->spotn;
+    s->type = r->type;
+    s->tenths = r->tenths;
+    s->X = r->X;
+    s->Y = r->Y;
+    s->Z = r->Z;
+    s->LATD = r->LATD;
+    s->LATM = r->LATM;
+    s->LOND = r->LOND;
+    s->LONM = r->LONM;
+    s->has_utc = r->has_utc;
+    s->utc_us = r->utc_us;
+}
+
+/* the same stream twice, some frames withheld the first time */
+static void serve(int lsock) {
+    struct spot_codec_s enc;
+    struct spot_codec_rec_s r;
+    uint8_t frame[LORA_FRAME_HDR_SIZE + SPOT_CODEC_PAYLOAD_MAX];
+    char line[64];
+    unsigned k;
+    int conn, fd, len;
+
+    for (conn = 0; conn < 2; ++conn) {
+        fd = accept(lsock, NULL, NULL);
+        put(fd, "Connected...\n", 13);
+        spot_codec_reset(&enc, SPOT_CODEC_KEY_INTERVAL);
+        for (k = 0; k < NB_SAMPLE; ++k) {
+            gen(k % NB_SPOT, k / NB_SPOT, &r);
+            len = spot_codec_encode(&enc, &r, frame + LORA_FRAME_HDR_SIZE);
+            lora_frame_header(frame, LORA_FRAME_SPOT, (uint16_t)len);
+            if ((conn == 1) || ((k % DROP_EVERY) != 50)) {
+                put(fd, frame, LORA_FRAME_HDR_SIZE + len);
+            }
+            if ((k % STAT_EVERY) == 0) {
+                put(fd, line, sprintf(line, "$STAT,%u,120,118,2,-85.3,\n", k % NB_SPOT));
+            }
+        }
+        put(fd, "$END\nDISCONNECT\n", 16);
+        flush(fd);
+        close(fd);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    struct sockaddr_in addr;
+    socklen_t alen = sizeof addr;
+    struct lc_client_s *c;
+    struct lc_rec_s recs[256];
+    struct lc_spot_s spot, ref;
+    struct lc_stats_s st;
+    struct spot_codec_rec_s r;
+    unsigned next[NB_SPOT] = {0};
+    unsigned n, nb_ok = 0, nb_resync = 0, nb_text = 0, nb_line = 0, nb_frame = 0, nb_key = 0;
+    uint64_t bytes_frame = 0, bytes_text = 0;
+    char *out, line[LC_SPOT_LINE_MAX];
+    char *p, *nl;
+    int lsock, i, nb, len;
+    long got;
+    pid_t pid;
+    int nb_err = 0;
+
+    lsock = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(lsock, (struct sockaddr *)&addr, sizeof addr) != 0) || (listen(lsock, 1) != 0) ||
+        (getsockname(lsock, (struct sockaddr *)&addr, &alen) != 0)) {
+        printf("ERROR: no local server\n");
+        return EXIT_FAILURE;
+    }
+    pid = fork();
+    if (pid == 0) {
+        serve(lsock);
+        return EXIT_SUCCESS;
+    }
+    close(lsock);
+    c = lc_create("127.0.0.1", ntohs(addr.sin_port));
+    lc_set_backoff(c, 10, 100);
+
+    /* first connection, frames decoded one by one, some missing */
+    while ((nb_line == 0) && ((nb = lc_pull(c, recs, 256, 5000)) > 0)) {
+        for (i = 0; i < nb; ++i) {
+            if (recs[i].kind == LC_REC_LINE) {
+                nb_line += (recs[i].len == 4) && (memcmp(recs[i].data, "$END", 4) == 0);
+                continue;
+            }
+            ++nb_frame;
+            bytes_frame += LORA_FRAME_HDR_SIZE + recs[i].len;
+            nb_key += (recs[i].data[1] & SPOT_CODEC_KEY) ? 1 : 0;
+            switch (lc_spot_decode(c, &recs[i], &spot)) {
+                case LC_SUCCESS:
+                    /* the first sample of the spotter after the expected one that matches */
+                    for (n = next[spot.spotn]; n < next[spot.spotn] + 2 * SPOT_CODEC_KEY_INTERVAL; ++n) {
+                        gen(spot.spotn, n, &r);
+                        if (same(&spot, &r)) {
+                            break;
+                        }
+                    }
+                    if (n == next[spot.spotn] + 2 * SPOT_CODEC_KEY_INTERVAL) {
+                        printf("ERROR: spotter %u, sample decoded wrong after sample %u\n", spot.spotn, next[spot.spotn]);
+                        ++nb_err;
+                    } else {
+                        to_spot(&r, &ref);
+                        lc_spot_format(&ref, line, sizeof line);
+                        bytes_text += strlen(line);
+                    }
+                    next[spot.spotn] = n + 1;
+                    ++nb_ok;
+                    break;
+                case LC_SPOT_RESYNC:
+                    ++nb_resync;
+                    break;
+                default:
+                    printf("ERROR: invalid frame\n");
+                    ++nb_err;
+            }
+        }
+    }
+    lc_get_stats(c, &st);
+    n = NB_SAMPLE - (NB_SAMPLE + DROP_EVERY - 51) / DROP_EVERY; /* frames sent */
+    printf("frames: %u samples decoded, %u waiting for a keyframe, %u keyframes, %u sent\n", nb_ok, nb_resync, nb_key, n);
+    printf("bytes per sample: %.1f as frames, %.1f as text lines (%.1f%%)\n", (double)bytes_frame / nb_frame,
+           (double)bytes_text / nb_ok, 100.0 * bytes_frame / nb_frame / ((double)bytes_text / nb_ok));
+    if ((nb_frame != n) || (nb_ok + nb_resync != n) || (st.resyncs != nb_resync) || (nb_resync == 0) ||
+        (nb_resync > (NB_SAMPLE / DROP_EVERY + 1) * SPOT_CODEC_KEY_INTERVAL)) {
+        printf("ERROR: frames lost or not decoded again after a keyframe\n");
+        ++nb_err;
+    }
+
+    /* second connection, the same samples as text lines */
+    out = malloc(1 << 20);
+    memset(next, 0, sizeof next);
+    nb_line = 0;
+    while ((nb_line < NB_SAMPLE) && ((got = lc_pull_lines(c, out, 1 << 20, 5000)) > 0)) {
+        for (p = out; (nl = memchr(p, '\n', out + got - p)) != NULL; p = nl + 1) {
+            if (*p != '#') {
+                nb_text++;
+                continue;
+            }
+            len = (int)(nl - p + 1);
+            i = *(p + 1) - '0';
+            gen(i, next[i]++, &r);
+            to_spot(&r, &ref);
+            if ((lc_spot_format(&ref, line, sizeof line) != len) || (memcmp(line, p, len) != 0)) {
+                printf("ERROR: line %u: %.*s", nb_line, len, p);
+                ++nb_err;
+            }
+            ++nb_line;
+        }
+    }
+    printf("text lines: %u samples, %u other lines\n", nb_line, nb_text);
+    if (nb_line != NB_SAMPLE) {
+        printf("ERROR: %u samples missing\n", NB_SAMPLE - nb_line);
+        ++nb_err;
+    }
+    free(out);
+
+    lc_destroy(c);
+    waitpid(pid, NULL, 0);
+    printf("%s: %d error(s)\n", (nb_err == 0) ? "PASS" : "FAIL", nb_err);
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,270 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Client library against a local server process: lines split across
+    reads, binary frames, control lines, a connection cut in the middle of
+    a line, a line longer than the buffer and the reconnections. Then the
+    number of records per second the client sustains, pulled in batches
+    and through a callback.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>     /* malloc atoi */
+#include <string.h>     /* memset strlen */
+#include <signal.h>     /* kill signal */
+#include <time.h>       /* clock_gettime */
+#include <unistd.h>     /* fork write close */
+#include <sys/wait.h>   /* waitpid */
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "loraclient.h"
+#include "lora_frame.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_LINES        100000  /* lines of the first connection */
+#define FRAME_EVERY     1000    /* one frame every N lines */
+#define NB_BENCH        2000000 /* lines of the throughput runs */
+#define CHUNK           8192    /* server writes */
+
+static const char end_line[] = "#9,9,0,0,0,0";
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static char chunk[CHUNK + 128];
+static size_t chunk_len;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static double elapsed_s(struct timespec *t0, struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+static void put(int fd, const void *data, size_t len) {
+    if (chunk_len + len > CHUNK) {
+        if (write(fd, chunk, chunk_len) < 0) exit(EXIT_FAILURE);
+        chunk_len = 0;
+    }
+    if (len > CHUNK) {
+        if (write(fd, data, len) < 0) exit(EXIT_FAILURE);
+        return;
+    }
+    memcpy(chunk + chunk_len, data, len);
+    chunk_len += len;
+}
+
+static void flush(int fd) {
+    if ((chunk_len > 0) && (write(fd, chunk, chunk_len) < 0)) exit(EXIT_FAILURE);
+    chunk_len = 0;
+}
+
+static int format_line(char *buf, unsigned seq) {
+    return sprintf(buf, "#%u,2,%u,-695,743,-16,45.123456789,-1.500000000\n", seq % 8, seq);
+}
+
+/* lines with a frame now and then, the first connection ends with DISCONNECT, the second one is cut, the third one has an overlong line */
+static void serve(int lsock, unsigned nb_bench) {
+    char line[128];
+    uint8_t frame[LORA_FRAME_HDR_SIZE + 16];
+    char *big;
+    unsigned i;
+    int fd, n;
+
+    fd = accept(lsock, NULL, NULL);
+    put(fd, "Connected...\n", 13);
+    for (i = 0; i < NB_LINES; ++i) {
+        n = format_line(line, i);
+        put(fd, line, n);
+        if ((i % FRAME_EVERY) == 0) {
+            lora_frame_header(frame, 7, 16);
+            memset(frame + LORA_FRAME_HDR_SIZE, '\n', 8);
+            memset(frame + LORA_FRAME_HDR_SIZE + 8, LORA_FRAME_MAGIC, 8);
+            put(fd, frame, sizeof frame);
+        }
+    }
+    put(fd, "#1,2,7,8,9,10\r\n", 15);
+    put(fd, "DISCONNECT\n", 11);
+    flush(fd);
+    close(fd);
+
+    fd = accept(lsock, NULL, NULL);
+    put(fd, "Connected...\n#2,2,1,2,3,4\n#2,2,1,2", 34); /* cut in the middle */
+    flush(fd);
+    close(fd);
+
+    fd = accept(lsock, NULL, NULL);
+    big = malloc(LC_BUF_SIZE + 1000);
+    memset(big, 'x', LC_BUF_SIZE + 999);
+    big[0] = '$';
+    big[LC_BUF_SIZE + 999] = '\n';
+    put(fd, "Connected...\n", 13);
+    put(fd, big, LC_BUF_SIZE + 1000);
+    put(fd, end_line, strlen(end_line));
+    put(fd, "\n", 1);
+    flush(fd);
+    free(big);
+
+    /* throughput, the client closes when done */
+    fd = accept(lsock, NULL, NULL);
+    for (i = 0; i < nb_bench; ++i) {
+        put(fd, line, format_line(line, i));
+    }
+    flush(fd);
+    fd = accept(lsock, NULL, NULL);
+    for (i = 0; i < nb_bench; ++i) {
+        put(fd, line, format_line(line, i));
+    }
+    flush(fd);
+    sleep(60); /* killed by the client */
+}
+
+static int count_cb(const struct lc_rec_s *rec, void *ctx) {
+    unsigned long *nb = ctx;
+
+    (void)rec;
+    return (++*nb >= NB_BENCH) ? 1 : 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    struct sockaddr_in addr;
+    socklen_t alen = sizeof addr;
+    struct lc_client_s *c;
+    struct lc_rec_s recs[64];
+    struct lc_stats_s st;
+    struct timespec t0, t1;
+    char expect[128];
+    unsigned long nb_cb = 0;
+    unsigned seq = 0, nb_frames = 0, nb_bench = 0;
+    bool done = false, got_crlf = false, got_cut = false;
+    int lsock, nb_err = 0, i, j, n, len;
+    pid_t pid;
+
+    /* local server */
+    lsock = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(lsock, (struct sockaddr *)&addr, sizeof addr) != 0) || (listen(lsock, 4) != 0)) {
+        printf("ERROR: impossible to listen on the loopback interface\n");
+        return EXIT_FAILURE;
+    }
+    getsockname(lsock, (struct sockaddr *)&addr, &alen);
+    pid = fork();
+    if (pid == 0) {
+        serve(lsock, NB_BENCH);
+        return EXIT_SUCCESS;
+    }
+    close(lsock);
+
+    /* functional part */
+    c = lc_create("127.0.0.1", ntohs(addr.sin_port));
+    lc_set_backoff(c, 10, 100);
+    while (!done) {
+        n = lc_pull(c, recs, 64, 5000);
+        if (n <= 0) {
+            printf("ERROR: pull returned %d, %u lines received\n", n, seq);
+            ++nb_err;
+            break;
+        }
+        for (i = 0; i < n; ++i) {
+            if (recs[i].kind == LC_REC_FRAME) {
+                for (j = 0; j < 16; ++j) {
+                    if (recs[i].data[j] != ((j < 8) ? '\n' : LORA_FRAME_MAGIC)) break;
+                }
+                if ((recs[i].type != 7) || (recs[i].len != 16) || (j != 16) || (seq != nb_frames * FRAME_EVERY + 1)) {
+                    printf("ERROR: frame %u wrong or misplaced\n", nb_frames);
+                    ++nb_err;
+                }
+                ++nb_frames;
+                continue;
+            }
+            if (seq < NB_LINES) {
+                len = format_line(expect, seq) - 1;
+                if (((int)recs[i].len != len) || (memcmp(recs[i].data, expect, len) != 0)) {
+                    printf("ERROR: line %u is '%.*s'\n", seq, (int)recs[i].len, recs[i].data);
+                    ++nb_err;
+                }
+                ++seq;
+            } else if ((recs[i].len == 13) && (memcmp(recs[i].data, "#1,2,7,8,9,10", 13) == 0)) {
+                got_crlf = true;
+            } else if ((recs[i].len == 12) && (memcmp(recs[i].data, "#2,2,1,2,3,4", 12) == 0)) {
+                got_cut = true;
+            } else if ((recs[i].len == strlen(end_line)) && (memcmp(recs[i].data, end_line, recs[i].len) == 0)) {
+                done = true;
+            } else {
+                printf("ERROR: unexpected line '%.*s'\n", (int)recs[i].len, recs[i].data);
+                ++nb_err;
+            }
+        }
+    }
+    lc_get_stats(c, &st);
+    printf("%u lines, %u frames, %u connections, %u hellos, %u closes, %llu bytes dropped\n", seq, nb_frames, st.connects, st.hellos, st.closes, (unsigned long long)st.dropped);
+    if ((seq != NB_LINES) || (nb_frames != NB_LINES / FRAME_EVERY) || !got_crlf || !got_cut) {
+        printf("ERROR: records missing\n");
+        ++nb_err;
+    }
+    if ((st.connects != 3) || (st.hellos != 3) || (st.closes != 2) || (st.dropped != LC_BUF_SIZE + 1000)) {
+        printf("ERROR: wrong connection counters\n");
+        ++nb_err;
+    }
+    lc_destroy(c);
+
+    /* throughput, batch pull then callback */
+    c = lc_create("127.0.0.1", ntohs(addr.sin_port));
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while ((nb_bench < NB_BENCH) && ((n = lc_pull(c, recs, 64, 5000)) > 0)) {
+        nb_bench += n;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("batch pull: %u records in %.3f s, %.0f records/s\n", nb_bench, elapsed_s(&t0, &t1), nb_bench / elapsed_s(&t0, &t1));
+    lc_destroy(c);
+
+    c = lc_create("127.0.0.1", ntohs(addr.sin_port));
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    lc_run(c, count_cb, &nb_cb, 10000);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("callback: %lu records in %.3f s, %.0f records/s\n", nb_cb, elapsed_s(&t0, &t1), nb_cb / elapsed_s(&t0, &t1));
+    lc_destroy(c);
+    if ((nb_bench != NB_BENCH) || (nb_cb != NB_BENCH)) {
+        printf("ERROR: throughput runs incomplete\n");
+        ++nb_err;
+    }
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    printf("%s: %d error(s)\n", (nb_err == 0) ? "PASS" : "FAIL", nb_err);
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
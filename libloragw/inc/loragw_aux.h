@@ -20,8 +20,30 @@ Maintainer: Sylvain Miermont
 /* -------------------------------------------------------------------------- */
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
 #include "config.h"    /* library configuration options (dynamically generated) */
 
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_CNT_REFRESH_MS  600000  /* longest time without a counter sample, well below the 2^31 us of a half wrap */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_cnt_ext_s
+@brief Extension of the 32-bit concentrator counter to 64 bits
+*/
+struct lgw_cnt_ext_s {
+    bool        valid;      /*!> a sample was taken since the counter started */
+    uint32_t    last;       /*!> latest counter sample that moved the extension forward */
+    uint64_t    ext;        /*!> its extended value, low 32 bits equal to last */
+    uint64_t    last_ms;    /*!> monotonic time of that sample, ms */
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC MACROS -------------------------------------------------------- */
 
@@ -43,6 +65,48 @@ Maintainer: Sylvain Miermont
 */
 void wait_ms(unsigned long t);
 
+/**
+@brief Monotonic time
+@return milliseconds since an arbitrary point, never going back
+*/
+uint64_t lgw_mono_ms(void);
+
+/**
+@brief Start the extension over, the counter restarted from zero
+@param e counter extension
+*/
+void lgw_cnt_ext_init(struct lgw_cnt_ext_s *e);
+
+/**
+@brief Extend a value the counter had at most a few seconds ago and move the extension to it
+@param e counter extension
+@param c counter value, current or a packet timestamp
+@param now_ms monotonic time of the sample
+@return extended value
+
+A value older than the latest sample (packet received before the last read)
+is extended without moving the extension back. Wraps are found from the
+signed difference to the latest sample, or from the monotonic time elapsed
+since it when that is more than a quarter of a wrap (~18 min).
+*/
+uint64_t lgw_cnt_ext_sample(struct lgw_cnt_ext_s *e, uint32_t c, uint64_t now_ms);
+
+/**
+@brief Extend a value latched by the counter, e.g. at the latest GPS pulse, without moving the extension
+@param e counter extension
+@param c latched counter value
+@return extended value, right if the value was latched less than ~35 min from the latest sample
+*/
+uint64_t lgw_cnt_ext_at(const struct lgw_cnt_ext_s *e, uint32_t c);
+
+/**
+@brief Tell whether the counter must be sampled so that no wrap is missed
+@param e counter extension
+@param now_ms monotonic time
+@return true if no sample was taken for LGW_CNT_REFRESH_MS
+*/
+bool lgw_cnt_ext_due(const struct lgw_cnt_ext_s *e, uint64_t now_ms);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,86 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Host specific functions to get notified by a concentrator GPIO that
+    packets are waiting in the RX FIFO, through the Linux GPIO character
+    device (edge events on a file descriptor that can be poll()'ed).
+    A simulated source, backed by an eventfd, is available for testing
+    without hardware.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _LORAGW_GPIO_H
+#define _LORAGW_GPIO_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "config.h"     /* library configuration options (dynamically generated) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_GPIO_SUCCESS    0
+#define LGW_GPIO_ERROR      -1
+
+#define LGW_GPIO_SIM_PATH   "sim"   /* chip path selecting the simulated event source */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Request rising edge events on the host GPIO wired to the concentrator RX-ready output
+@param chip_path path of the GPIO character device (eg. /dev/gpiochip0), or LGW_GPIO_SIM_PATH
+@param line offset of the GPIO line on that chip
+@param fd_ptr pointer to a variable to receive the (non-blocking) event file descriptor
+@return LGW_GPIO_ERROR if the line could not be requested, LGW_GPIO_SUCCESS else
+*/
+int lgw_gpio_rx_open(const char *chip_path, uint32_t line, int *fd_ptr);
+
+/**
+@brief Release the RX-ready line
+@param fd file descriptor returned by lgw_gpio_rx_open
+@return LGW_GPIO_ERROR if the operation failed, LGW_GPIO_SUCCESS else
+*/
+int lgw_gpio_rx_close(int fd);
+
+/**
+@brief Consume all pending edge events (non-blocking)
+@param fd file descriptor returned by lgw_gpio_rx_open
+@param ts_ns pointer to receive the kernel timestamp of the latest event in ns (NULL to ignore)
+@return LGW_GPIO_ERROR if the operation failed, else the number of events consumed
+*/
+int lgw_gpio_rx_ack(int fd, uint64_t *ts_ns);
+
+/**
+@brief Read the current level of the RX-ready line
+@param fd file descriptor returned by lgw_gpio_rx_open
+@param level pointer to receive the line level (true while packets are pending)
+@return LGW_GPIO_ERROR if the operation failed, LGW_GPIO_SUCCESS else
+
+Edge events are only generated when the line goes up, so after draining the
+FIFO the level must be checked to catch packets that arrived in the meantime.
+*/
+int lgw_gpio_rx_level(int fd, bool *level);
+
+/**
+@brief Raise a fake RX-ready event on the simulated source
+@return LGW_GPIO_ERROR if the simulated source is not open, LGW_GPIO_SUCCESS else
+*/
+int lgw_gpio_sim_raise(void);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
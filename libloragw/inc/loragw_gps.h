@@ -30,6 +30,21 @@ Maintainer: Michael Coracin
 
 #include "config.h"     /* library configuration options (dynamically generated) */
 
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_GPS_SUCCESS 0
+#define LGW_GPS_ERROR   -1
+
+#define LGW_GPS_MIN_MSG_SIZE      (8)
+#define LGW_GPS_UBX_SYNC_CHAR     (0xB5)
+#define LGW_GPS_NMEA_SYNC_CHAR    (0x24)
+
+#define LGW_GPS_FRAME_MAX         (256) /* longest NMEA sentence or UBX frame kept by the stream parser */
+
+#define LGW_CLK_WINDOW            (32)  /* PPS captures used to fit the clock model */
+#define LGW_CLK_HOLDOVER_S        (600) /* default time the model is trusted after the last capture */
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC TYPES --------------------------------------------------------- */
 
@@ -45,6 +60,39 @@ struct tref {
     double          xtal_err;   /*!> raw clock error (eg. <1 'slow' XTAL) */
 };
 
+/**
+@struct lgw_clk_model_s
+@brief Concentrator counter to GPS time model: offset and drift fitted over a window of PPS captures
+
+The counter is extended to 64 bits internally, so captures and conversions
+are not limited by the 32-bit wrap. The structure holds all the state, no
+memory is allocated and no global variable is used.
+*/
+struct lgw_clk_model_s {
+    /* window of accepted captures, relative to the anchor */
+    double          x_us[LGW_CLK_WINDOW];   /*!> counter since anchor, in us */
+    double          r_us[LGW_CLK_WINDOW];   /*!> UTC since anchor minus counter since anchor, in us */
+    int             nb;                     /*!> number of captures in the window */
+    int             head;                   /*!> index of the next capture to overwrite */
+    /* anchor: first capture since the last reset */
+    uint32_t        anchor_cnt;             /*!> counter value of the anchor */
+    struct timespec anchor_utc;             /*!> UTC time of the anchor */
+    struct timespec gps_minus_utc;          /*!> GPS time - UTC time (leap seconds and epoch) */
+    /* 64-bit extension of the counter */
+    uint32_t        last_cnt;               /*!> counter of the latest accepted capture */
+    int64_t         last_ext;               /*!> same, extended, relative to the anchor */
+    /* fit result, r = offset + drift * (x - x_mean) */
+    double          x_mean;
+    double          offset_us;
+    double          drift;                  /*!> relative frequency error of the counter (counter slow if > 0) */
+    double          rms_us;                 /*!> residual RMS of the fit */
+    /* health */
+    time_t          systime;                /*!> system time of the latest accepted capture, 0 if never */
+    int             holdover_s;             /*!> conversions further than that from the latest capture fail */
+    int             nb_outliers;            /*!> successive rejected captures */
+    uint32_t        nb_rejected;            /*!> total rejected captures */
+};
+
 /**
 @struct coord_s
 @brief Geodesic coordinates
@@ -83,15 +131,33 @@ enum gps_msg {
     UBX_NAV_TIMEUTC  /*!> UTC Time Solution */
 };
 
-/* -------------------------------------------------------------------------- */
-/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+/**
+@brief Function called by the stream parser for every frame with a valid checksum
 
-#define LGW_GPS_SUCCESS 0
-#define LGW_GPS_ERROR   -1
+@param msg type of frame, as returned by lgw_parse_nmea/lgw_parse_ubx
+@param frame frame content, only valid during the call (NMEA fields are null-separated once decoded)
+@param size number of bytes of the frame, sync chars and checksum included
+@param arg user pointer given to lgw_gps_stream_init
+*/
+typedef void (*lgw_gps_frame_cb)(enum gps_msg msg, const char *frame, size_t size, void *arg);
 
-#define LGW_GPS_MIN_MSG_SIZE      (8)
-#define LGW_GPS_UBX_SYNC_CHAR     (0xB5)
-#define LGW_GPS_NMEA_SYNC_CHAR    (0x24)
+/**
+@struct lgw_gps_stream_s
+@brief State of the incremental NMEA/UBX parser of one serial stream
+*/
+struct lgw_gps_stream_s {
+    uint8_t             state;      /*!> position in the current frame */
+    uint8_t             ck_a;       /*!> running checksum (NMEA XOR, UBX Fletcher A) */
+    uint8_t             ck_b;       /*!> running checksum (UBX Fletcher B) */
+    uint16_t            len;        /*!> number of bytes of the current frame */
+    uint16_t            size;       /*!> expected size of the current UBX frame */
+    char                frame[LGW_GPS_FRAME_MAX];
+    lgw_gps_frame_cb    cb;         /*!> called for every valid frame (NULL to ignore) */
+    void                *arg;       /*!> passed to cb */
+    enum gps_msg        last;       /*!> type of the last valid frame */
+    uint32_t            nb_frames;  /*!> number of frames with a valid checksum */
+    uint32_t            nb_errors;  /*!> number of frames dropped (checksum, format or size) */
+};
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
@@ -144,6 +210,39 @@ lock must be acquired before calling either function.
 */
 enum gps_msg lgw_parse_ubx(const char* serial_buff, size_t buff_size, size_t *msg_size);
 
+/**
+@brief Initialize an incremental NMEA/UBX stream parser
+
+@param s parser state
+@param cb function called for every valid frame (NULL to ignore)
+@param arg user pointer passed to cb
+*/
+void lgw_gps_stream_init(struct lgw_gps_stream_s *s, lgw_gps_frame_cb cb, void *arg);
+
+/**
+@brief Feed bytes coming from the GPS to a stream parser
+
+@param s parser state
+@param buf bytes received, frames may span several calls
+@param size number of bytes
+@return number of frames with a valid checksum completed by these bytes
+
+Sync chars are looked for and checksums are computed as bytes arrive, so a
+frame is decoded (lgw_parse_nmea/lgw_parse_ubx global variables updated) and
+its callback called as soon as its last byte is fed. On a corrupted or
+truncated frame, the parser resynchronizes on the next sync char.
+*/
+int lgw_gps_stream_feed(struct lgw_gps_stream_s *s, const uint8_t *buf, size_t size);
+
+/**
+@brief Read the bytes available on the GPS tty and feed them to a stream parser
+
+@param s parser state
+@param fd file descriptor on GPS tty, as returned by lgw_gps_enable
+@return number of frames completed, LGW_GPS_ERROR if read failed
+*/
+int lgw_gps_stream_read(struct lgw_gps_stream_s *s, int fd);
+
 /**
 @brief Get the GPS solution (space & time) for the concentrator
 
@@ -171,9 +270,51 @@ int lgw_gps_get(struct timespec *utc, struct timespec *gps_time, struct coord_s
 @return success if timestamp was read and time reference could be refreshed
 
 Set systime to 0 in ref to trigger initial synchronization.
+Only the two latest points are used, and the aberrant point tracking is shared
+by all callers; lgw_clk_update fits a model over a window of captures instead.
 */
 int lgw_gps_sync(struct tref *ref, uint32_t count_us, struct timespec utc, struct timespec gps_time);
 
+/**
+@brief Initialize a clock model
+
+@param m clock model state
+*/
+void lgw_clk_init(struct lgw_clk_model_s *m);
+
+/**
+@brief Add a PPS capture to a clock model
+
+@param m clock model state
+@param count_us counter value latched by the PPS (lgw_get_trigcnt)
+@param utc UTC time of that PPS
+@param gps_time GPS time of that PPS
+@return LGW_GPS_SUCCESS if the capture was used, LGW_GPS_ERROR if it was rejected as an outlier
+
+A capture far from the fitted line is rejected; several successive rejected
+captures mean a time step (or a concentrator reset) and restart the fit.
+*/
+int lgw_clk_update(struct lgw_clk_model_s *m, uint32_t count_us, struct timespec utc, struct timespec gps_time);
+
+/**
+@brief Convert a counter value to UTC time with a clock model
+
+@param m clock model state
+@param count_us internal timestamp counter of the LoRa concentrator
+@param utc pointer to store UTC time
+@return LGW_GPS_ERROR if the model has less than 2 captures or count_us is beyond holdover
+*/
+int lgw_clk_cnt2utc(const struct lgw_clk_model_s *m, uint32_t count_us, struct timespec *utc);
+
+/**
+@brief Express the current state of a clock model as a time reference
+
+@param m clock model state
+@param ref time reference usable with lgw_cnt2utc, lgw_cnt2gps, etc
+@return LGW_GPS_ERROR if the model has less than 2 captures
+*/
+int lgw_clk_get_tref(const struct lgw_clk_model_s *m, struct tref *ref);
+
 /**
 @brief Convert concentrator timestamp counter value to UTC time
 
@@ -62,6 +62,7 @@ Maintainer: Sylvain Miermont
 #define LGW_IF_CHAIN_NB     10    /* number of IF+modem RX chains */
 #define LGW_PKT_FIFO_SIZE   16    /* depth of the RX packet FIFO */
 #define LGW_DATABUFF_SIZE   1024    /* size in bytes of the RX data buffer (contains payload & metadata) */
+#define LGW_PKT_BUF_SIZE    272    /* bytes read in one SPI burst per packet, 255 bytes payload + 16 bytes metadata */
 #define LGW_REF_BW          125000    /* typical bandwidth of data channel */
 #define LGW_MULTI_NB        8    /* number of LoRa 'multi SF' chains */
 #define LGW_IFMODEM_CONFIG {\
@@ -200,6 +201,15 @@ struct lgw_conf_lbt_s {
     int8_t                      rssi_offset;        /*!> RSSI offset to be applied to SX127x RSSI values */
 };
 
+/**
+@struct lgw_conf_rxirq_s
+@brief Configuration structure for the RX-ready GPIO notification
+*/
+struct lgw_conf_rxirq_s {
+    bool        enable;         /*!> enable or disable routing of the RX-ready status to a concentrator GPIO */
+    uint8_t     gpio_select;    /*!> value of GPIO_SELECT_OUTPUT, board dependent (which GPIO and which status is output) */
+};
+
 /**
 @struct lgw_conf_rxrf_s
 @brief Configuration structure for a RF chain
@@ -250,6 +260,43 @@ struct lgw_pkt_rx_s {
     uint8_t     payload[256];   /*!> buffer containing the payload */
 };
 
+/**
+@struct lgw_pkt_meta_s
+@brief Compact metadata of a received packet, the payload is kept in a buffer of the RX pool
+*/
+struct lgw_pkt_meta_s {
+    uint64_t    count_us64;     /*!> internal counter extended to 64 bits, monotonic since lgw_start, the 32-bit counter in the low bits */
+    uint32_t    freq_hz;        /*!> central frequency of the IF chain */
+    uint16_t    crc;            /*!> CRC that was received in the payload */
+    int16_t     rssi_x16;       /*!> average packet RSSI, in 1/16 dB */
+    int8_t      snr_x4;         /*!> average packet SNR, in 1/4 dB (LoRa only, LGW_SNR_UNDEFINED else) */
+    int8_t      snr_min_x4;     /*!> minimum packet SNR, in 1/4 dB (LoRa only) */
+    int8_t      snr_max_x4;     /*!> maximum packet SNR, in 1/4 dB (LoRa only) */
+    uint8_t     size;           /*!> payload size in bytes */
+    uint8_t     chain;          /*!> RF chain in the high nibble, IF chain in the low nibble */
+    uint8_t     status;         /*!> status of the received packet */
+    uint8_t     modulation;     /*!> modulation used by the packet */
+    uint8_t     bandwidth;      /*!> modulation bandwidth (LoRa only) */
+    uint8_t     datarate;       /*!> RX datarate of the packet (SF for LoRa, DR_UNDEFINED for FSK) */
+    uint8_t     coderate;       /*!> error-correcting code of the packet (LoRa only) */
+    uint16_t    slot;           /*!> index of the RX pool buffer holding the payload */
+} __attribute__((packed));
+
+#define LGW_SNR_UNDEFINED       INT8_MIN    /* snr_x4 value for packets without SNR information */
+#define LGW_META_RF_CHAIN(m)    ((m)->chain >> 4)
+#define LGW_META_IF_CHAIN(m)    ((m)->chain & 0x0F)
+#define LGW_META_COUNT_US(m)    ((uint32_t)(m)->count_us64) /* internal concentrator counter, as count_us of lgw_pkt_rx_s */
+
+/**
+@struct lgw_pkt_buf_s
+@brief Packet buffer from the RX pool, the SPI burst is read in place: payload at data[0], raw metadata after it
+*/
+struct lgw_pkt_buf_s {
+    struct lgw_pkt_meta_s   meta;   /*!> metadata parsed from the raw bytes following the payload */
+    int                     refcnt; /*!> number of holders of that buffer, 0 when back in the pool */
+    uint8_t                 data[LGW_PKT_BUF_SIZE] __attribute__((aligned(64))); /*!> payload followed by raw metadata */
+} __attribute__((aligned(64)));
+
 /**
 @struct lgw_pkt_tx_s
 @brief Structure containing the configuration of a packet to send and a pointer to the payload
@@ -327,6 +374,16 @@ int lgw_rxrf_setconf(uint8_t rf_chain, struct lgw_conf_rxrf_s conf);
 */
 int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf);
 
+/**
+@brief Configure the RX-ready GPIO notification (must configure before start)
+@param conf structure containing the configuration parameters
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+When enabled, the concentrator GPIOs are no longer controlled by the AGC for
+TX signalling, the selected output reflects the RX FIFO status instead.
+*/
+int lgw_rxirq_setconf(struct lgw_conf_rxirq_s conf);
+
 /**
 @brief Configure the Tx gain LUT
 @param pointer to structure defining the LUT
@@ -354,6 +411,38 @@ int lgw_stop(void);
 */
 int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data);
 
+/**
+@brief Same as lgw_receive, but packets are read directly into buffers taken from the RX pool
+@param max_pkt maximum number of packet that must be retrieved (equal to the size of the array of pointers)
+@param pkt_buf pointer to an array of pointers that will receive the packet buffers
+@return LGW_HAL_ERROR id the operation failed, else the number of packets retrieved
+
+Each buffer returned is held once by the caller and must be given back with
+lgw_pool_release. Packets are left in the concentrator FIFO if the pool is
+exhausted.
+*/
+int lgw_receive_buf(uint8_t max_pkt, struct lgw_pkt_buf_s **pkt_buf);
+
+/**
+@brief Same as lgw_receive, but fills an array of compact metadata records
+@param max_pkt maximum number of packet that must be retrieved (equal to the size of the array of struct)
+@param meta pointer to an array of struct that will receive the packet metadata
+@return LGW_HAL_ERROR id the operation failed, else the number of packets retrieved
+
+The payloads stay in the RX pool, meta[i].slot gives the buffer holding each
+of them (see lgw_pool_slot), which must be given back with lgw_pool_release.
+*/
+int lgw_receive_meta(uint8_t max_pkt, struct lgw_pkt_meta_s *meta);
+
+/**
+@brief Expand a compact metadata record and its payload into the legacy packet structure
+@param meta compact metadata of the packet
+@param payload pointer to the payload (meta->size bytes), NULL to leave the payload untouched
+@param pkt_data pointer to the structure to fill
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_pkt_meta_to_rx(const struct lgw_pkt_meta_s *meta, const uint8_t *payload, struct lgw_pkt_rx_s *pkt_data);
+
 /**
 @brief Schedule a packet to be send immediately or after a delay depending on tx_mode
 @param pkt_data structure containing the data and metadata for the packet to send
@@ -401,6 +490,30 @@ int lgw_abort_tx(void);
 */
 int lgw_get_trigcnt(uint32_t* trig_cnt_us);
 
+/**
+@brief Same as lgw_get_trigcnt, with the counter extended to 64 bits
+@param trig_cnt_us64 pointer to receive timestamp value, on the scale of count_us64
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The value is latched, so it is extended around the latest counter sample
+without moving the extension: it is right if the event was captured less than
+~35 min from it, a value frozen for longer (no GPS pulse) is meaningless.
+*/
+int lgw_get_trigcnt64(uint64_t* trig_cnt_us64);
+
+/**
+@brief Return the current value of the internal counter
+@param inst_cnt_us pointer to receive the counter value
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The GPS pulse capture is turned off for the time of the read. The 64-bit
+extension of the counter (count_us64 of the packets) follows the packet
+timestamps and these reads; lgw_receive and lgw_receive_buf read the counter
+themselves when nothing did for LGW_CNT_REFRESH_MS, so no wrap is missed while
+the RX FIFO is polled.
+*/
+int lgw_get_instcnt(uint32_t* inst_cnt_us);
+
 /**
 @brief Allow user to check the version/options of the library once compiled
 @return pointer on a human-readable null terminated string
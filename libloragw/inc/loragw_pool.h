@@ -0,0 +1,76 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Preallocated pool of reference counted RX packet buffers.
+    Buffers are cache-line aligned and filled in place by lgw_receive_buf, they
+    can then be shared between several consumers without copying the payload.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _LORAGW_POOL_H
+#define _LORAGW_POOL_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "config.h"     /* library configuration options (dynamically generated) */
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_POOL_SUCCESS    0
+#define LGW_POOL_ERROR      -1
+
+#define LGW_POOL_SIZE       64  /* number of packet buffers, 4 full RX FIFOs */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Take a free buffer from the pool
+@return pointer to a buffer held once by the caller, NULL if the pool is exhausted
+*/
+struct lgw_pkt_buf_s *lgw_pool_get(void);
+
+/**
+@brief Add a holder to a buffer, before handing it to another consumer
+@param buf buffer obtained from lgw_pool_get or lgw_receive_buf
+*/
+void lgw_pool_hold(struct lgw_pkt_buf_s *buf);
+
+/**
+@brief Remove a holder from a buffer, it goes back to the pool when nobody holds it anymore
+@param buf buffer obtained from lgw_pool_get or lgw_receive_buf
+@return LGW_POOL_ERROR if the buffer is not from the pool or was not held, LGW_POOL_SUCCESS else
+*/
+int lgw_pool_release(struct lgw_pkt_buf_s *buf);
+
+/**
+@brief Get a pool buffer from its index, as found in the slot field of its metadata
+@param slot index of the buffer in the pool
+@return pointer to the buffer, NULL if the index is out of range
+*/
+struct lgw_pkt_buf_s *lgw_pool_slot(uint16_t slot);
+
+/**
+@brief Count the buffers currently available in the pool
+@return number of free buffers
+*/
+int lgw_pool_available(void);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -53,6 +53,12 @@ int reg_r_align32(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target
 #define LGW_REG_SUCCESS  0
 #define LGW_REG_ERROR    -1
 
+/* SPI bus access priorities, see lgw_bus_lock */
+enum lgw_bus_prio_e {
+    LGW_BUS_PRIO_RX,            /* RX FIFO drain and TX sequence, served first */
+    LGW_BUS_PRIO_BACKGROUND     /* any other access, waits while RX requests are pending */
+};
+
 /*
 auto generated register mapping for C code : 11-Jul-2013 13:20:40
 this file contains autogenerated C struct used to access the LORA registers
@@ -455,6 +461,35 @@ int lgw_reg_wb(uint16_t register_id, uint8_t *data, uint16_t size);
 */
 int lgw_reg_rb(uint16_t register_id, uint8_t *data, uint16_t size);
 
+/**
+@brief Get exclusive access to the SPI bus, for a sequence of register accesses
+@param prio priority of the request, RX requests are granted before any pending background one
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+
+Every register access of the library takes the bus by itself, at background
+priority, so that accesses from several threads never interleave and the
+selected register page stays consistent. A thread already owning the bus can
+lock it again (nested calls), the bus is released by the last unlock.
+The owner holds a priority inheritance mutex: a real-time thread waiting for
+the bus raises a normal thread holding it to its own priority.
+Background work should hold the bus for short sequences only, checking
+lgw_bus_contended between them, so that RX requests wait for one sequence at
+most. lgw_start and lgw_stop are not serialized as a whole, other threads
+should not use the concentrator while it is being started or stopped.
+*/
+int lgw_bus_lock(enum lgw_bus_prio_e prio);
+
+/**
+@brief Release the SPI bus taken by lgw_bus_lock
+*/
+void lgw_bus_unlock(void);
+
+/**
+@brief Check if an RX request is waiting for the bus
+@return true if the current owner should release the bus at its next chunk boundary
+*/
+bool lgw_bus_contended(void);
+
 
 #endif
 
@@ -0,0 +1,115 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Background spectral scan: the FPGA builds RSSI histograms from the
+    SX127x radio (the one used for LBT) while the SX1301 keeps receiving.
+    The scan is driven by small steps, each one spending at most a given
+    time on the SPI bus, so that it can run between two RX FIFO drains.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _LORAGW_SCAN_H
+#define _LORAGW_SCAN_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "config.h"     /* library configuration options (dynamically generated) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_SCAN_SUCCESS    0
+#define LGW_SCAN_ERROR      -1
+
+#define LGW_SCAN_CHAN_MAX   8       /* channels swept by the scan */
+#define LGW_SCAN_RSSI_BINS  256     /* histogram bins, bin i counts the reads at -i/2 dBm */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_conf_scan_s
+@brief Spectral scan configuration
+*/
+struct lgw_conf_scan_s {
+    uint8_t     nb_channel;                     /*!> number of channels to sweep */
+    uint32_t    freq_hz[LGW_SCAN_CHAN_MAX];     /*!> center frequency of each channel */
+    uint16_t    nb_read;                        /*!> RSSI reads per histogram */
+    int8_t      rssi_offset;                    /*!> SX127x RSSI offset, in dB */
+    uint32_t    interval_ms;                    /*!> pause between two sweeps */
+    uint16_t    chunk_size;                     /*!> histogram bytes read per SPI burst, 0 for the default */
+};
+
+/**
+@struct lgw_scan_result_s
+@brief RSSI histogram of one channel
+*/
+struct lgw_scan_result_s {
+    uint8_t     chan;                           /*!> channel index in the configuration */
+    uint32_t    freq_hz;                        /*!> channel center frequency */
+    uint32_t    nb_read;                        /*!> sum of the histogram bins */
+    uint16_t    histo[LGW_SCAN_RSSI_BINS];      /*!> number of reads per RSSI bin */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Set the channels and pace of the spectral scan
+@param conf structure containing the configuration parameters
+@return LGW_SCAN_ERROR id the operation failed, LGW_SCAN_SUCCESS else
+*/
+int lgw_scan_setconf(const struct lgw_conf_scan_s *conf);
+
+/**
+@brief Configure the SX127x and the FPGA for the scan, after lgw_start
+@return LGW_SCAN_ERROR if the FPGA has no spectral scan, LBT is enabled or the radio is missing, LGW_SCAN_SUCCESS else
+*/
+int lgw_scan_start(void);
+
+/**
+@brief Advance the scan without blocking
+@param budget_us time that may be spent on the SPI bus by this call
+@param result pointer to store a histogram when one is complete
+@return LGW_SCAN_ERROR if the operation failed, 1 if result was filled, 0 else
+
+Each call performs SPI transactions while their measured cost fits in the
+budget, and at least one when the scan has something to do, so a call never
+lasts longer than max(budget_us, cost of one transaction). It also returns
+between two transactions as soon as an RX request waits for the bus. The FPGA
+status is polled at most once per millisecond and nothing is done between two
+sweeps.
+*/
+int lgw_scan_step(uint32_t budget_us, struct lgw_scan_result_s *result);
+
+/**
+@brief Stop the histogram engine, the scan has to be started again to resume
+*/
+void lgw_scan_stop(void);
+
+/**
+@brief Estimate the noise floor and the occupancy of a channel from its histogram
+@param result histogram returned by lgw_scan_step
+@param margin_db level above the noise floor counted as occupied
+@param floor_dbm pointer to store the median RSSI, in dBm
+@param occupancy pointer to store the fraction of reads above floor + margin, 0 to 1
+@return LGW_SCAN_ERROR if the histogram is empty, LGW_SCAN_SUCCESS else
+*/
+int lgw_scan_analyze(const struct lgw_scan_result_s *result, float margin_db, float *floor_dbm, float *occupancy);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
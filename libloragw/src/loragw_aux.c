@@ -25,7 +25,10 @@ Maintainer: Sylvain Miermont
 #endif
 
 #include <stdio.h>  /* printf fprintf */
-#include <time.h>   /* clock_nanosleep */
+#include <string.h> /* memset */
+#include <time.h>   /* clock_nanosleep clock_gettime */
+
+#include "loragw_aux.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -58,4 +61,69 @@ void wait_ms(unsigned long a) {
     return;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint64_t lgw_mono_ms(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000 + (uint64_t)(t.tv_nsec / 1000000);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_cnt_ext_init(struct lgw_cnt_ext_s *e) {
+    memset(e, 0, sizeof *e);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint64_t lgw_cnt_ext_sample(struct lgw_cnt_ext_s *e, uint32_t c, uint64_t now_ms) {
+    uint64_t elapsed_us, wraps;
+    uint32_t fwd;
+    int32_t delta;
+
+    if (e->valid == false) {
+        e->valid = true;
+        e->last = c;
+        e->ext = c;
+        e->last_ms = now_ms;
+        return e->ext;
+    }
+    fwd = c - e->last;
+    elapsed_us = (now_ms > e->last_ms) ? (now_ms - e->last_ms) * 1000 : 0;
+    if (elapsed_us < 0x40000000ULL) {
+        /* less than a quarter of a wrap since the latest sample, the signed difference tells */
+        delta = (int32_t)fwd;
+        if (delta < 0) {
+            return e->ext - (uint32_t)(-(int64_t)delta);
+        }
+        wraps = 0;
+    } else {
+        /* quiet for longer, the wraps missed are those closest to the time elapsed */
+        wraps = (elapsed_us > fwd) ? (elapsed_us - fwd + 0x80000000ULL) >> 32 : 0;
+    }
+    e->last = c;
+    e->ext += fwd + (wraps << 32);
+    e->last_ms = now_ms;
+    return e->ext;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint64_t lgw_cnt_ext_at(const struct lgw_cnt_ext_s *e, uint32_t c) {
+    int32_t delta = (int32_t)(c - e->last);
+
+    if (e->valid == false) {
+        return c;
+    }
+    return (delta < 0) ? e->ext - (uint32_t)(-(int64_t)delta) : e->ext + (uint32_t)delta;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool lgw_cnt_ext_due(const struct lgw_cnt_ext_s *e, uint64_t now_ms) {
+    return (e->valid == false) || (now_ms >= e->last_ms + LGW_CNT_REFRESH_MS);
+}
+
 /* --- EOF ------------------------------------------------------------------ */
@@ -224,7 +224,9 @@ int lgw_fpga_reg_w(uint16_t register_id, int32_t reg_value) {
         return LGW_REG_ERROR;
     }
 
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
     spi_stat += reg_w_align32(lgw_spi_target, LGW_SPI_MUX_MODE1, LGW_SPI_MUX_TARGET_FPGA, r, reg_value);
+    lgw_bus_unlock();
 
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER WRITE\n");
@@ -257,7 +259,9 @@ int lgw_fpga_reg_r(uint16_t register_id, int32_t *reg_value) {
     /* get register struct from the struct array */
     r = fpga_regs[register_id];
 
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
     spi_stat += reg_r_align32(lgw_spi_target, LGW_SPI_MUX_MODE1, LGW_SPI_MUX_TARGET_FPGA, r, reg_value);
+    lgw_bus_unlock();
 
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER WRITE\n");
@@ -301,7 +305,9 @@ int lgw_fpga_reg_wb(uint16_t register_id, uint8_t *data, uint16_t size) {
     }
 
     /* do the burst write */
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
     spi_stat += lgw_spi_wb(lgw_spi_target, LGW_SPI_MUX_MODE1, LGW_SPI_MUX_TARGET_FPGA, r.addr, data, size);
+    lgw_bus_unlock();
 
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER BURST WRITE\n");
@@ -339,7 +345,9 @@ int lgw_fpga_reg_rb(uint16_t register_id, uint8_t *data, uint16_t size) {
     r = fpga_regs[register_id];
 
     /* do the burst read */
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
     spi_stat += lgw_spi_rb(lgw_spi_target, LGW_SPI_MUX_MODE1, LGW_SPI_MUX_TARGET_FPGA, r.addr, data, size);
+    lgw_bus_unlock();
 
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER BURST READ\n");
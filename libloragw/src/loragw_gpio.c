@@ -0,0 +1,225 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Host specific functions to get notified by a concentrator GPIO that
+    packets are waiting in the RX FIFO, through the Linux GPIO character
+    device (edge events on a file descriptor that can be poll()'ed).
+    A simulated source, backed by an eventfd, is available for testing
+    without hardware.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99, O_CLOEXEC needs POSIX.1-2008 */
+#define _XOPEN_SOURCE 700
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <string.h>     /* memset strncpy strcmp */
+#include <errno.h>      /* EAGAIN */
+#include <unistd.h>     /* read write close */
+#include <fcntl.h>      /* open fcntl */
+
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <linux/gpio.h>
+
+#include "loragw_gpio.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_GPIO == 1
+    #define DEBUG_MSG(str)                fprintf(stderr, str)
+    #define DEBUG_PRINTF(fmt, args...)    fprintf(stderr,"%s:%d: "fmt, __FUNCTION__, __LINE__, args)
+    #define CHECK_NULL(a)                 if(a==NULL){fprintf(stderr,"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);return LGW_GPIO_ERROR;}
+#else
+    #define DEBUG_MSG(str)
+    #define DEBUG_PRINTF(fmt, args...)
+    #define CHECK_NULL(a)                 if(a==NULL){return LGW_GPIO_ERROR;}
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define GPIO_CONSUMER_LABEL "loragw_rx"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static int sim_fd = -1; /* eventfd of the simulated source, -1 when not in use */
+static bool sim_level = false; /* simulated line level, up between raise and ack */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lgw_gpio_rx_open(const char *chip_path, uint32_t line, int *fd_ptr) {
+    struct gpioevent_request req;
+    int chip_fd;
+    int a;
+
+    /* check input variables */
+    CHECK_NULL(chip_path);
+    CHECK_NULL(fd_ptr);
+
+    /* simulated source, events are raised by lgw_gpio_sim_raise */
+    if (strcmp(chip_path, LGW_GPIO_SIM_PATH) == 0) {
+        if (sim_fd >= 0) {
+            DEBUG_MSG("ERROR: SIMULATED GPIO SOURCE ALREADY OPEN\n");
+            return LGW_GPIO_ERROR;
+        }
+        sim_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (sim_fd < 0) {
+            DEBUG_MSG("ERROR: FAILED TO CREATE SIMULATED GPIO SOURCE\n");
+            return LGW_GPIO_ERROR;
+        }
+        sim_level = false;
+        *fd_ptr = sim_fd;
+        DEBUG_MSG("Note: simulated RX-ready GPIO source opened\n");
+        return LGW_GPIO_SUCCESS;
+    }
+
+    /* open GPIO chip */
+    chip_fd = open(chip_path, O_RDONLY | O_CLOEXEC);
+    if (chip_fd < 0) {
+        DEBUG_PRINTF("ERROR: failed to open GPIO chip %s\n", chip_path);
+        return LGW_GPIO_ERROR;
+    }
+
+    /* request rising edge events on the line */
+    memset(&req, 0, sizeof req);
+    req.lineoffset = line;
+    req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    req.eventflags = GPIOEVENT_REQUEST_RISING_EDGE;
+    strncpy(req.consumer_label, GPIO_CONSUMER_LABEL, sizeof req.consumer_label - 1);
+    a = ioctl(chip_fd, GPIO_GET_LINEEVENT_IOCTL, &req);
+    close(chip_fd); /* the line stays requested through req.fd */
+    if (a < 0) {
+        DEBUG_PRINTF("ERROR: failed to request edge events on line %u\n", line);
+        return LGW_GPIO_ERROR;
+    }
+
+    /* event reads must never block the caller */
+    a = fcntl(req.fd, F_GETFL);
+    if ((a < 0) || (fcntl(req.fd, F_SETFL, a | O_NONBLOCK) < 0)) {
+        DEBUG_MSG("ERROR: FAILED TO SET GPIO EVENT FD NON-BLOCKING\n");
+        close(req.fd);
+        return LGW_GPIO_ERROR;
+    }
+
+    *fd_ptr = req.fd;
+    DEBUG_PRINTF("Note: RX-ready GPIO %s:%u opened\n", chip_path, line);
+    return LGW_GPIO_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_gpio_rx_close(int fd) {
+    if (fd < 0) {
+        return LGW_GPIO_ERROR;
+    }
+    if (fd == sim_fd) {
+        sim_fd = -1;
+        sim_level = false;
+    }
+    if (close(fd) < 0) {
+        DEBUG_MSG("ERROR: RX-READY GPIO FAILED TO CLOSE\n");
+        return LGW_GPIO_ERROR;
+    }
+    return LGW_GPIO_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_gpio_rx_ack(int fd, uint64_t *ts_ns) {
+    struct gpioevent_data evt;
+    uint64_t cnt;
+    ssize_t n;
+    int nb_evt = 0;
+
+    if (fd < 0) {
+        return LGW_GPIO_ERROR;
+    }
+
+    if (fd == sim_fd) {
+        n = read(fd, &cnt, sizeof cnt);
+        if (n == (ssize_t)sizeof cnt) {
+            nb_evt = (int)cnt;
+        } else if ((n < 0) && (errno != EAGAIN)) {
+            return LGW_GPIO_ERROR;
+        }
+        sim_level = false;
+        return nb_evt;
+    }
+
+    /* drain every queued event, keep the latest timestamp */
+    for (;;) {
+        n = read(fd, &evt, sizeof evt);
+        if (n == (ssize_t)sizeof evt) {
+            if (ts_ns != NULL) {
+                *ts_ns = evt.timestamp;
+            }
+            ++nb_evt;
+        } else if ((n < 0) && (errno == EAGAIN)) {
+            break;
+        } else {
+            DEBUG_MSG("ERROR: FAILED TO READ GPIO EVENT\n");
+            return LGW_GPIO_ERROR;
+        }
+    }
+    return nb_evt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_gpio_rx_level(int fd, bool *level) {
+    struct gpiohandle_data data;
+
+    CHECK_NULL(level);
+    if (fd < 0) {
+        return LGW_GPIO_ERROR;
+    }
+
+    if (fd == sim_fd) {
+        *level = sim_level;
+        return LGW_GPIO_SUCCESS;
+    }
+
+    memset(&data, 0, sizeof data);
+    if (ioctl(fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0) {
+        DEBUG_MSG("ERROR: FAILED TO READ GPIO LEVEL\n");
+        return LGW_GPIO_ERROR;
+    }
+    *level = (data.values[0] != 0);
+    return LGW_GPIO_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_gpio_sim_raise(void) {
+    uint64_t one = 1;
+
+    if (sim_fd < 0) {
+        DEBUG_MSG("ERROR: SIMULATED GPIO SOURCE NOT OPEN\n");
+        return LGW_GPIO_ERROR;
+    }
+    sim_level = true;
+    if (write(sim_fd, &one, sizeof one) != (ssize_t)sizeof one) {
+        return LGW_GPIO_ERROR;
+    }
+    return LGW_GPIO_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
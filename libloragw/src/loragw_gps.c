@@ -29,6 +29,7 @@ Maintainer: Michael Coracin
 #include <fcntl.h>      /* open */
 #include <termios.h>    /* tcflush */
 #include <math.h>       /* modf */
+#include <errno.h>      /* errno */
 
 #include <stdlib.h>
 
@@ -59,6 +60,22 @@ Maintainer: Michael Coracin
 
 #define UBX_MSG_NAVTIMEGPS_LEN  16
 
+/* states of the stream parser */
+#define STREAM_SYNC         0   /* looking for a sync char */
+#define STREAM_NMEA_BODY    1   /* NMEA characters up to '*', XOR running */
+#define STREAM_NMEA_CK_HI   2   /* first checksum digit */
+#define STREAM_NMEA_CK_LO   3   /* second checksum digit */
+#define STREAM_NMEA_EOL     4   /* CR LF */
+#define STREAM_UBX_SYNC2    5   /* second UBX sync char */
+#define STREAM_UBX_FRAME    6   /* class, ID, length, payload and checksum */
+#define STREAM_UBX_SKIP     7   /* frame too long to be kept, skipped */
+#define STREAM_UBX_SKIP_MAX 2048 /* longer frames are taken as a false sync */
+
+/* clock model */
+#define CLK_OUTLIER_US      100.0   /* distance to the fitted line beyond which a capture is rejected */
+#define CLK_DRIFT_MAX       1E-5    /* +/-10 ppm, like the slope check of lgw_gps_sync */
+#define CLK_RESET_NB        3       /* successive rejected captures restarting the fit */
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
@@ -103,6 +120,24 @@ static bool match_label(const char *s, char *label, int size, char wildcard);
 
 static int str_chop(char *s, int buff_size, char separator, int *idx_ary, int max_idx);
 
+static enum gps_msg ubx_decode(const char *serial_buff);
+
+static enum gps_msg nmea_decode(char *parser_buf, int buff_size);
+
+static int hexchar_to_nibble(char c);
+
+static int stream_byte(struct lgw_gps_stream_s *s, uint8_t c);
+
+static double ts_diff_us(struct timespec a, struct timespec b);
+
+static struct timespec ts_add_us(struct timespec a, double us);
+
+static struct timespec ts_sub(struct timespec a, struct timespec b);
+
+static void clk_fit(struct lgw_clk_model_s *m);
+
+static void clk_reset(struct lgw_clk_model_s *m, uint32_t count_us, struct timespec utc, struct timespec gps_time);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -248,6 +283,378 @@ int str_chop(char *s, int buff_size, char separator, int *idx_ary, int max_idx)
     return j;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/*
+Decode a complete UBX frame whose checksum was verified, sync chars included.
+Update the global GPS time variables and return the type of frame.
+*/
+static enum gps_msg ubx_decode(const char *serial_buff) {
+    bool valid = 0;    /* iTOW, fTOW and week validity */
+
+    /* Check for Class 0x01 (NAV) and ID 0x20 (NAV-TIMEGPS) */
+    if ((serial_buff[2] == 0x01) && (serial_buff[3] == 0x20)) {
+        /* Check validity of information */
+        valid = serial_buff[17] & 0x3; /* towValid, weekValid */
+        if (valid) {
+            /* Parse buffer to extract GPS time */
+            /* Warning: payload byte ordering is Little Endian */
+            gps_iTOW =  (uint8_t)serial_buff[6];
+            gps_iTOW |= (uint8_t)serial_buff[7] << 8;
+            gps_iTOW |= (uint8_t)serial_buff[8] << 16;
+            gps_iTOW |= (uint8_t)serial_buff[9] << 24; /* GPS time of week, in ms */
+
+            gps_fTOW =  (uint8_t)serial_buff[10];
+            gps_fTOW |= (uint8_t)serial_buff[11] << 8;
+            gps_fTOW |= (uint8_t)serial_buff[12] << 16;
+            gps_fTOW |= (uint8_t)serial_buff[13] << 24; /* Fractional part of iTOW, in ns */
+
+            gps_week =  (uint8_t)serial_buff[14];
+            gps_week |= (uint8_t)serial_buff[15] << 8; /* GPS week number */
+
+            gps_time_ok = true;
+#if 0
+            /* For debug */
+            {
+                short ubx_gps_hou = 0; /* hours (0-23) */
+                short ubx_gps_min = 0; /* minutes (0-59) */
+                short ubx_gps_sec = 0; /* seconds (0-59) */
+
+                /* Format GPS time in hh:mm:ss based on iTOW */
+                ubx_gps_sec = (gps_iTOW / 1000) % 60;
+                ubx_gps_min = (gps_iTOW / 1000 / 60) % 60;
+                ubx_gps_hou = (gps_iTOW / 1000 / 60 / 60) % 24;
+                printf("  GPS time = %02d:%02d:%02d\n", ubx_gps_hou, ubx_gps_min, ubx_gps_sec);
+            }
+#endif
+        } else { /* valid */
+            gps_time_ok = false;
+        }
+
+        return UBX_NAV_TIMEGPS;
+    } else if ((serial_buff[2] == 0x05) && (serial_buff[3] == 0x00)) {
+        DEBUG_MSG("NOTE: UBX ACK-NAK received\n");
+        return IGNORED;
+    } else if ((serial_buff[2] == 0x05) && (serial_buff[3] == 0x01)) {
+        DEBUG_MSG("NOTE: UBX ACK-ACK received\n");
+        return IGNORED;
+    } else { /* not a supported message */
+        DEBUG_MSG("ERROR: UBX message is not supported (%02x %02x)\n", serial_buff[2], serial_buff[3]);
+        return IGNORED;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/*
+Decode a NMEA sentence whose checksum was verified.
+The sentence is chopped in place into fields, it must be null-terminated at
+buff_size. Update the global GPS variables and return the type of sentence.
+*/
+static enum gps_msg nmea_decode(char *parser_buf, int buff_size) {
+    int i, j, k;
+    int str_index[30]; /* string index from the string chopping */
+    int nb_fields; /* number of strings detected by string chopping */
+
+    if (match_label(parser_buf, "$G?RMC", 6, '?')) {
+        /*
+        NMEA sentence format: $xxRMC,time,status,lat,NS,long,EW,spd,cog,date,mv,mvEW,posMode*cs<CR><LF>
+        Valid fix: $GPRMC,083559.34,A,4717.11437,N,00833.91522,E,0.004,77.52,091202,,,A*00
+        No fix: $GPRMC,,V,,,,,,,,,,N*00
+        */
+        nb_fields = str_chop(parser_buf, buff_size, ',', str_index, ARRAY_SIZE(str_index));
+        if (nb_fields != 13) {
+            DEBUG_MSG("Warning: invalid RMC sentence (number of fields)\n");
+            return IGNORED;
+        }
+        /* parse GPS status */
+        gps_mod = *(parser_buf + str_index[12]); /* get first character, no need to bother with sscanf */
+        if ((gps_mod != 'N') && (gps_mod != 'A') && (gps_mod != 'D')) {
+            gps_mod = 'N';
+        }
+        /* parse complete time */
+        i = sscanf(parser_buf + str_index[1], "%2hd%2hd%2hd%4f", &gps_hou, &gps_min, &gps_sec, &gps_fra);
+        j = sscanf(parser_buf + str_index[9], "%2hd%2hd%2hd", &gps_day, &gps_mon, &gps_yea);
+        if ((i == 4) && (j == 3)) {
+            if ((gps_mod == 'A') || (gps_mod == 'D')) {
+                gps_time_ok = true;
+                DEBUG_MSG("Note: Valid RMC sentence, GPS locked, date: 20%02d-%02d-%02dT%02d:%02d:%06.3fZ\n", gps_yea, gps_mon, gps_day, gps_hou, gps_min, gps_fra + (float)gps_sec);
+            } else {
+                gps_time_ok = false;
+                DEBUG_MSG("Note: Valid RMC sentence, no satellite fix, estimated date: 20%02d-%02d-%02dT%02d:%02d:%06.3fZ\n", gps_yea, gps_mon, gps_day, gps_hou, gps_min, gps_fra + (float)gps_sec);
+            }
+        } else {
+            /* could not get a valid hour AND date */
+            gps_time_ok = false;
+            DEBUG_MSG("Note: Valid RMC sentence, mode %c, no date\n", gps_mod);
+        }
+        return NMEA_RMC;
+    } else if (match_label(parser_buf, "$G?GGA", 6, '?')) {
+        /*
+        NMEA sentence format: $xxGGA,time,lat,NS,long,EW,quality,numSV,HDOP,alt,M,sep,M,diffAge,diffStation*cs<CR><LF>
+        Valid fix: $GPGGA,092725.00,4717.11399,N,00833.91590,E,1,08,1.01,499.6,M,48.0,M,,*5B
+        */
+        nb_fields = str_chop(parser_buf, buff_size, ',', str_index, ARRAY_SIZE(str_index));
+        if (nb_fields != 15) {
+            DEBUG_MSG("Warning: invalid GGA sentence (number of fields)\n");
+            return IGNORED;
+        }
+        /* parse number of satellites used for fix */
+        sscanf(parser_buf + str_index[7], "%hd", &gps_sat);
+        /* parse 3D coordinates */
+        i = sscanf(parser_buf + str_index[2], "%2hd%10lf", &gps_dla, &gps_mla);
+        gps_ola = *(parser_buf + str_index[3]);
+        j = sscanf(parser_buf + str_index[4], "%3hd%10lf", &gps_dlo, &gps_mlo);
+        gps_olo = *(parser_buf + str_index[5]);
+        k = sscanf(parser_buf + str_index[9], "%hd", &gps_alt);
+        if ((i == 2) && (j == 2) && (k == 1) && ((gps_ola=='N')||(gps_ola=='S')) && ((gps_olo=='E')||(gps_olo=='W'))) {
+            gps_pos_ok = true;
+            DEBUG_MSG("Note: Valid GGA sentence, %d sat, lat %02ddeg %06.3fmin %c, lon %03ddeg%06.3fmin %c, alt %d\n", gps_sat, gps_dla, gps_mla, gps_ola, gps_dlo, gps_mlo, gps_olo, gps_alt);
+        } else {
+            /* could not get a valid latitude, longitude AND altitude */
+            gps_pos_ok = false;
+            DEBUG_MSG("Note: Valid GGA sentence, %d sat, no coordinates\n", gps_sat);
+        }
+        return NMEA_GGA;
+    } else {
+        DEBUG_MSG("Note: ignored NMEA sentence\n"); /* quite verbose */
+        return IGNORED;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int hexchar_to_nibble(char c) {
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    } else if ((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    } else if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    } else {
+        return -1;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/*
+Advance the stream parser by one byte.
+The frame is decoded in place as soon as its last byte arrives.
+Return 1 if a valid frame was completed, 0 else.
+*/
+static int stream_byte(struct lgw_gps_stream_s *s, uint8_t c) {
+    int x;
+
+    switch (s->state) {
+        case STREAM_SYNC:
+            if (c == LGW_GPS_NMEA_SYNC_CHAR) {
+                s->frame[0] = (char)c;
+                s->len = 1;
+                s->ck_a = 0;
+                s->state = STREAM_NMEA_BODY;
+            } else if (c == LGW_GPS_UBX_SYNC_CHAR) {
+                s->frame[0] = (char)c;
+                s->len = 1;
+                s->state = STREAM_UBX_SYNC2;
+            }
+            return 0;
+
+        case STREAM_NMEA_BODY:
+            if (c == '*') {
+                s->frame[s->len++] = (char)c;
+                s->state = STREAM_NMEA_CK_HI;
+                return 0;
+            } else if ((c >= 0x20) && (c <= 0x7E) && (c != LGW_GPS_NMEA_SYNC_CHAR) && (s->len < (LGW_GPS_FRAME_MAX - 5))) {
+                s->frame[s->len++] = (char)c;
+                s->ck_a ^= c;
+                return 0;
+            }
+            break; /* not printable, new sentence or too long */
+
+        case STREAM_NMEA_CK_HI:
+        case STREAM_NMEA_CK_LO:
+            x = hexchar_to_nibble((char)c);
+            if (x < 0) {
+                break;
+            }
+            if (s->state == STREAM_NMEA_CK_HI) {
+                x <<= 4;
+            }
+            if ((x ^ s->ck_a) & ((s->state == STREAM_NMEA_CK_HI) ? 0xF0 : 0x0F)) {
+                DEBUG_MSG("ERROR: NMEA CHECKSUM DOESN'T MATCH VERIFICATION CHECKSUM %02X\n", s->ck_a);
+                break;
+            }
+            s->frame[s->len++] = (char)c;
+            s->state = (s->state == STREAM_NMEA_CK_HI) ? STREAM_NMEA_CK_LO : STREAM_NMEA_EOL;
+            return 0;
+
+        case STREAM_NMEA_EOL:
+            /* the checksum is verified, anything but a sync char is accepted up to LF */
+            if ((c != '\n') && (c != LGW_GPS_NMEA_SYNC_CHAR) && (c != LGW_GPS_UBX_SYNC_CHAR)) {
+                s->frame[s->len++] = (char)c;
+                if (s->len < (LGW_GPS_FRAME_MAX - 1)) {
+                    return 0;
+                }
+            } else if (c == '\n') {
+                s->frame[s->len++] = (char)c;
+                s->frame[s->len] = '\0';
+                s->state = STREAM_SYNC;
+                s->last = nmea_decode(s->frame, s->len);
+                s->nb_frames += 1;
+                if (s->cb != NULL) {
+                    s->cb(s->last, s->frame, s->len, s->arg);
+                }
+                return 1;
+            }
+            break;
+
+        case STREAM_UBX_SYNC2:
+            if (c == 0x62) {
+                s->frame[s->len++] = (char)c;
+                s->ck_a = 0;
+                s->ck_b = 0;
+                s->size = 0;
+                s->state = STREAM_UBX_FRAME;
+                return 0;
+            }
+            break;
+
+        case STREAM_UBX_FRAME:
+            s->frame[s->len++] = (char)c;
+            if (s->len == 6) {
+                /* header complete: header + payload + checksum */
+                s->size = 8 + ((uint8_t)s->frame[4] | ((uint8_t)s->frame[5] << 8));
+                if (s->size > STREAM_UBX_SKIP_MAX) {
+                    break;
+                } else if (s->size > LGW_GPS_FRAME_MAX) {
+                    DEBUG_MSG("Note: UBX frame of %u bytes skipped\n", s->size);
+                    s->state = STREAM_UBX_SKIP;
+                    return 0;
+                }
+            }
+            if ((s->size == 0) || (s->len <= (s->size - 2))) {
+                /* 8-bit Fletcher checksum of class, ID, length and payload */
+                s->ck_a += c;
+                s->ck_b += s->ck_a;
+                return 0;
+            }
+            if (s->len < s->size) {
+                return 0;
+            }
+            if (((uint8_t)s->frame[s->size - 2] != s->ck_a) || ((uint8_t)s->frame[s->size - 1] != s->ck_b)) {
+                DEBUG_MSG("ERROR: UBX message is corrupted, checksum failed\n");
+                s->nb_errors += 1;
+                s->state = STREAM_SYNC;
+                return 0; /* the last byte is a checksum, do not try it as a sync char */
+            }
+            s->state = STREAM_SYNC;
+            s->last = ubx_decode(s->frame);
+            s->nb_frames += 1;
+            if (s->cb != NULL) {
+                s->cb(s->last, s->frame, s->len, s->arg);
+            }
+            return 1;
+
+        case STREAM_UBX_SKIP:
+            if (++s->len >= s->size) {
+                s->state = STREAM_SYNC;
+            }
+            return 0;
+    }
+
+    /* frame dropped, the byte may start the next one */
+    s->nb_errors += 1;
+    s->state = STREAM_SYNC;
+    return stream_byte(s, c);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* a - b, in microseconds */
+static double ts_diff_us(struct timespec a, struct timespec b) {
+    return (double)(a.tv_sec - b.tv_sec) * 1E6 + (double)(a.tv_nsec - b.tv_nsec) / 1E3;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* a + us, normalized */
+static struct timespec ts_add_us(struct timespec a, double us) {
+    int64_t ns = (int64_t)a.tv_nsec + (int64_t)llround(us * 1E3);
+    int64_t sec = ns / 1000000000;
+
+    ns -= sec * 1000000000;
+    if (ns < 0) {
+        ns += 1000000000;
+        sec -= 1;
+    }
+    a.tv_sec += (time_t)sec;
+    a.tv_nsec = (long)ns;
+    return a;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* a - b, exact, normalized */
+static struct timespec ts_sub(struct timespec a, struct timespec b) {
+    a.tv_sec -= b.tv_sec;
+    a.tv_nsec -= b.tv_nsec;
+    if (a.tv_nsec < 0) {
+        a.tv_nsec += 1000000000;
+        a.tv_sec -= 1;
+    }
+    return a;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/*
+Least-squares fit of r = offset + drift * (x - x_mean) over the window.
+The window is small, a full pass per capture is cheaper than maintaining
+running sums that would lose precision as x grows.
+*/
+static void clk_fit(struct lgw_clk_model_s *m) {
+    double xm = 0.0, rm = 0.0, sxx = 0.0, sxr = 0.0, e, acc = 0.0;
+    int i;
+
+    for (i = 0; i < m->nb; ++i) {
+        xm += m->x_us[i];
+        rm += m->r_us[i];
+    }
+    xm /= m->nb;
+    rm /= m->nb;
+    for (i = 0; i < m->nb; ++i) {
+        sxx += (m->x_us[i] - xm) * (m->x_us[i] - xm);
+        sxr += (m->x_us[i] - xm) * (m->r_us[i] - rm);
+    }
+    m->x_mean = xm;
+    m->offset_us = rm;
+    m->drift = (sxx > 0.0) ? (sxr / sxx) : 0.0;
+    for (i = 0; i < m->nb; ++i) {
+        e = m->r_us[i] - (m->offset_us + m->drift * (m->x_us[i] - xm));
+        acc += e * e;
+    }
+    m->rms_us = sqrt(acc / m->nb);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* restart the model from a single capture, keeping the settings */
+static void clk_reset(struct lgw_clk_model_s *m, uint32_t count_us, struct timespec utc, struct timespec gps_time) {
+    m->anchor_cnt = count_us;
+    m->anchor_utc = utc;
+    m->gps_minus_utc = ts_sub(gps_time, utc);
+    m->last_cnt = count_us;
+    m->last_ext = 0;
+    m->x_us[0] = 0.0;
+    m->r_us[0] = 0.0;
+    m->nb = 1;
+    m->head = 1;
+    m->nb_outliers = 0;
+    m->systime = time(NULL);
+    clk_fit(m);
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -391,7 +798,6 @@ int lgw_gps_disable(int fd) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 enum gps_msg lgw_parse_ubx(const char *serial_buff, size_t buff_size, size_t *msg_size) {
-    bool valid = 0;    /* iTOW, fTOW and week validity */
     unsigned int payload_length;
     uint8_t ck_a, ck_b;
     uint8_t ck_a_rcv, ck_b_rcv;
@@ -437,56 +843,7 @@ enum gps_msg lgw_parse_ubx(const char *serial_buff, size_t buff_size, size_t *ms
 
             /* Compare checksums and parse if OK */
             if ((ck_a == ck_a_rcv) && (ck_b == ck_b_rcv)) {
-                /* Check for Class 0x01 (NAV) and ID 0x20 (NAV-TIMEGPS) */
-                if ((serial_buff[2] == 0x01) && (serial_buff[3] == 0x20)) {
-                    /* Check validity of information */
-                    valid = serial_buff[17] & 0x3; /* towValid, weekValid */
-                    if (valid) {
-                        /* Parse buffer to extract GPS time */
-                        /* Warning: payload byte ordering is Little Endian */
-                        gps_iTOW =  (uint8_t)serial_buff[6];
-                        gps_iTOW |= (uint8_t)serial_buff[7] << 8;
-                        gps_iTOW |= (uint8_t)serial_buff[8] << 16;
-                        gps_iTOW |= (uint8_t)serial_buff[9] << 24; /* GPS time of week, in ms */
-
-                        gps_fTOW =  (uint8_t)serial_buff[10];
-                        gps_fTOW |= (uint8_t)serial_buff[11] << 8;
-                        gps_fTOW |= (uint8_t)serial_buff[12] << 16;
-                        gps_fTOW |= (uint8_t)serial_buff[13] << 24; /* Fractional part of iTOW, in ns */
-
-                        gps_week =  (uint8_t)serial_buff[14];
-                        gps_week |= (uint8_t)serial_buff[15] << 8; /* GPS week number */
-
-                        gps_time_ok = true;
-#if 0
-                        /* For debug */
-                        {
-                            short ubx_gps_hou = 0; /* hours (0-23) */
-                            short ubx_gps_min = 0; /* minutes (0-59) */
-                            short ubx_gps_sec = 0; /* seconds (0-59) */
-
-                            /* Format GPS time in hh:mm:ss based on iTOW */
-                            ubx_gps_sec = (gps_iTOW / 1000) % 60;
-                            ubx_gps_min = (gps_iTOW / 1000 / 60) % 60;
-                            ubx_gps_hou = (gps_iTOW / 1000 / 60 / 60) % 24;
-                            printf("  GPS time = %02d:%02d:%02d\n", ubx_gps_hou, ubx_gps_min, ubx_gps_sec);
-                        }
-#endif
-                    } else { /* valid */
-                        gps_time_ok = false;
-                    }
-
-                    return UBX_NAV_TIMEGPS;
-                } else if ((serial_buff[2] == 0x05) && (serial_buff[3] == 0x00)) {
-                    DEBUG_MSG("NOTE: UBX ACK-NAK received\n");
-                    return IGNORED;
-                } else if ((serial_buff[2] == 0x05) && (serial_buff[3] == 0x01)) {
-                    DEBUG_MSG("NOTE: UBX ACK-ACK received\n");
-                    return IGNORED;
-                } else { /* not a supported message */
-                    DEBUG_MSG("ERROR: UBX message is not supported (%02x %02x)\n", serial_buff[2], serial_buff[3]);
-                    return IGNORED;
-                }
+                return ubx_decode(serial_buff);
             } else { /* checksum failed */
                 DEBUG_MSG("ERROR: UBX message is corrupted, checksum failed\n");
                 return INVALID;
@@ -504,9 +861,6 @@ enum gps_msg lgw_parse_ubx(const char *serial_buff, size_t buff_size, size_t *ms
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 enum gps_msg lgw_parse_nmea(const char *serial_buff, int buff_size) {
-    int i, j, k;
-    int str_index[30]; /* string index from the string chopping */
-    int nb_fields; /* number of strings detected by string chopping */
     char parser_buf[256]; /* parsing modifies buffer so need a local copy */
 
     /* check input parameters */
@@ -526,74 +880,68 @@ enum gps_msg lgw_parse_nmea(const char *serial_buff, int buff_size) {
     } else if (!validate_nmea_checksum(serial_buff, buff_size)) {
         DEBUG_MSG("Warning: invalid NMEA sentence (bad checksum)\n");
         return INVALID;
-    } else if (match_label(serial_buff, "$G?RMC", 6, '?')) {
-        /*
-        NMEA sentence format: $xxRMC,time,status,lat,NS,long,EW,spd,cog,date,mv,mvEW,posMode*cs<CR><LF>
-        Valid fix: $GPRMC,083559.34,A,4717.11437,N,00833.91522,E,0.004,77.52,091202,,,A*00
-        No fix: $GPRMC,,V,,,,,,,,,,N*00
-        */
-        memcpy(parser_buf, serial_buff, buff_size);
-        parser_buf[buff_size] = '\0';
-        nb_fields = str_chop(parser_buf, buff_size, ',', str_index, ARRAY_SIZE(str_index));
-        if (nb_fields != 13) {
-            DEBUG_MSG("Warning: invalid RMC sentence (number of fields)\n");
-            return IGNORED;
-        }
-        /* parse GPS status */
-        gps_mod = *(parser_buf + str_index[12]); /* get first character, no need to bother with sscanf */
-        if ((gps_mod != 'N') && (gps_mod != 'A') && (gps_mod != 'D')) {
-            gps_mod = 'N';
-        }
-        /* parse complete time */
-        i = sscanf(parser_buf + str_index[1], "%2hd%2hd%2hd%4f", &gps_hou, &gps_min, &gps_sec, &gps_fra);
-        j = sscanf(parser_buf + str_index[9], "%2hd%2hd%2hd", &gps_day, &gps_mon, &gps_yea);
-        if ((i == 4) && (j == 3)) {
-            if ((gps_mod == 'A') || (gps_mod == 'D')) {
-                gps_time_ok = true;
-                DEBUG_MSG("Note: Valid RMC sentence, GPS locked, date: 20%02d-%02d-%02dT%02d:%02d:%06.3fZ\n", gps_yea, gps_mon, gps_day, gps_hou, gps_min, gps_fra + (float)gps_sec);
-            } else {
-                gps_time_ok = false;
-                DEBUG_MSG("Note: Valid RMC sentence, no satellite fix, estimated date: 20%02d-%02d-%02dT%02d:%02d:%06.3fZ\n", gps_yea, gps_mon, gps_day, gps_hou, gps_min, gps_fra + (float)gps_sec);
-            }
-        } else {
-            /* could not get a valid hour AND date */
-            gps_time_ok = false;
-            DEBUG_MSG("Note: Valid RMC sentence, mode %c, no date\n", gps_mod);
-        }
-        return NMEA_RMC;
-    } else if (match_label(serial_buff, "$G?GGA", 6, '?')) {
-        /*
-        NMEA sentence format: $xxGGA,time,lat,NS,long,EW,quality,numSV,HDOP,alt,M,sep,M,diffAge,diffStation*cs<CR><LF>
-        Valid fix: $GPGGA,092725.00,4717.11399,N,00833.91590,E,1,08,1.01,499.6,M,48.0,M,,*5B
-        */
-        memcpy(parser_buf, serial_buff, buff_size);
-        parser_buf[buff_size] = '\0';
-        nb_fields = str_chop(parser_buf, buff_size, ',', str_index, ARRAY_SIZE(str_index));
-        if (nb_fields != 15) {
-            DEBUG_MSG("Warning: invalid GGA sentence (number of fields)\n");
-            return IGNORED;
+    }
+
+    /* parsing modifies buffer so need a local copy */
+    memcpy(parser_buf, serial_buff, buff_size);
+    parser_buf[buff_size] = '\0';
+    return nmea_decode(parser_buf, buff_size);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_gps_stream_init(struct lgw_gps_stream_s *s, lgw_gps_frame_cb cb, void *arg) {
+    if (s == NULL) {
+        return;
+    }
+    memset(s, 0, sizeof *s);
+    s->state = STREAM_SYNC;
+    s->cb = cb;
+    s->arg = arg;
+    s->last = UNKNOWN;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_gps_stream_feed(struct lgw_gps_stream_s *s, const uint8_t *buf, size_t size) {
+    int nb = 0;
+    size_t i;
+
+    CHECK_NULL(s);
+    CHECK_NULL(buf);
+
+    for (i = 0; i < size; ++i) {
+        /* most bytes are NMEA text, only the checksum is updated for them */
+        if ((s->state == STREAM_NMEA_BODY) && (buf[i] >= 0x20) && (buf[i] <= 0x7E) && (buf[i] != '*') &&
+            (buf[i] != LGW_GPS_NMEA_SYNC_CHAR) && (s->len < (LGW_GPS_FRAME_MAX - 5))) {
+            s->frame[s->len++] = (char)buf[i];
+            s->ck_a ^= buf[i];
+            continue;
         }
-        /* parse number of satellites used for fix */
-        sscanf(parser_buf + str_index[7], "%hd", &gps_sat);
-        /* parse 3D coordinates */
-        i = sscanf(parser_buf + str_index[2], "%2hd%10lf", &gps_dla, &gps_mla);
-        gps_ola = *(parser_buf + str_index[3]);
-        j = sscanf(parser_buf + str_index[4], "%3hd%10lf", &gps_dlo, &gps_mlo);
-        gps_olo = *(parser_buf + str_index[5]);
-        k = sscanf(parser_buf + str_index[9], "%hd", &gps_alt);
-        if ((i == 2) && (j == 2) && (k == 1) && ((gps_ola=='N')||(gps_ola=='S')) && ((gps_olo=='E')||(gps_olo=='W'))) {
-            gps_pos_ok = true;
-            DEBUG_MSG("Note: Valid GGA sentence, %d sat, lat %02ddeg %06.3fmin %c, lon %03ddeg%06.3fmin %c, alt %d\n", gps_sat, gps_dla, gps_mla, gps_ola, gps_dlo, gps_mlo, gps_olo, gps_alt);
-        } else {
-            /* could not get a valid latitude, longitude AND altitude */
-            gps_pos_ok = false;
-            DEBUG_MSG("Note: Valid GGA sentence, %d sat, no coordinates\n", gps_sat);
+        nb += stream_byte(s, buf[i]);
+    }
+    return nb;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_gps_stream_read(struct lgw_gps_stream_s *s, int fd) {
+    uint8_t buf[LGW_GPS_FRAME_MAX];
+    ssize_t nb_char;
+
+    CHECK_NULL(s);
+
+    nb_char = read(fd, buf, sizeof buf);
+    if (nb_char < 0) {
+        if ((errno == EAGAIN) || (errno == EINTR)) {
+            return 0;
         }
-        return NMEA_GGA;
-    } else {
-        DEBUG_MSG("Note: ignored NMEA sentence\n"); /* quite verbose */
-        return IGNORED;
+        DEBUG_MSG("ERROR: failed to read GPS tty\n");
+        return LGW_GPS_ERROR;
+    } else if (nb_char == 0) {
+        return LGW_GPS_ERROR; /* tty closed */
     }
+    return lgw_gps_stream_feed(s, buf, (size_t)nb_char);
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -732,6 +1080,123 @@ int lgw_gps_sync(struct tref *ref, uint32_t count_us, struct timespec utc, struc
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+void lgw_clk_init(struct lgw_clk_model_s *m) {
+    if (m == NULL) {
+        return;
+    }
+    memset(m, 0, sizeof *m);
+    m->holdover_s = LGW_CLK_HOLDOVER_S;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_clk_update(struct lgw_clk_model_s *m, uint32_t count_us, struct timespec utc, struct timespec gps_time) {
+    double y, x, r, tol;
+    double x_last;
+    int64_t ext, k;
+
+    CHECK_NULL(m);
+
+    if (m->nb == 0) {
+        clk_reset(m, count_us, utc, gps_time);
+        return LGW_GPS_SUCCESS;
+    }
+
+    /* extend the counter: the number of wraps is the one closest to the elapsed UTC time */
+    y = ts_diff_us(utc, m->anchor_utc);
+    ext = m->last_ext + (int64_t)(uint32_t)(count_us - m->last_cnt);
+    k = llround((y - (double)ext) / 4294967296.0);
+    ext += k * 4294967296LL;
+    x = (double)ext;
+    r = y - x;
+
+    /* check the capture against the model, or against the only capture if there is one */
+    x_last = (double)m->last_ext;
+    if (x <= x_last) {
+        tol = -1.0; /* time going backward or standing still */
+    } else if (m->nb == 1) {
+        tol = CLK_DRIFT_MAX * (x - x_last);
+    } else {
+        tol = CLK_OUTLIER_US + CLK_DRIFT_MAX * (x - x_last);
+    }
+    if ((tol < 0.0) || (fabs(r - (m->offset_us + m->drift * (x - m->x_mean))) > tol)) {
+        m->nb_rejected += 1;
+        m->nb_outliers += 1;
+        if (m->nb_outliers >= CLK_RESET_NB) {
+            DEBUG_MSG("Warning: %d successive aberrant sync attempts, clock model reset\n", m->nb_outliers);
+            clk_reset(m, count_us, utc, gps_time);
+            return LGW_GPS_SUCCESS;
+        }
+        DEBUG_MSG("Warning: aberrant capture for clock model, ignored\n");
+        return LGW_GPS_ERROR;
+    }
+
+    /* accept it, the oldest capture leaves the window */
+    m->x_us[m->head] = x;
+    m->r_us[m->head] = r;
+    m->head = (m->head + 1) % LGW_CLK_WINDOW;
+    if (m->nb < LGW_CLK_WINDOW) {
+        m->nb += 1;
+    }
+    m->last_cnt = count_us;
+    m->last_ext = ext;
+    m->gps_minus_utc = ts_sub(gps_time, utc);
+    m->nb_outliers = 0;
+    m->systime = time(NULL);
+    clk_fit(m);
+
+    return LGW_GPS_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_clk_cnt2utc(const struct lgw_clk_model_s *m, uint32_t count_us, struct timespec *utc) {
+    int32_t delta;
+    double x;
+
+    CHECK_NULL(m);
+    CHECK_NULL(utc);
+    if (m->nb < 2) {
+        DEBUG_MSG("ERROR: CLOCK MODEL NOT SYNCHRONIZED\n");
+        return LGW_GPS_ERROR;
+    }
+
+    /* counter values are taken within holdover_s (LGW_CLK_HOLDOVER_S, 10 min by default) of the latest capture, before or after it */
+    delta = (int32_t)(count_us - m->last_cnt);
+    if ((delta > (int64_t)m->holdover_s * 1000000) || (delta < -(int64_t)m->holdover_s * 1000000)) {
+        DEBUG_MSG("ERROR: COUNTER VALUE BEYOND CLOCK MODEL HOLDOVER\n");
+        return LGW_GPS_ERROR;
+    }
+    x = (double)(m->last_ext + delta);
+    *utc = ts_add_us(m->anchor_utc, x + m->offset_us + m->drift * (x - m->x_mean));
+
+    return LGW_GPS_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_clk_get_tref(const struct lgw_clk_model_s *m, struct tref *ref) {
+    double x;
+
+    CHECK_NULL(m);
+    CHECK_NULL(ref);
+    if (m->nb < 2) {
+        return LGW_GPS_ERROR;
+    }
+
+    /* reference point: the model value at the latest capture */
+    x = (double)m->last_ext;
+    ref->systime = m->systime;
+    ref->count_us = m->last_cnt;
+    ref->utc = ts_add_us(m->anchor_utc, x + m->offset_us + m->drift * (x - m->x_mean));
+    ref->gps = ts_sub(ref->utc, ts_sub((struct timespec){0, 0}, m->gps_minus_utc));
+    ref->xtal_err = 1.0 / (1.0 + m->drift);
+
+    return LGW_GPS_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_cnt2utc(struct tref ref, uint32_t count_us, struct timespec *utc) {
     double delta_sec;
     double intpart, fractpart;
@@ -744,12 +1209,15 @@ int lgw_cnt2utc(struct tref ref, uint32_t count_us, struct timespec *utc) {
     }
 
     /* calculate delta in seconds between reference count_us and target count_us */
-    delta_sec = (double)(count_us - ref.count_us) / (TS_CPS * ref.xtal_err);
+    delta_sec = (double)(int32_t)(count_us - ref.count_us) / (TS_CPS * ref.xtal_err); /* count_us may precede the reference */
 
     /* now add that delta to reference UTC time */
     fractpart = modf (delta_sec , &intpart);
     tmp = ref.utc.tv_nsec + (long)(fractpart * 1E9);
-    if (tmp < (long)1E9) { /* the nanosecond part doesn't overflow */
+    if (tmp < 0) { /* must borrow one second */
+        utc->tv_sec = ref.utc.tv_sec + (time_t)intpart - 1;
+        utc->tv_nsec = tmp + (long)1E9;
+    } else if (tmp < (long)1E9) { /* the nanosecond part doesn't overflow */
         utc->tv_sec = ref.utc.tv_sec + (time_t)intpart;
         utc->tv_nsec = tmp;
     } else { /* must carry one second */
@@ -795,12 +1263,15 @@ int lgw_cnt2gps(struct tref ref, uint32_t count_us, struct timespec *gps_time) {
     }
 
     /* calculate delta in milliseconds between reference count_us and target count_us */
-    delta_sec = (double)(count_us - ref.count_us) / (TS_CPS * ref.xtal_err);
+    delta_sec = (double)(int32_t)(count_us - ref.count_us) / (TS_CPS * ref.xtal_err); /* count_us may precede the reference */
 
     /* now add that delta to reference GPS time */
     fractpart = modf (delta_sec , &intpart);
     tmp = ref.gps.tv_nsec + (long)(fractpart * 1E9);
-    if (tmp < (long)1E9) { /* the nanosecond part doesn't overflow */
+    if (tmp < 0) { /* must borrow one second */
+        gps_time->tv_sec = ref.gps.tv_sec + (time_t)intpart - 1;
+        gps_time->tv_nsec = tmp + (long)1E9;
+    } else if (tmp < (long)1E9) { /* the nanosecond part doesn't overflow */
         gps_time->tv_sec = ref.gps.tv_sec + (time_t)intpart;
         gps_time->tv_nsec = tmp;
     } else { /* must carry one second */
@@ -30,6 +30,7 @@ Maintainer: Sylvain Miermont
 #include "loragw_radio.h"
 #include "loragw_fpga.h"
 #include "loragw_lbt.h"
+#include "loragw_pool.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -66,6 +67,9 @@ Maintainer: Sylvain Miermont
 #define TX_METADATA_NB      16
 #define RX_METADATA_NB      16
 
+/* the compact RX metadata record must stay that small, fail the build otherwise */
+typedef char lgw_pkt_meta_size_check[(sizeof(struct lgw_pkt_meta_s) == 28) ? 1 : -1];
+
 #define AGC_CMD_WAIT        16
 #define AGC_CMD_ABORT       17
 
@@ -136,6 +140,12 @@ static uint64_t fsk_sync_word= 0xC194C1; /* default FSK sync word (ALIGNED RIGHT
 static bool lorawan_public = false;
 static uint8_t rf_clkout = 0;
 
+static bool rxirq_enable = false; /* route RX FIFO status to a GPIO instead of AGC TX signals */
+static uint8_t rxirq_gpio_select = 2;
+
+/* 64-bit extension of the internal counter, moved by packet timestamps and instantaneous reads only */
+static struct lgw_cnt_ext_s cnt_ext;
+
 static struct lgw_tx_gain_lut_s txgain_lut = {
     .size = 2,
     .lut[0] = {
@@ -172,6 +182,40 @@ int32_t lgw_bw_getval(int x);
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
+/*
+Read the current value of the internal counter, the bus being held. LGW_TIMESTAMP
+holds the value latched at the latest GPS pulse while GPS_EN is set, so the
+capture is turned off for the time of the read. The counter extension is moved
+to that value, which keeps it right on a gateway receiving no packet.
+*/
+static int instcnt_read(uint32_t *cnt_us) {
+    int32_t val;
+    int i;
+
+    lgw_reg_w(LGW_GPS_EN, 0);
+    i = lgw_reg_r(LGW_TIMESTAMP, &val);
+    lgw_reg_w(LGW_GPS_EN, 1);
+    if (i != LGW_REG_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+    *cnt_us = (uint32_t)val;
+    lgw_cnt_ext_sample(&cnt_ext, (uint32_t)val, lgw_mono_ms());
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* sample the counter if nothing did for a while, so that no wrap is missed on a quiet gateway */
+static void cnt_refresh(void) {
+    uint32_t dummy;
+
+    if (lgw_cnt_ext_due(&cnt_ext, lgw_mono_ms()) == true) {
+        instcnt_read(&dummy);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 /* size is the firmware size in bytes (not 14b words) */
 int load_firmware(uint8_t target, uint8_t *firmware, uint16_t size) {
     int reg_rst;
@@ -409,6 +453,218 @@ uint16_t lgw_get_tx_start_delay(bool tx_notch_enable, uint8_t bw) {
     return (uint16_t)tx_start_delay; /* keep truncating instead of rounding: better behaviour measured */
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* Fetch the packet at the head of the RX FIFO into a packet buffer, metadata are
+   parsed in place from the bytes following the payload.
+   Return 1 if a packet was fetched, 0 if the FIFO is empty, -1 on invalid FIFO content. */
+static int rx_fetch_buf(struct lgw_pkt_buf_s *p) {
+    uint8_t fifo[5]; /* FIFO status, read before the payload */
+    uint8_t *buff = p->data; /* SPI read burst destination */
+    struct lgw_pkt_meta_s *m = &p->meta; /* compact metadata, filled in place */
+    uint8_t if_chain, rf_chain;
+    float rssi; /* RSSI in dB, before quantization */
+    unsigned sz; /* size of the payload, uses to address metadata */
+    int ifmod; /* type of if_chain/modem a packet was received by */
+    int stat_fifo; /* the packet status as indicated in the FIFO */
+    uint32_t raw_timestamp; /* timestamp when internal 'RX finished' was triggered */
+    uint32_t delay_x, delay_y, delay_z; /* temporary variable for timestamp offset calculation */
+    uint32_t timestamp_correction; /* correction to account for processing delay */
+    uint32_t sf, cr, bw_pow, crc_en, ppm; /* used to calculate timestamp correction */
+
+    /* fetch all the RX FIFO data */
+    lgw_reg_rb(LGW_RX_PACKET_DATA_FIFO_NUM_STORED, fifo, 5);
+    /* 0:   number of packets available in RX data buffer */
+    /* 1,2: start address of the current packet in RX data buffer */
+    /* 3:   CRC status of the current packet */
+    /* 4:   size of the current packet payload in byte */
+
+    /* how many packets are in the RX buffer ? Stop if zero */
+    if (fifo[0] == 0) {
+        return 0; /* no more packets to fetch */
+    }
+
+    /* sanity check */
+    if (fifo[0] > LGW_PKT_FIFO_SIZE) {
+        DEBUG_PRINTF("WARNING: %u = INVALID NUMBER OF PACKETS TO FETCH, ABORTING\n", fifo[0]);
+        return -1;
+    }
+
+    DEBUG_PRINTF("FIFO content: %x %x %x %x %x\n", fifo[0], fifo[1], fifo[2], fifo[3], fifo[4]);
+
+    m->size = fifo[4];
+    sz = m->size;
+    stat_fifo = fifo[3];
+
+    /* get payload + metadata, straight into the packet buffer */
+    lgw_reg_rb(LGW_RX_DATA_BUF_DATA, buff, sz+RX_METADATA_NB);
+
+    /* process metadata */
+    if_chain = buff[sz+0];
+    if (if_chain >= LGW_IF_CHAIN_NB) {
+        DEBUG_PRINTF("WARNING: %u NOT A VALID IF_CHAIN NUMBER, ABORTING\n", if_chain);
+        return -1;
+    }
+    ifmod = ifmod_config[if_chain];
+    DEBUG_PRINTF("[%d %d]\n", if_chain, ifmod);
+
+    rf_chain = (uint8_t)if_rf_chain[if_chain];
+    m->freq_hz = (uint32_t)((int32_t)rf_rx_freq[rf_chain] + if_freq[if_chain]);
+    rssi = (float)buff[sz+5] + rf_rssi_offset[rf_chain];
+
+    if ((ifmod == IF_LORA_MULTI) || (ifmod == IF_LORA_STD)) {
+        DEBUG_MSG("Note: LoRa packet\n");
+        switch(stat_fifo & 0x07) {
+            case 5:
+                m->status = STAT_CRC_OK;
+                crc_en = 1;
+                break;
+            case 7:
+                m->status = STAT_CRC_BAD;
+                crc_en = 1;
+                break;
+            case 1:
+                m->status = STAT_NO_CRC;
+                crc_en = 0;
+                break;
+            default:
+                m->status = STAT_UNDEFINED;
+                crc_en = 0;
+        }
+        m->modulation = MOD_LORA;
+        m->snr_x4 = (int8_t)buff[sz+2]; /* kept in the native quarter dB unit */
+        m->snr_min_x4 = (int8_t)buff[sz+3];
+        m->snr_max_x4 = (int8_t)buff[sz+4];
+        if (ifmod == IF_LORA_MULTI) {
+            m->bandwidth = BW_125KHZ; /* fixed in hardware */
+        } else {
+            m->bandwidth = lora_rx_bw; /* get the parameter from the config variable */
+        }
+        sf = (buff[sz+1] >> 4) & 0x0F;
+        switch (sf) {
+            case 7: m->datarate = DR_LORA_SF7; break;
+            case 8: m->datarate = DR_LORA_SF8; break;
+            case 9: m->datarate = DR_LORA_SF9; break;
+            case 10: m->datarate = DR_LORA_SF10; break;
+            case 11: m->datarate = DR_LORA_SF11; break;
+            case 12: m->datarate = DR_LORA_SF12; break;
+            default: m->datarate = DR_UNDEFINED;
+        }
+        cr = (buff[sz+1] >> 1) & 0x07;
+        switch (cr) {
+            case 1: m->coderate = CR_LORA_4_5; break;
+            case 2: m->coderate = CR_LORA_4_6; break;
+            case 3: m->coderate = CR_LORA_4_7; break;
+            case 4: m->coderate = CR_LORA_4_8; break;
+            default: m->coderate = CR_UNDEFINED;
+        }
+
+        /* determine if 'PPM mode' is on, needed for timestamp correction */
+        if (SET_PPM_ON(m->bandwidth,m->datarate)) {
+            ppm = 1;
+        } else {
+            ppm = 0;
+        }
+
+        /* timestamp correction code, base delay */
+        if (ifmod == IF_LORA_STD) { /* if packet was received on the stand-alone LoRa modem */
+            switch (lora_rx_bw) {
+                case BW_125KHZ:
+                    delay_x = 64;
+                    bw_pow = 1;
+                    break;
+                case BW_250KHZ:
+                    delay_x = 32;
+                    bw_pow = 2;
+                    break;
+                case BW_500KHZ:
+                    delay_x = 16;
+                    bw_pow = 4;
+                    break;
+                default:
+                    DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\n", m->bandwidth);
+                    delay_x = 0;
+                    bw_pow = 0;
+            }
+        } else { /* packet was received on one of the sensor channels = 125kHz */
+            delay_x = 114;
+            bw_pow = 1;
+        }
+
+        /* timestamp correction code, variable delay */
+        if ((sf >= 6) && (sf <= 12) && (bw_pow > 0)) {
+            if ((2*(sz + 2*crc_en) - (sf-7)) <= 0) { /* payload fits entirely in first 8 symbols */
+                delay_y = ( ((1<<(sf-1)) * (sf+1)) + (3 * (1<<(sf-4))) ) / bw_pow;
+                delay_z = 32 * (2*(sz+2*crc_en) + 5) / bw_pow;
+            } else {
+                delay_y = ( ((1<<(sf-1)) * (sf+1)) + ((4 - ppm) * (1<<(sf-4))) ) / bw_pow;
+                delay_z = (16 + 4*cr) * (((2*(sz+2*crc_en)-sf+6) % (sf - 2*ppm)) + 1) / bw_pow;
+            }
+            timestamp_correction = delay_x + delay_y + delay_z;
+        } else {
+            timestamp_correction = 0;
+            DEBUG_MSG("WARNING: invalid packet, no timestamp correction\n");
+        }
+
+        /* RSSI correction */
+        if (ifmod == IF_LORA_MULTI) {
+            rssi -= RSSI_MULTI_BIAS;
+        }
+
+    } else if (ifmod == IF_FSK_STD) {
+        DEBUG_MSG("Note: FSK packet\n");
+        switch(stat_fifo & 0x07) {
+            case 5:
+                m->status = STAT_CRC_OK;
+                break;
+            case 7:
+                m->status = STAT_CRC_BAD;
+                break;
+            case 1:
+                m->status = STAT_NO_CRC;
+                break;
+            default:
+                m->status = STAT_UNDEFINED;
+                break;
+        }
+        m->modulation = MOD_FSK;
+        m->snr_x4 = LGW_SNR_UNDEFINED;
+        m->snr_min_x4 = LGW_SNR_UNDEFINED;
+        m->snr_max_x4 = LGW_SNR_UNDEFINED;
+        m->bandwidth = fsk_rx_bw;
+        m->datarate = DR_UNDEFINED; /* FSK datarate does not fit, it is the configured one (fsk_rx_dr) */
+        m->coderate = CR_UNDEFINED;
+        timestamp_correction = ((uint32_t)680000 / fsk_rx_dr) - 20;
+
+        /* RSSI correction */
+        rssi = RSSI_FSK_POLY_0 + RSSI_FSK_POLY_1 * rssi + RSSI_FSK_POLY_2 * pow(rssi, 2);
+    } else {
+        DEBUG_MSG("ERROR: UNEXPECTED PACKET ORIGIN\n");
+        m->status = STAT_UNDEFINED;
+        m->modulation = MOD_UNDEFINED;
+        rssi = -128.0;
+        m->snr_x4 = LGW_SNR_UNDEFINED;
+        m->snr_min_x4 = LGW_SNR_UNDEFINED;
+        m->snr_max_x4 = LGW_SNR_UNDEFINED;
+        m->bandwidth = BW_UNDEFINED;
+        m->datarate = DR_UNDEFINED;
+        m->coderate = CR_UNDEFINED;
+        timestamp_correction = 0;
+    }
+
+    m->chain = (uint8_t)((rf_chain << 4) | if_chain);
+    m->rssi_x16 = (int16_t)lroundf(rssi * 16);
+
+    raw_timestamp = (uint32_t)buff[sz+6] + ((uint32_t)buff[sz+7] << 8) + ((uint32_t)buff[sz+8] << 16) + ((uint32_t)buff[sz+9] << 24);
+    m->count_us64 = lgw_cnt_ext_sample(&cnt_ext, raw_timestamp - timestamp_correction, lgw_mono_ms());
+    m->crc = (uint16_t)buff[sz+10] + ((uint16_t)buff[sz+11] << 8);
+
+    /* advance packet FIFO */
+    lgw_reg_w(LGW_RX_PACKET_DATA_FIFO_NUM_STORED, 0);
+
+    return 1;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -647,6 +903,31 @@ int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_rxirq_setconf(struct lgw_conf_rxirq_s conf) {
+
+    /* check if the concentrator is running */
+    if (lgw_is_started == true) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* GPIO_SELECT_OUTPUT is a 4-bit field */
+    if (conf.gpio_select > 15) {
+        DEBUG_MSG("ERROR: RX-READY GPIO SELECT VALUE OUT OF RANGE\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* set internal config according to parameters */
+    rxirq_enable = conf.enable;
+    rxirq_gpio_select = (conf.enable == true) ? conf.gpio_select : 2;
+
+    DEBUG_PRINTF("Note: RX-ready GPIO configuration; enable:%d, gpio_select:%d\n", rxirq_enable, rxirq_gpio_select);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_txgain_setconf(struct lgw_tx_gain_lut_s *conf) {
     int i;
 
@@ -744,9 +1025,10 @@ int lgw_start(void) {
         return LGW_HAL_ERROR;
     }
 
-    /* gives AGC control of GPIOs to enable Tx external digital filter */
+    /* gives AGC control of GPIOs to enable Tx external digital filter, */
+    /* unless they are used to signal packets waiting in the RX FIFO */
     lgw_reg_w(LGW_GPIO_MODE,31); /* Set all GPIOs as output */
-    lgw_reg_w(LGW_GPIO_SELECT_OUTPUT,2);
+    lgw_reg_w(LGW_GPIO_SELECT_OUTPUT,rxirq_gpio_select);
 
     /* Configure LBT */
     if (lbt_is_enabled() == true) {
@@ -1084,6 +1366,9 @@ int lgw_start(void) {
         wait_ms(8400);
     }
 
+    /* the counter restarted from zero, so does its extension */
+    lgw_cnt_ext_init(&cnt_ext);
+
     lgw_is_started = true;
     return LGW_HAL_SUCCESS;
 }
@@ -1103,14 +1388,7 @@ int lgw_stop(void) {
 int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
     int nb_pkt_fetch; /* loop variable and return value */
     struct lgw_pkt_rx_s *p; /* pointer to the current structure in the struct array */
-    uint8_t buff[255+RX_METADATA_NB]; /* buffer to store the result of SPI read bursts */
-    unsigned sz; /* size of the payload, uses to address metadata */
-    int ifmod; /* type of if_chain/modem a packet was received by */
-    int stat_fifo; /* the packet status as indicated in the FIFO */
-    uint32_t raw_timestamp; /* timestamp when internal 'RX finished' was triggered */
-    uint32_t delay_x, delay_y, delay_z; /* temporary variable for timestamp offset calculation */
-    uint32_t timestamp_correction; /* correction to account for processing delay */
-    uint32_t sf, cr, bw_pow, crc_en, ppm; /* used to calculate timestamp correction */
+    struct lgw_pkt_buf_s buf; /* buffer to store the result of SPI read bursts */
 
     /* check if the concentrator is running */
     if (lgw_is_started == false) {
@@ -1125,207 +1403,119 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
     }
     CHECK_NULL(pkt_data);
 
-    /* Initialize buffer */
-    memset (buff, 0, sizeof buff);
-
-    /* iterate max_pkt times at most */
+    /* iterate max_pkt times at most, the drain has priority on the bus */
+    lgw_bus_lock(LGW_BUS_PRIO_RX);
     for (nb_pkt_fetch = 0; nb_pkt_fetch < max_pkt; ++nb_pkt_fetch) {
 
         /* point to the proper struct in the struct array */
         p = &pkt_data[nb_pkt_fetch];
 
-        /* fetch all the RX FIFO data */
-        lgw_reg_rb(LGW_RX_PACKET_DATA_FIFO_NUM_STORED, buff, 5);
-        /* 0:   number of packets available in RX data buffer */
-        /* 1,2: start address of the current packet in RX data buffer */
-        /* 3:   CRC status of the current packet */
-        /* 4:   size of the current packet payload in byte */
-
-        /* how many packets are in the RX buffer ? Break if zero */
-        if (buff[0] == 0) {
+        if (rx_fetch_buf(&buf) != 1) {
             break; /* no more packets to fetch, exit out of FOR loop */
         }
 
-        /* sanity check */
-        if (buff[0] > LGW_PKT_FIFO_SIZE) {
-            DEBUG_PRINTF("WARNING: %u = INVALID NUMBER OF PACKETS TO FETCH, ABORTING\n", buff[0]);
-            break;
-        }
+        /* expand metadata and copy payload to result struct */
+        lgw_pkt_meta_to_rx(&buf.meta, buf.data, p);
+    }
+    cnt_refresh();
+    lgw_bus_unlock();
+
+    return nb_pkt_fetch;
+}
 
-        DEBUG_PRINTF("FIFO content: %x %x %x %x %x\n", buff[0], buff[1], buff[2], buff[3], buff[4]);
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-        p->size = buff[4];
-        sz = p->size;
-        stat_fifo = buff[3]; /* will be used later, need to save it before overwriting buff */
+int lgw_receive_buf(uint8_t max_pkt, struct lgw_pkt_buf_s **pkt_buf) {
+    int nb_pkt_fetch; /* loop variable and return value */
+    struct lgw_pkt_buf_s *b;
+    int x;
 
-        /* get payload + metadata */
-        lgw_reg_rb(LGW_RX_DATA_BUF_DATA, buff, sz+RX_METADATA_NB);
+    /* check if the concentrator is running */
+    if (lgw_is_started == false) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE RECEIVING\n");
+        return LGW_HAL_ERROR;
+    }
 
-        /* copy payload to result struct */
-        memcpy((void *)p->payload, (void *)buff, sz);
+    /* check input variables */
+    if ((max_pkt <= 0) || (max_pkt > LGW_PKT_FIFO_SIZE)) {
+        DEBUG_PRINTF("ERROR: %d = INVALID MAX NUMBER OF PACKETS TO FETCH\n", max_pkt);
+        return LGW_HAL_ERROR;
+    }
+    CHECK_NULL(pkt_buf);
 
-        /* process metadata */
-        p->if_chain = buff[sz+0];
-        if (p->if_chain >= LGW_IF_CHAIN_NB) {
-            DEBUG_PRINTF("WARNING: %u NOT A VALID IF_CHAIN NUMBER, ABORTING\n", p->if_chain);
+    /* iterate max_pkt times at most, the drain has priority on the bus */
+    lgw_bus_lock(LGW_BUS_PRIO_RX);
+    for (nb_pkt_fetch = 0; nb_pkt_fetch < max_pkt; ++nb_pkt_fetch) {
+        b = lgw_pool_get();
+        if (b == NULL) {
+            break; /* packets stay in the FIFO until buffers are released */
+        }
+        x = rx_fetch_buf(b);
+        if (x != 1) {
+            lgw_pool_release(b);
             break;
         }
-        ifmod = ifmod_config[p->if_chain];
-        DEBUG_PRINTF("[%d %d]\n", p->if_chain, ifmod);
-
-        p->rf_chain = (uint8_t)if_rf_chain[p->if_chain];
-        p->freq_hz = (uint32_t)((int32_t)rf_rx_freq[p->rf_chain] + if_freq[p->if_chain]);
-        p->rssi = (float)buff[sz+5] + rf_rssi_offset[p->rf_chain];
-
-        if ((ifmod == IF_LORA_MULTI) || (ifmod == IF_LORA_STD)) {
-            DEBUG_MSG("Note: LoRa packet\n");
-            switch(stat_fifo & 0x07) {
-                case 5:
-                    p->status = STAT_CRC_OK;
-                    crc_en = 1;
-                    break;
-                case 7:
-                    p->status = STAT_CRC_BAD;
-                    crc_en = 1;
-                    break;
-                case 1:
-                    p->status = STAT_NO_CRC;
-                    crc_en = 0;
-                    break;
-                default:
-                    p->status = STAT_UNDEFINED;
-                    crc_en = 0;
-            }
-            p->modulation = MOD_LORA;
-            p->snr = ((float)((int8_t)buff[sz+2]))/4;
-            p->snr_min = ((float)((int8_t)buff[sz+3]))/4;
-            p->snr_max = ((float)((int8_t)buff[sz+4]))/4;
-            if (ifmod == IF_LORA_MULTI) {
-                p->bandwidth = BW_125KHZ; /* fixed in hardware */
-            } else {
-                p->bandwidth = lora_rx_bw; /* get the parameter from the config variable */
-            }
-            sf = (buff[sz+1] >> 4) & 0x0F;
-            switch (sf) {
-                case 7: p->datarate = DR_LORA_SF7; break;
-                case 8: p->datarate = DR_LORA_SF8; break;
-                case 9: p->datarate = DR_LORA_SF9; break;
-                case 10: p->datarate = DR_LORA_SF10; break;
-                case 11: p->datarate = DR_LORA_SF11; break;
-                case 12: p->datarate = DR_LORA_SF12; break;
-                default: p->datarate = DR_UNDEFINED;
-            }
-            cr = (buff[sz+1] >> 1) & 0x07;
-            switch (cr) {
-                case 1: p->coderate = CR_LORA_4_5; break;
-                case 2: p->coderate = CR_LORA_4_6; break;
-                case 3: p->coderate = CR_LORA_4_7; break;
-                case 4: p->coderate = CR_LORA_4_8; break;
-                default: p->coderate = CR_UNDEFINED;
-            }
+        pkt_buf[nb_pkt_fetch] = b;
+    }
+    cnt_refresh();
+    lgw_bus_unlock();
 
-            /* determine if 'PPM mode' is on, needed for timestamp correction */
-            if (SET_PPM_ON(p->bandwidth,p->datarate)) {
-                ppm = 1;
-            } else {
-                ppm = 0;
-            }
+    return nb_pkt_fetch;
+}
 
-            /* timestamp correction code, base delay */
-            if (ifmod == IF_LORA_STD) { /* if packet was received on the stand-alone LoRa modem */
-                switch (lora_rx_bw) {
-                    case BW_125KHZ:
-                        delay_x = 64;
-                        bw_pow = 1;
-                        break;
-                    case BW_250KHZ:
-                        delay_x = 32;
-                        bw_pow = 2;
-                        break;
-                    case BW_500KHZ:
-                        delay_x = 16;
-                        bw_pow = 4;
-                        break;
-                    default:
-                        DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\n", p->bandwidth);
-                        delay_x = 0;
-                        bw_pow = 0;
-                }
-            } else { /* packet was received on one of the sensor channels = 125kHz */
-                delay_x = 114;
-                bw_pow = 1;
-            }
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-            /* timestamp correction code, variable delay */
-            if ((sf >= 6) && (sf <= 12) && (bw_pow > 0)) {
-                if ((2*(sz + 2*crc_en) - (sf-7)) <= 0) { /* payload fits entirely in first 8 symbols */
-                    delay_y = ( ((1<<(sf-1)) * (sf+1)) + (3 * (1<<(sf-4))) ) / bw_pow;
-                    delay_z = 32 * (2*(sz+2*crc_en) + 5) / bw_pow;
-                } else {
-                    delay_y = ( ((1<<(sf-1)) * (sf+1)) + ((4 - ppm) * (1<<(sf-4))) ) / bw_pow;
-                    delay_z = (16 + 4*cr) * (((2*(sz+2*crc_en)-sf+6) % (sf - 2*ppm)) + 1) / bw_pow;
-                }
-                timestamp_correction = delay_x + delay_y + delay_z;
-            } else {
-                timestamp_correction = 0;
-                DEBUG_MSG("WARNING: invalid packet, no timestamp correction\n");
-            }
+int lgw_receive_meta(uint8_t max_pkt, struct lgw_pkt_meta_s *meta) {
+    struct lgw_pkt_buf_s *pkt_buf[LGW_PKT_FIFO_SIZE];
+    int nb_pkt_fetch;
+    int i;
 
-            /* RSSI correction */
-            if (ifmod == IF_LORA_MULTI) {
-                p->rssi -= RSSI_MULTI_BIAS;
-            }
+    CHECK_NULL(meta);
 
-        } else if (ifmod == IF_FSK_STD) {
-            DEBUG_MSG("Note: FSK packet\n");
-            switch(stat_fifo & 0x07) {
-                case 5:
-                    p->status = STAT_CRC_OK;
-                    break;
-                case 7:
-                    p->status = STAT_CRC_BAD;
-                    break;
-                case 1:
-                    p->status = STAT_NO_CRC;
-                    break;
-                default:
-                    p->status = STAT_UNDEFINED;
-                    break;
-            }
-            p->modulation = MOD_FSK;
-            p->snr = -128.0;
-            p->snr_min = -128.0;
-            p->snr_max = -128.0;
-            p->bandwidth = fsk_rx_bw;
-            p->datarate = fsk_rx_dr;
-            p->coderate = CR_UNDEFINED;
-            timestamp_correction = ((uint32_t)680000 / fsk_rx_dr) - 20;
-
-            /* RSSI correction */
-            p->rssi = RSSI_FSK_POLY_0 + RSSI_FSK_POLY_1 * p->rssi + RSSI_FSK_POLY_2 * pow(p->rssi, 2);
-        } else {
-            DEBUG_MSG("ERROR: UNEXPECTED PACKET ORIGIN\n");
-            p->status = STAT_UNDEFINED;
-            p->modulation = MOD_UNDEFINED;
-            p->rssi = -128.0;
-            p->snr = -128.0;
-            p->snr_min = -128.0;
-            p->snr_max = -128.0;
-            p->bandwidth = BW_UNDEFINED;
-            p->datarate = DR_UNDEFINED;
-            p->coderate = CR_UNDEFINED;
-            timestamp_correction = 0;
-        }
+    nb_pkt_fetch = lgw_receive_buf(max_pkt, pkt_buf);
+    for (i = 0; i < nb_pkt_fetch; ++i) {
+        meta[i] = pkt_buf[i]->meta; /* buffers stay held, released through meta[i].slot */
+    }
 
-        raw_timestamp = (uint32_t)buff[sz+6] + ((uint32_t)buff[sz+7] << 8) + ((uint32_t)buff[sz+8] << 16) + ((uint32_t)buff[sz+9] << 24);
-        p->count_us = raw_timestamp - timestamp_correction;
-        p->crc = (uint16_t)buff[sz+10] + ((uint16_t)buff[sz+11] << 8);
+    return nb_pkt_fetch;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_pkt_meta_to_rx(const struct lgw_pkt_meta_s *meta, const uint8_t *payload, struct lgw_pkt_rx_s *pkt_data) {
+    CHECK_NULL(meta);
+    CHECK_NULL(pkt_data);
 
-        /* advance packet FIFO */
-        lgw_reg_w(LGW_RX_PACKET_DATA_FIFO_NUM_STORED, 0);
+    pkt_data->freq_hz = meta->freq_hz;
+    pkt_data->if_chain = LGW_META_IF_CHAIN(meta);
+    pkt_data->status = meta->status;
+    pkt_data->count_us = LGW_META_COUNT_US(meta);
+    pkt_data->rf_chain = LGW_META_RF_CHAIN(meta);
+    pkt_data->modulation = meta->modulation;
+    pkt_data->bandwidth = meta->bandwidth;
+    if (meta->modulation == MOD_FSK) {
+        pkt_data->datarate = fsk_rx_dr; /* not packet specific, get the parameter from the config variable */
+    } else {
+        pkt_data->datarate = meta->datarate;
+    }
+    pkt_data->coderate = meta->coderate;
+    pkt_data->rssi = (float)meta->rssi_x16 / 16;
+    if (meta->snr_x4 == LGW_SNR_UNDEFINED) {
+        pkt_data->snr = -128.0;
+        pkt_data->snr_min = -128.0;
+        pkt_data->snr_max = -128.0;
+    } else {
+        pkt_data->snr = (float)meta->snr_x4 / 4;
+        pkt_data->snr_min = (float)meta->snr_min_x4 / 4;
+        pkt_data->snr_max = (float)meta->snr_max_x4 / 4;
+    }
+    pkt_data->crc = meta->crc;
+    pkt_data->size = meta->size;
+    if (payload != NULL) {
+        memcpy((void *)pkt_data->payload, (void *)payload, meta->size);
     }
 
-    return nb_pkt_fetch;
+    return LGW_HAL_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -1586,6 +1776,9 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
         return LGW_HAL_ERROR;
     }
 
+    /* the TX sequence must not interleave with other accesses, nor wait behind background work */
+    lgw_bus_lock(LGW_BUS_PRIO_RX);
+
     /* Configure TX start delay based on TX notch filter */
     lgw_reg_w(LGW_TX_START_DELAY, tx_start_delay);
 
@@ -1603,6 +1796,7 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
     x = lbt_is_channel_free(&pkt_data, tx_start_delay, &tx_allowed);
     if (x != LGW_LBT_SUCCESS) {
         DEBUG_MSG("ERROR: Failed to check channel availability for TX\n");
+        lgw_bus_unlock();
         return LGW_HAL_ERROR;
     }
     if (tx_allowed == true) {
@@ -1621,13 +1815,16 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
 
             default:
                 DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\n", pkt_data.tx_mode);
+                lgw_bus_unlock();
                 return LGW_HAL_ERROR;
         }
     } else {
         DEBUG_MSG("ERROR: Cannot send packet, channel is busy (LBT)\n");
+        lgw_bus_unlock();
         return LGW_LBT_ISSUE;
     }
 
+    lgw_bus_unlock();
     return LGW_HAL_SUCCESS;
 }
 
@@ -1680,13 +1877,46 @@ int lgw_get_trigcnt(uint32_t* trig_cnt_us) {
     int i;
     int32_t val;
 
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
     i = lgw_reg_r(LGW_TIMESTAMP, &val);
     if (i == LGW_REG_SUCCESS) {
         *trig_cnt_us = (uint32_t)val;
-        return LGW_HAL_SUCCESS;
-    } else {
-        return LGW_HAL_ERROR;
     }
+    lgw_bus_unlock();
+
+    return (i == LGW_REG_SUCCESS) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_trigcnt64(uint64_t* trig_cnt_us64) {
+    int i;
+    int32_t val;
+
+    CHECK_NULL(trig_cnt_us64);
+
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
+    i = lgw_reg_r(LGW_TIMESTAMP, &val);
+    if (i == LGW_REG_SUCCESS) {
+        *trig_cnt_us64 = lgw_cnt_ext_at(&cnt_ext, (uint32_t)val); /* a latched value never moves the extension */
+    }
+    lgw_bus_unlock();
+
+    return (i == LGW_REG_SUCCESS) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_instcnt(uint32_t* inst_cnt_us) {
+    int i;
+
+    CHECK_NULL(inst_cnt_us);
+
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
+    i = instcnt_read(inst_cnt_us);
+    lgw_bus_unlock();
+
+    return i;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
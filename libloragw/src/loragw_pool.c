@@ -0,0 +1,129 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Preallocated pool of reference counted RX packet buffers.
+    Buffers are cache-line aligned and filled in place by lgw_receive_buf, they
+    can then be shared between several consumers without copying the payload.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+
+#include "loragw_pool.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_HAL == 1
+    #define DEBUG_MSG(str)                fprintf(stderr, str)
+    #define DEBUG_PRINTF(fmt, args...)    fprintf(stderr,"%s:%d: "fmt, __FUNCTION__, __LINE__, args)
+#else
+    #define DEBUG_MSG(str)
+    #define DEBUG_PRINTF(fmt, args...)
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+/*
+Reference counts are updated with atomic builtins so that buffers can be taken
+by the thread fetching packets and released by any other thread. A buffer is
+free when its count is zero; taking one is a compare-and-swap 0 -> 1, there is
+no free list to protect.
+*/
+
+static struct lgw_pkt_buf_s pool[LGW_POOL_SIZE];
+static unsigned pool_next = 0; /* where to start looking for a free buffer */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+struct lgw_pkt_buf_s *lgw_pool_get(void) {
+    unsigned start;
+    unsigned i;
+    int expected;
+    struct lgw_pkt_buf_s *b;
+
+    start = __atomic_load_n(&pool_next, __ATOMIC_RELAXED);
+    for (i = 0; i < LGW_POOL_SIZE; ++i) {
+        b = &pool[(start + i) % LGW_POOL_SIZE];
+        expected = 0;
+        if (__atomic_compare_exchange_n(&b->refcnt, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            b->meta.slot = (uint16_t)(b - pool);
+            __atomic_store_n(&pool_next, (start + i + 1) % LGW_POOL_SIZE, __ATOMIC_RELAXED);
+            return b;
+        }
+    }
+
+    DEBUG_MSG("WARNING: RX PACKET POOL EXHAUSTED\n");
+    return NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_pool_hold(struct lgw_pkt_buf_s *buf) {
+    if (buf != NULL) {
+        __atomic_add_fetch(&buf->refcnt, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_pool_release(struct lgw_pkt_buf_s *buf) {
+    int cnt;
+
+    if ((buf < &pool[0]) || (buf > &pool[LGW_POOL_SIZE - 1])) {
+        DEBUG_MSG("ERROR: BUFFER DOES NOT BELONG TO THE RX PACKET POOL\n");
+        return LGW_POOL_ERROR;
+    }
+
+    /* release ordering: writes done by that holder are visible to the next user */
+    cnt = __atomic_sub_fetch(&buf->refcnt, 1, __ATOMIC_RELEASE);
+    if (cnt < 0) {
+        DEBUG_PRINTF("ERROR: BUFFER %d RELEASED MORE TIMES THAN HELD\n", (int)(buf - pool));
+        __atomic_store_n(&buf->refcnt, 0, __ATOMIC_RELAXED);
+        return LGW_POOL_ERROR;
+    }
+
+    return LGW_POOL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+struct lgw_pkt_buf_s *lgw_pool_slot(uint16_t slot) {
+    if (slot >= LGW_POOL_SIZE) {
+        return NULL;
+    }
+    return &pool[slot];
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_pool_available(void) {
+    int i;
+    int nb = 0;
+
+    for (i = 0; i < LGW_POOL_SIZE; ++i) {
+        if (__atomic_load_n(&pool[i].refcnt, __ATOMIC_RELAXED) == 0) {
+            ++nb;
+        }
+    }
+
+    return nb;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -150,12 +150,14 @@ void sx125x_write(uint8_t channel, uint8_t addr, uint8_t data) {
             return;
     }
 
-    /* SPI master data write procedure */
+    /* SPI master data write procedure, in one bus access */
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
     lgw_reg_w(reg_cs, 0);
     lgw_reg_w(reg_add, 0x80 | addr); /* MSB at 1 for write operation */
     lgw_reg_w(reg_dat, data);
     lgw_reg_w(reg_cs, 1);
     lgw_reg_w(reg_cs, 0);
+    lgw_bus_unlock();
 
     return;
 }
@@ -197,13 +199,15 @@ uint8_t sx125x_read(uint8_t channel, uint8_t addr) {
             return 0;
     }
 
-    /* SPI master data read procedure */
+    /* SPI master data read procedure, in one bus access */
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
     lgw_reg_w(reg_cs, 0);
     lgw_reg_w(reg_add, addr); /* MSB at 0 for read operation */
     lgw_reg_w(reg_dat, 0);
     lgw_reg_w(reg_cs, 1);
     lgw_reg_w(reg_cs, 0);
     lgw_reg_r(reg_rb, &read_value);
+    lgw_bus_unlock();
 
     return (uint8_t)read_value;
 }
@@ -479,13 +483,23 @@ int lgw_setup_sx125x(uint8_t rf_chain, uint8_t rf_clkout, bool rf_enable, uint8_
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int lgw_sx127x_reg_w(uint8_t address, uint8_t reg_value) {
-    return lgw_spi_w(lgw_spi_target, LGW_SPI_MUX_MODE1, LGW_SPI_MUX_TARGET_SX127X, address, reg_value);
+    int x;
+
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
+    x = lgw_spi_w(lgw_spi_target, LGW_SPI_MUX_MODE1, LGW_SPI_MUX_TARGET_SX127X, address, reg_value);
+    lgw_bus_unlock();
+    return x;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int lgw_sx127x_reg_r(uint8_t address, uint8_t *reg_value) {
-    return lgw_spi_r(lgw_spi_target, LGW_SPI_MUX_MODE1, LGW_SPI_MUX_TARGET_SX127X, address, reg_value);
+    int x;
+
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
+    x = lgw_spi_r(lgw_spi_target, LGW_SPI_MUX_MODE1, LGW_SPI_MUX_TARGET_SX127X, address, reg_value);
+    lgw_bus_unlock();
+    return x;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -20,9 +20,17 @@ Maintainer: Sylvain Miermont
 /* -------------------------------------------------------------------------- */
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
 #include <stdint.h>     /* C99 types */
 #include <stdbool.h>    /* bool type */
 #include <stdio.h>      /* printf fprintf */
+#include <pthread.h>    /* pthread_mutex_lock pthread_cond_wait pthread_once */
 
 #include "loragw_spi.h"
 #include "loragw_reg.h"
@@ -390,6 +398,16 @@ const struct lgw_reg_s loregs[LGW_TOTALREGS] = {
 
 static int lgw_regpage = -1; /*! keep the value of the register page selected */
 
+/* SPI bus arbiter: the owner holds bus_own, a recursive priority inheritance mutex, so that a
+   real-time thread waiting for the bus lends its priority to a normal thread holding it */
+static pthread_once_t bus_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t bus_own;
+static pthread_mutex_t bus_mx; /* protects bus_users, priority inheritance too */
+static pthread_cond_t bus_cond = PTHREAD_COND_INITIALIZER;
+static int bus_users = 0; /* threads owning or waiting for bus_own, background requests wait for 0 */
+static int bus_rx_waiting = 0; /* RX requests waiting for bus_own */
+static __thread int bus_depth = 0; /* nesting depth of the calling thread, 0 if it does not own the bus */
+
 /* -------------------------------------------------------------------------- */
 /* --- INTERNAL SHARED VARIABLES -------------------------------------------- */
 
@@ -497,6 +515,20 @@ int reg_r_align32(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target
     return spi_stat;
 }
 
+/* owner mutex recursive, both mutexes with priority inheritance (plain ones if not supported) */
+static void bus_init(void) {
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    if (pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT) != 0) {
+        DEBUG_MSG("WARNING: NO PRIORITY INHERITANCE FOR THE SPI BUS\n");
+    }
+    pthread_mutex_init(&bus_mx, &attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&bus_own, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -575,8 +607,10 @@ int lgw_connect(bool spi_only, uint32_t tx_notch_freq) {
 /* Concentrator disconnect */
 int lgw_disconnect(void) {
     if (lgw_spi_target != NULL) {
+        lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
         lgw_spi_close(lgw_spi_target);
         lgw_spi_target = NULL;
+        lgw_bus_unlock();
         DEBUG_MSG("Note: success disconnecting the concentrator\n");
         return LGW_REG_SUCCESS;
     } else {
@@ -594,8 +628,10 @@ int lgw_soft_reset(void) {
         DEBUG_MSG("ERROR: CONCENTRATOR UNCONNECTED\n");
         return LGW_REG_ERROR;
     }
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
     lgw_spi_w(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, 0, 0x80); /* 1 -> SOFT_RESET bit */
     lgw_regpage = 0; /* reset the paging static variable */
+    lgw_bus_unlock();
     return LGW_REG_SUCCESS;
 }
 
@@ -653,7 +689,9 @@ int lgw_reg_w(uint16_t register_id, int32_t reg_value) {
 
     /* intercept direct access to PAGE_REG & SOFT_RESET */
     if (register_id == LGW_PAGE_REG) {
+        lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
         page_switch(reg_value);
+        lgw_bus_unlock();
         return LGW_REG_SUCCESS;
     } else if (register_id == LGW_SOFT_RESET) {
         /* only reset if lsb is 1 */
@@ -671,12 +709,14 @@ int lgw_reg_w(uint16_t register_id, int32_t reg_value) {
         return LGW_REG_ERROR;
     }
 
-    /* select proper register page if needed */
+    /* select proper register page if needed, in the same bus access */
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
     if ((r.page != -1) && (r.page != lgw_regpage)) {
         spi_stat += page_switch(r.page);
     }
 
     spi_stat += reg_w_align32(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, r, reg_value);
+    lgw_bus_unlock();
 
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER WRITE\n");
@@ -709,12 +749,14 @@ int lgw_reg_r(uint16_t register_id, int32_t *reg_value) {
     /* get register struct from the struct array */
     r = loregs[register_id];
 
-    /* select proper register page if needed */
+    /* select proper register page if needed, in the same bus access */
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
     if ((r.page != -1) && (r.page != lgw_regpage)) {
         spi_stat += page_switch(r.page);
     }
 
     spi_stat += reg_r_align32(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, r, reg_value);
+    lgw_bus_unlock();
 
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER WRITE\n");
@@ -757,13 +799,15 @@ int lgw_reg_wb(uint16_t register_id, uint8_t *data, uint16_t size) {
         return LGW_REG_ERROR;
     }
 
-    /* select proper register page if needed */
+    /* select proper register page if needed, in the same bus access */
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
     if ((r.page != -1) && (r.page != lgw_regpage)) {
         spi_stat += page_switch(r.page);
     }
 
     /* do the burst write */
     spi_stat += lgw_spi_wb(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, r.addr, data, size);
+    lgw_bus_unlock();
 
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER BURST WRITE\n");
@@ -800,13 +844,15 @@ int lgw_reg_rb(uint16_t register_id, uint8_t *data, uint16_t size) {
     /* get register struct from the struct array */
     r = loregs[register_id];
 
-    /* select proper register page if needed */
+    /* select proper register page if needed, in the same bus access */
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
     if ((r.page != -1) && (r.page != lgw_regpage)) {
         spi_stat += page_switch(r.page);
     }
 
     /* do the burst read */
     spi_stat += lgw_spi_rb(lgw_spi_target, lgw_spi_mux_mode, LGW_SPI_MUX_TARGET_SX1301, r.addr, data, size);
+    lgw_bus_unlock();
 
     if (spi_stat != LGW_SPI_SUCCESS) {
         DEBUG_MSG("ERROR: SPI ERROR DURING REGISTER BURST READ\n");
@@ -816,4 +862,61 @@ int lgw_reg_rb(uint16_t register_id, uint8_t *data, uint16_t size) {
     }
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_bus_lock(enum lgw_bus_prio_e prio) {
+    if (pthread_once(&bus_once, bus_init) != 0) {
+        DEBUG_MSG("ERROR: FAILED TO INITIALIZE SPI BUS ARBITER\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* nested lock by the owner */
+    if (bus_depth > 0) {
+        pthread_mutex_lock(&bus_own);
+        bus_depth++;
+        return LGW_REG_SUCCESS;
+    }
+
+    /* RX requests queue on the owner mutex at once, background ones let the pending RX requests go first */
+    pthread_mutex_lock(&bus_mx);
+    if (prio == LGW_BUS_PRIO_RX) {
+        __atomic_add_fetch(&bus_rx_waiting, 1, __ATOMIC_RELAXED);
+    } else {
+        while (bus_users > 0) {
+            pthread_cond_wait(&bus_cond, &bus_mx);
+        }
+    }
+    bus_users++;
+    pthread_mutex_unlock(&bus_mx);
+    pthread_mutex_lock(&bus_own);
+    if (prio == LGW_BUS_PRIO_RX) {
+        __atomic_sub_fetch(&bus_rx_waiting, 1, __ATOMIC_RELAXED);
+    }
+    bus_depth = 1;
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_bus_unlock(void) {
+    if (bus_depth == 0) {
+        return; /* not the owner */
+    }
+    pthread_mutex_unlock(&bus_own);
+    if (--bus_depth > 0) {
+        return;
+    }
+    pthread_mutex_lock(&bus_mx);
+    if (--bus_users == 0) {
+        pthread_cond_broadcast(&bus_cond);
+    }
+    pthread_mutex_unlock(&bus_mx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool lgw_bus_contended(void) {
+    return __atomic_load_n(&bus_rx_waiting, __ATOMIC_RELAXED) > 0;
+}
+
 /* --- EOF ------------------------------------------------------------------ */
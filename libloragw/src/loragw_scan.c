@@ -0,0 +1,338 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Background spectral scan, driven step by step within a time budget.
+    Each state of the scan does one short SPI transaction, holding the bus
+    at background priority; the histogram readout is split in bursts that
+    continue where the previous one stopped, the FPGA histogram RAM address
+    being only reset when the RAM is opened.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf */
+#include <string.h>     /* memset memcpy */
+#include <time.h>       /* clock_gettime */
+
+#include "loragw_scan.h"
+#include "loragw_hal.h"
+#include "loragw_reg.h"
+#include "loragw_aux.h"
+#include "loragw_fpga.h"
+#include "loragw_radio.h"
+#include "loragw_lbt.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_SCAN == 1
+    #define DEBUG_MSG(str)                fprintf(stderr, str)
+    #define DEBUG_PRINTF(fmt, args...)    fprintf(stderr,"%s:%d: "fmt, __FUNCTION__, __LINE__, args)
+    #define CHECK_NULL(a)                 if(a==NULL){fprintf(stderr,"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);return LGW_SCAN_ERROR;}
+#else
+    #define DEBUG_MSG(str)
+    #define DEBUG_PRINTF(fmt, args...)
+    #define CHECK_NULL(a)                 if(a==NULL){return LGW_SCAN_ERROR;}
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SCAN_HISTO_BYTES        (2 * LGW_SCAN_RSSI_BINS) /* 12-bit count per bin, LSB first */
+#define SCAN_DEFAULT_CHUNK      64      /* histogram bytes per burst, ~70 us at 8 MHz SPI */
+#define SCAN_POLL_US            1000    /* minimum interval between two FPGA status reads */
+#define SCAN_FEATURE_BIT        1       /* LGW_FPGA_FEATURE bit telling spectral scan is supported */
+#define SCAN_STATUS_DONE_BIT    5       /* LGW_FPGA_STATUS bit set when the histogram is complete */
+#define SCAN_XTAL_FREQ          32000000 /* SX127x reference, for the frequency register */
+
+enum scan_state_e {
+    SCAN_OFF,       /* not started */
+    SCAN_IDLE,      /* waiting for the next sweep */
+    SCAN_TUNE,      /* set the frequency of the channel */
+    SCAN_CLEAR,     /* clear the histogram RAM */
+    SCAN_RUN,       /* start the histogram */
+    SCAN_WAIT,      /* poll for the end of the histogram */
+    SCAN_HALT,      /* stop the histogram */
+    SCAN_OPEN,      /* give the host access to the histogram RAM */
+    SCAN_READ,      /* read the histogram RAM, one burst per transaction */
+    SCAN_CLOSE,     /* give the histogram RAM back to the FPGA */
+    SCAN_STATE_NB
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct lgw_conf_scan_s scan_conf;
+static enum scan_state_e scan_state = SCAN_OFF;
+static uint8_t scan_chan; /* channel being scanned */
+static uint64_t scan_next_us; /* earliest time of the next action in the idle and wait states */
+static uint16_t scan_pos; /* histogram bytes already read */
+static uint8_t scan_buf[SCAN_HISTO_BYTES];
+static uint32_t scan_cost_us[SCAN_STATE_NB]; /* last measured duration of the transaction of each state */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static uint64_t scan_now_us(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + (uint64_t)(t.tv_nsec / 1000);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* one SPI transaction of the current state, then move to the next state */
+static int scan_transaction(uint64_t now) {
+    int x = LGW_REG_SUCCESS;
+    int32_t val;
+    uint16_t n;
+
+    switch (scan_state) {
+        case SCAN_TUNE:
+            val = (int32_t)(((uint64_t)scan_conf.freq_hz[scan_chan] << 19) / SCAN_XTAL_FREQ);
+            x = lgw_fpga_reg_w(LGW_FPGA_HISTO_SCAN_FREQ, val);
+            scan_state = SCAN_CLEAR;
+            break;
+        case SCAN_CLEAR:
+            x  = lgw_fpga_reg_w(LGW_FPGA_CTRL_CLEAR_HISTO_MEM, 1);
+            x |= lgw_fpga_reg_w(LGW_FPGA_CTRL_CLEAR_HISTO_MEM, 0);
+            scan_state = SCAN_RUN;
+            break;
+        case SCAN_RUN:
+            x = lgw_fpga_reg_w(LGW_FPGA_CTRL_FEATURE_START, 1);
+            scan_next_us = now + SCAN_POLL_US;
+            scan_state = SCAN_WAIT;
+            break;
+        case SCAN_WAIT:
+            x = lgw_fpga_reg_r(LGW_FPGA_STATUS, &val);
+            if ((x == LGW_REG_SUCCESS) && (TAKE_N_BITS_FROM((uint8_t)val, SCAN_STATUS_DONE_BIT, 1) == 1)) {
+                scan_state = SCAN_HALT;
+            } else {
+                scan_next_us = now + SCAN_POLL_US;
+            }
+            break;
+        case SCAN_HALT:
+            x = lgw_fpga_reg_w(LGW_FPGA_CTRL_FEATURE_START, 0);
+            scan_state = SCAN_OPEN;
+            break;
+        case SCAN_OPEN:
+            x  = lgw_fpga_reg_w(LGW_FPGA_CTRL_ACCESS_HISTO_MEM, 1);
+            x |= lgw_fpga_reg_w(LGW_FPGA_HISTO_RAM_ADDR, 0);
+            x |= lgw_fpga_reg_r(LGW_FPGA_HISTO_RAM_DATA, &val); /* dummy read, primes the RAM output */
+            scan_pos = 0;
+            scan_state = SCAN_READ;
+            break;
+        case SCAN_READ:
+            n = SCAN_HISTO_BYTES - scan_pos;
+            if (n > scan_conf.chunk_size) {
+                n = scan_conf.chunk_size;
+            }
+            x = lgw_fpga_reg_rb(LGW_FPGA_HISTO_RAM_DATA, &scan_buf[scan_pos], n);
+            scan_pos += n;
+            if (scan_pos >= SCAN_HISTO_BYTES) {
+                scan_state = SCAN_CLOSE;
+            }
+            break;
+        case SCAN_CLOSE:
+            x = lgw_fpga_reg_w(LGW_FPGA_CTRL_ACCESS_HISTO_MEM, 0);
+            if (scan_chan + 1 < scan_conf.nb_channel) {
+                scan_state = SCAN_TUNE;
+            } else {
+                scan_next_us = now + (uint64_t)scan_conf.interval_ms * 1000;
+                scan_state = SCAN_IDLE;
+            }
+            break;
+        default:
+            break;
+    }
+
+    return (x == LGW_REG_SUCCESS) ? LGW_SCAN_SUCCESS : LGW_SCAN_ERROR;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lgw_scan_setconf(const struct lgw_conf_scan_s *conf) {
+    CHECK_NULL(conf);
+    if ((conf->nb_channel < 1) || (conf->nb_channel > LGW_SCAN_CHAN_MAX)) {
+        DEBUG_PRINTF("ERROR: number of scan channels is out of range (%u)\n", conf->nb_channel);
+        return LGW_SCAN_ERROR;
+    }
+    if (conf->nb_read == 0) {
+        DEBUG_MSG("ERROR: no RSSI read per histogram\n");
+        return LGW_SCAN_ERROR;
+    }
+
+    scan_conf = *conf;
+    if ((scan_conf.chunk_size == 0) || (scan_conf.chunk_size > SCAN_HISTO_BYTES)) {
+        scan_conf.chunk_size = SCAN_DEFAULT_CHUNK;
+    }
+    scan_state = SCAN_OFF;
+    return LGW_SCAN_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_scan_start(void) {
+    int x;
+    int32_t val;
+
+    if (scan_conf.nb_channel == 0) {
+        DEBUG_MSG("ERROR: spectral scan not configured\n");
+        return LGW_SCAN_ERROR;
+    }
+    if (lbt_is_enabled() == true) {
+        DEBUG_MSG("ERROR: spectral scan and LBT share the SX127x radio\n");
+        return LGW_SCAN_ERROR;
+    }
+
+    /* Check if spectral scan is supported by FPGA */
+    x = lgw_fpga_reg_r(LGW_FPGA_FEATURE, &val);
+    if ((x != LGW_REG_SUCCESS) || (TAKE_N_BITS_FROM((uint8_t)val, SCAN_FEATURE_BIT, 1) != 1)) {
+        DEBUG_MSG("ERROR: No support for spectral scan in FPGA\n");
+        return LGW_SCAN_ERROR;
+    }
+
+    /* Configure SX127x for FSK, the bandwidth of a LoRa 125 kHz channel */
+    x = lgw_setup_sx127x(scan_conf.freq_hz[0], MOD_FSK, LGW_SX127X_RXBW_125K_HZ, scan_conf.rssi_offset);
+    if (x != LGW_REG_SUCCESS) {
+        DEBUG_MSG("ERROR: Failed to configure SX127x for spectral scan\n");
+        return LGW_SCAN_ERROR;
+    }
+
+    /* Configure FPGA histogram engine */
+    x  = lgw_fpga_reg_w(LGW_FPGA_CTRL_FEATURE_START, 0);
+    x |= lgw_fpga_reg_w(LGW_FPGA_HISTO_NB_READ, scan_conf.nb_read);
+    if (x != LGW_REG_SUCCESS) {
+        DEBUG_MSG("ERROR: Failed to configure FPGA for spectral scan\n");
+        return LGW_SCAN_ERROR;
+    }
+
+    memset(scan_cost_us, 0, sizeof scan_cost_us);
+    scan_chan = 0;
+    scan_state = SCAN_TUNE;
+    return LGW_SCAN_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_scan_step(uint32_t budget_us, struct lgw_scan_result_s *result) {
+    uint64_t start, t0, t1;
+    enum scan_state_e s;
+    int nb_trans = 0;
+    int i, x;
+
+    CHECK_NULL(result);
+    if (scan_state == SCAN_OFF) {
+        return 0;
+    }
+
+    start = scan_now_us();
+    t1 = start;
+    while (true) {
+        t0 = t1;
+        s = scan_state;
+        if (((s == SCAN_IDLE) || (s == SCAN_WAIT)) && (t0 < scan_next_us)) {
+            return 0; /* nothing to do yet */
+        }
+        if (s == SCAN_IDLE) {
+            scan_chan = 0;
+            scan_state = SCAN_TUNE;
+            continue;
+        }
+        /* stop before the transaction that would exceed the budget, or delay an RX request, but always make progress */
+        if ((nb_trans > 0) && (((t0 - start) + scan_cost_us[s] > budget_us) || (lgw_bus_contended() == true))) {
+            return 0;
+        }
+
+        lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
+        x = scan_transaction(t0);
+        lgw_bus_unlock();
+        if (x != LGW_SCAN_SUCCESS) {
+            DEBUG_PRINTF("ERROR: spectral scan transaction failed in state %d\n", s);
+            lgw_scan_stop();
+            return LGW_SCAN_ERROR;
+        }
+        nb_trans++;
+        t1 = scan_now_us();
+        scan_cost_us[s] = (uint32_t)(t1 - t0);
+
+        if (s == SCAN_CLOSE) {
+            result->chan = scan_chan;
+            result->freq_hz = scan_conf.freq_hz[scan_chan];
+            result->nb_read = 0;
+            for (i = 0; i < LGW_SCAN_RSSI_BINS; ++i) {
+                result->histo[i] = (uint16_t)scan_buf[2*i] | ((uint16_t)(scan_buf[2*i+1] & 0x0F) << 8);
+                result->nb_read += result->histo[i];
+            }
+            scan_chan++;
+            return 1;
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void lgw_scan_stop(void) {
+    if (scan_state == SCAN_OFF) {
+        return;
+    }
+    lgw_fpga_reg_w(LGW_FPGA_CTRL_FEATURE_START, 0);
+    lgw_fpga_reg_w(LGW_FPGA_CTRL_ACCESS_HISTO_MEM, 0);
+    scan_state = SCAN_OFF;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_scan_analyze(const struct lgw_scan_result_s *result, float margin_db, float *floor_dbm, float *occupancy) {
+    uint32_t cum = 0, busy = 0;
+    float level;
+    int i;
+
+    CHECK_NULL(result);
+    CHECK_NULL(floor_dbm);
+    CHECK_NULL(occupancy);
+    if (result->nb_read == 0) {
+        return LGW_SCAN_ERROR;
+    }
+
+    /* median, from the weakest bin up */
+    for (i = LGW_SCAN_RSSI_BINS - 1; i >= 0; --i) {
+        cum += result->histo[i];
+        if (2 * cum >= result->nb_read) {
+            break;
+        }
+    }
+    *floor_dbm = -i / 2.0;
+
+    level = *floor_dbm + margin_db;
+    for (i = 0; (i < LGW_SCAN_RSSI_BINS) && (-i / 2.0 > level); ++i) {
+        busy += result->histo[i];
+    }
+    *occupancy = (float)busy / result->nb_read;
+
+    return LGW_SCAN_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,295 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check the SPI bus arbiter of loragw_reg: mutual exclusion, nested locks,
+    RX requests served before background ones, and RX wait time while
+    background threads hold the bus for short sequences. Then the wait of a
+    SCHED_FIFO RX thread while a normal priority thread, as the GPS one, holds
+    the bus on a CPU loaded by other normal threads, against a plain mutex
+    (run as root, skipped if SCHED_FIFO is not allowed).
+    No concentrator is needed, the bus is only locked, never accessed.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#define _GNU_SOURCE     /* needed for cpu_set_t and pthread_setaffinity_np to be defined */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* EXIT_SUCCESS */
+#include <time.h>       /* clock_gettime nanosleep */
+#include <sched.h>      /* sched_yield CPU_SET */
+#include <pthread.h>
+
+#include "loragw_reg.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_THREADS      4
+#define NB_LOCKS        20000       /* per thread, mutual exclusion check */
+#define NB_RX_REQ       500         /* RX requests during the wait time check */
+#define BG_HOLD_US      200         /* background sequence length */
+#define RX_PERIOD_US    1000
+#define NB_HOGS         3           /* normal threads loading the CPU of the RX thread */
+#define GPS_HOLD_US     300         /* bus held by the normal priority thread, computing */
+#define STRESS_REQ      1000        /* RX requests during the stress check */
+#define STRESS_MAX_US   1500        /* most RX wait allowed with priority inheritance */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static volatile uint32_t counter = 0; /* only incremented while holding the bus */
+static volatile int order[2];
+static volatile int nb_order = 0;
+static volatile bool stop = false;
+static volatile bool stress_stop = false;
+static pthread_mutex_t plain_mx = PTHREAD_MUTEX_INITIALIZER; /* what the bus lock was, no priority inheritance */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static uint64_t now_us(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + (uint64_t)(t.tv_nsec / 1000);
+}
+
+static void sleep_us(long us) {
+    struct timespec t = {us / 1000000, (us % 1000000) * 1000};
+
+    nanosleep(&t, NULL);
+}
+
+static void *thread_count(void *arg) {
+    enum lgw_bus_prio_e prio = (arg != NULL) ? LGW_BUS_PRIO_RX : LGW_BUS_PRIO_BACKGROUND;
+    uint32_t c;
+    int i;
+
+    for (i = 0; i < NB_LOCKS; ++i) {
+        lgw_bus_lock(prio);
+        lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND); /* nested, as register accesses within a sequence */
+        c = counter;
+        if ((i % 64) == 0) {
+            sched_yield();
+        }
+        counter = c + 1;
+        lgw_bus_unlock();
+        lgw_bus_unlock();
+    }
+    return NULL;
+}
+
+static void *thread_order(void *arg) {
+    int id = (int)(intptr_t)arg;
+
+    lgw_bus_lock((id == 1) ? LGW_BUS_PRIO_RX : LGW_BUS_PRIO_BACKGROUND);
+    order[nb_order++] = id;
+    lgw_bus_unlock();
+    return NULL;
+}
+
+static void *thread_background(void *arg) {
+    uint64_t *nb_seq = arg;
+
+    while (stop == false) {
+        lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
+        sleep_us(BG_HOLD_US);
+        lgw_bus_unlock();
+        (*nb_seq)++;
+    }
+    return NULL;
+}
+
+/* keep the calling thread on CPU 0, with the given policy */
+static int set_sched(int policy, int prio) {
+    struct sched_param param = { .sched_priority = prio };
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(0, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof set, &set) != 0) {
+        return -1;
+    }
+    return pthread_setschedparam(pthread_self(), policy, &param);
+}
+
+static void spin_us(uint64_t us) {
+    uint64_t end = now_us() + us;
+
+    while (now_us() < end);
+}
+
+static void *thread_hog(void *arg) {
+    (void)arg;
+    set_sched(SCHED_OTHER, 0);
+    while (stress_stop == false);
+    return NULL;
+}
+
+/* normal priority thread holding the bus while it computes, as the GPS thread reading the counter */
+static void *thread_gps(void *arg) {
+    bool plain = (arg != NULL);
+
+    set_sched(SCHED_OTHER, 0);
+    while (stress_stop == false) {
+        if (plain == true) {
+            pthread_mutex_lock(&plain_mx);
+        } else {
+            lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
+        }
+        spin_us(GPS_HOLD_US);
+        if (plain == true) {
+            pthread_mutex_unlock(&plain_mx);
+        } else {
+            lgw_bus_unlock();
+        }
+        sleep_us(GPS_HOLD_US);
+    }
+    return NULL;
+}
+
+/* SCHED_FIFO RX requests on the loaded CPU, the worst wait in us, 0 if SCHED_FIFO is not allowed */
+static void *thread_rx_stress(void *arg) {
+    bool plain = (arg != NULL);
+    uint64_t t0, w, w_max = 1;
+    int i;
+
+    if (set_sched(SCHED_FIFO, 50) != 0) {
+        return (void *)0;
+    }
+    for (i = 0; i < STRESS_REQ; ++i) {
+        sleep_us(RX_PERIOD_US);
+        t0 = now_us();
+        if (plain == true) {
+            pthread_mutex_lock(&plain_mx);
+            w = now_us() - t0;
+            pthread_mutex_unlock(&plain_mx);
+        } else {
+            lgw_bus_lock(LGW_BUS_PRIO_RX);
+            w = now_us() - t0;
+            lgw_bus_unlock();
+        }
+        w_max = (w > w_max) ? w : w_max;
+    }
+    return (void *)(uintptr_t)w_max;
+}
+
+/* worst RX wait under stress, with the bus lock or with a plain mutex */
+static uint64_t stress(bool plain) {
+    pthread_t hog[NB_HOGS], gps, rx;
+    void *ret;
+    int i;
+
+    stress_stop = false;
+    for (i = 0; i < NB_HOGS; ++i) {
+        pthread_create(&hog[i], NULL, thread_hog, NULL);
+    }
+    pthread_create(&gps, NULL, thread_gps, (plain == true) ? (void *)1 : NULL);
+    pthread_create(&rx, NULL, thread_rx_stress, (plain == true) ? (void *)1 : NULL);
+    pthread_join(rx, &ret);
+    stress_stop = true;
+    pthread_join(gps, NULL);
+    for (i = 0; i < NB_HOGS; ++i) {
+        pthread_join(hog[i], NULL);
+    }
+    return (uint64_t)(uintptr_t)ret;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    pthread_t thr[NB_THREADS];
+    uint64_t nb_seq[NB_THREADS] = {0};
+    uint64_t t0, w, w_max = 0, w_sum = 0;
+    int i;
+    int err = 0;
+
+    printf("Beginning of test for the loragw_reg.c SPI bus arbiter\n");
+
+    /* mutual exclusion, mixed priorities and nested locks */
+    for (i = 0; i < NB_THREADS; ++i) {
+        pthread_create(&thr[i], NULL, thread_count, (i == 0) ? (void *)1 : NULL);
+    }
+    for (i = 0; i < NB_THREADS; ++i) {
+        pthread_join(thr[i], NULL);
+    }
+    printf("mutual exclusion: %u increments, %u expected\n", counter, NB_THREADS * NB_LOCKS);
+    if (counter != NB_THREADS * NB_LOCKS) {
+        printf("ERROR: concurrent accesses to the bus\n");
+        err++;
+    }
+
+    /* a background request waiting first is served after an RX request waiting later */
+    lgw_bus_lock(LGW_BUS_PRIO_BACKGROUND);
+    pthread_create(&thr[0], NULL, thread_order, (void *)0);
+    sleep_us(20000);
+    pthread_create(&thr[1], NULL, thread_order, (void *)1);
+    for (i = 0; (i < 1000) && (lgw_bus_contended() == false); ++i) {
+        sleep_us(1000);
+    }
+    sleep_us(20000);
+    lgw_bus_unlock();
+    pthread_join(thr[0], NULL);
+    pthread_join(thr[1], NULL);
+    printf("priority: served %s then %s\n", (order[0] == 1) ? "RX" : "background", (order[1] == 1) ? "RX" : "background");
+    if ((nb_order != 2) || (order[0] != 1)) {
+        printf("ERROR: RX request not served first\n");
+        err++;
+    }
+
+    /* RX wait time while background threads keep the bus busy */
+    for (i = 0; i < NB_THREADS - 1; ++i) {
+        pthread_create(&thr[i], NULL, thread_background, &nb_seq[i]);
+    }
+    for (i = 0; i < NB_RX_REQ; ++i) {
+        sleep_us(RX_PERIOD_US);
+        t0 = now_us();
+        lgw_bus_lock(LGW_BUS_PRIO_RX);
+        w = now_us() - t0;
+        lgw_bus_unlock();
+        w_sum += w;
+        w_max = (w > w_max) ? w : w_max;
+    }
+    stop = true;
+    for (i = 0; i < NB_THREADS - 1; ++i) {
+        pthread_join(thr[i], NULL);
+    }
+    printf("RX wait with %d background threads holding the bus %d us at a time: mean %.0f us, max %llu us, %llu background sequences\n",
+           NB_THREADS - 1, BG_HOLD_US, (double)w_sum / NB_RX_REQ, (unsigned long long)w_max,
+           (unsigned long long)(nb_seq[0] + nb_seq[1] + nb_seq[2]));
+
+    /* SCHED_FIFO RX thread, normal thread holding the bus and normal threads loading the same CPU */
+    w = stress(true);
+    if (w == 0) {
+        printf("RX wait under stress skipped, SCHED_FIFO not allowed\n");
+    } else {
+        w_max = stress(false);
+        printf("RX wait under stress, %d normal threads and the bus held %d us by a normal thread on the same CPU: max %llu us, %llu us with a plain mutex\n",
+               NB_HOGS, GPS_HOLD_US, (unsigned long long)w_max, (unsigned long long)w);
+        if (w_max > STRESS_MAX_US) {
+            printf("ERROR: RX request waited for a preempted normal thread\n");
+            err++;
+        }
+    }
+
+    printf("End of test for the loragw_reg.c SPI bus arbiter\n");
+    return (err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,180 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check the clock model of loragw_gps against lgw_gps_sync on simulated PPS
+    captures: drifting crystal, capture jitter, aberrant captures, counter
+    wrap, counter reset and GPS loss (holdover).
+    No GPS nor concentrator is needed.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Michael Coracin
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* rand */
+#include <string.h>     /* memset */
+#include <math.h>       /* sin fabs */
+
+#include "loragw_gps.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_SEC          3600        /* captures, one per second */
+#define STEP_SEC        2400        /* concentrator restart: counter jumps */
+#define XTAL_ERR        3.7E-6      /* mean crystal error */
+#define XTAL_WANDER     0.2E-6      /* slow variation of the crystal error */
+#define WANDER_PERIOD   1800.0
+#define JITTER_US       1.0         /* capture jitter, uniform +/- */
+#define PI              3.14159265358979323846
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static const struct timespec utc0 = {1500000000, 0};
+static const double cnt0 = 4293918720.0; /* wraps 1 s after the start */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* counter value at t seconds after the start, without jitter */
+static uint32_t counter(double t) {
+    double c = cnt0 + 1E6 * (t + XTAL_ERR * t - XTAL_WANDER * WANDER_PERIOD / (2 * PI) * cos(2 * PI * t / WANDER_PERIOD));
+
+    if (t >= STEP_SEC) {
+        c -= 123456789.0;
+    }
+    return (uint32_t)(uint64_t)llround(c);
+}
+
+static struct timespec utc_at(double t) {
+    struct timespec x = utc0;
+    double s = floor(t);
+
+    x.tv_sec += (time_t)s;
+    x.tv_nsec = (long)llround((t - s) * 1E9);
+    return x;
+}
+
+static double err_us(struct timespec a, struct timespec b) {
+    return (double)(a.tv_sec - b.tv_sec) * 1E6 + (double)(a.tv_nsec - b.tv_nsec) / 1E3;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    struct lgw_clk_model_s clk;
+    struct tref ref;
+    struct timespec utc, gps, conv;
+    double e, max_legacy = 0, max_model = 0, sq_legacy = 0, sq_model = 0;
+    double hold[3] = {60, 300, 590};
+    uint32_t cnt;
+    int nb_legacy = 0, nb_model = 0, fail_legacy = 0, fail_model = 0;
+    int t, i;
+    int err = 0;
+
+    printf("Beginning of test for the loragw_gps.c clock model\n");
+
+    srand(1);
+    lgw_clk_init(&clk);
+    memset(&ref, 0, sizeof ref);
+
+    for (t = 0; t < NB_SEC; ++t) {
+        /* PPS capture, with jitter and some aberrant values */
+        cnt = counter(t) + (int32_t)lround(JITTER_US * (2.0 * rand() / RAND_MAX - 1.0));
+        utc = utc_at(t);
+        if ((t % 97) == 50) {
+            utc.tv_sec += 1; /* NMEA and PPS mismatch */
+        }
+        if ((t % 151) == 75) {
+            cnt += 500; /* glitch on the capture */
+        }
+        gps = utc;
+        gps.tv_sec -= 315964800 - 18; /* whatever, only carried along */
+        lgw_gps_sync(&ref, cnt, utc, gps);
+        lgw_clk_update(&clk, cnt, utc, gps);
+
+        /* conversion of a packet received half-way to the next PPS */
+        if (lgw_cnt2utc(ref, counter(t + 0.5), &conv) == LGW_GPS_SUCCESS) {
+            e = fabs(err_us(conv, utc_at(t + 0.5)));
+            if ((t < STEP_SEC) || (t > STEP_SEC + 5)) {
+                max_legacy = (e > max_legacy) ? e : max_legacy;
+                sq_legacy += e * e;
+                nb_legacy++;
+            }
+        } else {
+            fail_legacy++;
+        }
+        if (lgw_clk_cnt2utc(&clk, counter(t + 0.5), &conv) == LGW_GPS_SUCCESS) {
+            e = fabs(err_us(conv, utc_at(t + 0.5)));
+            if ((t < STEP_SEC) || (t > STEP_SEC + 5)) {
+                max_model = (e > max_model) ? e : max_model;
+                sq_model += e * e;
+                nb_model++;
+            }
+        } else {
+            fail_model++;
+        }
+    }
+
+    printf("lgw_gps_sync    : max error %10.2f us, rms %8.2f us, %d conversions refused\n", max_legacy, sqrt(sq_legacy / nb_legacy), fail_legacy);
+    printf("lgw_clk_update  : max error %10.2f us, rms %8.2f us, %d conversions refused, %u captures rejected, drift %.3f ppm\n",
+           max_model, sqrt(sq_model / nb_model), fail_model, clk.nb_rejected, clk.drift * 1E6);
+    if ((max_model > 5.0) || (fail_model > 10)) {
+        printf("ERROR: clock model error too large\n");
+        err++;
+    }
+
+    /* holdover: no capture any more */
+    for (i = 0; i < 3; ++i) {
+        double th = NB_SEC - 1 + hold[i];
+        if (lgw_clk_cnt2utc(&clk, counter(th), &conv) != LGW_GPS_SUCCESS) {
+            printf("ERROR: no conversion after %.0f s of holdover\n", hold[i]);
+            err++;
+            continue;
+        }
+        e = err_us(conv, utc_at(th));
+        printf("holdover %4.0f s : error %8.2f us\n", hold[i], e);
+        if (fabs(e) > 1E-6 * 1E6 * hold[i]) { /* 1 ppm of the holdover time */
+            printf("ERROR: holdover error too large\n");
+            err++;
+        }
+    }
+    if (lgw_clk_cnt2utc(&clk, counter(NB_SEC + LGW_CLK_HOLDOVER_S + 10), &conv) == LGW_GPS_SUCCESS) {
+        printf("ERROR: conversion accepted beyond holdover\n");
+        err++;
+    }
+
+    /* the model as a classic time reference */
+    if ((lgw_clk_get_tref(&clk, &ref) != LGW_GPS_SUCCESS) || (lgw_cnt2utc(ref, counter(NB_SEC - 1.5), &conv) != LGW_GPS_SUCCESS) ||
+        (fabs(err_us(conv, utc_at(NB_SEC - 1.5))) > 5.0)) {
+        printf("ERROR: time reference exported by the clock model is wrong\n");
+        err++;
+    }
+
+    printf("End of test for the loragw_gps.c clock model\n");
+    return (err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
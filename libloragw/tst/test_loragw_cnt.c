@@ -0,0 +1,115 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check the 64-bit extension of the concentrator counter over several wraps:
+    packets read along with a trigger counter frozen by the lack of GPS pulse,
+    a packet older than the latest read, then a 40 minutes quiet gap, with the
+    RX loop sampling the counter and with the loop stalled.
+    No concentrator is needed.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf */
+#include <stdlib.h>     /* rand */
+#include <inttypes.h>   /* PRIu64 */
+
+#include "loragw_aux.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define CNT0            4000000000ULL   /* counter at the start, wraps after ~5 min */
+#define RUN_MS          (4 * 3600 * 1000ULL)
+#define QUIET_MS        (40 * 60 * 1000ULL)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct lgw_cnt_ext_s ext;
+static int nb_err = 0;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* a sample of the counter at ms since the start, expected to extend to the exact value */
+static void check_sample(const char *what, uint64_t ms, uint32_t late_us) {
+    uint64_t truth = CNT0 + ms * 1000 - late_us;
+    uint64_t x = lgw_cnt_ext_sample(&ext, (uint32_t)truth, ms);
+
+    if (x != truth) {
+        if (nb_err++ < 5) {
+            printf("ERROR: %s at %" PRIu64 " ms extended to %" PRIu64 " instead of %" PRIu64 "\n", what, ms, x, truth);
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    const uint32_t frozen = (uint32_t)CNT0 + 1000000; /* latched once, 1 s after the start */
+    struct lgw_cnt_ext_s before;
+    uint64_t ms, x;
+    int nb_pkt = 0;
+
+    srand(1);
+    lgw_cnt_ext_init(&ext);
+
+    /* packets every 0.1 to 10 s, the frozen trigger counter read every 10 s */
+    for (ms = 0; ms < RUN_MS; ms += 100 + rand() % 9900, ++nb_pkt) {
+        check_sample("packet", ms, 0);
+        if ((nb_pkt % 5) == 0) {
+            before = ext;
+            x = lgw_cnt_ext_at(&ext, frozen);
+            if ((before.ext != ext.ext) || (before.last != ext.last)) {
+                printf("ERROR: a latched value moved the extension\n");
+                ++nb_err;
+            }
+            if ((ms < 2000000) && (x != CNT0 + 1000000)) {
+                printf("ERROR: latched value extended to %" PRIu64 "\n", x);
+                ++nb_err;
+            }
+        }
+    }
+    printf("%d packets over %" PRIu64 " wraps, trigger counter frozen\n", nb_pkt, (uint64_t)((CNT0 + RUN_MS * 1000) >> 32));
+
+    /* a packet timestamped before the latest sample does not move the extension back */
+    check_sample("read", ms, 0);
+    check_sample("late packet", ms, 300000);
+    check_sample("read", ms + 1, 0);
+
+    /* quiet gateway, the RX loop polls every second and samples the counter when due */
+    for (x = ms + 1000; x < ms + QUIET_MS; x += 1000) {
+        if (lgw_cnt_ext_due(&ext, x) == true) {
+            check_sample("refresh", x, 0);
+        }
+    }
+    ms += QUIET_MS;
+    check_sample("packet after a quiet gap", ms, 0);
+
+    /* same gap with the loop stalled, no sample at all */
+    ms += QUIET_MS;
+    check_sample("packet after a stalled gap", ms, 0);
+    ms += 3 * QUIET_MS + 12345;
+    check_sample("packet after a 2 hours gap", ms, 0);
+
+    printf("%s: %d error(s)\n", (nb_err == 0) ? "PASS" : "FAIL", nb_err);
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,144 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Minimum test program for the loragw_gpio 'library'
+    Without argument, fake RX-ready events are raised on the simulated source
+    and the wakeup latency is measured.
+    With a GPIO chip path and line number, waits for real edges on that line.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>     /* atoi */
+#include <time.h>       /* clock_gettime */
+#include <poll.h>
+
+#include "loragw_gpio.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SIM_EVENT_NB    1000
+#define HW_EVENT_NB     10
+#define HW_TIMEOUT_MS   10000
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    int i, x;
+    int fd;
+    bool level;
+    uint64_t ts_ns = 0;
+    struct pollfd pfd;
+    struct timespec t0, t1;
+    double lat_us, lat_max = 0.0, lat_sum = 0.0;
+
+    printf("Beginning of test for loragw_gpio.c\n");
+
+    if (argc == 3) {
+        /* real hardware: wait for edges on the given line */
+        x = lgw_gpio_rx_open(argv[1], (uint32_t)atoi(argv[2]), &fd);
+        if (x != LGW_GPIO_SUCCESS) {
+            printf("ERROR: failed to open line %s:%s\n", argv[1], argv[2]);
+            return EXIT_FAILURE;
+        }
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        for (i = 0; i < HW_EVENT_NB; ++i) {
+            x = poll(&pfd, 1, HW_TIMEOUT_MS);
+            if (x == 0) {
+                printf("timeout, no edge in %d ms\n", HW_TIMEOUT_MS);
+                continue;
+            }
+            x = lgw_gpio_rx_ack(fd, &ts_ns);
+            lgw_gpio_rx_level(fd, &level);
+            printf("%d edge(s), last at %llu ns, level now %d\n", x, (unsigned long long)ts_ns, level);
+        }
+        lgw_gpio_rx_close(fd);
+        printf("End of test for loragw_gpio.c\n");
+        return EXIT_SUCCESS;
+    } else if (argc != 1) {
+        printf("usage: %s [gpio_chip_path line]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* simulated source */
+    x = lgw_gpio_rx_open(LGW_GPIO_SIM_PATH, 0, &fd);
+    if (x != LGW_GPIO_SUCCESS) {
+        printf("ERROR: failed to open simulated source\n");
+        return EXIT_FAILURE;
+    }
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    /* nothing pending: poll must time out */
+    x = poll(&pfd, 1, 0);
+    if (x != 0) {
+        printf("ERROR: event reported while none was raised\n");
+        return EXIT_FAILURE;
+    }
+
+    /* several raises before an ack are coalesced */
+    lgw_gpio_sim_raise();
+    lgw_gpio_sim_raise();
+    lgw_gpio_rx_level(fd, &level);
+    x = lgw_gpio_rx_ack(fd, NULL);
+    if ((x != 2) || (level != true)) {
+        printf("ERROR: expected 2 events with level up, got %d events, level %d\n", x, level);
+        return EXIT_FAILURE;
+    }
+    lgw_gpio_rx_level(fd, &level);
+    if (level != false) {
+        printf("ERROR: level still up after ack\n");
+        return EXIT_FAILURE;
+    }
+
+    /* wakeup latency, raise -> poll return -> ack */
+    for (i = 0; i < SIM_EVENT_NB; ++i) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        lgw_gpio_sim_raise();
+        x = poll(&pfd, 1, 1000);
+        lgw_gpio_rx_ack(fd, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        if (x != 1) {
+            printf("ERROR: missed simulated event %d\n", i);
+            return EXIT_FAILURE;
+        }
+        lat_us = (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+        lat_sum += lat_us;
+        if (lat_us > lat_max) {
+            lat_max = lat_us;
+        }
+    }
+    printf("%d simulated events, wakeup latency avg %.2f us, max %.2f us\n", SIM_EVENT_NB, lat_sum / SIM_EVENT_NB, lat_max);
+
+    lgw_gpio_rx_close(fd);
+    printf("End of test for loragw_gpio.c\n");
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
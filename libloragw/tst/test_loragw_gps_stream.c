@@ -0,0 +1,305 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Throughput of the incremental NMEA/UBX stream parser, compared to the
+    buffer + lgw_parse_nmea/lgw_parse_ubx framing it replaces.
+    The stream is a recorded u-blox capture given as argument, or a synthetic
+    one (u-blox 7 default output plus NAV-TIMEGPS, with corrupted frames).
+    No GPS nor concentrator is needed.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Michael Coracin
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fopen */
+#include <string.h>     /* memcpy memchr */
+#include <stdlib.h>     /* malloc exit */
+#include <time.h>       /* clock_gettime */
+
+#include "loragw_gps.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_EPOCH        2000    /* seconds of synthetic output */
+#define NB_REPEAT       20
+#define STREAM_MAX      (4 * 1024 * 1024)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static uint8_t stream[STREAM_MAX];
+static size_t stream_len = 0;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static double elapsed_ns(struct timespec *t0, struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+/* size of the next read() chunk, like a tty with VMIN = 8 under varying load */
+static size_t chunk_size(unsigned k) {
+    return 8 + (k * 37) % 57;
+}
+
+static void add_nmea(const char *body) {
+    uint8_t ck = 0;
+    const char *p;
+
+    for (p = body; *p != '\0'; ++p) {
+        ck ^= (uint8_t)*p;
+    }
+    stream_len += sprintf((char *)stream + stream_len, "$%s*%02X\r\n", body, ck);
+}
+
+static void add_ubx(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t size) {
+    uint8_t *f = stream + stream_len;
+    uint8_t ck_a = 0, ck_b = 0;
+    int i;
+
+    f[0] = 0xB5;
+    f[1] = 0x62;
+    f[2] = cls;
+    f[3] = id;
+    f[4] = size & 0xFF;
+    f[5] = size >> 8;
+    memcpy(f + 6, payload, size);
+    for (i = 2; i < 6 + size; ++i) {
+        ck_a += f[i];
+        ck_b += ck_a;
+    }
+    f[6 + size] = ck_a;
+    f[7 + size] = ck_b;
+    stream_len += 8 + size;
+}
+
+static void make_stream(void) {
+    char s[128];
+    uint8_t p[16];
+    uint32_t itow;
+    int k, h, m, sec;
+    size_t start;
+
+    for (k = 0; k < NB_EPOCH; ++k) {
+        start = stream_len;
+        h = (k / 3600) % 24;
+        m = (k / 60) % 60;
+        sec = k % 60;
+        sprintf(s, "GPRMC,%02d%02d%02d.00,A,4717.11437,N,00833.91522,E,0.004,77.52,091202,,,A", h, m, sec);
+        add_nmea(s);
+        add_nmea("GPVTG,77.52,T,,M,0.004,N,0.008,K,A");
+        sprintf(s, "GPGGA,%02d%02d%02d.00,4717.11399,N,00833.91590,E,1,08,1.01,499.6,M,48.0,M,,", h, m, sec);
+        add_nmea(s);
+        add_nmea("GPGSA,A,3,23,29,07,08,09,18,26,28,,,,,1.94,1.18,1.54");
+        add_nmea("GPGSV,3,1,10,23,38,230,44,29,71,156,47,07,29,116,41,08,09,081,36");
+        add_nmea("GPGSV,3,2,10,10,07,189,,05,05,220,,09,34,274,42,18,25,309,44");
+        add_nmea("GPGSV,3,3,10,26,82,187,47,28,43,056,46");
+        sprintf(s, "GPGLL,4717.11364,N,00833.91565,E,%02d%02d%02d.00,A,A", h, m, sec);
+        add_nmea(s);
+
+        /* NAV-TIMEGPS: iTOW, fTOW, week, leapS, valid, tAcc */
+        itow = (uint32_t)(k + 1) * 1000;
+        memset(p, 0, sizeof p);
+        p[0] = itow & 0xFF;
+        p[1] = (itow >> 8) & 0xFF;
+        p[2] = (itow >> 16) & 0xFF;
+        p[3] = itow >> 24;
+        p[8] = 2000 & 0xFF;
+        p[9] = 2000 >> 8;
+        p[10] = 18;
+        p[11] = 0x07;
+        add_ubx(0x01, 0x20, p, 16);
+
+        /* one corrupted byte every 16 epochs, in an NMEA sentence or the UBX frame */
+        if ((k % 16) == 5) {
+            stream[start + 10 + (k % 500)] ^= 0x11;
+        }
+    }
+}
+
+static int load_stream(const char *path) {
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL) {
+        return -1;
+    }
+    stream_len = fread(stream, 1, sizeof stream, f);
+    fclose(f);
+    return (stream_len > 0) ? 0 : -1;
+}
+
+/* count the frames of interest, in the callback of the stream parser */
+static void count_frame(enum gps_msg msg, const char *frame, size_t size, void *arg) {
+    uint32_t *nb = arg;
+
+    (void)frame;
+    (void)size;
+    nb[msg] += 1;
+}
+
+/* framing previously done by the callers: 128-byte buffer, sync char scan, full frame parsing */
+static void legacy_parse(uint32_t *nb) {
+    char serial_buff[128];
+    size_t wr_idx = 0;
+    size_t pos = 0;
+    unsigned k = 0;
+
+    while (pos < stream_len) {
+        size_t rd_idx = 0;
+        size_t frame_end_idx = 0;
+        size_t nb_char = chunk_size(k++);
+
+        if (nb_char > (sizeof serial_buff - wr_idx)) {
+            nb_char = sizeof serial_buff - wr_idx;
+        }
+        if (nb_char > (stream_len - pos)) {
+            nb_char = stream_len - pos;
+        }
+        memcpy(serial_buff + wr_idx, stream + pos, nb_char);
+        pos += nb_char;
+        wr_idx += nb_char;
+
+        while (rd_idx < wr_idx) {
+            size_t frame_size = 0;
+            enum gps_msg msg;
+
+            if (serial_buff[rd_idx] == (char)LGW_GPS_UBX_SYNC_CHAR) {
+                msg = lgw_parse_ubx(&serial_buff[rd_idx], (wr_idx - rd_idx), &frame_size);
+                if (frame_size > 0) {
+                    if ((msg == INCOMPLETE) || (msg == INVALID)) {
+                        frame_size = 0;
+                    } else {
+                        nb[msg] += 1;
+                    }
+                }
+            } else if (serial_buff[rd_idx] == LGW_GPS_NMEA_SYNC_CHAR) {
+                char *nmea_end_ptr = memchr(&serial_buff[rd_idx], (int)0x0a, (wr_idx - rd_idx));
+                if (nmea_end_ptr) {
+                    frame_size = nmea_end_ptr - &serial_buff[rd_idx] + 1;
+                    msg = lgw_parse_nmea(&serial_buff[rd_idx], frame_size);
+                    if ((msg == INVALID) || (msg == UNKNOWN)) {
+                        frame_size = 0;
+                    } else {
+                        nb[msg] += 1;
+                    }
+                }
+            }
+            if (frame_size > 0) {
+                rd_idx += frame_size;
+                frame_end_idx = rd_idx;
+            } else {
+                rd_idx++;
+            }
+        }
+        if (frame_end_idx) {
+            memmove(serial_buff, &serial_buff[frame_end_idx], wr_idx - frame_end_idx);
+            wr_idx -= frame_end_idx;
+        }
+        if ((sizeof(serial_buff) - wr_idx) < LGW_GPS_MIN_MSG_SIZE) {
+            memmove(serial_buff, &serial_buff[LGW_GPS_MIN_MSG_SIZE], wr_idx - LGW_GPS_MIN_MSG_SIZE);
+            wr_idx -= LGW_GPS_MIN_MSG_SIZE;
+        }
+    }
+}
+
+static void stream_parse(struct lgw_gps_stream_s *s) {
+    size_t pos = 0;
+    size_t n;
+    unsigned k = 0;
+
+    while (pos < stream_len) {
+        n = chunk_size(k++);
+        if (n > (stream_len - pos)) {
+            n = stream_len - pos;
+        }
+        lgw_gps_stream_feed(s, stream + pos, n);
+        pos += n;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    struct lgw_gps_stream_s gs;
+    uint32_t nb_legacy[UBX_NAV_TIMEUTC + 1];
+    uint32_t nb_stream[UBX_NAV_TIMEUTC + 1];
+    struct timespec t0, t1, utc;
+    double t;
+    int i;
+
+    printf("Beginning of test for the loragw_gps.c stream parser\n");
+
+    if (argc > 1) {
+        if (load_stream(argv[1]) != 0) {
+            printf("ERROR: failed to read recorded stream %s\n", argv[1]);
+            return EXIT_FAILURE;
+        }
+        printf("recorded stream %s: %zu bytes\n", argv[1], stream_len);
+    } else {
+        make_stream();
+        printf("synthetic u-blox stream: %d epochs, %zu bytes\n", NB_EPOCH, stream_len);
+    }
+
+    /* correctness: both framings must find the same frames of interest */
+    memset(nb_legacy, 0, sizeof nb_legacy);
+    memset(nb_stream, 0, sizeof nb_stream);
+    legacy_parse(nb_legacy);
+    lgw_gps_stream_init(&gs, count_frame, nb_stream);
+    stream_parse(&gs);
+    printf("frames: RMC %u/%u, GGA %u/%u, NAV-TIMEGPS %u/%u (legacy/stream), %u valid, %u dropped by the stream parser\n",
+           nb_legacy[NMEA_RMC], nb_stream[NMEA_RMC], nb_legacy[NMEA_GGA], nb_stream[NMEA_GGA],
+           nb_legacy[UBX_NAV_TIMEGPS], nb_stream[UBX_NAV_TIMEGPS], gs.nb_frames, gs.nb_errors);
+    if ((nb_legacy[NMEA_RMC] != nb_stream[NMEA_RMC]) || (nb_legacy[NMEA_GGA] != nb_stream[NMEA_GGA]) ||
+        (nb_legacy[UBX_NAV_TIMEGPS] != nb_stream[UBX_NAV_TIMEGPS])) {
+        printf("ERROR: stream parser and legacy framing disagree\n");
+        return EXIT_FAILURE;
+    }
+    if (lgw_gps_get(&utc, NULL, NULL, NULL) == LGW_GPS_SUCCESS) {
+        printf("last UTC time decoded: %lld\n", (long long)utc.tv_sec);
+    }
+
+    /* timing */
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < NB_REPEAT; ++i) {
+        legacy_parse(nb_legacy);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    t = elapsed_ns(&t0, &t1) / ((double)stream_len * NB_REPEAT);
+    printf("legacy framing + lgw_parse_*  : %6.2f ns/byte, %7.1f MB/s\n", t, 1e3 / t);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < NB_REPEAT; ++i) {
+        lgw_gps_stream_init(&gs, count_frame, nb_stream);
+        stream_parse(&gs);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    t = elapsed_ns(&t0, &t1) / ((double)stream_len * NB_REPEAT);
+    printf("stream parser                 : %6.2f ns/byte, %7.1f MB/s\n", t, 1e3 / t);
+
+    printf("End of test for the loragw_gps.c stream parser\n");
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,82 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Arena allocator: allocations are carved out of a preallocated block and
+    all released at once. Meant for short-lived trees of small objects, like
+    a parsed configuration file.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stddef.h>     /* size_t */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define ARENA_ALIGN     8   /* alignment of every allocation */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct arena_s
+@brief Preallocated block and the part of it already handed out
+*/
+struct arena_s {
+    uint8_t     *buf;       /*!> block, provided by the user */
+    size_t      size;       /*!> size of the block */
+    size_t      used;       /*!> bytes handed out since the last reset */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Set up an empty arena on a block
+@param a arena
+@param buf block, ARENA_ALIGN aligned, that must outlive the arena
+@param size size of the block
+*/
+void arena_init(struct arena_s *a, void *buf, size_t size);
+
+/**
+@brief Allocate from the arena
+@param a arena
+@param size number of bytes
+@return ARENA_ALIGN aligned pointer, NULL if the arena is full
+*/
+void *arena_alloc(struct arena_s *a, size_t size);
+
+/**
+@brief Tell whether a pointer was allocated from the arena
+@param a arena
+@param p pointer
+@return true if p is in the block of the arena
+*/
+bool arena_owns(const struct arena_s *a, const void *p);
+
+/**
+@brief Release all the allocations at once
+@param a arena
+*/
+void arena_reset(struct arena_s *a);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,107 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Configuration file loader shared by the utilities. The file is parsed
+    once, into an arena, and the "SX1301_conf" object and gateway ID are
+    read in a single pass into a flat structure of HAL configurations.
+    The "gateway_conf" object stays available to the application for its
+    own parameters until the parsed file is released.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _GW_CONF_H
+#define _GW_CONF_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "parson.h"
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define GW_CONF_SUCCESS     0
+#define GW_CONF_ERROR       -1
+
+#define GW_CONF_ARENA_SIZE  (64 * 1024) /* parsed file, larger files fall back to malloc */
+
+#define GW_CONF_IF_STD      8   /* IF chain of the LoRa standard channel */
+#define GW_CONF_IF_FSK      9   /* IF chain of the FSK channel */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct gw_conf_s
+@brief Concentrator configuration, each section is marked as set when found in a file
+*/
+struct gw_conf_s {
+    bool                        board_set;
+    struct lgw_conf_board_s     board;
+    bool                        rf_set[LGW_RF_CHAIN_NB];
+    struct lgw_conf_rxrf_s      rf[LGW_RF_CHAIN_NB];
+    bool                        if_set[LGW_IF_CHAIN_NB];
+    struct lgw_conf_rxif_s      ifc[LGW_IF_CHAIN_NB];   /*!> LoRa multi-SF 0 to 7, then GW_CONF_IF_STD and GW_CONF_IF_FSK */
+    bool                        gateway_id_set;
+    uint64_t                    gateway_id;             /*!> "gateway_ID" of "gateway_conf" */
+    JSON_Value                  *root;                  /*!> parsed file, NULL once released */
+    JSON_Object                 *gateway;               /*!> "gateway_conf" object of the parsed file, NULL if none */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Set every section as not set
+@param conf configuration
+*/
+void gw_conf_init(struct gw_conf_s *conf);
+
+/**
+@brief Parse a file, the sections it contains replace those already set
+@param conf configuration, a file still held is released first
+@param file path of the JSON file, comments allowed
+@return GW_CONF_ERROR if the file is not a valid JSON object, GW_CONF_SUCCESS else
+
+The parsed file is held until gw_conf_release. Only one file can be held at a
+time in the process, parson allocations are redirected to a single arena.
+*/
+int gw_conf_load(struct gw_conf_s *conf, const char *file);
+
+/**
+@brief Release the parsed file, the flat configuration stays valid
+@param conf configuration
+*/
+void gw_conf_release(struct gw_conf_s *conf);
+
+/**
+@brief Compare the concentrator configurations, the gateway ID and parsed file aside
+@param a configuration
+@param b configuration
+@return true if the same sections are set, with the same parameters
+*/
+bool gw_conf_same_radio(const struct gw_conf_s *a, const struct gw_conf_s *b);
+
+/**
+@brief Submit the sections set to the HAL, before lgw_start
+@param conf configuration
+@return GW_CONF_ERROR if the HAL refused a section, GW_CONF_SUCCESS else
+*/
+int gw_conf_apply(const struct gw_conf_s *conf);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,65 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Binary frames of the packet server stream. They are interleaved with the
+    text lines: a frame starts with a byte no text line starts with, then
+    its type and the length of its payload, little endian.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _LORA_FRAME_H
+#define _LORA_FRAME_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stddef.h>     /* size_t */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LORA_FRAME_MAGIC        0xA5    /* not ASCII, text lines never start with it */
+#define LORA_FRAME_HDR_SIZE     4       /* magic, type, payload length on 16 bits */
+#define LORA_FRAME_PAYLOAD_MAX  0xFFFF
+
+/* frame types */
+#define LORA_FRAME_SPOT         0x01    /* spotter sample, delta encoded (spot_codec.h) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS ----------------------------------------------------- */
+
+/**
+@brief Write the header of a frame
+@param hdr LORA_FRAME_HDR_SIZE bytes
+@param type frame type
+@param len payload length, up to LORA_FRAME_PAYLOAD_MAX
+*/
+static inline void lora_frame_header(uint8_t *hdr, uint8_t type, uint16_t len) {
+    hdr[0] = LORA_FRAME_MAGIC;
+    hdr[1] = type;
+    hdr[2] = (uint8_t)(len & 0xFF);
+    hdr[3] = (uint8_t)(len >> 8);
+}
+
+/**
+@brief Get the payload length of a frame
+@param hdr LORA_FRAME_HDR_SIZE bytes, starting with LORA_FRAME_MAGIC
+@return payload length
+*/
+static inline uint16_t lora_frame_len(const uint8_t *hdr) {
+    return (uint16_t)(hdr[2] | (hdr[3] << 8));
+}
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,172 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Layout of the shared memory ring the packet server publishes its lines
+    to, for the consumers running on the gateway. One writer, any number of
+    readers that never write to the ring: each slot carries a generation
+    counter, odd while the writer fills it, so that a reader detects a line
+    overwritten while it was copying it, or before it got to it.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _SHM_RING_H
+#define _SHM_RING_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stddef.h>     /* size_t */
+#include <string.h>     /* memcpy */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define SHM_RING_NAME       "/lora_pkt_server"  /* shm_open name of the packet server ring */
+#define SHM_RING_MAGIC      0x4C524E47          /* 'LRNG' */
+#define SHM_RING_VERSION    1
+#define SHM_RING_NB_SLOT    2048                /* power of 2, about 2 s of the fastest stream */
+#define SHM_RING_DATA_MAX   240                 /* bytes of a line, without its line ending */
+
+/* result of shm_ring_get */
+#define SHM_RING_OK         0
+#define SHM_RING_EMPTY      1   /* not published yet */
+#define SHM_RING_OVERRUN    2   /* overwritten before or while being read */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct shm_ring_hdr_s
+@brief Start of the shared memory, followed by nb_slot slots
+*/
+struct shm_ring_hdr_s {
+    uint32_t    magic;          /*!> SHM_RING_MAGIC once the ring is initialized */
+    uint16_t    version;        /*!> SHM_RING_VERSION */
+    uint16_t    slot_size;      /*!> sizeof(struct shm_ring_slot_s) */
+    uint32_t    nb_slot;
+    uint32_t    epoch;          /*!> changed each time a writer takes the ring over, lines restart from 0 */
+    uint32_t    alive;          /*!> 1 while the writer runs */
+    uint64_t    head __attribute__((aligned(64)));  /*!> lines published */
+};
+
+/**
+@struct shm_ring_slot_s
+@brief Line n is in slot n % nb_slot, gen is 2n+1 while it is written and 2n+2 once complete
+*/
+struct shm_ring_slot_s {
+    uint64_t    gen;
+    uint16_t    len;
+    char        data[SHM_RING_DATA_MAX];
+} __attribute__((aligned(8)));
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS ----------------------------------------------------- */
+
+/**
+@brief Size of the shared memory of a ring
+@param nb_slot number of slots
+@return size in bytes
+*/
+static inline size_t shm_ring_size(uint32_t nb_slot) {
+    return sizeof(struct shm_ring_hdr_s) + (size_t)nb_slot * sizeof(struct shm_ring_slot_s);
+}
+
+/**
+@brief Get the slots of a ring
+@param h ring
+@return first slot
+*/
+static inline struct shm_ring_slot_s *shm_ring_slots(const struct shm_ring_hdr_s *h) {
+    return (struct shm_ring_slot_s *)((uintptr_t)h + sizeof(struct shm_ring_hdr_s));
+}
+
+/**
+@brief Take the ring over, readers of a former writer restart from line 0 (writer only)
+@param h ring, in a shared memory of shm_ring_size(nb_slot) bytes at least
+@param nb_slot number of slots, power of 2
+*/
+static inline void shm_ring_init(struct shm_ring_hdr_s *h, uint32_t nb_slot) {
+    uint32_t epoch = (h->magic == SHM_RING_MAGIC) ? h->epoch + 1 : 1;
+
+    __atomic_store_n(&h->magic, 0, __ATOMIC_RELEASE);
+    memset(shm_ring_slots(h), 0, (size_t)nb_slot * sizeof(struct shm_ring_slot_s));
+    h->version = SHM_RING_VERSION;
+    h->slot_size = sizeof(struct shm_ring_slot_s);
+    h->nb_slot = nb_slot;
+    h->alive = 1;
+    __atomic_store_n(&h->epoch, epoch, __ATOMIC_RELEASE); /* before head, see lc_shm.c */
+    __atomic_store_n(&h->head, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&h->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+}
+
+/**
+@brief Publish a line (writer only)
+@param h ring
+@param data line, without its line ending
+@param len length, truncated to SHM_RING_DATA_MAX
+*/
+static inline void shm_ring_put(struct shm_ring_hdr_s *h, const char *data, size_t len) {
+    uint64_t n = h->head;
+    struct shm_ring_slot_s *s = &shm_ring_slots(h)[n & (h->nb_slot - 1)];
+
+    __atomic_store_n(&s->gen, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE); /* odd generation seen before any byte of the new line */
+    len = (len > SHM_RING_DATA_MAX) ? SHM_RING_DATA_MAX : len;
+    memcpy(s->data, data, len);
+    s->len = (uint16_t)len;
+    __atomic_store_n(&s->gen, 2 * n + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&h->head, n + 1, __ATOMIC_RELEASE);
+}
+
+/**
+@brief Copy a line (reader)
+@param h ring
+@param n number of the line
+@param buf SHM_RING_DATA_MAX bytes
+@param len pointer to store the length of the line
+@return SHM_RING_OK, SHM_RING_EMPTY or SHM_RING_OVERRUN
+*/
+static inline int shm_ring_get(const struct shm_ring_hdr_s *h, uint64_t n, char *buf, uint16_t *len) {
+    const struct shm_ring_slot_s *s = &shm_ring_slots(h)[n & (h->nb_slot - 1)];
+    uint64_t g1, g2;
+    uint16_t l;
+
+    g1 = __atomic_load_n(&s->gen, __ATOMIC_ACQUIRE);
+    if (g1 < 2 * n + 2) {
+        return SHM_RING_EMPTY;
+    } else if (g1 > 2 * n + 2) {
+        return SHM_RING_OVERRUN;
+    }
+    l = s->len;
+    l = (l > SHM_RING_DATA_MAX) ? SHM_RING_DATA_MAX : l;
+    memcpy(buf, s->data, l);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE); /* copy done before the generation is read again */
+    g2 = __atomic_load_n(&s->gen, __ATOMIC_RELAXED);
+    if (g2 != g1) {
+        return SHM_RING_OVERRUN;
+    }
+    *len = l;
+    return SHM_RING_OK;
+}
+
+/**
+@brief Tell the readers no more line will be published (writer only)
+@param h ring
+*/
+static inline void shm_ring_stop(struct shm_ring_hdr_s *h) {
+    __atomic_store_n(&h->alive, 0, __ATOMIC_RELEASE);
+}
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
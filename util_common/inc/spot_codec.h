@@ -0,0 +1,325 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Compressed encoding of the spotter samples, payload of the
+    LORA_FRAME_SPOT frames. Each spotter has its own predictor: timestamps
+    are sent as a delta of delta, displacements as deltas, position only
+    when it changed, all as zigzag varints. A keyframe carrying every field
+    starts the stream of each spotter and comes back periodically, a
+    decoder that missed a frame (sequence number gap) waits for the next.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _SPOT_CODEC_H
+#define _SPOT_CODEC_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stddef.h>     /* size_t */
+#include <string.h>     /* memset */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+/*
+Payload of a LORA_FRAME_SPOT frame:
+  0  spotter number     u8
+  1  flags              u8, SPOT_CODEC_xxx
+  2  sequence number    u16, per spotter, one more for each frame
+  4  keyframe: type u8, timestamp (tenths of a second) varint, X, Y, Z,
+     LATD, LATM, LOND, LONM zigzag varints
+     other frames: [type u8], timestamp delta of delta, X, Y, Z deltas
+     zigzag varints, [LATD, LATM, LOND, LONM zigzag varints]
+  .. [receive UTC minus timestamp, microseconds, zigzag varint]
+Fields in brackets are present if the flag says so.
+*/
+#define SPOT_CODEC_KEY          0x01    /* keyframe, every field absolute */
+#define SPOT_CODEC_TYPE         0x02    /* type present, always in a keyframe */
+#define SPOT_CODEC_POS          0x04    /* position present, always in a keyframe */
+#define SPOT_CODEC_UTC          0x08    /* receive UTC present */
+
+#define SPOT_CODEC_SPOT_MAX     16      /* spotter numbers 0 to 15 */
+#define SPOT_CODEC_PAYLOAD_MAX  64      /* largest payload, a keyframe with the receive time */
+#define SPOT_CODEC_KEY_INTERVAL 32      /* default frames of a spotter from a keyframe to the next */
+
+/* result of spot_codec_decode */
+#define SPOT_CODEC_OK           0
+#define SPOT_CODEC_RESYNC       1       /* frame missed before, waiting for a keyframe */
+#define SPOT_CODEC_INVALID      -1      /* truncated or out of range */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct spot_codec_rec_s
+@brief One spotter sample, with the fields of the text line
+*/
+struct spot_codec_rec_s {
+    uint8_t     spotn;
+    uint8_t     type;
+    uint64_t    tenths;         /*!> timestamp, tenths of a second since epoch */
+    int32_t     X;
+    int32_t     Y;
+    int32_t     Z;
+    int8_t      LATD;
+    int32_t     LATM;
+    int32_t     LOND;
+    int32_t     LONM;
+    bool        has_utc;
+    int64_t     utc_us;         /*!> gateway receive time, microseconds since epoch */
+};
+
+/**
+@struct spot_codec_chan_s
+@brief Predictor of one spotter, the same on both ends
+*/
+struct spot_codec_chan_s {
+    bool        valid;          /*!> a keyframe was sent or received since the last reset or gap */
+    uint16_t    seq;            /*!> sequence number of the last frame */
+    uint16_t    since_key;      /*!> frames since the last keyframe */
+    struct spot_codec_rec_s last;
+    uint64_t    prev_tenths;    /*!> timestamp before the last one */
+};
+
+/**
+@struct spot_codec_s
+@brief Predictors of all spotters, of an encoder or a decoder
+*/
+struct spot_codec_s {
+    struct spot_codec_chan_s    chan[SPOT_CODEC_SPOT_MAX];
+    uint16_t                    key_interval;   /*!> encoder only, 1 for keyframes only */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS ---------------------------------------------------- */
+
+static inline uint8_t *spot_codec_put_uv(uint8_t *p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static inline uint8_t *spot_codec_put_sv(uint8_t *p, int64_t v) {
+    return spot_codec_put_uv(p, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+/* NULL if the varint goes past the end */
+static inline const uint8_t *spot_codec_get_uv(const uint8_t *p, const uint8_t *end, uint64_t *v) {
+    uint64_t r = 0;
+    int shift = 0;
+
+    while ((p < end) && (shift < 64)) {
+        r |= (uint64_t)(*p & 0x7F) << shift;
+        if ((*p++ & 0x80) == 0) {
+            *v = r;
+            return p;
+        }
+        shift += 7;
+    }
+    return NULL;
+}
+
+static inline const uint8_t *spot_codec_get_sv(const uint8_t *p, const uint8_t *end, int64_t *v) {
+    uint64_t u = 0;
+
+    p = spot_codec_get_uv(p, end, &u);
+    *v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+    return p;
+}
+
+/* NULL if the varint goes past the end or out of the 32-bit range */
+static inline const uint8_t *spot_codec_get_s32(const uint8_t *p, const uint8_t *end, int64_t base, int32_t *v) {
+    int64_t d = 0;
+
+    p = spot_codec_get_sv(p, end, &d);
+    d += base;
+    if ((d < INT32_MIN) || (d > INT32_MAX)) {
+        return NULL;
+    }
+    *v = (int32_t)d;
+    return p;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS ----------------------------------------------------- */
+
+/**
+@brief Forget every spotter, the next frame of each is a keyframe (encoder) or must be one (decoder)
+@param c codec
+@param key_interval frames from a keyframe to the next, encoder only
+*/
+static inline void spot_codec_reset(struct spot_codec_s *c, uint16_t key_interval) {
+    memset(c, 0, sizeof *c);
+    c->key_interval = (key_interval == 0) ? SPOT_CODEC_KEY_INTERVAL : key_interval;
+}
+
+/**
+@brief Forget one spotter, its next frame is a keyframe (encoder) or must be one (decoder)
+@param c codec
+@param spotn spotter number, below SPOT_CODEC_SPOT_MAX
+*/
+static inline void spot_codec_forget(struct spot_codec_s *c, uint8_t spotn) {
+    c->chan[spotn % SPOT_CODEC_SPOT_MAX].valid = false;
+}
+
+/**
+@brief Encode a sample against the predictor of its spotter
+@param c encoder
+@param r sample, spotn below SPOT_CODEC_SPOT_MAX
+@param buf SPOT_CODEC_PAYLOAD_MAX bytes
+@return payload length
+*/
+static inline int spot_codec_encode(struct spot_codec_s *c, const struct spot_codec_rec_s *r, uint8_t *buf) {
+    struct spot_codec_chan_s *ch = &c->chan[r->spotn % SPOT_CODEC_SPOT_MAX];
+    const struct spot_codec_rec_s *l = &ch->last;
+    uint8_t flags = 0;
+    uint8_t *p = buf + 4;
+
+    if ((ch->valid == false) || (ch->since_key + 1 >= c->key_interval)) {
+        flags = SPOT_CODEC_KEY | SPOT_CODEC_TYPE | SPOT_CODEC_POS;
+        ch->since_key = 0;
+        *p++ = r->type;
+        p = spot_codec_put_uv(p, r->tenths);
+        p = spot_codec_put_sv(p, r->X);
+        p = spot_codec_put_sv(p, r->Y);
+        p = spot_codec_put_sv(p, r->Z);
+        ch->prev_tenths = r->tenths;
+    } else {
+        ch->since_key++;
+        if (r->type != l->type) {
+            flags |= SPOT_CODEC_TYPE;
+            *p++ = r->type;
+        }
+        p = spot_codec_put_sv(p, (int64_t)(r->tenths - l->tenths) - (int64_t)(l->tenths - ch->prev_tenths));
+        p = spot_codec_put_sv(p, (int64_t)r->X - l->X);
+        p = spot_codec_put_sv(p, (int64_t)r->Y - l->Y);
+        p = spot_codec_put_sv(p, (int64_t)r->Z - l->Z);
+        if ((r->LATD != l->LATD) || (r->LATM != l->LATM) || (r->LOND != l->LOND) || (r->LONM != l->LONM)) {
+            flags |= SPOT_CODEC_POS;
+        }
+        ch->prev_tenths = l->tenths;
+    }
+    if (flags & SPOT_CODEC_POS) {
+        p = spot_codec_put_sv(p, r->LATD);
+        p = spot_codec_put_sv(p, r->LATM);
+        p = spot_codec_put_sv(p, r->LOND);
+        p = spot_codec_put_sv(p, r->LONM);
+    }
+    if (r->has_utc == true) {
+        flags |= SPOT_CODEC_UTC;
+        p = spot_codec_put_sv(p, r->utc_us - (int64_t)r->tenths * 100000);
+    }
+    ch->seq++;
+    ch->valid = true;
+    ch->last = *r;
+    buf[0] = r->spotn;
+    buf[1] = flags;
+    buf[2] = (uint8_t)(ch->seq & 0xFF);
+    buf[3] = (uint8_t)(ch->seq >> 8);
+    return (int)(p - buf);
+}
+
+/**
+@brief Decode a sample with the predictor of its spotter
+@param c decoder
+@param buf payload of a LORA_FRAME_SPOT frame
+@param len payload length
+@param r filled with the sample if SPOT_CODEC_OK, only spotn is set if SPOT_CODEC_RESYNC
+@return SPOT_CODEC_OK, SPOT_CODEC_RESYNC or SPOT_CODEC_INVALID
+*/
+static inline int spot_codec_decode(struct spot_codec_s *c, const uint8_t *buf, size_t len, struct spot_codec_rec_s *r) {
+    const uint8_t *p = buf + 4;
+    const uint8_t *end = buf + len;
+    struct spot_codec_chan_s *ch;
+    struct spot_codec_rec_s n;
+    uint64_t t = 0;
+    int64_t v = 0;
+    uint16_t seq;
+    uint8_t flags;
+
+    if ((len < 4) || (buf[0] >= SPOT_CODEC_SPOT_MAX)) {
+        return SPOT_CODEC_INVALID;
+    }
+    ch = &c->chan[buf[0]];
+    flags = buf[1];
+    seq = (uint16_t)(buf[2] | (buf[3] << 8));
+    r->spotn = buf[0];
+
+    if ((flags & SPOT_CODEC_KEY) == 0) {
+        if ((ch->valid == false) || (seq != (uint16_t)(ch->seq + 1))) {
+            ch->valid = false;
+            return SPOT_CODEC_RESYNC;
+        }
+    }
+    n = ch->last;
+    n.spotn = buf[0];
+    if (flags & SPOT_CODEC_TYPE) {
+        if (p >= end) {
+            return SPOT_CODEC_INVALID;
+        }
+        n.type = *p++;
+    } else if (flags & SPOT_CODEC_KEY) {
+        return SPOT_CODEC_INVALID;
+    }
+    if (flags & SPOT_CODEC_KEY) {
+        if ((flags & SPOT_CODEC_POS) == 0) {
+            return SPOT_CODEC_INVALID;
+        }
+        p = spot_codec_get_uv(p, end, &t);
+        n.tenths = t;
+        if (p != NULL) p = spot_codec_get_s32(p, end, 0, &n.X);
+        if (p != NULL) p = spot_codec_get_s32(p, end, 0, &n.Y);
+        if (p != NULL) p = spot_codec_get_s32(p, end, 0, &n.Z);
+    } else {
+        p = spot_codec_get_sv(p, end, &v);
+        n.tenths = ch->last.tenths + (ch->last.tenths - ch->prev_tenths) + (uint64_t)v;
+        if (p != NULL) p = spot_codec_get_s32(p, end, ch->last.X, &n.X);
+        if (p != NULL) p = spot_codec_get_s32(p, end, ch->last.Y, &n.Y);
+        if (p != NULL) p = spot_codec_get_s32(p, end, ch->last.Z, &n.Z);
+    }
+    if ((p != NULL) && (flags & SPOT_CODEC_POS)) {
+        p = spot_codec_get_sv(p, end, &v);
+        if ((p != NULL) && ((v < INT8_MIN) || (v > INT8_MAX))) {
+            p = NULL;
+        }
+        n.LATD = (int8_t)v;
+        if (p != NULL) p = spot_codec_get_s32(p, end, 0, &n.LATM);
+        if (p != NULL) p = spot_codec_get_s32(p, end, 0, &n.LOND);
+        if (p != NULL) p = spot_codec_get_s32(p, end, 0, &n.LONM);
+    }
+    n.has_utc = (flags & SPOT_CODEC_UTC) ? true : false;
+    if ((p != NULL) && (n.has_utc == true)) {
+        p = spot_codec_get_sv(p, end, &v);
+        n.utc_us = v + (int64_t)n.tenths * 100000;
+    }
+    if ((p == NULL) || (p != end)) {
+        ch->valid = false;
+        return SPOT_CODEC_INVALID;
+    }
+
+    ch->prev_tenths = (flags & SPOT_CODEC_KEY) ? n.tenths : ch->last.tenths;
+    ch->last = n;
+    ch->seq = seq;
+    ch->valid = true;
+    *r = n;
+    return SPOT_CODEC_OK;
+}
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,61 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Arena allocator
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stddef.h>     /* size_t */
+
+#include "arena.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void arena_init(struct arena_s *a, void *buf, size_t size) {
+    a->buf = buf;
+    a->size = size;
+    a->used = 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void *arena_alloc(struct arena_s *a, size_t size) {
+    size_t n = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    void *p;
+
+    if ((size == 0) || (n > (a->size - a->used))) {
+        return NULL;
+    }
+    p = a->buf + a->used;
+    a->used += n;
+    return p;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool arena_owns(const struct arena_s *a, const void *p) {
+    return ((const uint8_t *)p >= a->buf) && ((const uint8_t *)p < (a->buf + a->size));
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void arena_reset(struct arena_s *a) {
+    a->used = 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
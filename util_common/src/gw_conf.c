@@ -0,0 +1,396 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Configuration file loader shared by the utilities
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* fprintf sscanf */
+#include <stdlib.h>     /* malloc free */
+#include <string.h>     /* memset strcmp strncmp */
+
+#include "arena.h"
+#include "gw_conf.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define MSG(args...)    fprintf(stderr, "gw_conf: " args) /* message that is destined to the user */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static uint64_t arena_buf[GW_CONF_ARENA_SIZE / sizeof(uint64_t)]; /* 8 bytes aligned */
+static struct arena_s arena = {(uint8_t *)arena_buf, sizeof arena_buf, 0};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* parson allocation functions while a file is parsed or released */
+static void *conf_malloc(size_t size) {
+    void *p = arena_alloc(&arena, size);
+
+    return (p != NULL) ? p : malloc(size);
+}
+
+static void conf_free(void *p) {
+    if ((p != NULL) && (arena_owns(&arena, p) == false)) {
+        free(p);
+    }
+}
+
+/* number or boolean members, left as they are if missing or of another type */
+static void get_number(JSON_Object *obj, const char *name, double *x) {
+    JSON_Value *val = json_object_get_value(obj, name);
+
+    if (json_value_get_type(val) == JSONNumber) {
+        *x = json_value_get_number(val);
+    }
+}
+
+static void get_bool(JSON_Object *obj, const char *name, bool *x) {
+    JSON_Value *val = json_object_get_value(obj, name);
+
+    if (json_value_get_type(val) == JSONBoolean) {
+        *x = (bool)json_value_get_boolean(val);
+    }
+}
+
+static void parse_radio(int i, JSON_Object *obj, struct lgw_conf_rxrf_s *rf) {
+    const char *str;
+    double x;
+
+    memset(rf, 0, sizeof *rf);
+    get_bool(obj, "enable", &rf->enable);
+    if (rf->enable == false) {
+        MSG("INFO: radio %i disabled\n", i);
+        return;
+    }
+    x = 0; get_number(obj, "freq", &x); rf->freq_hz = (uint32_t)x;
+    x = 0; get_number(obj, "rssi_offset", &x); rf->rssi_offset = (float)x;
+    str = json_object_get_string(obj, "type");
+    if ((str != NULL) && !strncmp(str, "SX1255", 6)) {
+        rf->type = LGW_RADIO_TYPE_SX1255;
+    } else if ((str != NULL) && !strncmp(str, "SX1257", 6)) {
+        rf->type = LGW_RADIO_TYPE_SX1257;
+    } else {
+        MSG("WARNING: invalid radio type: %s (should be SX1255 or SX1257)\n", (str != NULL) ? str : "none");
+    }
+    get_bool(obj, "tx_enable", &rf->tx_enable);
+    if (rf->tx_enable == true) {
+        /* tx notch filter frequency to be set */
+        x = 0; get_number(obj, "tx_notch_freq", &x); rf->tx_notch_freq = (uint32_t)x;
+    }
+    MSG("INFO: radio %i enabled (type %s), center frequency %u, RSSI offset %f, tx enabled %d, tx_notch_freq %u\n", i, (str != NULL) ? str : "none", rf->freq_hz, rf->rssi_offset, rf->tx_enable, rf->tx_notch_freq);
+}
+
+static void parse_multi(int i, JSON_Object *obj, struct lgw_conf_rxif_s *ifc) {
+    JSON_Value *val;
+    JSON_Array *sfs;
+    uint32_t sf;
+    double x;
+    size_t k;
+
+    memset(ifc, 0, sizeof *ifc);
+    get_bool(obj, "enable", &ifc->enable);
+    if (ifc->enable == false) {
+        MSG("INFO: LoRa multi-SF channel %i disabled\n", i);
+        return;
+    }
+    x = 0; get_number(obj, "radio", &x); ifc->rf_chain = (uint8_t)x;
+    x = 0; get_number(obj, "if", &x); ifc->freq_hz = (int32_t)x;
+    /* enabled spreading factors, one number or an array of numbers, all of them if not given */
+    val = json_object_get_value(obj, "spread_factor");
+    if (json_value_get_type(val) == JSONArray) {
+        sfs = json_value_get_array(val);
+        for (k = 0; k < json_array_get_count(sfs); ++k) {
+            sf = (uint32_t)json_array_get_number(sfs, k);
+            if ((sf >= 7) && (sf <= 12)) ifc->datarate |= DR_LORA_SF7 << (sf - 7);
+        }
+    } else if (json_value_get_type(val) == JSONNumber) {
+        sf = (uint32_t)json_value_get_number(val);
+        if ((sf >= 7) && (sf <= 12)) ifc->datarate = DR_LORA_SF7 << (sf - 7);
+    }
+    if (ifc->datarate == DR_UNDEFINED) {
+        ifc->datarate = DR_LORA_MULTI;
+    }
+    MSG("INFO: LoRa multi-SF channel %i enabled, radio %i selected, IF %i Hz, 125 kHz bandwidth, SF mask 0x%02X\n", i, ifc->rf_chain, ifc->freq_hz, ifc->datarate);
+}
+
+static void parse_std(JSON_Object *obj, struct lgw_conf_rxif_s *ifc) {
+    uint32_t sf, bw;
+    double x;
+
+    memset(ifc, 0, sizeof *ifc);
+    get_bool(obj, "enable", &ifc->enable);
+    if (ifc->enable == false) {
+        MSG("INFO: LoRa standard channel disabled\n");
+        return;
+    }
+    x = 0; get_number(obj, "radio", &x); ifc->rf_chain = (uint8_t)x;
+    x = 0; get_number(obj, "if", &x); ifc->freq_hz = (int32_t)x;
+    x = 0; get_number(obj, "bandwidth", &x); bw = (uint32_t)x;
+    switch(bw) {
+        case 500000: ifc->bandwidth = BW_500KHZ; break;
+        case 250000: ifc->bandwidth = BW_250KHZ; break;
+        case 125000: ifc->bandwidth = BW_125KHZ; break;
+        default: ifc->bandwidth = BW_UNDEFINED;
+    }
+    x = 0; get_number(obj, "spread_factor", &x); sf = (uint32_t)x;
+    switch(sf) {
+        case  7: ifc->datarate = DR_LORA_SF7;  break;
+        case  8: ifc->datarate = DR_LORA_SF8;  break;
+        case  9: ifc->datarate = DR_LORA_SF9;  break;
+        case 10: ifc->datarate = DR_LORA_SF10; break;
+        case 11: ifc->datarate = DR_LORA_SF11; break;
+        case 12: ifc->datarate = DR_LORA_SF12; break;
+        default: ifc->datarate = DR_UNDEFINED;
+    }
+    MSG("INFO: LoRa standard channel enabled, radio %i selected, IF %i Hz, %u Hz bandwidth, SF %u\n", ifc->rf_chain, ifc->freq_hz, bw, sf);
+}
+
+static void parse_fsk(JSON_Object *obj, struct lgw_conf_rxif_s *ifc) {
+    uint32_t bw;
+    double x;
+
+    memset(ifc, 0, sizeof *ifc);
+    get_bool(obj, "enable", &ifc->enable);
+    if (ifc->enable == false) {
+        MSG("INFO: FSK channel disabled\n");
+        return;
+    }
+    x = 0; get_number(obj, "radio", &x); ifc->rf_chain = (uint8_t)x;
+    x = 0; get_number(obj, "if", &x); ifc->freq_hz = (int32_t)x;
+    x = 0; get_number(obj, "bandwidth", &x); bw = (uint32_t)x;
+    if      (bw <= 7800)   ifc->bandwidth = BW_7K8HZ;
+    else if (bw <= 15600)  ifc->bandwidth = BW_15K6HZ;
+    else if (bw <= 31200)  ifc->bandwidth = BW_31K2HZ;
+    else if (bw <= 62500)  ifc->bandwidth = BW_62K5HZ;
+    else if (bw <= 125000) ifc->bandwidth = BW_125KHZ;
+    else if (bw <= 250000) ifc->bandwidth = BW_250KHZ;
+    else if (bw <= 500000) ifc->bandwidth = BW_500KHZ;
+    else ifc->bandwidth = BW_UNDEFINED;
+    x = 0; get_number(obj, "datarate", &x); ifc->datarate = (uint32_t)x;
+    MSG("INFO: FSK channel enabled, radio %i selected, IF %i Hz, %u Hz bandwidth, %u bps datarate\n", ifc->rf_chain, ifc->freq_hz, bw, ifc->datarate);
+}
+
+/* one pass over the members of "SX1301_conf", each section is looked up only once */
+static void parse_sx1301(struct gw_conf_s *conf, JSON_Object *sx) {
+    struct gw_conf_s found;
+    JSON_Value *val;
+    JSON_Object *obj;
+    const char *name;
+    bool pub_ok = false, clk_ok = false;
+    size_t k;
+    int i;
+
+    memset(&found, 0, sizeof found);
+    for (k = 0; k < json_object_get_count(sx); ++k) {
+        name = json_object_get_name(sx, k);
+        val = json_object_get_value_at(sx, k);
+        obj = json_value_get_object(val); /* NULL if not an object */
+        if (!strcmp(name, "lorawan_public")) {
+            if (json_value_get_type(val) == JSONBoolean) {
+                conf->board.lorawan_public = (bool)json_value_get_boolean(val);
+                pub_ok = true;
+            }
+        } else if (!strcmp(name, "clksrc")) {
+            if (json_value_get_type(val) == JSONNumber) {
+                conf->board.clksrc = (uint8_t)json_value_get_number(val);
+                clk_ok = true;
+            }
+        } else if ((obj != NULL) && !strncmp(name, "radio_", 6)) {
+            i = atoi(name + 6);
+            if ((i >= 0) && (i < LGW_RF_CHAIN_NB)) {
+                parse_radio(i, obj, &conf->rf[i]);
+                found.rf_set[i] = true;
+            }
+        } else if ((obj != NULL) && !strncmp(name, "chan_multiSF_", 13)) {
+            i = atoi(name + 13);
+            if ((i >= 0) && (i < LGW_MULTI_NB)) {
+                parse_multi(i, obj, &conf->ifc[i]);
+                found.if_set[i] = true;
+            }
+        } else if ((obj != NULL) && !strcmp(name, "chan_Lora_std")) {
+            parse_std(obj, &conf->ifc[GW_CONF_IF_STD]);
+            found.if_set[GW_CONF_IF_STD] = true;
+        } else if ((obj != NULL) && !strcmp(name, "chan_FSK")) {
+            parse_fsk(obj, &conf->ifc[GW_CONF_IF_FSK]);
+            found.if_set[GW_CONF_IF_FSK] = true;
+        }
+    }
+
+    /* board parameters always come with the SX1301 object */
+    if (pub_ok == false) {
+        MSG("WARNING: Data type for lorawan_public seems wrong, please check\n");
+        conf->board.lorawan_public = false;
+    }
+    if (clk_ok == false) {
+        MSG("WARNING: Data type for clksrc seems wrong, please check\n");
+        conf->board.clksrc = 0;
+    }
+    conf->board_set = true;
+    MSG("INFO: lorawan_public %d, clksrc %d\n", conf->board.lorawan_public, conf->board.clksrc);
+
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        if (found.rf_set[i] == false) {
+            MSG("INFO: no configuration for radio %i\n", i);
+        }
+        conf->rf_set[i] |= found.rf_set[i];
+    }
+    for (i = 0; i < LGW_IF_CHAIN_NB; ++i) {
+        if (found.if_set[i] == false) {
+            if (i < LGW_MULTI_NB) {
+                MSG("INFO: no configuration for LoRa multi-SF channel %i\n", i);
+            } else {
+                MSG("INFO: no configuration for %s channel\n", (i == GW_CONF_IF_STD) ? "LoRa standard" : "FSK");
+            }
+        }
+        conf->if_set[i] |= found.if_set[i];
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* field by field, padding bytes are not copied by struct assignment */
+static bool same_rf(const struct lgw_conf_rxrf_s *a, const struct lgw_conf_rxrf_s *b) {
+    return (a->enable == b->enable) && (a->freq_hz == b->freq_hz) && (a->rssi_offset == b->rssi_offset) &&
+           (a->type == b->type) && (a->tx_enable == b->tx_enable) && (a->tx_notch_freq == b->tx_notch_freq);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool same_if(const struct lgw_conf_rxif_s *a, const struct lgw_conf_rxif_s *b) {
+    return (a->enable == b->enable) && (a->rf_chain == b->rf_chain) && (a->freq_hz == b->freq_hz) &&
+           (a->bandwidth == b->bandwidth) && (a->datarate == b->datarate) &&
+           (a->sync_word_size == b->sync_word_size) && (a->sync_word == b->sync_word);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void gw_conf_init(struct gw_conf_s *conf) {
+    memset(conf, 0, sizeof *conf);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int gw_conf_load(struct gw_conf_s *conf, const char *file) {
+    JSON_Object *root;
+    JSON_Object *sx;
+    const char *str;
+    unsigned long long ull = 0;
+
+    gw_conf_release(conf);
+
+    /* try to parse JSON, every node lands in the arena */
+    arena_reset(&arena);
+    json_set_allocation_functions(conf_malloc, conf_free);
+    conf->root = json_parse_file_with_comments(file);
+    json_set_allocation_functions(malloc, free);
+    root = json_value_get_object(conf->root);
+    if (root == NULL) {
+        MSG("ERROR: %s is not a valid JSON file\n", file);
+        gw_conf_release(conf);
+        return GW_CONF_ERROR;
+    }
+
+    sx = json_object_get_object(root, "SX1301_conf");
+    if (sx == NULL) {
+        MSG("INFO: %s does not contain a JSON object named SX1301_conf\n", file);
+    } else {
+        MSG("INFO: %s does contain a JSON object named SX1301_conf, parsing SX1301 parameters\n", file);
+        parse_sx1301(conf, sx);
+    }
+
+    conf->gateway = json_object_get_object(root, "gateway_conf");
+    if (conf->gateway == NULL) {
+        MSG("INFO: %s does not contain a JSON object named gateway_conf\n", file);
+    } else {
+        MSG("INFO: %s does contain a JSON object named gateway_conf, parsing gateway parameters\n", file);
+        str = json_object_get_string(conf->gateway, "gateway_ID");
+        if ((str != NULL) && (sscanf(str, "%llx", &ull) == 1)) {
+            conf->gateway_id = ull;
+            conf->gateway_id_set = true;
+            MSG("INFO: gateway MAC address is configured to %016llX\n", ull);
+        }
+    }
+
+    return GW_CONF_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void gw_conf_release(struct gw_conf_s *conf) {
+    if (conf->root != NULL) {
+        /* only the allocations that did not fit in the arena are actually freed */
+        json_set_allocation_functions(conf_malloc, conf_free);
+        json_value_free(conf->root);
+        json_set_allocation_functions(malloc, free);
+    }
+    arena_reset(&arena);
+    conf->root = NULL;
+    conf->gateway = NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool gw_conf_same_radio(const struct gw_conf_s *a, const struct gw_conf_s *b) {
+    int i;
+
+    if ((a->board_set != b->board_set) || ((a->board_set == true) &&
+        ((a->board.lorawan_public != b->board.lorawan_public) || (a->board.clksrc != b->board.clksrc)))) {
+        return false;
+    }
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        if ((a->rf_set[i] != b->rf_set[i]) || ((a->rf_set[i] == true) && (same_rf(&a->rf[i], &b->rf[i]) == false))) {
+            return false;
+        }
+    }
+    for (i = 0; i < LGW_IF_CHAIN_NB; ++i) {
+        if ((a->if_set[i] != b->if_set[i]) || ((a->if_set[i] == true) && (same_if(&a->ifc[i], &b->ifc[i]) == false))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int gw_conf_apply(const struct gw_conf_s *conf) {
+    int i;
+
+    if ((conf->board_set == true) && (lgw_board_setconf(conf->board) != LGW_HAL_SUCCESS)) {
+        MSG("ERROR: Failed to configure board\n");
+        return GW_CONF_ERROR;
+    }
+    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
+        if ((conf->rf_set[i] == true) && (lgw_rxrf_setconf(i, conf->rf[i]) != LGW_HAL_SUCCESS)) {
+            MSG("ERROR: invalid configuration for radio %i\n", i);
+            return GW_CONF_ERROR;
+        }
+    }
+    for (i = 0; i < LGW_IF_CHAIN_NB; ++i) {
+        if ((conf->if_set[i] == true) && (lgw_rxif_setconf(i, conf->ifc[i]) != LGW_HAL_SUCCESS)) {
+            MSG("ERROR: invalid configuration for IF chain %i\n", i);
+            return GW_CONF_ERROR;
+        }
+    }
+    return GW_CONF_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,109 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Tokenizer of text logs and CSV files. The file is mapped in memory and
+    split in place into lines and fields, nothing is copied but the numbers
+    being converted.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _CSV_TOK_H
+#define _CSV_TOK_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stddef.h>     /* size_t */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define CSV_TOK_SUCCESS     0
+#define CSV_TOK_ERROR       -1
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct csv_file_s
+@brief File mapped in memory, read only
+*/
+struct csv_file_s {
+    const char  *data;
+    size_t      size;
+    const char  *pos;   /*!> start of the next line */
+};
+
+/**
+@struct csv_field_s
+@brief Field of a line, not NUL terminated
+*/
+struct csv_field_s {
+    const char  *p;
+    size_t      len;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Map a file in memory
+@param f file
+@param path path of the file
+@return CSV_TOK_ERROR if the file could not be opened or mapped, CSV_TOK_SUCCESS else
+*/
+int csv_open(struct csv_file_s *f, const char *path);
+
+/**
+@brief Unmap a file, the fields taken from it are not valid any more
+@param f file
+*/
+void csv_close(struct csv_file_s *f);
+
+/**
+@brief Get the next line, without its line ending
+@param f file
+@param line filled with the line
+@return false at the end of the file
+*/
+bool csv_next_line(struct csv_file_s *f, struct csv_field_s *line);
+
+/**
+@brief Split a line on commas
+@param line line
+@param fields filled with the fields
+@param max number of fields that can be filled
+@return number of fields of the line, may be more than max
+*/
+int csv_split(const struct csv_field_s *line, struct csv_field_s *fields, int max);
+
+/**
+@brief Convert a field to a floating point number, surrounding blanks allowed
+@param fld field
+@param v filled with the number
+@return false if the field is empty or not a number
+*/
+bool csv_to_double(const struct csv_field_s *fld, double *v);
+
+/**
+@brief Convert a field to an integer, surrounding blanks allowed
+@param fld field
+@param v filled with the number
+@return false if the field is empty, not an integer or out of range
+*/
+bool csv_to_int(const struct csv_field_s *fld, int64_t *v);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
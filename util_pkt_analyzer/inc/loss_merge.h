@@ -0,0 +1,128 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Packet loss of a channel: each sample sent by the Spotter is matched
+    with the received packet nearest in time, within a tolerance, in a
+    single pass over both streams sorted by time. Same rules as the
+    merge_asof(direction='nearest') of the analysis scripts: the packet
+    before wins a tie, and a packet may be matched more than once.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _LOSS_MERGE_H
+#define _LOSS_MERGE_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stddef.h>     /* size_t */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LOSS_NO_MATCH       -1
+
+#define LOSS_TOLERANCE_S    0.1 /* default, time difference of a match */
+#define LOSS_DATA_TOL_MM    1   /* displacement difference of correct data, after truncation */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct loss_rx_s
+@brief Packet of the receiver log
+*/
+struct loss_rx_s {
+    double      time;   /*!> GPS epoch time, in seconds, kept first for the sort */
+    int32_t     x;      /*!> displacements, in mm */
+    int32_t     y;
+    int32_t     z;
+    int32_t     stage;  /*!> signal stage */
+};
+
+/**
+@struct loss_flt_s
+@brief Sample of a Spotter FLT file, missing numbers are NaN
+*/
+struct loss_flt_s {
+    double      time;   /*!> GPS epoch time, in seconds, kept first for the sort */
+    double      x;      /*!> displacements, in mm */
+    double      y;
+    double      z;
+    double      millis;
+    const char  *flag;  /*!> flag field, as found in the file */
+    uint32_t    flag_len;
+};
+
+/**
+@struct loss_stats_s
+@brief Outcome of the samples of a channel
+*/
+struct loss_stats_s {
+    size_t      attempted;  /*!> samples sent */
+    size_t      delivered;  /*!> samples matched with a packet */
+    size_t      corrupted;  /*!> delivered with a displacement off */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Sort received packets by time, only if needed, equal times keep their order
+@param rx packets
+@param nb number of packets
+@return LOSS_NO_MATCH if out of memory, 0 else
+*/
+int loss_sort_rx(struct loss_rx_s *rx, size_t nb);
+
+/**
+@brief Sort samples by time, only if needed, equal times keep their order
+@param flt samples
+@param nb number of samples
+@return LOSS_NO_MATCH if out of memory, 0 else
+*/
+int loss_sort_flt(struct loss_flt_s *flt, size_t nb);
+
+/**
+@brief Match each sample with the nearest packet in time
+@param flt samples, sorted by time
+@param nb_flt number of samples
+@param rx packets, sorted by time
+@param nb_rx number of packets
+@param tolerance largest time difference of a match, in seconds
+@param match filled with the index of the packet of each sample, LOSS_NO_MATCH if none
+*/
+void loss_merge(const struct loss_flt_s *flt, size_t nb_flt, const struct loss_rx_s *rx, size_t nb_rx, double tolerance, int32_t *match);
+
+/**
+@brief Check the data of a delivered sample
+@param f sample
+@param r packet matched
+@return true if each displacement, truncated to an integer, is off by LOSS_DATA_TOL_MM at most
+*/
+bool loss_data_correct(const struct loss_flt_s *f, const struct loss_rx_s *r);
+
+/**
+@brief Count the samples delivered and corrupted
+@param flt samples
+@param nb_flt number of samples
+@param rx packets
+@param match index of the packet of each sample, from loss_merge
+@param stats filled with the counts
+*/
+void loss_evaluate(const struct loss_flt_s *flt, size_t nb_flt, const struct loss_rx_s *rx, const int32_t *match, struct loss_stats_s *stats);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
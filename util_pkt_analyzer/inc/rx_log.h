@@ -0,0 +1,118 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Reader of the packet lines of a receiver log, or of a capture of the
+    server output stream: '#n,stage,time,X,Y,Z[,lat,lon][,utc]', the time in
+    1/10 s. Other lines are ignored. Also built as a shared library, for the
+    analysis scripts to fill their NumPy columns in place.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _RX_LOG_H
+#define _RX_LOG_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "csv_tok.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define RX_LOG_SUCCESS      0
+#define RX_LOG_ERROR        -1
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct rx_log_rec_s
+@brief Packet line, optional fields are NaN when missing
+*/
+struct rx_log_rec_s {
+    int32_t     chan;   /*!> Spotter channel */
+    int32_t     stage;  /*!> signal stage */
+    double      time;   /*!> GPS epoch time, in seconds */
+    int32_t     x;      /*!> displacements, in mm */
+    int32_t     y;
+    int32_t     z;
+    double      lat;    /*!> position of the Spotter, in degrees */
+    double      lon;
+    double      utc;    /*!> receive time, when the server appends it */
+};
+
+/**
+@struct rx_log_s
+@brief Log mapped in memory
+*/
+struct rx_log_s {
+    struct csv_file_s   file;
+    long                nb_lines;   /*!> packet lines, malformed ones included */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Parse a line
+@param line line, without its line ending
+@param rec filled with the packet
+@return false if not a packet line, or a malformed one
+*/
+bool rx_log_parse_line(const struct csv_field_s *line, struct rx_log_rec_s *rec);
+
+/**
+@brief Map a log and count its packet lines
+@param path path of the log
+@return the log, to be closed, NULL if it could not be opened
+*/
+struct rx_log_s *rx_log_open(const char *path);
+
+/**
+@brief Number of packet lines, the size of the columns to fill
+@param log log
+@return number of lines starting with '#'
+*/
+long rx_log_lines(const struct rx_log_s *log);
+
+/**
+@brief Parse the packet lines into columns, any column may be NULL
+@param log log
+@param max size of the columns
+@param chan Spotter channel
+@param stage signal stage
+@param time GPS epoch time, in seconds
+@param x displacements, in mm
+@param y
+@param z
+@param lat position of the Spotter, in degrees, NaN if missing
+@param lon
+@param utc receive time, NaN if missing
+@param nb_bad filled with the number of malformed lines skipped, may be NULL
+@return number of packets, in the order of the log
+
+The integer columns are 64 bits wide, the type pandas gives to integers.
+*/
+long rx_log_fill(struct rx_log_s *log, long max, int64_t *chan, int64_t *stage, double *time, int64_t *x, int64_t *y, int64_t *z, double *lat, double *lon, double *utc, long *nb_bad);
+
+/**
+@brief Unmap and free a log
+@param log log
+*/
+void rx_log_close(struct rx_log_s *log);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,190 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    In place tokenizer of memory mapped text files
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdlib.h>     /* strtod */
+#include <string.h>     /* memchr memcpy */
+#include <fcntl.h>      /* open */
+#include <unistd.h>     /* close */
+#include <sys/mman.h>   /* mmap munmap madvise */
+#include <sys/stat.h>   /* fstat */
+
+#include "csv_tok.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NUM_MAX_LEN     63  /* longest number converted, longer fields are rejected */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void trim(const struct csv_field_s *fld, const char **b, const char **e) {
+    *b = fld->p;
+    *e = fld->p + fld->len;
+    while ((*b < *e) && ((**b == ' ') || (**b == '\t'))) {
+        ++*b;
+    }
+    while ((*e > *b) && ((*(*e - 1) == ' ') || (*(*e - 1) == '\t'))) {
+        --*e;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int csv_open(struct csv_file_s *f, const char *path) {
+    struct stat st;
+    void *p;
+    int fd;
+
+    f->data = f->pos = NULL;
+    f->size = 0;
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return CSV_TOK_ERROR;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return CSV_TOK_ERROR;
+    }
+    if (st.st_size > 0) {
+        p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close(fd);
+            return CSV_TOK_ERROR;
+        }
+        posix_madvise(p, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+        f->data = f->pos = p;
+        f->size = (size_t)st.st_size;
+    }
+    close(fd); /* the mapping holds the file */
+    return CSV_TOK_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void csv_close(struct csv_file_s *f) {
+    if (f->data != NULL) {
+        munmap((void *)f->data, f->size);
+    }
+    f->data = f->pos = NULL;
+    f->size = 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool csv_next_line(struct csv_file_s *f, struct csv_field_s *line) {
+    const char *end = f->data + f->size;
+    const char *nl;
+
+    if ((f->pos == NULL) || (f->pos >= end)) {
+        return false;
+    }
+    nl = memchr(f->pos, '\n', (size_t)(end - f->pos));
+    if (nl == NULL) {
+        nl = end; /* last line, not terminated */
+    }
+    line->p = f->pos;
+    line->len = (size_t)(nl - f->pos);
+    if ((line->len > 0) && (line->p[line->len - 1] == '\r')) {
+        --line->len;
+    }
+    f->pos = (nl < end) ? nl + 1 : end;
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int csv_split(const struct csv_field_s *line, struct csv_field_s *fields, int max) {
+    const char *p = line->p;
+    const char *end = line->p + line->len;
+    const char *c;
+    int n = 0;
+
+    for (;;) {
+        c = memchr(p, ',', (size_t)(end - p));
+        if (n < max) {
+            fields[n].p = p;
+            fields[n].len = (size_t)(((c != NULL) ? c : end) - p);
+        }
+        ++n;
+        if (c == NULL) {
+            return n;
+        }
+        p = c + 1;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool csv_to_double(const struct csv_field_s *fld, double *v) {
+    char buf[NUM_MAX_LEN + 1];
+    const char *b, *e;
+    char *stop;
+    size_t len;
+
+    trim(fld, &b, &e);
+    len = (size_t)(e - b);
+    if ((len == 0) || (len > NUM_MAX_LEN)) {
+        return false;
+    }
+    memcpy(buf, b, len);
+    buf[len] = '\0';
+    *v = strtod(buf, &stop);
+    return (*stop == '\0');
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool csv_to_int(const struct csv_field_s *fld, int64_t *v) {
+    const char *b, *e;
+    bool neg = false;
+    uint64_t x = 0;
+
+    trim(fld, &b, &e);
+    if ((b < e) && ((*b == '-') || (*b == '+'))) {
+        neg = (*b == '-');
+        ++b;
+    }
+    if (b == e) {
+        return false;
+    }
+    for (; b < e; ++b) {
+        if ((*b < '0') || (*b > '9') || (x > (uint64_t)INT64_MAX / 10)) {
+            return false;
+        }
+        x = x * 10 + (uint64_t)(*b - '0');
+    }
+    if (x > (uint64_t)INT64_MAX) {
+        return false;
+    }
+    *v = neg ? -(int64_t)x : (int64_t)x;
+    return true;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
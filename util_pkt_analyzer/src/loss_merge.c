@@ -0,0 +1,160 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Nearest time match of the Spotter samples with the received packets
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdlib.h>     /* malloc free */
+#include <string.h>     /* memcpy */
+#include <math.h>       /* isnan trunc */
+
+#include "loss_merge.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* both record types start with their time */
+#define TIME_OF(base, size, i)  (*(const double *)((const char *)(base) + (i) * (size)))
+
+/* stable merge sort, on records of any size */
+static void merge_sort(char *a, char *tmp, size_t nb, size_t size) {
+    size_t h = nb / 2, i = 0, j = h, k = 0;
+
+    if (nb < 2) {
+        return;
+    }
+    merge_sort(a, tmp, h, size);
+    merge_sort(a + h * size, tmp, nb - h, size);
+    if (TIME_OF(a, size, h - 1) <= TIME_OF(a, size, h)) {
+        return; /* halves already in order */
+    }
+    memcpy(tmp, a, h * size);
+    while ((i < h) && (j < nb)) {
+        if (TIME_OF(a, size, j) < TIME_OF(tmp, size, i)) {
+            memcpy(a + (k++) * size, a + (j++) * size, size);
+        } else {
+            memcpy(a + (k++) * size, tmp + (i++) * size, size);
+        }
+    }
+    memcpy(a + k * size, tmp + i * size, (h - i) * size);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* logs are in time order but for a few late lines, most of the time nothing is to be done */
+static int sort_by_time(void *base, size_t nb, size_t size) {
+    char *tmp;
+    size_t i;
+
+    for (i = 1; (i < nb) && (TIME_OF(base, size, i - 1) <= TIME_OF(base, size, i)); ++i);
+    if (i >= nb) {
+        return 0;
+    }
+    tmp = malloc((nb / 2) * size);
+    if (tmp == NULL) {
+        return LOSS_NO_MATCH;
+    }
+    merge_sort(base, tmp, nb, size);
+    free(tmp);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* missing numbers count as off, like the fillna(10) and fillna(-10) of the scripts */
+static bool close_enough(int32_t rec, double sent) {
+    int64_t d;
+
+    if (isnan(sent)) {
+        sent = 10.0;
+    } else if (fabs(sent) > 1e9) {
+        return false;
+    }
+    d = (int64_t)rec - (int64_t)trunc(sent);
+    return (d >= -LOSS_DATA_TOL_MM) && (d <= LOSS_DATA_TOL_MM);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int loss_sort_rx(struct loss_rx_s *rx, size_t nb) {
+    return sort_by_time(rx, nb, sizeof *rx);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int loss_sort_flt(struct loss_flt_s *flt, size_t nb) {
+    return sort_by_time(flt, nb, sizeof *flt);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void loss_merge(const struct loss_flt_s *flt, size_t nb_flt, const struct loss_rx_s *rx, size_t nb_rx, double tolerance, int32_t *match) {
+    size_t i, j = 0, k;
+    double t, bdiff = 0.0, fdiff = 0.0;
+    int32_t b, f;
+
+    for (i = 0; i < nb_flt; ++i) {
+        t = flt[i].time;
+        /* j: first packet after the sample, j - 1 the last one at or before it */
+        while ((j < nb_rx) && (rx[j].time <= t)) {
+            ++j;
+        }
+        b = f = LOSS_NO_MATCH;
+        if ((j > 0) && ((bdiff = t - rx[j - 1].time) <= tolerance)) {
+            b = (int32_t)(j - 1);
+        }
+        /* packets at the same time as the sample are both before and after it */
+        for (k = j; (k > 0) && (rx[k - 1].time == t); --k);
+        if ((k < nb_rx) && ((fdiff = rx[k].time - t) <= tolerance)) {
+            f = (int32_t)k;
+        }
+        if ((b != LOSS_NO_MATCH) && (f != LOSS_NO_MATCH)) {
+            match[i] = (bdiff <= fdiff) ? b : f;
+        } else {
+            match[i] = (b != LOSS_NO_MATCH) ? b : f;
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool loss_data_correct(const struct loss_flt_s *f, const struct loss_rx_s *r) {
+    return close_enough(r->x, f->x) && close_enough(r->y, f->y) && close_enough(r->z, f->z);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void loss_evaluate(const struct loss_flt_s *flt, size_t nb_flt, const struct loss_rx_s *rx, const int32_t *match, struct loss_stats_s *stats) {
+    size_t i;
+
+    stats->attempted = nb_flt;
+    stats->delivered = 0;
+    stats->corrupted = 0;
+    for (i = 0; i < nb_flt; ++i) {
+        if (match[i] == LOSS_NO_MATCH) {
+            continue;
+        }
+        ++stats->delivered;
+        if (!loss_data_correct(&flt[i], &rx[match[i]])) {
+            ++stats->corrupted;
+        }
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
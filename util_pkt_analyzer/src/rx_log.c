@@ -0,0 +1,164 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Reader of the packet lines of receiver logs
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdlib.h>     /* malloc free */
+#include <string.h>     /* memchr */
+#include <math.h>       /* NAN */
+
+#include "rx_log.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define RX_FIELDS_MIN   6   /* #channel, stage, time in 1/10 s, x, y, z */
+#define RX_FIELDS_MAX   9   /* then lat, lon, and the receive UTC time */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static bool to_int32(const struct csv_field_s *fld, int32_t *v) {
+    int64_t x;
+
+    if (!csv_to_int(fld, &x) || (x < INT32_MIN) || (x > INT32_MAX)) {
+        return false;
+    }
+    *v = (int32_t)x;
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static double opt_double(const struct csv_field_s *fld, int i, int n) {
+    double v;
+
+    return ((i < n) && csv_to_double(&fld[i], &v)) ? v : NAN;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+bool rx_log_parse_line(const struct csv_field_s *line, struct rx_log_rec_s *rec) {
+    struct csv_field_s fld[RX_FIELDS_MAX], chan;
+    int n;
+
+    if ((line->len == 0) || (line->p[0] != '#')) {
+        return false;
+    }
+    n = csv_split(line, fld, RX_FIELDS_MAX);
+    if (n < RX_FIELDS_MIN) {
+        return false;
+    }
+    chan.p = fld[0].p + 1;
+    chan.len = fld[0].len - 1;
+    if (!to_int32(&chan, &rec->chan) || !to_int32(&fld[1], &rec->stage) || !csv_to_double(&fld[2], &rec->time)) {
+        return false;
+    }
+    if (!to_int32(&fld[3], &rec->x) || !to_int32(&fld[4], &rec->y) || !to_int32(&fld[5], &rec->z)) {
+        return false;
+    }
+    rec->time /= 10;
+    rec->lat = opt_double(fld, 6, n);
+    rec->lon = opt_double(fld, 7, n);
+    rec->utc = opt_double(fld, 8, n);
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+struct rx_log_s *rx_log_open(const char *path) {
+    struct rx_log_s *log;
+    const char *p, *end;
+
+    log = malloc(sizeof *log);
+    if (log == NULL) {
+        return NULL;
+    }
+    if (csv_open(&log->file, path) != CSV_TOK_SUCCESS) {
+        free(log);
+        return NULL;
+    }
+
+    /* lines starting with '#', to size the columns */
+    log->nb_lines = 0;
+    p = log->file.data;
+    end = p + log->file.size;
+    while (p < end) {
+        if (*p == '#') {
+            ++log->nb_lines;
+        }
+        p = memchr(p, '\n', (size_t)(end - p));
+        if (p == NULL) {
+            break;
+        }
+        ++p;
+    }
+    return log;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+long rx_log_lines(const struct rx_log_s *log) {
+    return log->nb_lines;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+long rx_log_fill(struct rx_log_s *log, long max, int64_t *chan, int64_t *stage, double *time, int64_t *x, int64_t *y, int64_t *z, double *lat, double *lon, double *utc, long *nb_bad) {
+    struct csv_field_s line;
+    struct rx_log_rec_s r;
+    long n = 0, bad = 0;
+
+    log->file.pos = log->file.data; /* may be filled again */
+    while ((n < max) && csv_next_line(&log->file, &line)) {
+        if ((line.len == 0) || (line.p[0] != '#')) {
+            continue;
+        }
+        if (!rx_log_parse_line(&line, &r)) {
+            ++bad;
+            continue;
+        }
+        if (chan != NULL) chan[n] = r.chan;
+        if (stage != NULL) stage[n] = r.stage;
+        if (time != NULL) time[n] = r.time;
+        if (x != NULL) x[n] = r.x;
+        if (y != NULL) y[n] = r.y;
+        if (z != NULL) z[n] = r.z;
+        if (lat != NULL) lat[n] = r.lat;
+        if (lon != NULL) lon[n] = r.lon;
+        if (utc != NULL) utc[n] = r.utc;
+        ++n;
+    }
+    if (nb_bad != NULL) {
+        *nb_bad = bad;
+    }
+    return n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void rx_log_close(struct rx_log_s *log) {
+    if (log != NULL) {
+        csv_close(&log->file);
+        free(log);
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,587 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Packet loss and corruption of a test run, from the receiver log and the
+    FLT files of the Spotters. Native counterpart of determine_packet_loss()
+    of the analysis scripts, with the same figures and the same CSV files,
+    one thread per channel.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf fprintf snprintf fopen fwrite */
+#include <stdlib.h>     /* atoi strtod llabs EXIT_FAILURE */
+#include <string.h>     /* strchr strrchr memcpy */
+#include <math.h>       /* isnan isinf signbit fabs llround NAN */
+#include <unistd.h>     /* getopt sysconf */
+#include <pthread.h>
+
+#include "csv_tok.h"
+#include "loss_merge.h"
+#include "rx_log.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
+#define MSG(args...)    fprintf(stderr,"util_pkt_analyzer: " args) /* message that is destined to the user */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define CHAN_NB         256         /* channel numbers of the receiver log */
+#define SPOTTER_MAX     64          /* FLT files of a run */
+#define FLT_FIELDS      6           /* millis, GPS time, x, y, z, flag */
+#define OUT_BUF_SIZE    (1 << 20)   /* stdio buffer of each CSV file */
+#define LINE_MAX_LEN    512
+
+static const char csv_header[] = "millis,GPS_Epoch_Time(s),outx(mm),outy(mm),outz(mm),flag,channel_number,signal_stage,rec_epoch_time,rec_outx,rec_outy,rec_outz,packet_delivered,packet_data_correct\n";
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+enum flt_col_e {COL_MILLIS, COL_TIME, COL_X, COL_Y, COL_Z, COL_NB};
+
+struct rx_chan_s {
+    struct loss_rx_s    *pkt;
+    size_t              nb;
+    size_t              size;
+};
+
+struct job_s {
+    int                 channel;
+    const char          *flt_path;
+    struct rx_chan_s    *rx;            /* packets received on the channel, sorted by the job */
+    int                 status;
+    size_t              nb_rows;        /* rows of the FLT file, incomplete ones included */
+    size_t              nb_bad;         /* lines with too many fields, skipped */
+    bool                int_col[COL_NB];/* columns of integers only, printed without decimals */
+    struct loss_stats_s stats;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
+
+static struct rx_chan_s rxchan[CHAN_NB];
+static bool chan_used[CHAN_NB];
+
+static struct job_s jobs[SPOTTER_MAX];
+static int nb_jobs = 0;
+static int next_job = 0; /* taken by the worker threads */
+
+static double tolerance = LOSS_TOLERANCE_S;
+static const char *out_dir = ".";
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+void usage (void);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+void usage(void) {
+    printf( "Available options:\n");
+    printf( " -h print this help\n");
+    printf( " -r <path> receiver log, as written by the example client\n");
+    printf( " -s <int>:<path> channel number and FLT file of a Spotter, once per Spotter\n");
+    printf( " -t <float> largest time difference of a delivered packet, in seconds (default %.1f)\n", LOSS_TOLERANCE_S);
+    printf( " -o <path> directory of the CSV files (default current directory)\n");
+    printf( " -j <int> number of threads (default number of CPUs)\n");
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* integer in decimal, with a point before its last 'dec' digits, "-0.5" for -5 and 1 decimal */
+static int fmt_fixed(char *buf, long long n, int dec) {
+    char tmp[24];
+    int i = 0, len = 0;
+    unsigned long long u = (n < 0) ? 0ULL - (unsigned long long)n : (unsigned long long)n;
+
+    do {
+        tmp[i++] = (char)('0' + u % 10);
+        u /= 10;
+    } while ((u != 0) || (i <= dec));
+    if (n < 0) {
+        buf[len++] = '-';
+    }
+    while (i > dec) {
+        buf[len++] = tmp[--i];
+    }
+    buf[len++] = '.';
+    if (dec == 0) {
+        buf[len++] = '0';
+    }
+    while (i > 0) {
+        buf[len++] = tmp[--i];
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* shortest text reading back as the same number, in the format of Python repr() */
+static int fmt_repr(char *buf, size_t size, double v) {
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+    char tmp[32];
+    int lo = 1, hi = 17, p, e;
+    long long n;
+
+    if (isnan(v)) {
+        return snprintf(buf, size, "nan");
+    } else if (isinf(v)) {
+        return snprintf(buf, size, (v < 0) ? "-inf" : "inf");
+    } else if (v == 0.0) {
+        return snprintf(buf, size, signbit(v) ? "-0.0" : "0.0");
+    }
+
+    /* up to 15 digits, distinct decimals read back as distinct numbers: the fewest decimals reading back is the shortest text */
+    if ((fabs(v) >= 1e-4) && (fabs(v) < 1e15) && (size >= 24)) {
+        for (p = 0; p < (int)ARRAY_SIZE(pow10); ++p) {
+            n = llround(v * pow10[p]);
+            if (llabs(n) >= 1000000000000000LL) {
+                break;
+            } else if ((double)n / pow10[p] == v) {
+                return fmt_fixed(buf, n, p);
+            }
+        }
+    }
+
+    while (lo < hi) { /* if p digits read back, so do p + 1 */
+        p = (lo + hi) / 2;
+        snprintf(tmp, sizeof tmp, "%.*e", p - 1, v);
+        if (strtod(tmp, NULL) == v) {
+            hi = p;
+        } else {
+            lo = p + 1;
+        }
+    }
+    snprintf(tmp, sizeof tmp, "%.*e", lo - 1, v);
+    e = atoi(strchr(tmp, 'e') + 1);
+    if ((e < -4) || (e >= 16)) {
+        return snprintf(buf, size, "%s", tmp);
+    } else if (lo - 1 - e > 0) {
+        return snprintf(buf, size, "%.*f", lo - 1 - e, v);
+    } else {
+        return snprintf(buf, size, "%.0f.0", v);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* number of the FLT file, nothing if missing, as pandas writes it */
+static int fmt_num(char *buf, size_t size, double v, bool int_col) {
+    if (isnan(v)) {
+        return snprintf(buf, size, "%s", "");
+    } else if (int_col) {
+        return snprintf(buf, size, "%lld", (long long)v);
+    } else {
+        return fmt_repr(buf, size, v);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int parse_receiver(const char *path, size_t *nb_parsed, size_t *nb_bad) {
+    struct csv_file_s f;
+    struct csv_field_s line;
+    struct rx_log_rec_s rec;
+    struct rx_chan_s *rc;
+    struct loss_rx_s *p;
+
+    if (csv_open(&f, path) != CSV_TOK_SUCCESS) {
+        MSG("ERROR: impossible to open receiver log %s\n", path);
+        return -1;
+    }
+    *nb_parsed = *nb_bad = 0;
+    while (csv_next_line(&f, &line)) {
+        if ((line.len == 0) || (line.p[0] != '#')) {
+            continue; /* connection and '$' status lines */
+        }
+        if (!rx_log_parse_line(&line, &rec)) {
+            ++*nb_bad;
+            continue;
+        }
+        ++*nb_parsed;
+        if ((rec.chan < 0) || (rec.chan >= CHAN_NB) || !chan_used[rec.chan]) {
+            continue;
+        }
+        rc = &rxchan[rec.chan];
+        if (rc->nb == rc->size) {
+            rc->size = (rc->size == 0) ? 4096 : 2 * rc->size;
+            p = realloc(rc->pkt, rc->size * sizeof *p);
+            if (p == NULL) {
+                MSG("ERROR: out of memory\n");
+                csv_close(&f);
+                return -1;
+            }
+            rc->pkt = p;
+        }
+        p = &rc->pkt[rc->nb++];
+        p->time = rec.time;
+        p->stage = rec.stage;
+        p->x = rec.x;
+        p->y = rec.y;
+        p->z = rec.z;
+    }
+    csv_close(&f);
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* samples with a time and a vertical displacement, the last line may be truncated */
+static struct loss_flt_s *load_flt(struct job_s *job, struct csv_file_s *f, size_t *nb) {
+    struct csv_field_s line, fld[FLT_FIELDS];
+    struct loss_flt_s *flt = NULL, *p;
+    double v[COL_NB];
+    int64_t iv;
+    size_t size = 0;
+    bool header = true;
+    int i, n;
+
+    *nb = 0;
+    for (i = 0; i < COL_NB; ++i) {
+        job->int_col[i] = true;
+    }
+    while (csv_next_line(f, &line)) {
+        if (line.len == 0) {
+            continue;
+        } else if (header) {
+            header = false;
+            continue;
+        }
+        n = csv_split(&line, fld, FLT_FIELDS);
+        if (n > FLT_FIELDS) {
+            ++job->nb_bad;
+            continue;
+        }
+        ++job->nb_rows;
+        for (i = 0; i < COL_NB; ++i) {
+            if ((i >= n) || !csv_to_double(&fld[i], &v[i])) {
+                v[i] = NAN;
+                job->int_col[i] = false;
+            } else if (job->int_col[i] && !csv_to_int(&fld[i], &iv)) {
+                job->int_col[i] = false;
+            }
+        }
+        if (isnan(v[COL_TIME]) || isnan(v[COL_Z])) {
+            continue;
+        }
+        if (*nb == size) {
+            size = (size == 0) ? 4096 : 2 * size;
+            p = realloc(flt, size * sizeof *p);
+            if (p == NULL) {
+                free(flt);
+                return NULL;
+            }
+            flt = p;
+        }
+        p = &flt[(*nb)++];
+        p->time = v[COL_TIME];
+        p->x = v[COL_X];
+        p->y = v[COL_Y];
+        p->z = v[COL_Z];
+        p->millis = v[COL_MILLIS];
+        p->flag = (n > COL_NB) ? fld[COL_NB].p : NULL;
+        p->flag_len = (n > COL_NB) ? (uint32_t)fld[COL_NB].len : 0;
+    }
+    if (flt == NULL) {
+        flt = malloc(sizeof *flt); /* no sample, not an error */
+    }
+    return flt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static FILE *open_csv(int channel, const char *kind) {
+    char path[1024];
+    FILE *out;
+
+    snprintf(path, sizeof path, "%s/channel_%d_packets_%s.csv", out_dir, channel, kind);
+    out = fopen(path, "w");
+    if (out == NULL) {
+        MSG("ERROR: impossible to create %s\n", path);
+        return NULL;
+    }
+    setvbuf(out, NULL, _IOFBF, OUT_BUF_SIZE);
+    fputs(csv_header, out);
+    return out;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* all samples, the lost ones and the corrupted ones, columns of the merged dataframe of the scripts */
+static int write_csv(const struct job_s *job, const struct loss_flt_s *flt, size_t nb, const int32_t *match) {
+    const char *kind[3] = {"all", "lost", "corrupted"};
+    FILE *out[3];
+    char buf[LINE_MAX_LEN];
+    const struct loss_rx_s *r;
+    bool any_lost, correct;
+    size_t i, len;
+    int k, err = 0;
+
+    for (k = 0; k < 3; ++k) {
+        out[k] = open_csv(job->channel, kind[k]);
+        if (out[k] == NULL) {
+            while (k-- > 0) {
+                fclose(out[k]);
+            }
+            return -1;
+        }
+    }
+
+    /* a single lost sample turns the received columns into floating point ones */
+    any_lost = (job->stats.delivered < nb);
+
+    for (i = 0; i < nb; ++i) {
+        len = 0;
+        len += fmt_num(buf + len, sizeof buf - len, flt[i].millis, job->int_col[COL_MILLIS]);
+        buf[len++] = ',';
+        len += fmt_num(buf + len, sizeof buf - len, flt[i].time, job->int_col[COL_TIME]);
+        buf[len++] = ',';
+        len += fmt_num(buf + len, sizeof buf - len, flt[i].x, job->int_col[COL_X]);
+        buf[len++] = ',';
+        len += fmt_num(buf + len, sizeof buf - len, flt[i].y, job->int_col[COL_Y]);
+        buf[len++] = ',';
+        len += fmt_num(buf + len, sizeof buf - len, flt[i].z, job->int_col[COL_Z]);
+        buf[len++] = ',';
+        if (flt[i].flag_len > sizeof buf / 2) {
+            err = -1;
+            break;
+        }
+        memcpy(buf + len, flt[i].flag, flt[i].flag_len);
+        len += flt[i].flag_len;
+        len += snprintf(buf + len, sizeof buf - len, ",%d,", job->channel);
+        if (match[i] == LOSS_NO_MATCH) {
+            correct = false;
+            len += snprintf(buf + len, sizeof buf - len, ",,,,,False,False\n");
+        } else {
+            r = &job->rx->pkt[match[i]];
+            correct = loss_data_correct(&flt[i], r);
+            len += snprintf(buf + len, sizeof buf - len, any_lost ? "%d.0," : "%d,", r->stage);
+            len += fmt_repr(buf + len, sizeof buf - len, r->time);
+            len += snprintf(buf + len, sizeof buf - len, any_lost ? ",%d.0,%d.0,%d.0,True,%s\n" : ",%d,%d,%d,True,%s\n", r->x, r->y, r->z, correct ? "True" : "False");
+        }
+        fwrite(buf, 1, len, out[0]);
+        if (match[i] == LOSS_NO_MATCH) {
+            fwrite(buf, 1, len, out[1]);
+        } else if (!correct) {
+            fwrite(buf, 1, len, out[2]);
+        }
+    }
+
+    for (k = 0; k < 3; ++k) {
+        if (ferror(out[k]) || (fclose(out[k]) != 0)) {
+            MSG("ERROR: failed to write the %s packets of channel %d\n", kind[k], job->channel);
+            err = -1;
+        }
+    }
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int run_job(struct job_s *job) {
+    struct csv_file_s f;
+    struct loss_flt_s *flt;
+    int32_t *match;
+    size_t nb;
+    int err = 0;
+
+    if (csv_open(&f, job->flt_path) != CSV_TOK_SUCCESS) {
+        MSG("ERROR: impossible to open FLT file %s\n", job->flt_path);
+        return -1;
+    }
+    flt = load_flt(job, &f, &nb);
+    match = malloc((nb + 1) * sizeof *match);
+    if ((flt == NULL) || (match == NULL) || (loss_sort_flt(flt, nb) != 0) || (loss_sort_rx(job->rx->pkt, job->rx->nb) != 0)) {
+        MSG("ERROR: out of memory for channel %d\n", job->channel);
+        err = -1;
+    } else {
+        loss_merge(flt, nb, job->rx->pkt, job->rx->nb, tolerance, match);
+        loss_evaluate(flt, nb, job->rx->pkt, match, &job->stats);
+        err = write_csv(job, flt, nb, match); /* flags still point into the mapped file */
+    }
+    free(match);
+    free(flt);
+    csv_close(&f);
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void *thread_job(void *arg) {
+    int i;
+
+    (void)arg;
+    while ((i = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED)) < nb_jobs) {
+        jobs[i].status = run_job(&jobs[i]);
+    }
+    return NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* rate of the scripts, printed with Python's '.2%' format */
+static void print_rate(const char *what, int channel, size_t num, size_t den, size_t count, size_t total) {
+    double rate = 1.0 - (double)num / (double)den;
+
+    if (isnan(rate)) {
+        printf("Channel %d packet %s rate: nan%% (%zu of %zu)\n", channel, what, count, total);
+    } else {
+        printf("Channel %d packet %s rate: %.2f%% (%zu of %zu)\n", channel, what, rate * 100, count, total);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    int i, ch;
+    char *sep;
+    const char *rx_path = NULL;
+    long nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_t thrid[SPOTTER_MAX];
+    size_t nb_parsed, nb_bad;
+    struct loss_stats_s *s;
+    int ret = EXIT_SUCCESS;
+
+    /* parse command line options */
+    while ((i = getopt (argc, argv, "hr:s:t:o:j:")) != -1) {
+        switch (i) {
+            case 'h':
+                usage();
+                return EXIT_FAILURE;
+                break;
+
+            case 'r':
+                rx_path = optarg;
+                break;
+
+            case 's':
+                sep = strchr(optarg, ':');
+                ch = atoi(optarg);
+                if ((sep == NULL) || (ch < 0) || (ch >= CHAN_NB) || (nb_jobs >= SPOTTER_MAX)) {
+                    MSG("ERROR: Invalid argument for -s option\n");
+                    return EXIT_FAILURE;
+                } else if (chan_used[ch]) {
+                    MSG("ERROR: channel %d given twice\n", ch);
+                    return EXIT_FAILURE;
+                }
+                chan_used[ch] = true;
+                jobs[nb_jobs].channel = ch;
+                jobs[nb_jobs].flt_path = sep + 1;
+                jobs[nb_jobs].rx = &rxchan[ch];
+                ++nb_jobs;
+                break;
+
+            case 't':
+                tolerance = strtod(optarg, NULL);
+                if (!(tolerance >= 0)) {
+                    MSG("ERROR: Invalid argument for -t option\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'o':
+                out_dir = optarg;
+                break;
+
+            case 'j':
+                nb_threads = atoi(optarg);
+                if (nb_threads < 1) {
+                    MSG("ERROR: Invalid argument for -j option\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            default:
+                MSG("ERROR: argument parsing use -h option for help\n");
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+    if ((rx_path == NULL) || (nb_jobs == 0)) {
+        MSG("ERROR: a receiver log and at least one FLT file are needed\n");
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    /* one pass over the receiver log, packets split by channel */
+    printf("Parsing receiver data...\n");
+    if (parse_receiver(rx_path, &nb_parsed, &nb_bad) != 0) {
+        return EXIT_FAILURE;
+    }
+    printf("\tParsed %zu packets\n", nb_parsed);
+    if (nb_bad > 0) {
+        MSG("WARNING: %zu malformed lines of the receiver log skipped\n", nb_bad);
+    }
+
+    /* channels are independent, each one is loaded, matched and written by a single thread */
+    printf("Parsing Spotter data from %d Spotters...\n", nb_jobs);
+    fflush(stdout);
+    if (nb_threads > nb_jobs) {
+        nb_threads = nb_jobs;
+    } else if (nb_threads < 1) {
+        nb_threads = 1;
+    }
+    for (i = 0; i < nb_threads; ++i) {
+        if (pthread_create(&thrid[i], NULL, thread_job, NULL) != 0) {
+            MSG("ERROR: impossible to create worker thread\n");
+            break;
+        }
+    }
+    if (i == 0) {
+        thread_job(NULL);
+    }
+    while (i-- > 0) {
+        pthread_join(thrid[i], NULL);
+    }
+
+    for (i = 0; i < nb_jobs; ++i) {
+        printf("%d: %zu packets\n", jobs[i].channel, jobs[i].nb_rows);
+        if (jobs[i].nb_bad > 0) {
+            MSG("WARNING: %zu lines with too many fields skipped in %s\n", jobs[i].nb_bad, jobs[i].flt_path);
+        }
+    }
+    for (i = 0; i < nb_jobs; ++i) {
+        printf("Evaluating performance for channel %d...\n", jobs[i].channel);
+        if (jobs[i].status != 0) {
+            ret = EXIT_FAILURE;
+            continue;
+        }
+        s = &jobs[i].stats;
+        print_rate("loss", jobs[i].channel, s->delivered, s->attempted, s->attempted - s->delivered, s->attempted);
+        print_rate("corruption", jobs[i].channel, s->delivered - s->corrupted, s->delivered, s->corrupted, s->attempted);
+    }
+
+    for (i = 0; i < CHAN_NB; ++i) {
+        free(rxchan[i].pkt);
+    }
+    return ret;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,256 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check the single pass nearest match against a search of every packet
+    for every sample, on random streams with late lines and duplicate
+    times, then check the tokenizer on a file with a truncated last line
+    and the parser of the receiver log lines.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>     /* rand */
+#include <string.h>     /* strlen */
+#include <math.h>       /* NAN */
+#include <time.h>       /* clock_gettime */
+#include <unistd.h>     /* write close unlink */
+
+#include "csv_tok.h"
+#include "loss_merge.h"
+#include "rx_log.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_RUN          200
+#define NB_FLT          500
+#define NB_RX           450
+#define NB_BIG          2000000
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct loss_flt_s flt[NB_FLT];
+static struct loss_rx_s rx[NB_RX];
+static int32_t match[NB_FLT];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static double elapsed_ns(struct timespec *t0, struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+/* times on a 1/10 s grid, a few out of order or repeated, like the logs */
+static double grid_time(int i) {
+    int k = i + (((rand() % 16) == 0) ? (rand() % 5) - 2 : 0);
+    return 1712696101.0 + k / 10.0 + (((rand() % 4) == 0) ? 0.01 * (rand() % 9) : 0.0);
+}
+
+/* the merge_asof rule: last packet at or before, first at or after, the one before on a tie */
+static int32_t reference(double t, double tolerance) {
+    int32_t b = LOSS_NO_MATCH, f = LOSS_NO_MATCH;
+    int j;
+
+    for (j = 0; j < NB_RX; ++j) {
+        if ((rx[j].time <= t) && (t - rx[j].time <= tolerance)) {
+            b = j;
+        }
+        if ((rx[j].time >= t) && (rx[j].time - t <= tolerance) && (f == LOSS_NO_MATCH)) {
+            f = j;
+        }
+    }
+    if ((b != LOSS_NO_MATCH) && (f != LOSS_NO_MATCH)) {
+        return ((t - rx[b].time) <= (rx[f].time - t)) ? b : f;
+    }
+    return (b != LOSS_NO_MATCH) ? b : f;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    int i, run, nb_err = 0;
+    const char text[] = "millis,GPS_Epoch_Time(s),outx(mm),outy(mm),outz(mm)\r\n"
+                        "24335, 1712696101.01,0.00,-1.5,2,I\n"
+                        "\n"
+                        "24600,1712696101.40,x,,7\n"
+                        "24800,17126961";
+    char path[] = "/tmp/test_loss_mergeXXXXXX";
+    struct csv_file_s f;
+    struct csv_field_s line, fld[6];
+    struct loss_flt_s *big_flt;
+    struct loss_rx_s *big_rx;
+    int32_t *big_match;
+    struct loss_stats_s stats;
+    struct rx_log_rec_s rec;
+    struct timespec t0, t1;
+    double v;
+    int64_t iv;
+    int fd, n;
+
+    /* merge, against the reference, on sorted copies of random streams */
+    srand(1);
+    for (run = 0; run < NB_RUN; ++run) {
+        for (i = 0; i < NB_FLT; ++i) {
+            flt[i].time = grid_time(i);
+            flt[i].x = flt[i].y = flt[i].z = (double)(rand() % 5) - 2.5;
+        }
+        for (i = 0; i < NB_RX; ++i) {
+            rx[i].time = grid_time(i + (rand() % 20));
+            rx[i].x = rx[i].y = rx[i].z = i; /* tells duplicates apart */
+        }
+        loss_sort_flt(flt, NB_FLT);
+        loss_sort_rx(rx, NB_RX);
+        for (i = 1; i < NB_RX; ++i) {
+            if ((rx[i - 1].time > rx[i].time) || ((rx[i - 1].time == rx[i].time) && (rx[i - 1].x > rx[i].x))) {
+                printf("ERROR: run %d, packets %d and %d out of order\n", run, i - 1, i);
+                ++nb_err;
+            }
+        }
+        loss_merge(flt, NB_FLT, rx, NB_RX, LOSS_TOLERANCE_S, match);
+        for (i = 0; i < NB_FLT; ++i) {
+            if (match[i] != reference(flt[i].time, LOSS_TOLERANCE_S)) {
+                printf("ERROR: run %d, sample %d at %.2f matched %d instead of %d\n", run, i, flt[i].time, match[i], reference(flt[i].time, LOSS_TOLERANCE_S));
+                ++nb_err;
+            }
+        }
+    }
+    printf("%d random runs of %d samples merged\n", NB_RUN, NB_FLT);
+
+    /* data check, truncation toward zero and missing numbers */
+    flt[0].x = -1.9; flt[0].y = 2.9; flt[0].z = 0.5;
+    rx[0].x = 0; rx[0].y = 3; rx[0].z = -1;
+    if (!loss_data_correct(&flt[0], &rx[0])) {
+        printf("ERROR: data within 1 mm reported corrupted\n");
+        ++nb_err;
+    }
+    rx[0].y = 4;
+    if (loss_data_correct(&flt[0], &rx[0])) {
+        printf("ERROR: data 2 mm off reported correct\n");
+        ++nb_err;
+    }
+    rx[0].y = 10;
+    flt[0].y = NAN;
+    if (!loss_data_correct(&flt[0], &rx[0])) {
+        printf("ERROR: missing number not taken as 10\n");
+        ++nb_err;
+    }
+
+    /* tokenizer */
+    fd = mkstemp(path);
+    if ((fd < 0) || (write(fd, text, strlen(text)) != (ssize_t)strlen(text))) {
+        printf("ERROR: impossible to write %s\n", path);
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    csv_open(&f, path);
+    n = 0;
+    while (csv_next_line(&f, &line)) {
+        ++n;
+        if ((n == 1) && (line.len != strlen("millis,GPS_Epoch_Time(s),outx(mm),outy(mm),outz(mm)"))) {
+            printf("ERROR: line ending kept\n");
+            ++nb_err;
+        } else if ((n == 2) && ((csv_split(&line, fld, 6) != 6) || !csv_to_double(&fld[1], &v) || (v != 1712696101.01) || !csv_to_int(&fld[0], &iv) || (iv != 24335) || csv_to_int(&fld[2], &iv) || (fld[5].len != 1))) {
+            printf("ERROR: complete line wrongly split or converted\n");
+            ++nb_err;
+        } else if ((n == 4) && ((csv_split(&line, fld, 6) != 5) || csv_to_double(&fld[2], &v) || csv_to_double(&fld[3], &v))) {
+            printf("ERROR: missing numbers converted\n");
+            ++nb_err;
+        } else if ((n == 5) && ((csv_split(&line, fld, 6) != 2) || !csv_to_int(&fld[1], &iv) || (iv != 17126961))) {
+            printf("ERROR: truncated last line wrongly split\n");
+            ++nb_err;
+        }
+    }
+    if (n != 5) {
+        printf("ERROR: %d lines instead of 5\n", n);
+        ++nb_err;
+    }
+    csv_close(&f);
+    unlink(path);
+
+    /* receiver log lines, optional position and receive time */
+    line.p = "#2,2,17126961014,-695,743,-16";
+    line.len = strlen(line.p);
+    if (!rx_log_parse_line(&line, &rec) || (rec.chan != 2) || (rec.time != 1712696101.4) || (rec.x != -695) || (rec.z != -16) || !isnan(rec.lat) || !isnan(rec.utc)) {
+        printf("ERROR: packet line wrongly parsed\n");
+        ++nb_err;
+    }
+    line.p = "#11,1,17126961020,1,2,3,45.500000000,-1.250000000,1712696102.003141";
+    line.len = strlen(line.p);
+    if (!rx_log_parse_line(&line, &rec) || (rec.chan != 11) || (rec.lat != 45.5) || (rec.lon != -1.25) || (rec.utc != 1712696102.003141)) {
+        printf("ERROR: packet line with position wrongly parsed\n");
+        ++nb_err;
+    }
+    line.p = "#2,2,17126961014,-695,743";
+    line.len = strlen(line.p);
+    if (rx_log_parse_line(&line, &rec)) {
+        printf("ERROR: truncated packet line parsed\n");
+        ++nb_err;
+    }
+    line.p = "$STAT,1712696102";
+    line.len = strlen(line.p);
+    if (rx_log_parse_line(&line, &rec)) {
+        printf("ERROR: status line parsed as a packet\n");
+        ++nb_err;
+    }
+
+    /* throughput of a multi-day run, one sample every 0.4 s with 1% lost */
+    big_flt = malloc(NB_BIG * sizeof *big_flt);
+    big_rx = malloc(NB_BIG * sizeof *big_rx);
+    big_match = malloc(NB_BIG * sizeof *big_match);
+    if ((big_flt == NULL) || (big_rx == NULL) || (big_match == NULL)) {
+        printf("ERROR: out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for (i = 0, n = 0; i < NB_BIG; ++i) {
+        big_flt[i].time = 1712696101.0 + 0.4 * i;
+        big_flt[i].x = big_flt[i].y = big_flt[i].z = 1.5;
+        if ((rand() % 100) != 0) {
+            big_rx[n].time = big_flt[i].time + 0.01 * (rand() % 3);
+            big_rx[n].x = big_rx[n].y = big_rx[n].z = 1;
+            ++n;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    loss_sort_flt(big_flt, NB_BIG);
+    loss_sort_rx(big_rx, n);
+    loss_merge(big_flt, NB_BIG, big_rx, n, LOSS_TOLERANCE_S, big_match);
+    loss_evaluate(big_flt, NB_BIG, big_rx, big_match, &stats);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if ((stats.delivered != (size_t)n) || (stats.corrupted != 0)) {
+        printf("ERROR: %zu delivered and %zu corrupted instead of %d and 0\n", stats.delivered, stats.corrupted, n);
+        ++nb_err;
+    }
+    printf("%d samples matched with %d packets in %.1f ms (%.1f ns per sample)\n", NB_BIG, n, elapsed_ns(&t0, &t1) / 1e6, elapsed_ns(&t0, &t1) / NB_BIG);
+    free(big_flt);
+    free(big_rx);
+    free(big_match);
+
+    printf("%s: %d error(s)\n", (nb_err == 0) ? "PASS" : "FAIL", nb_err);
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
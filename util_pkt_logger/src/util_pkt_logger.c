@@ -34,7 +34,7 @@ Maintainer: Sylvain Miermont
 #include <unistd.h>     /* getopt access */
 #include <stdlib.h>     /* atoi */
 
-#include "parson.h"
+#include "gw_conf.h"
 #include "loragw_hal.h"
 
 /* -------------------------------------------------------------------------- */
@@ -66,10 +66,6 @@ char log_file_name[64];
 
 static void sig_handler(int sigio);
 
-int parse_SX1301_configuration(const char * conf_file);
-
-int parse_gateway_configuration(const char * conf_file);
-
 void open_log(void);
 
 void usage (void);
@@ -85,261 +81,6 @@ static void sig_handler(int sigio) {
     }
 }
 
-int parse_SX1301_configuration(const char * conf_file) {
-    int i;
-    const char conf_obj[] = "SX1301_conf";
-    char param_name[32]; /* used to generate variable parameter names */
-    const char *str; /* used to store string value from JSON object */
-    struct lgw_conf_board_s boardconf;
-    struct lgw_conf_rxrf_s rfconf;
-    struct lgw_conf_rxif_s ifconf;
-    JSON_Value *root_val;
-    JSON_Object *root = NULL;
-    JSON_Object *conf = NULL;
-    JSON_Value *val;
-    uint32_t sf, bw;
-
-    /* try to parse JSON */
-    root_val = json_parse_file_with_comments(conf_file);
-    root = json_value_get_object(root_val);
-    if (root == NULL) {
-        MSG("ERROR: %s id not a valid JSON file\n", conf_file);
-        exit(EXIT_FAILURE);
-    }
-    conf = json_object_get_object(root, conf_obj);
-    if (conf == NULL) {
-        MSG("INFO: %s does not contain a JSON object named %s\n", conf_file, conf_obj);
-        return -1;
-    } else {
-        MSG("INFO: %s does contain a JSON object named %s, parsing SX1301 parameters\n", conf_file, conf_obj);
-    }
-
-    /* set board configuration */
-    memset(&boardconf, 0, sizeof boardconf); /* initialize configuration structure */
-    val = json_object_get_value(conf, "lorawan_public"); /* fetch value (if possible) */
-    if (json_value_get_type(val) == JSONBoolean) {
-        boardconf.lorawan_public = (bool)json_value_get_boolean(val);
-    } else {
-        MSG("WARNING: Data type for lorawan_public seems wrong, please check\n");
-        boardconf.lorawan_public = false;
-    }
-    val = json_object_get_value(conf, "clksrc"); /* fetch value (if possible) */
-    if (json_value_get_type(val) == JSONNumber) {
-        boardconf.clksrc = (uint8_t)json_value_get_number(val);
-    } else {
-        MSG("WARNING: Data type for clksrc seems wrong, please check\n");
-        boardconf.clksrc = 0;
-    }
-    MSG("INFO: lorawan_public %d, clksrc %d\n", boardconf.lorawan_public, boardconf.clksrc);
-    /* all parameters parsed, submitting configuration to the HAL */
-    if (lgw_board_setconf(boardconf) != LGW_HAL_SUCCESS) {
-        MSG("ERROR: Failed to configure board\n");
-        return -1;
-    }
-
-    /* set configuration for RF chains */
-    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
-        memset(&rfconf, 0, sizeof(rfconf)); /* initialize configuration structure */
-        sprintf(param_name, "radio_%i", i); /* compose parameter path inside JSON structure */
-        val = json_object_get_value(conf, param_name); /* fetch value (if possible) */
-        if (json_value_get_type(val) != JSONObject) {
-            MSG("INFO: no configuration for radio %i\n", i);
-            continue;
-        }
-        /* there is an object to configure that radio, let's parse it */
-        sprintf(param_name, "radio_%i.enable", i);
-        val = json_object_dotget_value(conf, param_name);
-        if (json_value_get_type(val) == JSONBoolean) {
-            rfconf.enable = (bool)json_value_get_boolean(val);
-        } else {
-            rfconf.enable = false;
-        }
-        if (rfconf.enable == false) { /* radio disabled, nothing else to parse */
-            MSG("INFO: radio %i disabled\n", i);
-        } else  { /* radio enabled, will parse the other parameters */
-            snprintf(param_name, sizeof param_name, "radio_%i.freq", i);
-            rfconf.freq_hz = (uint32_t)json_object_dotget_number(conf, param_name);
-            snprintf(param_name, sizeof param_name, "radio_%i.rssi_offset", i);
-            rfconf.rssi_offset = (float)json_object_dotget_number(conf, param_name);
-            snprintf(param_name, sizeof param_name, "radio_%i.type", i);
-            str = json_object_dotget_string(conf, param_name);
-            if (!strncmp(str, "SX1255", 6)) {
-                rfconf.type = LGW_RADIO_TYPE_SX1255;
-            } else if (!strncmp(str, "SX1257", 6)) {
-                rfconf.type = LGW_RADIO_TYPE_SX1257;
-            } else {
-                MSG("WARNING: invalid radio type: %s (should be SX1255 or SX1257)\n", str);
-            }
-            snprintf(param_name, sizeof param_name, "radio_%i.tx_enable", i);
-            val = json_object_dotget_value(conf, param_name);
-            if (json_value_get_type(val) == JSONBoolean) {
-                rfconf.tx_enable = (bool)json_value_get_boolean(val);
-                if (rfconf.tx_enable == true) {
-                    /* tx notch filter frequency to be set */
-                    snprintf(param_name, sizeof param_name, "radio_%i.tx_notch_freq", i);
-                    rfconf.tx_notch_freq = (uint32_t)json_object_dotget_number(conf, param_name);
-                }
-            } else {
-                rfconf.tx_enable = false;
-            }
-            MSG("INFO: radio %i enabled (type %s), center frequency %u, RSSI offset %f, tx enabled %d, tx_notch_freq %u\n", i, str, rfconf.freq_hz, rfconf.rssi_offset, rfconf.tx_enable, rfconf.tx_notch_freq);
-        }
-        /* all parameters parsed, submitting configuration to the HAL */
-        if (lgw_rxrf_setconf(i, rfconf) != LGW_HAL_SUCCESS) {
-            MSG("ERROR: invalid configuration for radio %i\n", i);
-            return -1;
-        }
-    }
-
-    /* set configuration for LoRa multi-SF channels (bandwidth cannot be set) */
-    for (i = 0; i < LGW_MULTI_NB; ++i) {
-        memset(&ifconf, 0, sizeof(ifconf)); /* initialize configuration structure */
-        sprintf(param_name, "chan_multiSF_%i", i); /* compose parameter path inside JSON structure */
-        val = json_object_get_value(conf, param_name); /* fetch value (if possible) */
-        if (json_value_get_type(val) != JSONObject) {
-            MSG("INFO: no configuration for LoRa multi-SF channel %i\n", i);
-            continue;
-        }
-        /* there is an object to configure that LoRa multi-SF channel, let's parse it */
-        sprintf(param_name, "chan_multiSF_%i.enable", i);
-        val = json_object_dotget_value(conf, param_name);
-        if (json_value_get_type(val) == JSONBoolean) {
-            ifconf.enable = (bool)json_value_get_boolean(val);
-        } else {
-            ifconf.enable = false;
-        }
-        if (ifconf.enable == false) { /* LoRa multi-SF channel disabled, nothing else to parse */
-            MSG("INFO: LoRa multi-SF channel %i disabled\n", i);
-        } else  { /* LoRa multi-SF channel enabled, will parse the other parameters */
-            sprintf(param_name, "chan_multiSF_%i.radio", i);
-            ifconf.rf_chain = (uint32_t)json_object_dotget_number(conf, param_name);
-            sprintf(param_name, "chan_multiSF_%i.if", i);
-            ifconf.freq_hz = (int32_t)json_object_dotget_number(conf, param_name);
-            // TODO: handle individual SF enabling and disabling (spread_factor)
-            MSG("INFO: LoRa multi-SF channel %i enabled, radio %i selected, IF %i Hz, 125 kHz bandwidth, SF 7 to 12\n", i, ifconf.rf_chain, ifconf.freq_hz);
-        }
-        /* all parameters parsed, submitting configuration to the HAL */
-        if (lgw_rxif_setconf(i, ifconf) != LGW_HAL_SUCCESS) {
-            MSG("ERROR: invalid configuration for Lora multi-SF channel %i\n", i);
-            return -1;
-        }
-    }
-
-    /* set configuration for LoRa standard channel */
-    memset(&ifconf, 0, sizeof(ifconf)); /* initialize configuration structure */
-    val = json_object_get_value(conf, "chan_Lora_std"); /* fetch value (if possible) */
-    if (json_value_get_type(val) != JSONObject) {
-        MSG("INFO: no configuration for LoRa standard channel\n");
-    } else {
-        val = json_object_dotget_value(conf, "chan_Lora_std.enable");
-        if (json_value_get_type(val) == JSONBoolean) {
-            ifconf.enable = (bool)json_value_get_boolean(val);
-        } else {
-            ifconf.enable = false;
-        }
-        if (ifconf.enable == false) {
-            MSG("INFO: LoRa standard channel %i disabled\n", i);
-        } else  {
-            ifconf.rf_chain = (uint32_t)json_object_dotget_number(conf, "chan_Lora_std.radio");
-            ifconf.freq_hz = (int32_t)json_object_dotget_number(conf, "chan_Lora_std.if");
-            bw = (uint32_t)json_object_dotget_number(conf, "chan_Lora_std.bandwidth");
-            switch(bw) {
-                case 500000: ifconf.bandwidth = BW_500KHZ; break;
-                case 250000: ifconf.bandwidth = BW_250KHZ; break;
-                case 125000: ifconf.bandwidth = BW_125KHZ; break;
-                default: ifconf.bandwidth = BW_UNDEFINED;
-            }
-            sf = (uint32_t)json_object_dotget_number(conf, "chan_Lora_std.spread_factor");
-            switch(sf) {
-                case  7: ifconf.datarate = DR_LORA_SF7;  break;
-                case  8: ifconf.datarate = DR_LORA_SF8;  break;
-                case  9: ifconf.datarate = DR_LORA_SF9;  break;
-                case 10: ifconf.datarate = DR_LORA_SF10; break;
-                case 11: ifconf.datarate = DR_LORA_SF11; break;
-                case 12: ifconf.datarate = DR_LORA_SF12; break;
-                default: ifconf.datarate = DR_UNDEFINED;
-            }
-            MSG("INFO: LoRa standard channel enabled, radio %i selected, IF %i Hz, %u Hz bandwidth, SF %u\n", ifconf.rf_chain, ifconf.freq_hz, bw, sf);
-        }
-        if (lgw_rxif_setconf(8, ifconf) != LGW_HAL_SUCCESS) {
-            MSG("ERROR: invalid configuration for Lora standard channel\n");
-            return -1;
-        }
-    }
-
-    /* set configuration for FSK channel */
-    memset(&ifconf, 0, sizeof(ifconf)); /* initialize configuration structure */
-    val = json_object_get_value(conf, "chan_FSK"); /* fetch value (if possible) */
-    if (json_value_get_type(val) != JSONObject) {
-        MSG("INFO: no configuration for FSK channel\n");
-    } else {
-        val = json_object_dotget_value(conf, "chan_FSK.enable");
-        if (json_value_get_type(val) == JSONBoolean) {
-            ifconf.enable = (bool)json_value_get_boolean(val);
-        } else {
-            ifconf.enable = false;
-        }
-        if (ifconf.enable == false) {
-            MSG("INFO: FSK channel %i disabled\n", i);
-        } else  {
-            ifconf.rf_chain = (uint32_t)json_object_dotget_number(conf, "chan_FSK.radio");
-            ifconf.freq_hz = (int32_t)json_object_dotget_number(conf, "chan_FSK.if");
-            bw = (uint32_t)json_object_dotget_number(conf, "chan_FSK.bandwidth");
-            if      (bw <= 7800)   ifconf.bandwidth = BW_7K8HZ;
-            else if (bw <= 15600)  ifconf.bandwidth = BW_15K6HZ;
-            else if (bw <= 31200)  ifconf.bandwidth = BW_31K2HZ;
-            else if (bw <= 62500)  ifconf.bandwidth = BW_62K5HZ;
-            else if (bw <= 125000) ifconf.bandwidth = BW_125KHZ;
-            else if (bw <= 250000) ifconf.bandwidth = BW_250KHZ;
-            else if (bw <= 500000) ifconf.bandwidth = BW_500KHZ;
-            else ifconf.bandwidth = BW_UNDEFINED;
-            ifconf.datarate = (uint32_t)json_object_dotget_number(conf, "chan_FSK.datarate");
-            MSG("INFO: FSK channel enabled, radio %i selected, IF %i Hz, %u Hz bandwidth, %u bps datarate\n", ifconf.rf_chain, ifconf.freq_hz, bw, ifconf.datarate);
-        }
-        if (lgw_rxif_setconf(9, ifconf) != LGW_HAL_SUCCESS) {
-            MSG("ERROR: invalid configuration for FSK channel\n");
-            return -1;
-        }
-    }
-    json_value_free(root_val);
-    return 0;
-}
-
-int parse_gateway_configuration(const char * conf_file) {
-    const char conf_obj[] = "gateway_conf";
-    JSON_Value *root_val;
-    JSON_Object *root = NULL;
-    JSON_Object *conf = NULL;
-    const char *str; /* pointer to sub-strings in the JSON data */
-    unsigned long long ull = 0;
-
-    /* try to parse JSON */
-    root_val = json_parse_file_with_comments(conf_file);
-    root = json_value_get_object(root_val);
-    if (root == NULL) {
-        MSG("ERROR: %s id not a valid JSON file\n", conf_file);
-        exit(EXIT_FAILURE);
-    }
-    conf = json_object_get_object(root, conf_obj);
-    if (conf == NULL) {
-        MSG("INFO: %s does not contain a JSON object named %s\n", conf_file, conf_obj);
-        return -1;
-    } else {
-        MSG("INFO: %s does contain a JSON object named %s, parsing gateway parameters\n", conf_file, conf_obj);
-    }
-
-    /* getting network parameters (only those necessary for the packet logger) */
-    str = json_object_get_string(conf, "gateway_ID");
-    if (str != NULL) {
-        sscanf(str, "%llx", &ull);
-        lgwm = ull;
-        MSG("INFO: gateway MAC address is configured to %016llX\n", ull);
-    }
-
-    json_value_free(root_val);
-    return 0;
-}
-
 void open_log(void) {
     int i;
     char iso_date[20];
@@ -389,6 +130,7 @@ int main(int argc, char **argv)
     const char global_conf_fname[] = "global_conf.json"; /* contain global (typ. network-wide) configuration */
     const char local_conf_fname[] = "local_conf.json"; /* contain node specific configuration, overwrite global parameters for parameters that are defined in both */
     const char debug_conf_fname[] = "debug_conf.json"; /* if present, all other configuration files are ignored */
+    struct gw_conf_s gwconf;
 
     /* allocate memory for packet fetching and processing */
     struct lgw_pkt_rx_s rxpkt[16]; /* array containing up to 16 inbound packets metadata */
@@ -431,31 +173,36 @@ int main(int argc, char **argv)
     sigaction(SIGINT, &sigact, NULL);
     sigaction(SIGTERM, &sigact, NULL);
 
-    /* configuration files management */
+    /* configuration files management, a local conf overrides the sections of the global conf it contains */
+    gw_conf_init(&gwconf);
     if (access(debug_conf_fname, R_OK) == 0) {
     /* if there is a debug conf, parse only the debug conf */
         MSG("INFO: found debug configuration file %s, other configuration files will be ignored\n", debug_conf_fname);
-        parse_SX1301_configuration(debug_conf_fname);
-        parse_gateway_configuration(debug_conf_fname);
+        i = gw_conf_load(&gwconf, debug_conf_fname);
     } else if (access(global_conf_fname, R_OK) == 0) {
     /* if there is a global conf, parse it and then try to parse local conf  */
         MSG("INFO: found global configuration file %s, trying to parse it\n", global_conf_fname);
-        parse_SX1301_configuration(global_conf_fname);
-        parse_gateway_configuration(global_conf_fname);
-        if (access(local_conf_fname, R_OK) == 0) {
+        i = gw_conf_load(&gwconf, global_conf_fname);
+        if ((i == GW_CONF_SUCCESS) && (access(local_conf_fname, R_OK) == 0)) {
             MSG("INFO: found local configuration file %s, trying to parse it\n", local_conf_fname);
-            parse_SX1301_configuration(local_conf_fname);
-            parse_gateway_configuration(local_conf_fname);
+            i = gw_conf_load(&gwconf, local_conf_fname);
         }
     } else if (access(local_conf_fname, R_OK) == 0) {
     /* if there is only a local conf, parse it and that's all */
         MSG("INFO: found local configuration file %s, trying to parse it\n", local_conf_fname);
-        parse_SX1301_configuration(local_conf_fname);
-        parse_gateway_configuration(local_conf_fname);
+        i = gw_conf_load(&gwconf, local_conf_fname);
     } else {
         MSG("ERROR: failed to find any configuration file named %s, %s or %s\n", global_conf_fname, local_conf_fname, debug_conf_fname);
         return EXIT_FAILURE;
     }
+    gw_conf_release(&gwconf);
+    if (i != GW_CONF_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    gw_conf_apply(&gwconf);
+    if (gwconf.gateway_id_set == true) {
+        lgwm = gwconf.gateway_id;
+    }
 
     /* starting the concentrator */
     i = lgw_start();
@@ -0,0 +1,78 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Commands of the TCP client, one per line: what the socket delivers is
+    kept in a buffer of the connection and cut into '\n' terminated lines, so
+    that several commands of a single read are all handled and a command
+    split over two reads is put back together.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _CLIENT_CMD_H
+#define _CLIENT_CMD_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <sys/types.h>  /* ssize_t */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define CLIENT_CMD_BUF_SIZE 1024    /* longest command, with its '\n' and the terminating null character */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct client_cmd_s
+@brief Input of a client connection, the lines not handled yet
+*/
+struct client_cmd_s {
+    char        buf[CLIENT_CMD_BUF_SIZE];
+    int         len;            /*!> bytes received in the buffer */
+    int         pos;            /*!> start of the first line not handled yet */
+    bool        skip;           /*!> the current line was too long, dropped up to its end */
+    uint32_t    nb_drop;        /*!> lines too long, dropped */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Empty the input, for a newly connected client
+@param c input of the connection
+*/
+void client_cmd_init(struct client_cmd_s *c);
+
+/**
+@brief Read what the socket holds after the unfinished line, without waiting
+@param c input of the connection
+@param sock client socket
+@return as recv: bytes read, 0 if the client disconnected, -1 with errno set (EAGAIN if nothing to read)
+
+A line that does not fit in the buffer is dropped up to its '\n'.
+*/
+ssize_t client_cmd_recv(struct client_cmd_s *c, int sock);
+
+/**
+@brief Next complete line of the input
+@param c input of the connection
+@return the line without its '\n' (nor a '\r' before it), valid until the next client_cmd_recv, NULL once only an unfinished line is left
+*/
+const char *client_cmd_next(struct client_cmd_s *c);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,128 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Subscription of the TCP client: the spotters and kinds of lines it wants
+    and the most lines per second it accepts, sent as a SUB command on the
+    client socket and compiled into masks that the lines of each write are
+    checked against before they leave the gateway.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _CLIENT_SUB_H
+#define _CLIENT_SUB_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <sys/uio.h>    /* struct iovec */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define CLIENT_SUB_SUCCESS  0
+#define CLIENT_SUB_ERROR    -1
+
+#define CLIENT_SUB_SPOT_MAX 16      /* spotter numbers 0 to 15 */
+
+/* kinds of lines, first characters of the line */
+#define CLIENT_SUB_PKT      0x01    /* '#' decoded spotter packet, or its LORA_FRAME_SPOT frame */
+#define CLIENT_SUB_DIAG     0x02    /* '$DIAG' packet metadata */
+#define CLIENT_SUB_STAT     0x04    /* '$STAT' statistics, '$LOSS' packet loss and '$AIR' airtime of a spotter */
+#define CLIENT_SUB_OTHER    0x08    /* any other '$' line, not related to a spotter */
+#define CLIENT_SUB_WAVE     0x10    /* '$WAVE' and '$WSPEC' wave spectrum of a spotter */
+#define CLIENT_SUB_ALL      0x1F
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct client_sub_s
+@brief Compiled subscription of a client, and the state of its rate limit
+*/
+struct client_sub_s {
+    uint16_t    spot_mask;      /*!> bit n set if lines of spotter n are wanted */
+    uint8_t     kind_mask;      /*!> CLIENT_SUB_xxx kinds wanted */
+    uint32_t    rate_max;       /*!> lines per second, 0 for no limit */
+    bool        frames;         /*!> packets go as frames, their text lines (kept for the other outputs) are skipped */
+    bool        all;            /*!> everything is wanted, lines are not looked at */
+    uint16_t    resync;         /*!> bit n set if spotter n lost a frame, its frames are dropped until a keyframe */
+    uint16_t    rekey;          /*!> bit n set if spotter n needs a keyframe, cleared by client_sub_rekey */
+    uint64_t    credit;         /*!> lines that can still be sent, in millionths */
+    uint64_t    last_us;        /*!> time the credit was last refilled */
+    uint64_t    nb_pass;        /*!> lines sent */
+    uint64_t    nb_skip;        /*!> lines not subscribed */
+    uint64_t    nb_limit;       /*!> lines over the rate, and the frames following one until a keyframe */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Subscribe to everything without limit, as a newly connected client
+@param s subscription
+*/
+void client_sub_init(struct client_sub_s *s);
+
+/**
+@brief Compile a SUB command, the subscription is left as it was if the command is invalid
+@param s subscription
+@param cmd command, e.g. "SUB spot=2,5 kind=PKT,STAT rate=20", "SUB" alone subscribes to everything
+@return CLIENT_SUB_ERROR if the command does not parse, CLIENT_SUB_SUCCESS else
+
+Each of spot=, kind= and rate= is optional and defaults to everything
+(spot=all, kind=all, rate=0 without limit). The rate is a budget of lines per
+second with a burst of one second, the lines over it are dropped.
+*/
+int client_sub_parse(struct client_sub_s *s, const char *cmd);
+
+/**
+@brief Tell whether the packets go to the client as frames while their text lines are in the stream too
+@param s subscription
+@param frames true to skip the text lines of the packets
+*/
+void client_sub_frames(struct client_sub_s *s, bool frames);
+
+/**
+@brief Keep the lines the client subscribed to, in place and in order
+@param s subscription
+@param lines lines, each starting with its kind and followed by the spotter number if any
+@param nb number of lines
+@param now_us monotonic time, for the rate limit
+@return number of lines kept at the start of lines
+*/
+int client_sub_filter(struct client_sub_s *s, struct iovec *lines, int nb, uint64_t now_us);
+
+/**
+@brief Take the spotters whose next frame must be a keyframe for the client to decode it
+@param s subscription
+@return bit n set for spotter n, cleared in the subscription
+
+A frame dropped over the rate breaks the sequence of its spotter, the delta
+frames after it are dropped too until the encoder sends a keyframe. The same
+goes for a spotter the client subscribes to again.
+*/
+uint16_t client_sub_rekey(struct client_sub_s *s);
+
+/**
+@brief Describe the subscription as a reply line
+@param s subscription
+@param buf buffer
+@param len size of the buffer
+@return length of the line, "$SUB,<spotter mask>,<kind mask>,<rate>\n"
+*/
+int client_sub_format(const struct client_sub_s *s, char *buf, int len);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
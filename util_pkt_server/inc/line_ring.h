@@ -0,0 +1,130 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Single producer, single consumer ring of text lines, from the acquisition
+    thread to the network thread. Lines are formatted in place in the ring,
+    neither side ever blocks the other: the producer drops lines when the ring
+    is full, and wakes the consumer up through a pipe it can poll.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _LINE_RING_H
+#define _LINE_RING_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+
+#include "spotter.h"    /* SPOTTER_LINE_MAX */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LINE_RING_SUCCESS   0
+#define LINE_RING_ERROR     -1
+
+#define LINE_RING_SIZE      256     /* lines, power of 2 */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct line_ring_s
+@brief Ring of lines, the indexes only grow and are taken modulo LINE_RING_SIZE
+*/
+struct line_ring_s {
+    uint32_t    head __attribute__((aligned(64)));  /*!> next line to write, producer only */
+    uint32_t    nb_drop;                            /*!> lines dropped because the ring was full, written by the producer */
+    uint32_t    tail __attribute__((aligned(64)));  /*!> next line to read, consumer only */
+    int         fd[2];                              /*!> wake-up pipe, the consumer polls fd[0] */
+    struct {
+        uint16_t    len;
+        char        buf[SPOTTER_LINE_MAX];
+    } line[LINE_RING_SIZE];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Empty the ring and open its wake-up pipe
+@param r ring
+@return LINE_RING_ERROR if the pipe could not be created, LINE_RING_SUCCESS else
+*/
+int line_ring_init(struct line_ring_s *r);
+
+/**
+@brief Close the wake-up pipe
+@param r ring
+*/
+void line_ring_close(struct line_ring_s *r);
+
+/**
+@brief Get the buffer of the next line to write (producer)
+@param r ring
+@return buffer of SPOTTER_LINE_MAX bytes, NULL if the ring is full (the line is counted as dropped)
+*/
+char *line_ring_reserve(struct line_ring_s *r);
+
+/**
+@brief Publish the line written in the buffer returned by line_ring_reserve (producer)
+@param r ring
+@param len length of the line
+*/
+void line_ring_commit(struct line_ring_s *r, int len);
+
+/**
+@brief Wake the consumer up, once after a group of lines (producer)
+@param r ring
+*/
+void line_ring_notify(struct line_ring_s *r);
+
+/**
+@brief Get the oldest line (consumer)
+@param r ring
+@param len pointer to store the length of the line
+@return the line, NULL if the ring is empty
+*/
+const char *line_ring_peek(struct line_ring_s *r, int *len);
+
+/**
+@brief Get a line after the oldest one, to send several lines at once (consumer)
+@param r ring
+@param n rank of the line, 0 for the oldest
+@param len pointer to store the length of the line
+@return the line, NULL if the ring holds n lines or less
+*/
+const char *line_ring_peek_at(struct line_ring_s *r, uint32_t n, int *len);
+
+/**
+@brief Free the line returned by line_ring_peek (consumer)
+@param r ring
+*/
+void line_ring_pop(struct line_ring_s *r);
+
+/**
+@brief Free the n oldest lines, returned by line_ring_peek_at (consumer)
+@param r ring
+@param n number of lines
+*/
+void line_ring_pop_n(struct line_ring_s *r, uint32_t n);
+
+/**
+@brief Consume the wake-ups, before reading the lines (consumer)
+@param r ring
+*/
+void line_ring_ack(struct line_ring_s *r);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,118 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Settings of the acquisition thread that can be reloaded while it runs.
+    They are published RCU style: the writer fills the copy the reader does
+    not use, swaps the published pointer, then waits for the reader to go
+    through a quiescent state (between two RX FIFO drains) before reusing
+    the copy it retired. The reader never locks nor waits.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _LIVE_CONF_H
+#define _LIVE_CONF_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "pkt_filter.h"
+#include "pkt_rules.h"
+#include "spotter.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LIVE_CONF_SUCCESS   0
+#define LIVE_CONF_ERROR     -1
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct live_conf_s
+@brief Settings read by the acquisition thread for each batch of packets
+*/
+struct live_conf_s {
+    struct pkt_filter_s filter;                     /*!> batch prefilter, derived from the rules once compiled */
+    struct pkt_rules_s  rules;                      /*!> per spotter rules selecting the output of each packet */
+    int32_t             chanlist[SPOTTER_NB];  /*!> spotter frequencies, sorted, INT32_MAX if unused */
+    int                 stat_interval;              /*!> seconds between two '$STAT' reports, 0 to disable */
+    bool                rx_utc;                     /*!> append the receive UTC time to the spotter lines */
+    uint32_t            scan_budget_us;             /*!> SPI time the scan may take after each RX FIFO drain */
+    float               scan_margin_db;             /*!> level above the noise floor counted as occupied */
+    uint32_t            tx_flush_us;                /*!> longest wait for more lines before a write to the client, 0 to write each FIFO drain at once */
+};
+
+/**
+@struct live_s
+@brief Two copies of the settings, one published to the reader
+*/
+struct live_s {
+    struct live_conf_s  copy[2];
+    struct live_conf_s  *cur;       /*!> published copy */
+    uint32_t            epoch;      /*!> incremented by the reader at each quiescent state */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Publish the first copy, left for the caller to fill before the reader starts
+@param l settings
+@return the published copy
+*/
+struct live_conf_s *live_init(struct live_s *l);
+
+/**
+@brief Get the copy that is not published, to fill it with new settings (writer only)
+@param l settings
+@return the unpublished copy, a former one the reader is done with
+*/
+struct live_conf_s *live_spare(struct live_s *l);
+
+/**
+@brief Publish the spare copy and wait for the reader to be done with the retired one
+@param l settings
+@param stop the wait is abandoned when *stop becomes non zero, e.g. the reader exited
+@return LIVE_CONF_ERROR if abandoned, the retired copy must then not be reused, LIVE_CONF_SUCCESS else
+*/
+int live_publish(struct live_s *l, const int *stop);
+
+/**
+@brief Publish the spare copy while no reader runs, e.g. before it is started
+@param l settings
+*/
+void live_swap(struct live_s *l);
+
+/**
+@brief Get the published copy, valid until the next quiescent state of the reader
+@param l settings
+@return the published copy
+*/
+static inline const struct live_conf_s *live_read(struct live_s *l) {
+    return __atomic_load_n(&l->cur, __ATOMIC_SEQ_CST);
+}
+
+/**
+@brief Tell the writer the reader holds no copy any more (reader only)
+@param l settings
+*/
+static inline void live_quiescent(struct live_s *l) {
+    __atomic_fetch_add(&l->epoch, 1, __ATOMIC_SEQ_CST); /* ordered with the next live_read */
+}
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
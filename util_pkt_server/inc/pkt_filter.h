@@ -0,0 +1,131 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Batch filtering of the packets fetched by one lgw_receive_meta call.
+    Metadata are transposed into one 16-byte column per field so that the
+    accept mask of the whole batch is computed with a few vector compares
+    (SSE2 or NEON, scalar fallback otherwise).
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _PKT_FILTER_H
+#define _PKT_FILTER_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_hal.h"
+#include "spotter.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define PKT_BATCH_SIZE      16  /* one RX FIFO, one 128-bit vector of 8-bit lanes */
+
+/* metadata fields the filter can test, index of the columns of a batch */
+#define PKT_FIELD_STATUS        0
+#define PKT_FIELD_MODULATION    1
+#define PKT_FIELD_BANDWIDTH     2
+#define PKT_FIELD_DATARATE      3
+#define PKT_FIELD_CODERATE      4
+#define PKT_FIELD_NB            5
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct pkt_batch_s
+@brief Structure-of-arrays view of up to PKT_BATCH_SIZE packets
+*/
+struct pkt_batch_s {
+    uint8_t     col[PKT_FIELD_NB][PKT_BATCH_SIZE] __attribute__((aligned(16))); /*!> filtered fields, one column each */
+    uint32_t    freq_hz[PKT_BATCH_SIZE];
+    uint16_t    slot[PKT_BATCH_SIZE];       /*!> RX pool buffer holding each payload */
+    uint8_t     size[PKT_BATCH_SIZE];
+    int         nb;                         /*!> number of packets in the batch */
+};
+
+/**
+@struct pkt_filter_s
+@brief Packet filter predicate: every enabled field must be equal to its value
+*/
+struct pkt_filter_s {
+    bool        enable[PKT_FIELD_NB];   /*!> false to accept any value of that field */
+    uint8_t     value[PKT_FIELD_NB];    /*!> required value (HAL STAT_/MOD_/BW_/DR_/CR_ constants) */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Set the filter to the historical criteria: CRC OK, LoRa, 125 kHz, SF7, CR 4/5
+@param f filter to initialize
+*/
+void pkt_filter_default(struct pkt_filter_s *f);
+
+/**
+@brief Require a value for one metadata field
+@param f filter to modify
+@param field one of the PKT_FIELD_ constants
+@param value required value
+*/
+void pkt_filter_set(struct pkt_filter_s *f, int field, uint8_t value);
+
+/**
+@brief Accept any value for one metadata field
+@param f filter to modify
+@param field one of the PKT_FIELD_ constants
+*/
+void pkt_filter_any(struct pkt_filter_s *f, int field);
+
+/**
+@brief Transpose an array of compact metadata records into a batch
+@param b batch to fill
+@param meta array of metadata, as filled by lgw_receive_meta
+@param nb number of records, at most PKT_BATCH_SIZE
+*/
+void pkt_batch_load(struct pkt_batch_s *b, const struct lgw_pkt_meta_s *meta, int nb);
+
+/**
+@brief Compute which packets of a batch are accepted by a filter
+@param f filter predicate
+@param b batch of packets
+@return accept mask, bit i set if packet i is accepted
+*/
+uint16_t pkt_filter_run(const struct pkt_filter_s *f, const struct pkt_batch_s *b);
+
+/**
+@brief Portable implementation of pkt_filter_run, used when no vector unit is available
+*/
+uint16_t pkt_filter_run_scalar(const struct pkt_filter_s *f, const struct pkt_batch_s *b);
+
+/**
+@brief Decode the spotter payloads of all the accepted packets
+@param b batch of packets, payloads read in place from the RX pool
+@param mask accept mask returned by pkt_filter_run
+@param d array of PKT_BATCH_SIZE structures, d[i] receives packet i fields
+@return mask of the packets successfully decoded (too short payloads are cleared)
+*/
+uint16_t pkt_batch_decode(const struct pkt_batch_s *b, uint16_t mask, struct spotter_data_s *d);
+
+/**
+@brief Name of the vector implementation selected at compile time
+@return "sse2", "neon" or "scalar"
+*/
+const char *pkt_filter_impl(void);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
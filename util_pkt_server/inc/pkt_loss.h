@@ -0,0 +1,115 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Live packet loss of each spotter. The spotters send a sample at a regular
+    cadence, stamped in tenths of a second: the cadence is learned from the
+    timestamps received and a longer step between two samples counts the
+    samples missing, the same timestamp again counts a duplicate. Loss rates
+    are kept over a few rolling windows of fixed buckets, the memory of a
+    spotter does not depend on the window lengths.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _PKT_LOSS_H
+#define _PKT_LOSS_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <time.h>       /* time_t */
+
+#include "roll_win.h"
+#include "spotter.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define PKT_LOSS_SUCCESS    0
+#define PKT_LOSS_ERROR      -1
+
+#define PKT_LOSS_WINDOW_MAX 3       /* rolling windows per spotter */
+#define PKT_LOSS_WINDOW_S   40      /* default window, as grouping_window_sec of the analysis scripts */
+#define PKT_LOSS_GAP_MAX_S  600     /* longer steps are a restart or a clock jump of the spotter, not lost samples */
+#define PKT_LOSS_SEEN       256     /* tenths of a second of timestamps remembered, a repeat within them is a duplicate */
+#define PKT_LOSS_LINE_MAX   128     /* size of a buffer able to hold any line */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct pkt_loss_chan_s
+@brief Cadence model and counters of a spotter
+*/
+struct pkt_loss_chan_s {
+    uint64_t    last;           /*!> timestamp of the latest sample, tenths of a second, 0 before the first */
+    uint32_t    period_x256;    /*!> cadence learned, 1/256 of a tenth of a second, 0 until learned */
+    uint32_t    nb_rx;          /*!> samples received, duplicates excepted */
+    uint32_t    nb_lost;        /*!> samples missing */
+    uint32_t    nb_dup;         /*!> samples received twice, up to PKT_LOSS_SEEN tenths behind the latest */
+    uint32_t    nb_late;        /*!> samples older than the latest, each one fills a counted gap */
+    uint32_t    nb_resync;      /*!> steps longer than PKT_LOSS_GAP_MAX_S, or back in time */
+    uint32_t    seen[PKT_LOSS_SEEN / 32];   /*!> bit (t % PKT_LOSS_SEEN) set if timestamp t was received, over the latest PKT_LOSS_SEEN tenths */
+    time_t      last_rx;        /*!> gateway time of the latest sample */
+    struct roll_win_s rx[PKT_LOSS_WINDOW_MAX];      /*!> samples received, in spotter time (bucket = tenths / window seconds) */
+    struct roll_win_s lost[PKT_LOSS_WINDOW_MAX];    /*!> samples missing, counted in the bucket of the sample after the gap */
+};
+
+/**
+@struct pkt_loss_s
+@brief Loss of all spotters
+*/
+struct pkt_loss_s {
+    int         nb_win;
+    uint32_t    win_s[PKT_LOSS_WINDOW_MAX]; /*!> window lengths, seconds */
+    struct pkt_loss_chan_s chan[SPOTTER_NB];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Clear the models and counters of all spotters
+@param l loss
+@param win_s lengths of the rolling windows, seconds
+@param nb_win number of windows, up to PKT_LOSS_WINDOW_MAX
+@return PKT_LOSS_ERROR if a window is 0 or there are too many, PKT_LOSS_SUCCESS else
+*/
+int pkt_loss_init(struct pkt_loss_s *l, const uint32_t *win_s, int nb_win);
+
+/**
+@brief Account a sample received
+@param l loss
+@param spotn spotter number of the sample
+@param tenths timestamp of the sample, tenths of a second since epoch
+@param now gateway time
+*/
+void pkt_loss_add(struct pkt_loss_s *l, int spotn, uint64_t tenths, time_t now);
+
+/**
+@brief Format the '$LOSS' line of a spotter
+@param l loss
+@param spotn spotter number
+@param now gateway time, for the age of the latest sample
+@param buf buffer to write the line into, PKT_LOSS_LINE_MAX bytes is always enough
+@param len size of the buffer
+@return length of the line, without the terminating null character
+
+"$LOSS,<spotter>,<cadence s>,<received>,<lost>,<duplicates>,<late>,<resyncs>,<age s>,<loss % of each window>\n",
+fields empty while unknown.
+*/
+int pkt_loss_format(const struct pkt_loss_s *l, int spotn, time_t now, char *buf, int len);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,170 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Forwarding rules: which packets of which spotter go to which output.
+    Rules are collected while parsing the configuration, then compiled once
+    into a flat table indexed by spotter number, holding only bitmasks and
+    thresholds, so that evaluating a packet needs no lookup.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _PKT_RULES_H
+#define _PKT_RULES_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_hal.h"
+#include "pkt_filter.h"
+#include "spotter.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define RULES_PER_SPOTTER   4   /* rules evaluated for one packet at most */
+#define RULES_PENDING_MAX   32  /* rules collected from the configuration */
+
+#define RULE_ALL_SPOTTERS   -1  /* spotn value of a rule applying to every spotter */
+
+/* outputs a packet can be sent to */
+#define RULE_OUT_SPOTTER    0x01    /* decoded spotter line ('#') */
+#define RULE_OUT_DIAG       0x02    /* packet metadata line ('$DIAG'), for any payload */
+
+/* status classes, the STAT_ values are not usable as bit positions */
+#define RULE_STAT_CRC_OK    0x01
+#define RULE_STAT_CRC_BAD   0x02
+#define RULE_STAT_UNDEFINED 0x04
+#define RULE_STAT_NO_CRC    0x08
+#define RULE_STAT_BIT(s)    ((((s) & 0x10) ? 1 : 4) << ((s) & 1))
+
+#define RULE_MOD_BIT(m)     ((m) >> 4)  /* MOD_LORA -> 1, MOD_FSK -> 2 */
+
+#define RULE_NO_MIN_RSSI    INT16_MIN
+#define RULE_NO_MIN_SNR     INT8_MIN
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct pkt_rule_s
+@brief One compiled rule, a packet matches if all its fields are in the allowed sets
+*/
+struct pkt_rule_s {
+    uint8_t     status_mask;    /*!> allowed RULE_STAT_ classes */
+    uint8_t     mod_mask;       /*!> allowed modulations, RULE_MOD_BIT */
+    uint8_t     bw_mask;        /*!> allowed bandwidths, bit BW_ value */
+    uint8_t     sf_mask;        /*!> allowed spreading factors, DR_LORA_SF flags, bit 0 for undefined */
+    uint8_t     cr_mask;        /*!> allowed coderates, bit CR_ value */
+    int8_t      min_snr_x4;     /*!> minimum SNR in 1/4 dB, RULE_NO_MIN_SNR to disable */
+    int16_t     min_rssi_x16;   /*!> minimum RSSI in 1/16 dB, RULE_NO_MIN_RSSI to disable */
+    uint8_t     outputs;        /*!> RULE_OUT_ flags of the packets matching */
+};
+
+/**
+@struct pkt_rules_s
+@brief Rules as written in the configuration, and the table compiled from them
+*/
+struct pkt_rules_s {
+    /* compiled table, the only part used per packet */
+    struct pkt_rule_s   table[SPOTTER_NB][RULES_PER_SPOTTER];
+    uint8_t             nb[SPOTTER_NB];
+    /* configuration, before compilation */
+    struct pkt_rule_s   pending[RULES_PENDING_MAX];
+    int                 pending_spotn[RULES_PENDING_MAX];   /*!> spotter, or RULE_ALL_SPOTTERS */
+    uint32_t            pending_freq[RULES_PENDING_MAX];    /*!> frequency selecting the spotter, 0 if unused */
+    int                 nb_pending;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Empty a rule set
+@param r rule set
+*/
+void pkt_rules_init(struct pkt_rules_s *r);
+
+/**
+@brief Initialize a rule accepting everything, with no output
+@param rule rule to initialize
+*/
+void pkt_rule_any(struct pkt_rule_s *rule);
+
+/**
+@brief Initialize a rule from an equality filter
+@param rule rule to initialize
+@param f filter giving the required values (any value if not enabled)
+@param outputs RULE_OUT_ flags
+*/
+void pkt_rule_from_filter(struct pkt_rule_s *rule, const struct pkt_filter_s *f, uint8_t outputs);
+
+/**
+@brief Add a rule to the configuration
+@param r rule set
+@param spotn spotter the rule applies to, RULE_ALL_SPOTTERS for every one
+@param freq_hz if not 0, the rule applies to the spotter received on that frequency instead
+@param rule rule to add
+@return -1 if too many rules, 0 else
+*/
+int pkt_rules_add(struct pkt_rules_s *r, int spotn, uint32_t freq_hz, const struct pkt_rule_s *rule);
+
+/**
+@brief Build the table evaluated per packet from the configured rules
+@param r rule set
+@param chanlist frequency of each spotter
+@param nb_chan number of entries in chanlist
+@return -1 if a rule could not be placed, 0 else
+*/
+int pkt_rules_compile(struct pkt_rules_s *r, const int32_t *chanlist, int nb_chan);
+
+/**
+@brief Derive the vector prefilter from the compiled table
+@param r compiled rule set
+@param f filter to set, only the fields having one single value allowed by every rule are enabled
+*/
+void pkt_rules_prefilter(const struct pkt_rules_s *r, struct pkt_filter_s *f);
+
+/**
+@brief Evaluate the rules of a spotter for one packet
+@param r compiled rule set
+@param spotn spotter number
+@param m packet metadata
+@return RULE_OUT_ flags of every matching rule
+*/
+static inline uint8_t pkt_rules_eval(const struct pkt_rules_s *r, int spotn, const struct lgw_pkt_meta_s *m) {
+    const struct pkt_rule_s *rule;
+    uint8_t out = 0;
+    int i;
+
+    if ((spotn < 0) || (spotn >= SPOTTER_NB)) {
+        return 0;
+    }
+    for (i = 0; i < r->nb[spotn]; ++i) {
+        rule = &r->table[spotn][i];
+        if ((rule->status_mask & RULE_STAT_BIT(m->status)) &&
+            (rule->mod_mask & RULE_MOD_BIT(m->modulation)) &&
+            (rule->bw_mask & (1U << m->bandwidth)) &&
+            ((m->modulation != MOD_LORA) || ((rule->sf_mask & (m->datarate | (m->datarate == DR_UNDEFINED))) && (rule->cr_mask & (1U << m->coderate)))) &&
+            (m->rssi_x16 >= rule->min_rssi_x16) &&
+            (m->snr_x4 >= rule->min_snr_x4)) {
+            out |= rule->outputs;
+        }
+    }
+    return out;
+}
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
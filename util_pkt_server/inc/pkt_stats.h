@@ -0,0 +1,100 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Per spotter statistics: packet counters over a reporting period and the
+    latest noise floor and occupancy measured by the spectral scan, sent to
+    the client as '$STAT' lines.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _PKT_STATS_H
+#define _PKT_STATS_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_hal.h"
+#include "spotter.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct pkt_stats_chan_s
+@brief Statistics of one spotter
+*/
+struct pkt_stats_chan_s {
+    uint32_t    nb_rx;          /*!> packets received during the period */
+    uint32_t    nb_crc_ok;      /*!> of which with a valid CRC */
+    uint32_t    nb_crc_bad;     /*!> of which with a wrong CRC */
+    int64_t     rssi_sum_x16;   /*!> sum of the RSSI of the packets, in 1/16 dB */
+    bool        noise_valid;    /*!> a spectral scan result is available */
+    float       noise_dbm;      /*!> latest noise floor, in dBm */
+    float       occupancy;      /*!> latest fraction of time the channel was above the noise floor */
+};
+
+/**
+@struct pkt_stats_s
+@brief Statistics of all spotters
+*/
+struct pkt_stats_s {
+    struct pkt_stats_chan_s chan[SPOTTER_NB];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Clear all the statistics
+@param s statistics
+*/
+void pkt_stats_init(struct pkt_stats_s *s);
+
+/**
+@brief Count a received packet
+@param s statistics
+@param spotn spotter number of the packet
+@param m metadata of the packet
+*/
+void pkt_stats_add(struct pkt_stats_s *s, int spotn, const struct lgw_pkt_meta_s *m);
+
+/**
+@brief Record the latest spectral scan result of a spotter channel
+@param s statistics
+@param spotn spotter number of the channel
+@param noise_dbm noise floor, in dBm
+@param occupancy fraction of time the channel was occupied
+*/
+void pkt_stats_noise(struct pkt_stats_s *s, int spotn, float noise_dbm, float occupancy);
+
+/**
+@brief Format the '$STAT' line of a spotter
+@param s statistics
+@param spotn spotter number
+@param buf buffer to write the line into
+@param len size of the buffer
+@return length of the line, without the terminating null character
+*/
+int pkt_stats_format(const struct pkt_stats_s *s, int spotn, char *buf, int len);
+
+/**
+@brief Start a new reporting period, the packet counters are cleared, the noise is kept
+@param s statistics
+*/
+void pkt_stats_period(struct pkt_stats_s *s);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,76 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Rolling window of a counter in fixed buckets. The window slides by one
+    bucket, a tenth of its length, so its memory does not depend on the
+    length. Bucket numbers are the time of an event divided by the
+    bucket length, in any unit (spotter time for the loss, concentrator time
+    for the airtime).
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _ROLL_WIN_H
+#define _ROLL_WIN_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define ROLL_WIN_BUCKETS    10      /* buckets of a window, a window slides by a tenth of its length */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct roll_win_s
+@brief Counter of the latest buckets, cleared by memset
+*/
+struct roll_win_s {
+    uint32_t    val[ROLL_WIN_BUCKETS];  /*!> counter of each bucket */
+    uint32_t    sum;                    /*!> counter over the whole window */
+    uint64_t    bucket;                 /*!> number of the latest bucket */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Add to the counter in the bucket of an event, the buckets left behind are cleared
+@param w window
+@param b bucket number of the event, an event of a former bucket is counted in the latest one
+@param n amount added
+*/
+void roll_win_add(struct roll_win_s *w, uint64_t b, uint32_t n);
+
+/**
+@brief Take one back from the counter, in the latest bucket where it is not zero
+@param w window
+@return false if the counter is zero over the whole window
+*/
+bool roll_win_take(struct roll_win_s *w);
+
+/**
+@brief Sum the counter over the buckets from a given one to the latest
+@param w window
+@param from number of the oldest bucket summed, the ones out of the window count as zero
+@return sum
+*/
+uint64_t roll_win_sum_from(const struct roll_win_s *w, uint64_t from);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,96 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Optional real-time mode of the acquisition path: SCHED_FIFO priority and
+    CPU pinning of the acquisition thread, other threads kept off its CPU,
+    memory locked and thread stacks pre-faulted so that no page fault can
+    happen between a packet reaching the RX FIFO and its drain.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _RT_SCHED_H
+#define _RT_SCHED_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <pthread.h>    /* pthread_attr_t */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define RT_SCHED_SUCCESS    0
+#define RT_SCHED_ERROR      -1
+
+#define RT_STACK_SIZE       (256 * 1024)    /* thread stacks, locked and faulted in as a whole */
+#define RT_STACK_PREFAULT   (64 * 1024)     /* stack touched by rt_sched_acq, deepest expected use */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct rt_conf_s
+@brief Real-time settings of the acquisition path
+*/
+struct rt_conf_s {
+    bool    enable;         /*!> false to run every thread as SCHED_OTHER, unpinned */
+    int     priority;       /*!> SCHED_FIFO priority of the acquisition thread, 1 to 99 */
+    int     cpu;            /*!> CPU of the acquisition thread, the other threads avoid it, -1 to not pin */
+    bool    lock_memory;    /*!> mlockall current and future mappings */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Set the default real-time settings, disabled
+@param conf pointer to the settings
+*/
+void rt_conf_default(struct rt_conf_s *conf);
+
+/**
+@brief Lock the process memory, before creating the threads
+@param conf real-time settings
+@return RT_SCHED_ERROR if locking was requested and failed, RT_SCHED_SUCCESS else
+
+Locking the current mappings faults in the static buffers (HAL packet pool,
+line ring), locking the future ones faults in each thread stack when the thread
+is created.
+*/
+int rt_lock_memory(const struct rt_conf_s *conf);
+
+/**
+@brief Initialize the attributes of a thread created by the application
+@param attr attributes to initialize, to be destroyed by the caller
+@return RT_SCHED_ERROR if the attributes could not be set, RT_SCHED_SUCCESS else
+*/
+int rt_thread_attr(pthread_attr_t *attr);
+
+/**
+@brief Make the calling thread the real-time acquisition thread
+@param conf real-time settings
+@return RT_SCHED_ERROR if the priority or the CPU could not be set (the thread keeps running as before), RT_SCHED_SUCCESS else
+*/
+int rt_sched_acq(const struct rt_conf_s *conf);
+
+/**
+@brief Keep the calling thread off the CPU of the acquisition thread
+@param conf real-time settings
+@return RT_SCHED_ERROR if the CPU affinity could not be set, RT_SCHED_SUCCESS else
+*/
+int rt_sched_other(const struct rt_conf_s *conf);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,120 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Airtime of the packets received on each spotter channel, from their
+    metadata: utilisation of the channel over a few rolling windows and
+    receptions overlapping on the same channel, likely collisions. The
+    airtime comes from a table of symbols per payload size built once, the
+    same as lgw_time_on_air but in integer microseconds.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _RX_AIRTIME_H
+#define _RX_AIRTIME_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_hal.h"
+#include "roll_win.h"
+#include "spotter.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define RX_AIRTIME_SUCCESS      0
+#define RX_AIRTIME_ERROR        -1
+
+#define RX_AIRTIME_WINDOW_MAX   3       /* rolling windows per channel */
+#define RX_AIRTIME_WINDOW_S_MAX 3600    /* longest window, the sums of a bucket stay in 32 bits */
+#define RX_AIRTIME_PREAMBLE     8       /* preamble symbols of the spotters, as the LoRa default */
+#define RX_AIRTIME_LINE_MAX     128     /* size of a buffer able to hold any line */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct rx_airtime_chan_s
+@brief Counters of a spotter channel
+*/
+struct rx_airtime_chan_s {
+    uint32_t    nb_rx;          /*!> LoRa packets received */
+    uint32_t    nb_overlap;     /*!> packets starting before the end of a former one */
+    uint32_t    nb_overlap_bad; /*!> of which with a wrong CRC */
+    uint64_t    air_us;         /*!> airtime of all the packets */
+    uint64_t    end_us;         /*!> end of the latest reception, 64 bits counter */
+    struct roll_win_s win[RX_AIRTIME_WINDOW_MAX];   /*!> airtime of the packets ending in each bucket (counter / tenth of the window) */
+};
+
+/**
+@struct rx_airtime_s
+@brief Airtime of all spotter channels
+*/
+struct rx_airtime_s {
+    int         nb_win;
+    uint32_t    win_s[RX_AIRTIME_WINDOW_MAX];   /*!> window lengths, seconds */
+    uint64_t    start_us;                       /*!> end of the first packet, 0 before it */
+    uint64_t    last_us;                        /*!> end of the latest packet */
+    uint16_t    pre_x4;                         /*!> preamble and sync word, quarters of a symbol */
+    uint8_t     blocks[6][256];                 /*!> payload blocks of each SF and size, (CR + 4) symbols each */
+    struct rx_airtime_chan_s chan[SPOTTER_NB];
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Build the symbol table and clear the counters of all channels
+@param a airtime
+@param preamble preamble length of the packets, symbols
+@param win_s lengths of the rolling windows, seconds
+@param nb_win number of windows, up to RX_AIRTIME_WINDOW_MAX
+@return RX_AIRTIME_ERROR if a window is 0 or too long or there are too many, RX_AIRTIME_SUCCESS else
+*/
+int rx_airtime_init(struct rx_airtime_s *a, int preamble, const uint32_t *win_s, int nb_win);
+
+/**
+@brief Airtime of a LoRa packet, explicit header and CRC on
+@param a airtime
+@param m metadata of the packet
+@return airtime in microseconds, 0 if the modulation is not LoRa or the datarate, bandwidth or coderate unknown
+*/
+uint32_t rx_airtime_packet(const struct rx_airtime_s *a, const struct lgw_pkt_meta_s *m);
+
+/**
+@brief Account a received packet on its channel
+@param a airtime
+@param spotn spotter number of the channel
+@param m metadata of the packet, the counter is taken at the end of the reception
+*/
+void rx_airtime_add(struct rx_airtime_s *a, int spotn, const struct lgw_pkt_meta_s *m);
+
+/**
+@brief Format the '$AIR' line of a channel
+@param a airtime
+@param spotn spotter number
+@param now_us concentrator counter, 64 bits, the latest packet is used if older
+@param buf buffer to write the line into, RX_AIRTIME_LINE_MAX bytes is always enough
+@param len size of the buffer
+@return length of the line, without the terminating null character
+
+"$AIR,<spotter>,<received>,<mean airtime ms>,<overlaps>,<overlaps CRC bad>,<utilisation % of each window>\n",
+fields empty while unknown.
+*/
+int rx_airtime_format(const struct rx_airtime_s *a, int spotn, uint64_t now_us, char *buf, int len);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
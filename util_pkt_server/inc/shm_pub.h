@@ -0,0 +1,78 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Publication of the lines sent to the client in a POSIX shared memory
+    ring, read without any system call by the consumers running on the
+    gateway (libloraclient lc_shm_* functions).
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _SHM_PUB_H
+#define _SHM_PUB_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stddef.h>     /* size_t */
+#include <sys/uio.h>    /* struct iovec */
+
+#include "shm_ring.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define SHM_PUB_SUCCESS     0
+#define SHM_PUB_ERROR       -1
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct shm_pub_s
+@brief Shared memory ring mapped by the writer
+*/
+struct shm_pub_s {
+    char                    name[64];   /*!> shm_open name, unlinked on close */
+    struct shm_ring_hdr_s   *ring;
+    size_t                  size;
+    uint64_t                nb_line;    /*!> lines published */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Create or take over the shared memory ring
+@param p publisher
+@param name shm_open name, starting with '/'
+@return SHM_PUB_ERROR if the shared memory could not be created or mapped, SHM_PUB_SUCCESS else
+*/
+int shm_pub_open(struct shm_pub_s *p, const char *name);
+
+/**
+@brief Publish lines, the oldest ones are overwritten whatever the readers
+@param p publisher
+@param lines lines, each ending with '\n'
+@param nb number of lines
+*/
+void shm_pub_send(struct shm_pub_s *p, const struct iovec *lines, int nb);
+
+/**
+@brief Tell the readers the publication stopped, unmap and remove the shared memory
+@param p publisher
+*/
+void shm_pub_close(struct shm_pub_s *p);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,99 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Decoding of the spotter payloads and formatting of the lines sent to the
+    network client.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _SPOTTER_H
+#define _SPOTTER_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stddef.h>     /* size_t */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+/*
+Spotter payload, packed little-endian fields as sent by the spotters (same
+layout as the packed struct of the original 32-bit gateway build):
+  0  type           u8
+  1  timestamp      u32, seconds since epoch
+  5  timestamp_f    u8, tenths of a second
+  6  X, Y, Z        s32 each
+  18 LATD           char, degrees
+  19 LATM           s32, minutes * 100000
+  23 LOND           s32, degrees
+  27 LONM           s32, minutes * 100000
+*/
+#define SPOTTER_PAYLOAD_SIZE    31
+
+#define SPOTTER_NB              8   /* spotters of a gateway, one per LoRa multi-SF channel */
+
+#define SPOTTER_LINE_MAX        128 /* size of a buffer able to hold any formatted line, receive time included */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct spotter_data_s
+@brief Fields of a decoded spotter payload
+*/
+struct spotter_data_s {
+    uint8_t     type;
+    uint32_t    timestamp;      /*!> seconds since epoch */
+    uint8_t     timestamp_f;    /*!> tenths of a second */
+    int32_t     X;
+    int32_t     Y;
+    int32_t     Z;
+    char        LATD;
+    int32_t     LATM;
+    int32_t     LOND;
+    int32_t     LONM;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Decode the fields of a spotter payload, reading them in place
+@param payload pointer to the received payload
+@param size payload size in bytes
+@param d pointer to the structure receiving the decoded fields
+@return -1 if the payload is too short, 0 else
+*/
+int spotter_decode(const uint8_t *payload, uint16_t size, struct spotter_data_s *d);
+
+/**
+@brief Timestamp of a decoded spotter payload, the tenths above 9 limited to 9
+@param d decoded payload
+@return tenths of a second since epoch, as sent in the lines and frames
+*/
+uint64_t spotter_tenths(const struct spotter_data_s *d);
+
+/**
+@brief Format a decoded spotter payload as an ASCII line for the network client
+@param d decoded payload
+@param spotn spotter number
+@param buf destination buffer, SPOTTER_LINE_MAX bytes is always enough
+@param len size of the destination buffer
+@return length of the line, without terminating null character
+*/
+int spotter_format(const struct spotter_data_s *d, int spotn, char *buf, size_t len);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,94 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    GPS time reference shared between the time-sync thread and the packet
+    processing loop. One writer publishes the reference under a sequence
+    counter (seqlock), readers copy it without taking any lock and retry in
+    the rare case an update happened during the copy.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _TIME_REF_H
+#define _TIME_REF_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <time.h>       /* struct timespec */
+
+#include "loragw_gps.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define TIME_REF_SUCCESS    0
+#define TIME_REF_ERROR      -1
+
+#define TIME_REF_MAX_AGE    LGW_CLK_HOLDOVER_S /* seconds without PPS sync before the reference is not trusted */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct time_ref_s
+@brief Time reference published by a single writer
+*/
+struct time_ref_s {
+    uint32_t    seq;    /*!> odd while the reference is being written */
+    struct tref ref;    /*!> counter <-> GPS/UTC reference, systime 0 until the first sync */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Set a time reference as never synchronized
+@param t shared time reference
+*/
+void time_ref_init(struct time_ref_s *t);
+
+/**
+@brief Publish a new reference (single writer)
+@param t shared time reference
+@param ref new reference, as updated by lgw_gps_sync
+*/
+void time_ref_publish(struct time_ref_s *t, const struct tref *ref);
+
+/**
+@brief Convert a concentrator counter value to UTC with the latest reference
+@param t shared time reference
+@param count_us internal counter value, e.g. packet timestamp
+@param utc pointer to store the UTC time
+@return TIME_REF_ERROR if never synchronized, not synchronized for TIME_REF_MAX_AGE, or conversion failed
+*/
+int time_ref_cnt2utc(const struct time_ref_s *t, uint32_t count_us, struct timespec *utc);
+
+/**
+@brief Get a consistent copy of the latest reference, without locking
+@param t shared time reference
+@param ref pointer to store the copy
+*/
+static inline void time_ref_get(const struct time_ref_s *t, struct tref *ref) {
+    uint32_t s0, s1;
+
+    do {
+        s0 = __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE);
+        *ref = t->ref;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        s1 = __atomic_load_n(&t->seq, __ATOMIC_RELAXED);
+    } while ((s0 & 1) || (s0 != s1));
+}
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,93 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Batched writes of the line ring to the client socket. The lines of one
+    RX FIFO drain, and of the next drains within a latency bound, are sent
+    in a single call straight from the ring, without copy.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _TX_BATCH_H
+#define _TX_BATCH_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <sys/uio.h>    /* struct iovec */
+
+#include "line_ring.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define TX_BATCH_SUCCESS    0
+#define TX_BATCH_ERROR      -1
+
+#define TX_BATCH_MAX        LINE_RING_SIZE  /* lines per write, the whole ring */
+#define TX_FLUSH_MAX_US     100000          /* longest latency bound, the ring must not fill up meanwhile */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct tx_batch_s
+@brief Lines gathered for the next write, and counters of the writes done
+*/
+struct tx_batch_s {
+    struct iovec    iov[TX_BATCH_MAX];  /*!> lines gathered, still in the ring */
+    int             nb;                 /*!> number of lines gathered */
+    int             nb_send;            /*!> lines of iov to send, fewer than nb once the client subscription dropped some */
+    uint64_t        nb_write;           /*!> write calls */
+    uint64_t        nb_line;            /*!> lines written */
+    uint64_t        nb_byte;            /*!> bytes written */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Forget the lines gathered and clear the counters, e.g. for a new client
+@param b batch
+*/
+void tx_batch_init(struct tx_batch_s *b);
+
+/**
+@brief Gather the lines of the ring, waiting for more within a latency bound
+@param b batch
+@param r ring, lines stay in it until sent
+@param bound_us longest wait after the first line for the next FIFO drains, 0 to take the lines available only
+@return number of lines gathered, all of them to be sent
+
+The wait ends early when the batch is full or a signal is received.
+*/
+int tx_batch_collect(struct tx_batch_s *b, struct line_ring_s *r, uint32_t bound_us);
+
+/**
+@brief Send the first nb_send lines gathered in a single call, and free all of them in the ring
+@param b batch
+@param r ring the lines were gathered from
+@param fd connected socket
+@return TX_BATCH_ERROR if the socket failed, the lines are freed anyway, TX_BATCH_SUCCESS else
+*/
+int tx_batch_send(struct tx_batch_s *b, struct line_ring_s *r, int fd);
+
+/**
+@brief Free the lines gathered in the ring without sending them, e.g. while no client is connected
+@param b batch
+@param r ring the lines were gathered from
+*/
+void tx_batch_release(struct tx_batch_s *b, struct line_ring_s *r);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
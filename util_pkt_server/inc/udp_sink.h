@@ -0,0 +1,111 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Multicast UDP output of the lines sent to the client. Lines are packed in
+    datagrams up to the MTU, each one starting with a '$SEQ' line giving the
+    gateway ID and a sequence number, so that any number of listeners get the
+    stream at a constant cost and can detect lost datagrams.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _UDP_SINK_H
+#define _UDP_SINK_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <sys/uio.h>    /* struct iovec */
+#include <netinet/in.h> /* struct sockaddr_in */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define UDP_SINK_SUCCESS    0
+#define UDP_SINK_ERROR      -1
+
+#define UDP_SINK_PORT       2601
+#define UDP_SINK_GROUP      "239.255.26.1"  /* organization-local scope */
+#define UDP_SINK_MTU        1500            /* Ethernet */
+#define UDP_SINK_MTU_MIN    576             /* smallest MTU of IPv4, far above the longest line */
+#define UDP_SINK_HDR_IP     28              /* IPv4 and UDP headers */
+#define UDP_SINK_HDR_MAX    48              /* '$SEQ,<16 hex digits>,<sequence>\n' */
+#define UDP_SINK_IOV_MAX    128             /* lines per datagram, more than fit in the MTU */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct udp_sink_conf_s
+@brief Settings of the multicast output
+*/
+struct udp_sink_conf_s {
+    bool        enable;
+    char        group[64];      /*!> multicast group, or any unicast or broadcast address */
+    uint16_t    port;
+    char        iface[64];      /*!> address of the interface to send from, default route if empty */
+    uint8_t     ttl;            /*!> 1 to stay on the LAN */
+    uint16_t    mtu;            /*!> largest IP packet, datagrams are never fragmented */
+};
+
+/**
+@struct udp_sink_s
+@brief Socket, datagram header and counters of the multicast output
+*/
+struct udp_sink_s {
+    int                 fd;
+    struct sockaddr_in  dst;
+    uint16_t            payload_max;    /*!> bytes of UDP payload */
+    char                id[17];         /*!> gateway ID, 16 hex digits */
+    uint32_t            seq;            /*!> sequence number of the next datagram, counts the lost ones too */
+    uint64_t            nb_datagram;    /*!> datagrams sent */
+    uint64_t            nb_line;        /*!> lines sent */
+    uint64_t            nb_lost;        /*!> datagrams the socket refused, e.g. buffer full */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Set the default settings
+@param conf settings, disabled
+*/
+void udp_sink_conf_default(struct udp_sink_conf_s *conf);
+
+/**
+@brief Open the socket of the multicast output
+@param u output
+@param conf settings
+@param id gateway ID sent in each datagram
+@return UDP_SINK_ERROR if the address or interface is invalid or the socket failed, UDP_SINK_SUCCESS else
+*/
+int udp_sink_open(struct udp_sink_s *u, const struct udp_sink_conf_s *conf, const char *id);
+
+/**
+@brief Send lines, packed in as few datagrams as possible, never blocking
+@param u output
+@param lines lines, each ending with '\n'
+@param nb number of lines
+@return number of datagrams the socket refused
+*/
+int udp_sink_send(struct udp_sink_s *u, const struct iovec *lines, int nb);
+
+/**
+@brief Close the socket
+@param u output
+*/
+void udp_sink_close(struct udp_sink_s *u);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
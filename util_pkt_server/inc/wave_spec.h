@@ -0,0 +1,175 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Wave spectrum of each spotter, computed on the gateway from the vertical
+    displacement of its samples: a ring of the latest samples filled by the
+    acquisition thread, read from time to time by a low priority thread that
+    averages the Hann windowed real FFT of overlapping segments (Welch) and
+    gives the significant wave height, the peak and mean periods and the
+    energy per frequency band, as '$WAVE' and '$WSPEC' lines.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+#ifndef _WAVE_SPEC_H
+#define _WAVE_SPEC_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "spotter.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define WAVE_SPEC_SUCCESS   0
+#define WAVE_SPEC_ERROR     -1
+#define WAVE_SPEC_NODATA    1       /* not enough samples, or none since the former spectrum */
+
+#define WAVE_SPEC_RING_SIZE 4096    /* samples kept per spotter, power of 2 */
+#define WAVE_SPEC_WINDOW_MAX 2048   /* samples of a spectrum, half the ring so that it is read while it fills */
+#define WAVE_SPEC_SEG_MIN   16
+#define WAVE_SPEC_SEG_MAX   1024    /* samples of a segment, power of 2 */
+#define WAVE_SPEC_WINDOW    1024    /* default, about 8 minutes at 2 Hz */
+#define WAVE_SPEC_SEGMENT   256     /* default, 7 segments overlapping by half, 0.008 Hz resolution at 2 Hz */
+#define WAVE_SPEC_INTERVAL  300     /* default seconds between spectra */
+#define WAVE_SPEC_STEP_MAX  100     /* tenths, longest step between two samples taken for the cadence */
+#define WAVE_SPEC_LOSS_PCT  20      /* most samples of a window lost, %, they are filled across the gaps */
+
+#define WAVE_SPEC_BANDS     16      /* bands of the '$WSPEC' line */
+#define WAVE_SPEC_FMIN      0.04f   /* Hz, the wave band starts there, below is drift of the sensor */
+#define WAVE_SPEC_DF_BAND   0.03f   /* Hz, the 16 bands end at 0.52 Hz, or at half the sample rate */
+
+#define WAVE_SPEC_LINE_MAX  128     /* size of a buffer able to hold any line */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct wave_spec_ring_s
+@brief Latest samples of a spotter, written by the acquisition thread only
+*/
+struct wave_spec_ring_s {
+    uint64_t    tenths[WAVE_SPEC_RING_SIZE];    /*!> timestamp of the sample, tenths of a second since epoch */
+    int32_t     z[WAVE_SPEC_RING_SIZE];         /*!> vertical displacement, mm */
+    uint32_t    wr;             /*!> samples written, published after the sample */
+    uint32_t    done;           /*!> samples written when the former spectrum was computed, spectrum thread only */
+};
+
+/**
+@struct wave_spec_res_s
+@brief Wave parameters of a spotter
+*/
+struct wave_spec_res_s {
+    int         spotn;
+    uint64_t    tenths;         /*!> timestamp of the latest sample */
+    int         nb;             /*!> samples of the window received, the lost ones are interpolated */
+    float       fs;             /*!> sample rate, Hz, from the cadence of the spotter */
+    float       hs;             /*!> significant wave height 4 * sqrt(m0), m */
+    float       tp;             /*!> peak period, s */
+    float       tm02;           /*!> mean period sqrt(m0 / m2), s */
+    float       band[WAVE_SPEC_BANDS]; /*!> fraction of m0 in each band */
+};
+
+/**
+@struct wave_spec_s
+@brief Sample rings of all spotters, FFT tables and work buffers of the spectrum thread
+*/
+struct wave_spec_s {
+    struct wave_spec_ring_s ring[SPOTTER_NB];
+    int         window;         /*!> samples of a spectrum */
+    int         segment;        /*!> samples of a segment */
+    float       hann[WAVE_SPEC_SEG_MAX];
+    float       hann_pow;       /*!> sum of the squares of the window */
+    uint16_t    rev[WAVE_SPEC_SEG_MAX / 2];     /*!> bit reversed indexes of the half size complex FFT */
+    float       tw_re[WAVE_SPEC_SEG_MAX / 2];   /*!> twiddles of each stage, contiguous, stage of half size h at h - 1 */
+    float       tw_im[WAVE_SPEC_SEG_MAX / 2];
+    float       sp_re[WAVE_SPEC_SEG_MAX / 2];   /*!> twiddles splitting the half size FFT into the real FFT */
+    float       sp_im[WAVE_SPEC_SEG_MAX / 2];
+    uint64_t    t[WAVE_SPEC_WINDOW_MAX];        /*!> timestamps of the samples read from the ring */
+    float       z[WAVE_SPEC_WINDOW_MAX];        /*!> samples read from the ring, m */
+    float       x[WAVE_SPEC_WINDOW_MAX];        /*!> samples of the spectrum at the cadence, m */
+    float       seg[WAVE_SPEC_SEG_MAX];         /*!> windowed segment */
+    float       re[WAVE_SPEC_SEG_MAX / 2 + 1];
+    float       im[WAVE_SPEC_SEG_MAX / 2 + 1];
+    float       psd[WAVE_SPEC_SEG_MAX / 2 + 1]; /*!> averaged spectrum, m^2/Hz */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Empty the rings and build the tables
+@param w spectra
+@param window samples of a spectrum, a multiple of half a segment up to WAVE_SPEC_WINDOW_MAX
+@param segment samples of a segment, a power of 2 from WAVE_SPEC_SEG_MIN to WAVE_SPEC_SEG_MAX
+@return WAVE_SPEC_ERROR if the sizes are not valid, WAVE_SPEC_SUCCESS else
+*/
+int wave_spec_init(struct wave_spec_s *w, int window, int segment);
+
+/**
+@brief Add a sample of a spotter, from the acquisition thread
+@param w spectra
+@param spotn spotter number, samples of the other spotters are ignored
+@param tenths timestamp of the sample, tenths of a second since epoch
+@param z vertical displacement, mm
+
+A sample not newer than the latest one of the spotter, duplicate or late, is dropped.
+*/
+void wave_spec_push(struct wave_spec_s *w, int spotn, uint64_t tenths, int32_t z);
+
+/**
+@brief Compute the spectrum of the latest samples of a spotter, from a single other thread
+@param w spectra
+@param spotn spotter number
+@param r filled with the wave parameters
+@return WAVE_SPEC_NODATA if fewer samples than a window, no new sample or too many lost, WAVE_SPEC_SUCCESS else
+
+The samples are taken at the cadence of the spotter, the mean of the steps
+between its timestamps up to 1.5 times the median one, ending at the latest
+one; the lost ones are filled by linear interpolation across the gap. A
+window with more than WAVE_SPEC_LOSS_PCT % of its samples lost is skipped.
+*/
+int wave_spec_compute(struct wave_spec_s *w, int spotn, struct wave_spec_res_s *r);
+
+/**
+@brief Real FFT of a segment, as used by wave_spec_compute on the windowed segments
+@param w spectra, the size is the segment of wave_spec_init
+@param in segment samples, not overlapping re nor im
+@param re filled with the real parts of bins 0 to segment / 2
+@param im filled with the imaginary parts
+*/
+void wave_spec_rfft(const struct wave_spec_s *w, const float *restrict in, float *restrict re, float *restrict im);
+
+/**
+@brief Format the '$WAVE' line of a spectrum
+@param r wave parameters
+@param buf destination buffer, WAVE_SPEC_LINE_MAX bytes is always enough
+@param len size of the destination buffer
+@return length of the line, "$WAVE,<spotter>,<tenths>,<Hs m>,<Tp s>,<Tm02 s>,<sample rate Hz>,<samples>\n"
+*/
+int wave_spec_format(const struct wave_spec_res_s *r, char *buf, int len);
+
+/**
+@brief Format the '$WSPEC' line of a spectrum
+@param r wave parameters
+@param buf destination buffer, WAVE_SPEC_LINE_MAX bytes is always enough
+@param len size of the destination buffer
+@return length of the line, "$WSPEC,<spotter>,<first band mHz>,<band width mHz>,<16 bands, per mille of m0>\n"
+*/
+int wave_spec_format_bands(const struct wave_spec_res_s *r, char *buf, int len);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,90 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Commands of the TCP client, cut into lines.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <string.h>     /* memchr memmove */
+#include <sys/socket.h> /* recv */
+
+#include "client_cmd.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void client_cmd_init(struct client_cmd_s *c) {
+    c->len = 0;
+    c->pos = 0;
+    c->skip = false;
+    c->nb_drop = 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+ssize_t client_cmd_recv(struct client_cmd_s *c, int sock) {
+    ssize_t n;
+
+    /* the unfinished line goes to the start of the buffer */
+    if (c->pos > 0) {
+        memmove(c->buf, c->buf + c->pos, c->len - c->pos);
+        c->len -= c->pos;
+        c->pos = 0;
+    }
+    if (c->len == CLIENT_CMD_BUF_SIZE - 1) {
+        c->len = 0; /* no '\n' in a full buffer */
+        if (c->skip == false) {
+            c->skip = true;
+            c->nb_drop++;
+        }
+    }
+    n = recv(sock, c->buf + c->len, CLIENT_CMD_BUF_SIZE - 1 - c->len, MSG_DONTWAIT);
+    if (n > 0) {
+        c->len += (int)n;
+    }
+    return n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+const char *client_cmd_next(struct client_cmd_s *c) {
+    char *line, *nl;
+
+    while ((nl = memchr(c->buf + c->pos, '\n', c->len - c->pos)) != NULL) {
+        line = c->buf + c->pos;
+        c->pos = (int)(nl - c->buf) + 1;
+        *nl = '\0';
+        if ((nl > line) && (nl[-1] == '\r')) {
+            nl[-1] = '\0';
+        }
+        if (c->skip == true) {
+            c->skip = false; /* end of the line too long */
+            continue;
+        }
+        return line;
+    }
+    return NULL;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,302 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Subscription of the TCP client, compiled from its SUB command
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* snprintf */
+#include <string.h>     /* strncmp */
+
+#include "client_sub.h"
+#include "lora_frame.h"
+#include "spot_codec.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define CREDIT_LINE     1000000     /* credit of one line */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static bool is_end(char c) {
+    return (c == '\0') || (c == ' ') || (c == '\r') || (c == '\n');
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* read a decimal number, the pointer is moved past it */
+static int read_uint(const char **p, uint32_t max, uint32_t *val) {
+    uint32_t v = 0;
+
+    if ((**p < '0') || (**p > '9')) {
+        return -1;
+    }
+    while ((**p >= '0') && (**p <= '9')) {
+        v = v * 10 + (**p - '0');
+        if (v > max) {
+            return -1;
+        }
+        (*p)++;
+    }
+    *val = v;
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* everything wanted, as is */
+static void update_all(struct client_sub_s *s) {
+    s->all = (s->spot_mask == 0xFFFF) && (s->kind_mask == CLIENT_SUB_ALL) && (s->rate_max == 0) && (s->frames == false);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* kind of a line and its spotter number, -1 if it has none, 0 if the line is to be skipped */
+static uint8_t line_kind(const struct client_sub_s *s, const char *line, int len, int *spotn) {
+    const char *p;
+    uint32_t n;
+
+    *spotn = -1;
+    if ((len > LORA_FRAME_HDR_SIZE) && ((uint8_t)line[0] == LORA_FRAME_MAGIC)) {
+        if ((uint8_t)line[1] != LORA_FRAME_SPOT) {
+            return CLIENT_SUB_OTHER;
+        }
+        *spotn = (uint8_t)line[LORA_FRAME_HDR_SIZE]; /* first byte of the payload */
+        return CLIENT_SUB_PKT;
+    } else if ((len > 1) && (line[0] == '#')) {
+        if (s->frames == true) {
+            return 0;
+        }
+        p = line + 1;
+        if (read_uint(&p, CLIENT_SUB_SPOT_MAX - 1, &n) == 0) {
+            *spotn = (int)n;
+        }
+        return CLIENT_SUB_PKT;
+    } else if ((len > 6) && (strncmp(line, "$DIAG,", 6) == 0)) {
+        p = line + 6;
+        if (read_uint(&p, CLIENT_SUB_SPOT_MAX - 1, &n) == 0) {
+            *spotn = (int)n;
+        }
+        return CLIENT_SUB_DIAG;
+    } else if ((len > 5) && ((strncmp(line, "$STAT,", 6) == 0) || (strncmp(line, "$LOSS,", 6) == 0) || (strncmp(line, "$AIR,", 5) == 0))) {
+        p = line + ((line[1] == 'A') ? 5 : 6);
+        if (read_uint(&p, CLIENT_SUB_SPOT_MAX - 1, &n) == 0) {
+            *spotn = (int)n;
+        }
+        return CLIENT_SUB_STAT;
+    } else if ((len > 6) && ((strncmp(line, "$WAVE,", 6) == 0) || (strncmp(line, "$WSPEC,", 7) == 0))) {
+        p = line + ((line[2] == 'A') ? 6 : 7);
+        if (read_uint(&p, CLIENT_SUB_SPOT_MAX - 1, &n) == 0) {
+            *spotn = (int)n;
+        }
+        return CLIENT_SUB_WAVE;
+    }
+    return CLIENT_SUB_OTHER;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void client_sub_init(struct client_sub_s *s) {
+    memset(s, 0, sizeof *s);
+    s->spot_mask = 0xFFFF;
+    s->kind_mask = CLIENT_SUB_ALL;
+    update_all(s);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int client_sub_parse(struct client_sub_s *s, const char *cmd) {
+    uint16_t spot_mask = 0xFFFF;
+    uint8_t kind_mask = CLIENT_SUB_ALL;
+    uint32_t rate = 0;
+    uint32_t n;
+    uint16_t was, now;
+    const char *p;
+
+    if ((strncmp(cmd, "SUB", 3) != 0) || (is_end(cmd[3]) == false)) {
+        return CLIENT_SUB_ERROR;
+    }
+    p = cmd + 3;
+    while (*p == ' ') {
+        ++p;
+    }
+    while (is_end(*p) == false) {
+        if (strncmp(p, "spot=", 5) == 0) {
+            p += 5;
+            if (strncmp(p, "all", 3) == 0) {
+                p += 3;
+            } else {
+                spot_mask = 0;
+                for (;;) {
+                    if (read_uint(&p, CLIENT_SUB_SPOT_MAX - 1, &n) != 0) {
+                        return CLIENT_SUB_ERROR;
+                    }
+                    spot_mask |= (uint16_t)(1U << n);
+                    if (*p != ',') {
+                        break;
+                    }
+                    ++p;
+                }
+            }
+        } else if (strncmp(p, "kind=", 5) == 0) {
+            p += 5;
+            kind_mask = 0;
+            for (;;) {
+                if (strncmp(p, "PKT", 3) == 0) {
+                    kind_mask |= CLIENT_SUB_PKT;
+                    p += 3;
+                } else if (strncmp(p, "DIAG", 4) == 0) {
+                    kind_mask |= CLIENT_SUB_DIAG;
+                    p += 4;
+                } else if (strncmp(p, "STAT", 4) == 0) {
+                    kind_mask |= CLIENT_SUB_STAT;
+                    p += 4;
+                } else if (strncmp(p, "OTHER", 5) == 0) {
+                    kind_mask |= CLIENT_SUB_OTHER;
+                    p += 5;
+                } else if (strncmp(p, "WAVE", 4) == 0) {
+                    kind_mask |= CLIENT_SUB_WAVE;
+                    p += 4;
+                } else if (strncmp(p, "all", 3) == 0) {
+                    kind_mask |= CLIENT_SUB_ALL;
+                    p += 3;
+                } else {
+                    return CLIENT_SUB_ERROR;
+                }
+                if (*p != ',') {
+                    break;
+                }
+                ++p;
+            }
+        } else if (strncmp(p, "rate=", 5) == 0) {
+            p += 5;
+            if (read_uint(&p, 1000000, &rate) != 0) {
+                return CLIENT_SUB_ERROR;
+            }
+        } else {
+            return CLIENT_SUB_ERROR;
+        }
+        if (is_end(*p) == false) {
+            return CLIENT_SUB_ERROR;
+        }
+        while (*p == ' ') {
+            ++p;
+        }
+    }
+
+    /* the frames of a spotter subscribed to again follow ones the client did not get */
+    was = (s->kind_mask & CLIENT_SUB_PKT) ? s->spot_mask : 0;
+    now = (kind_mask & CLIENT_SUB_PKT) ? spot_mask : 0;
+    s->resync |= now & ~was;
+    s->rekey |= now & ~was;
+
+    s->spot_mask = spot_mask;
+    s->kind_mask = kind_mask;
+    s->rate_max = rate;
+    update_all(s);
+    s->credit = (uint64_t)rate * CREDIT_LINE; /* a full second to start with */
+    s->last_us = 0;
+    return CLIENT_SUB_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void client_sub_frames(struct client_sub_s *s, bool frames) {
+    s->frames = frames;
+    s->resync = 0; /* the encoder starts over with keyframes */
+    s->rekey = 0;
+    update_all(s);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int client_sub_filter(struct client_sub_s *s, struct iovec *lines, int nb, uint64_t now_us) {
+    uint64_t credit_max = (uint64_t)s->rate_max * CREDIT_LINE;
+    uint8_t kind;
+    const uint8_t *b;
+    uint16_t bit;
+    bool frame;
+    int spotn;
+    int i, nb_keep = 0;
+
+    if (s->all == true) {
+        s->nb_pass += nb;
+        return nb;
+    }
+
+    /* refill the rate budget, one second of lines at most */
+    if (s->rate_max > 0) {
+        if ((s->last_us != 0) && (now_us > s->last_us)) {
+            s->credit += (now_us - s->last_us) * s->rate_max;
+            if (s->credit > credit_max) {
+                s->credit = credit_max;
+            }
+        }
+        s->last_us = now_us;
+    }
+
+    for (i = 0; i < nb; ++i) {
+        kind = line_kind(s, lines[i].iov_base, (int)lines[i].iov_len, &spotn);
+        if (((kind & s->kind_mask) == 0) || ((spotn >= 0) && ((s->spot_mask & (1U << spotn)) == 0))) {
+            s->nb_skip++;
+            continue;
+        }
+        b = lines[i].iov_base;
+        frame = (kind == CLIENT_SUB_PKT) && (spotn >= 0) && (spotn < CLIENT_SUB_SPOT_MAX) && (lines[i].iov_len > LORA_FRAME_HDR_SIZE + 1) && (b[0] == LORA_FRAME_MAGIC);
+        bit = (frame == true) ? (uint16_t)(1U << spotn) : 0;
+        if (((s->resync & bit) != 0) && ((b[LORA_FRAME_HDR_SIZE + 1] & SPOT_CODEC_KEY) == 0)) {
+            s->nb_limit++; /* a delta against a frame the client did not get */
+            continue;
+        }
+        if (s->rate_max > 0) {
+            if (s->credit < CREDIT_LINE) {
+                s->nb_limit++;
+                s->resync |= bit;
+                s->rekey |= bit;
+                continue;
+            }
+            s->credit -= CREDIT_LINE;
+        }
+        s->resync &= ~bit;
+        lines[nb_keep++] = lines[i];
+    }
+    s->nb_pass += nb_keep;
+    return nb_keep;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint16_t client_sub_rekey(struct client_sub_s *s) {
+    uint16_t r = s->rekey;
+
+    s->rekey = 0;
+    return r;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int client_sub_format(const struct client_sub_s *s, char *buf, int len) {
+    int n;
+
+    n = snprintf(buf, len, "$SUB,%04X,%X,%u\n", s->spot_mask, s->kind_mask, s->rate_max);
+    return ((n < 0) || (n >= len)) ? len - 1 : n;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,136 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Single producer, single consumer ring of text lines
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <unistd.h>     /* pipe read write close */
+#include <fcntl.h>      /* fcntl O_NONBLOCK */
+
+#include "line_ring.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int line_ring_init(struct line_ring_s *r) {
+    int i;
+
+    r->head = 0;
+    r->tail = 0;
+    r->nb_drop = 0;
+    if (pipe(r->fd) != 0) {
+        r->fd[0] = r->fd[1] = -1;
+        return LINE_RING_ERROR;
+    }
+    for (i = 0; i < 2; ++i) {
+        fcntl(r->fd[i], F_SETFL, fcntl(r->fd[i], F_GETFL) | O_NONBLOCK);
+    }
+    return LINE_RING_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void line_ring_close(struct line_ring_s *r) {
+    if (r->fd[0] >= 0) {
+        close(r->fd[0]);
+        close(r->fd[1]);
+        r->fd[0] = r->fd[1] = -1;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+char *line_ring_reserve(struct line_ring_s *r) {
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+    if ((r->head - tail) >= LINE_RING_SIZE) {
+        __atomic_fetch_add(&r->nb_drop, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    return r->line[r->head % LINE_RING_SIZE].buf;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void line_ring_commit(struct line_ring_s *r, int len) {
+    r->line[r->head % LINE_RING_SIZE].len = (uint16_t)len;
+    __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void line_ring_notify(struct line_ring_s *r) {
+    char c = 0;
+
+    /* a full pipe already holds a pending wake-up */
+    if (write(r->fd[1], &c, 1) < 0) {
+        return;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+const char *line_ring_peek(struct line_ring_s *r, int *len) {
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+    if (head == r->tail) {
+        return NULL;
+    }
+    *len = r->line[r->tail % LINE_RING_SIZE].len;
+    return r->line[r->tail % LINE_RING_SIZE].buf;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+const char *line_ring_peek_at(struct line_ring_s *r, uint32_t n, int *len) {
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+    if ((head - r->tail) <= n) {
+        return NULL;
+    }
+    *len = r->line[(r->tail + n) % LINE_RING_SIZE].len;
+    return r->line[(r->tail + n) % LINE_RING_SIZE].buf;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void line_ring_pop(struct line_ring_s *r) {
+    __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void line_ring_pop_n(struct line_ring_s *r, uint32_t n) {
+    __atomic_store_n(&r->tail, r->tail + n, __ATOMIC_RELEASE);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void line_ring_ack(struct line_ring_s *r) {
+    char buf[64];
+
+    while (read(r->fd[0], buf, sizeof buf) > 0);
+}
+
+/* --- EOF ------------------------------------------------------------------ */
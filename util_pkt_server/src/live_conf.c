@@ -0,0 +1,79 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Reloadable settings of the acquisition thread, published RCU style
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <string.h>     /* memset */
+#include <time.h>       /* nanosleep */
+
+#include "live_conf.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define GRACE_POLL_NS   1000000 /* 1 ms between two checks of the reader epoch */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+struct live_conf_s *live_init(struct live_s *l) {
+    memset(l, 0, sizeof *l);
+    l->cur = &l->copy[0];
+    return l->cur;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+struct live_conf_s *live_spare(struct live_s *l) {
+    return (l->cur == &l->copy[0]) ? &l->copy[1] : &l->copy[0];
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void live_swap(struct live_s *l) {
+    __atomic_store_n(&l->cur, live_spare(l), __ATOMIC_SEQ_CST);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int live_publish(struct live_s *l, const int *stop) {
+    struct timespec ts = {0, GRACE_POLL_NS};
+    uint32_t epoch;
+
+    /* the reader loads the new pointer after its next quiescent state, whatever it holds now */
+    __atomic_store_n(&l->cur, live_spare(l), __ATOMIC_SEQ_CST);
+    epoch = __atomic_load_n(&l->epoch, __ATOMIC_SEQ_CST);
+
+    /* grace period, the reader went through a quiescent state after the swap */
+    while (__atomic_load_n(&l->epoch, __ATOMIC_ACQUIRE) == epoch) {
+        if (__atomic_load_n(stop, __ATOMIC_RELAXED) != 0) {
+            return LIVE_CONF_ERROR;
+        }
+        nanosleep(&ts, NULL);
+    }
+    return LIVE_CONF_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,193 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Batch filtering of the packets fetched by one lgw_receive_meta call.
+    Metadata are transposed into one 16-byte column per field so that the
+    accept mask of the whole batch is computed with a few vector compares
+    (SSE2 or NEON, scalar fallback otherwise).
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <string.h>     /* memset */
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+    #define PKT_FILTER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define PKT_FILTER_NEON
+#endif
+
+#include "pkt_filter.h"
+#include "loragw_pool.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+#if defined(PKT_FILTER_SSE2)
+
+static uint16_t filter_vector(const struct pkt_filter_s *f, const struct pkt_batch_s *b) {
+    __m128i acc = _mm_set1_epi8((char)0xFF);
+    int i;
+
+    for (i = 0; i < PKT_FIELD_NB; ++i) {
+        if (f->enable[i]) {
+            __m128i c = _mm_load_si128((const __m128i *)b->col[i]);
+            acc = _mm_and_si128(acc, _mm_cmpeq_epi8(c, _mm_set1_epi8((char)f->value[i])));
+        }
+    }
+    return (uint16_t)_mm_movemask_epi8(acc);
+}
+
+#elif defined(PKT_FILTER_NEON)
+
+static uint16_t filter_vector(const struct pkt_filter_s *f, const struct pkt_batch_s *b) {
+    static const uint8_t bit_weight[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t acc = vdupq_n_u8(0xFF);
+    uint8x8_t lo, hi;
+    int i;
+
+    for (i = 0; i < PKT_FIELD_NB; ++i) {
+        if (f->enable[i]) {
+            acc = vandq_u8(acc, vceqq_u8(vld1q_u8(b->col[i]), vdupq_n_u8(f->value[i])));
+        }
+    }
+
+    /* no movemask on NEON: keep one weight per lane and add them pairwise */
+    acc = vandq_u8(acc, vld1q_u8(bit_weight));
+    lo = vget_low_u8(acc);
+    hi = vget_high_u8(acc);
+    lo = vpadd_u8(lo, hi);
+    lo = vpadd_u8(lo, lo);
+    lo = vpadd_u8(lo, lo);
+    return (uint16_t)(vget_lane_u8(lo, 0) | (vget_lane_u8(lo, 1) << 8));
+}
+
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void pkt_filter_default(struct pkt_filter_s *f) {
+    pkt_filter_set(f, PKT_FIELD_STATUS, STAT_CRC_OK);
+    pkt_filter_set(f, PKT_FIELD_MODULATION, MOD_LORA);
+    pkt_filter_set(f, PKT_FIELD_BANDWIDTH, BW_125KHZ);
+    pkt_filter_set(f, PKT_FIELD_DATARATE, DR_LORA_SF7);
+    pkt_filter_set(f, PKT_FIELD_CODERATE, CR_LORA_4_5);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void pkt_filter_set(struct pkt_filter_s *f, int field, uint8_t value) {
+    if ((field >= 0) && (field < PKT_FIELD_NB)) {
+        f->enable[field] = true;
+        f->value[field] = value;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void pkt_filter_any(struct pkt_filter_s *f, int field) {
+    if ((field >= 0) && (field < PKT_FIELD_NB)) {
+        f->enable[field] = false;
+        f->value[field] = 0;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void pkt_batch_load(struct pkt_batch_s *b, const struct lgw_pkt_meta_s *meta, int nb) {
+    int i;
+
+    if (nb > PKT_BATCH_SIZE) {
+        nb = PKT_BATCH_SIZE;
+    }
+
+    /* unused lanes are zeroed, the caller masks them out anyway */
+    memset(b->col, 0, sizeof b->col);
+    for (i = 0; i < nb; ++i) {
+        b->col[PKT_FIELD_STATUS][i] = meta[i].status;
+        b->col[PKT_FIELD_MODULATION][i] = meta[i].modulation;
+        b->col[PKT_FIELD_BANDWIDTH][i] = meta[i].bandwidth;
+        b->col[PKT_FIELD_DATARATE][i] = meta[i].datarate;
+        b->col[PKT_FIELD_CODERATE][i] = meta[i].coderate;
+        b->freq_hz[i] = meta[i].freq_hz;
+        b->slot[i] = meta[i].slot;
+        b->size[i] = meta[i].size;
+    }
+    b->nb = (nb > 0) ? nb : 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint16_t pkt_filter_run_scalar(const struct pkt_filter_s *f, const struct pkt_batch_s *b) {
+    uint16_t mask = 0;
+    int i, j;
+    bool ok;
+
+    for (i = 0; i < b->nb; ++i) {
+        ok = true;
+        for (j = 0; j < PKT_FIELD_NB; ++j) {
+            ok &= (!f->enable[j]) || (b->col[j][i] == f->value[j]);
+        }
+        mask |= (uint16_t)ok << i;
+    }
+    return mask;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint16_t pkt_filter_run(const struct pkt_filter_s *f, const struct pkt_batch_s *b) {
+#if defined(PKT_FILTER_SSE2) || defined(PKT_FILTER_NEON)
+    uint16_t valid = (b->nb >= PKT_BATCH_SIZE) ? 0xFFFF : (uint16_t)((1U << b->nb) - 1);
+    return filter_vector(f, b) & valid;
+#else
+    return pkt_filter_run_scalar(f, b);
+#endif
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint16_t pkt_batch_decode(const struct pkt_batch_s *b, uint16_t mask, struct spotter_data_s *d) {
+    struct lgw_pkt_buf_s *buf;
+    uint16_t m = mask;
+    int i;
+
+    while (m != 0) {
+        i = __builtin_ctz(m);
+        m &= m - 1;
+        buf = lgw_pool_slot(b->slot[i]);
+        if ((buf == NULL) || (spotter_decode(buf->data, b->size[i], &d[i]) != 0)) {
+            mask &= ~(1U << i);
+        }
+    }
+    return mask;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+const char *pkt_filter_impl(void) {
+#if defined(PKT_FILTER_SSE2)
+    return "sse2";
+#elif defined(PKT_FILTER_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+/* --- EOF ------------------------------------------------------------------ */
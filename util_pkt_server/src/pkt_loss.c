@@ -0,0 +1,173 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Live packet loss of each spotter, from the steps between the timestamps
+    of its samples.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* snprintf */
+#include <string.h>     /* memset */
+
+#include "pkt_loss.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* remember the timestamps received, moving the latest one up clears the ones left behind */
+static void see(struct pkt_loss_chan_s *c, uint64_t tenths) {
+    uint64_t t;
+
+    if ((tenths > c->last) && (tenths - c->last >= PKT_LOSS_SEEN)) {
+        memset(c->seen, 0, sizeof c->seen);
+    } else {
+        for (t = c->last + 1; t < tenths; ++t) {
+            c->seen[(t % PKT_LOSS_SEEN) / 32] &= ~(1U << (t % 32));
+        }
+    }
+    c->seen[(tenths % PKT_LOSS_SEEN) / 32] |= 1U << (tenths % 32);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool seen(const struct pkt_loss_chan_s *c, uint64_t tenths) {
+    return (c->last - tenths < PKT_LOSS_SEEN) && (c->seen[(tenths % PKT_LOSS_SEEN) / 32] & (1U << (tenths % 32)));
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void count(struct pkt_loss_s *l, struct pkt_loss_chan_s *c, uint64_t tenths, uint32_t lost, bool late) {
+    uint64_t b;
+    int i;
+
+    c->nb_rx++;
+    c->nb_lost += lost;
+    for (i = 0; i < l->nb_win; ++i) {
+        b = tenths / l->win_s[i]; /* a bucket is a tenth of the window */
+        roll_win_add(&c->rx[i], b, 1);
+        roll_win_add(&c->lost[i], b, lost);
+        if (late == true) {
+            roll_win_take(&c->lost[i]);
+        }
+    }
+    if ((late == true) && (c->nb_lost > 0)) {
+        c->nb_lost--;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int pkt_loss_init(struct pkt_loss_s *l, const uint32_t *win_s, int nb_win) {
+    int i;
+
+    if ((nb_win < 0) || (nb_win > PKT_LOSS_WINDOW_MAX)) {
+        return PKT_LOSS_ERROR;
+    }
+    for (i = 0; i < nb_win; ++i) {
+        if (win_s[i] == 0) {
+            return PKT_LOSS_ERROR;
+        }
+    }
+    memset(l, 0, sizeof *l);
+    l->nb_win = nb_win;
+    for (i = 0; i < nb_win; ++i) {
+        l->win_s[i] = win_s[i];
+    }
+    return PKT_LOSS_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void pkt_loss_add(struct pkt_loss_s *l, int spotn, uint64_t tenths, time_t now) {
+    struct pkt_loss_chan_s *c;
+    uint32_t step_x256;
+    int64_t step;
+
+    if ((spotn < 0) || (spotn >= SPOTTER_NB) || (tenths == 0)) {
+        return;
+    }
+    c = &l->chan[spotn];
+    c->last_rx = now;
+    step = (int64_t)(tenths - c->last);
+    if (c->last == 0) {
+        memset(c->seen, 0, sizeof c->seen);
+        see(c, tenths);
+        c->last = tenths;
+        count(l, c, tenths, 0, false);
+    } else if ((step <= 0) && (seen(c, tenths) == true)) {
+        c->nb_dup++; /* the latest sample again, or an older one already received */
+    } else if ((step > PKT_LOSS_GAP_MAX_S * 10) || (step < -PKT_LOSS_GAP_MAX_S * 10)) {
+        c->nb_resync++;
+        memset(c->seen, 0, sizeof c->seen);
+        see(c, tenths);
+        c->last = tenths;
+        count(l, c, tenths, 0, false);
+    } else if (step < 0) {
+        c->nb_late++;
+        see(c, tenths);
+        count(l, c, tenths, 0, true);
+    } else {
+        step_x256 = (uint32_t)step * 256;
+        see(c, tenths);
+        c->last = tenths;
+        if ((c->period_x256 == 0) || (4 * step_x256 <= 3 * c->period_x256)) {
+            c->period_x256 = step_x256; /* first step, or the former ones were gaps */
+            count(l, c, tenths, 0, false);
+        } else if (2 * step_x256 <= 3 * c->period_x256) {
+            c->period_x256 = (uint32_t)((int32_t)c->period_x256 + ((int32_t)step_x256 - (int32_t)c->period_x256) / 16);
+            count(l, c, tenths, 0, false);
+        } else {
+            count(l, c, tenths, (step_x256 + c->period_x256 / 2) / c->period_x256 - 1, false);
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int pkt_loss_format(const struct pkt_loss_s *l, int spotn, time_t now, char *buf, int len) {
+    const struct pkt_loss_chan_s *c = &l->chan[spotn];
+    uint32_t rx, lost;
+    char period[16] = "";
+    char age[16] = "";
+    int n, i;
+
+    /* empty fields while unknown */
+    if (c->period_x256 > 0) {
+        snprintf(period, sizeof period, "%.2f", c->period_x256 / 2560.0);
+    }
+    if (c->last != 0) {
+        snprintf(age, sizeof age, "%ld", (long)(now - c->last_rx));
+    }
+    n = snprintf(buf, len, "$LOSS,%d,%s,%u,%u,%u,%u,%u,%s", spotn, period, c->nb_rx, c->nb_lost, c->nb_dup, c->nb_late, c->nb_resync, age);
+    for (i = 0; (n > 0) && (n < len) && (i < l->nb_win); ++i) {
+        rx = c->rx[i].sum;
+        lost = c->lost[i].sum;
+        if (rx + lost > 0) {
+            n += snprintf(buf + n, len - n, ",%.1f", 100.0 * lost / (rx + lost));
+        } else {
+            n += snprintf(buf + n, len - n, ",");
+        }
+    }
+    if ((n > 0) && (n < len - 1)) {
+        buf[n++] = '\n';
+        buf[n] = '\0';
+    }
+    return ((n < 0) || (n >= len)) ? len - 1 : n;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
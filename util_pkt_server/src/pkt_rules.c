@@ -0,0 +1,177 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Forwarding rules: which packets of which spotter go to which output.
+    Rules are collected while parsing the configuration, then compiled once
+    into a flat table indexed by spotter number, holding only bitmasks and
+    thresholds, so that evaluating a packet needs no lookup.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <string.h>     /* memset */
+
+#include "pkt_rules.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* position of the only bit set in x, -1 if none or several are set */
+static int single_bit(unsigned x) {
+    if ((x == 0) || ((x & (x - 1)) != 0)) {
+        return -1;
+    }
+    return __builtin_ctz(x);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void pkt_rules_init(struct pkt_rules_s *r) {
+    memset(r, 0, sizeof *r);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void pkt_rule_any(struct pkt_rule_s *rule) {
+    rule->status_mask = 0xFF;
+    rule->mod_mask = 0xFF;
+    rule->bw_mask = 0xFF;
+    rule->sf_mask = 0xFF;
+    rule->cr_mask = 0xFF;
+    rule->min_snr_x4 = RULE_NO_MIN_SNR;
+    rule->min_rssi_x16 = RULE_NO_MIN_RSSI;
+    rule->outputs = 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void pkt_rule_from_filter(struct pkt_rule_s *rule, const struct pkt_filter_s *f, uint8_t outputs) {
+    pkt_rule_any(rule);
+    if (f->enable[PKT_FIELD_STATUS]) {
+        rule->status_mask = RULE_STAT_BIT(f->value[PKT_FIELD_STATUS]);
+    }
+    if (f->enable[PKT_FIELD_MODULATION]) {
+        rule->mod_mask = RULE_MOD_BIT(f->value[PKT_FIELD_MODULATION]);
+    }
+    if (f->enable[PKT_FIELD_BANDWIDTH]) {
+        rule->bw_mask = 1U << f->value[PKT_FIELD_BANDWIDTH];
+    }
+    if (f->enable[PKT_FIELD_DATARATE]) {
+        rule->sf_mask = f->value[PKT_FIELD_DATARATE];
+    }
+    if (f->enable[PKT_FIELD_CODERATE]) {
+        rule->cr_mask = 1U << f->value[PKT_FIELD_CODERATE];
+    }
+    rule->outputs = outputs;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int pkt_rules_add(struct pkt_rules_s *r, int spotn, uint32_t freq_hz, const struct pkt_rule_s *rule) {
+    if (r->nb_pending >= RULES_PENDING_MAX) {
+        return -1;
+    }
+    r->pending[r->nb_pending] = *rule;
+    r->pending_spotn[r->nb_pending] = spotn;
+    r->pending_freq[r->nb_pending] = freq_hz;
+    r->nb_pending++;
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int pkt_rules_compile(struct pkt_rules_s *r, const int32_t *chanlist, int nb_chan) {
+    int i, j, s;
+    int err = 0;
+
+    memset(r->table, 0, sizeof r->table);
+    memset(r->nb, 0, sizeof r->nb);
+
+    for (i = 0; i < r->nb_pending; ++i) {
+        s = r->pending_spotn[i];
+        if (r->pending_freq[i] != 0) {
+            /* resolve the frequency into a spotter number */
+            s = -2;
+            for (j = 0; (j < nb_chan) && (j < SPOTTER_NB); ++j) {
+                if ((int64_t)chanlist[j] == (int64_t)r->pending_freq[i]) {
+                    s = j;
+                }
+            }
+        }
+        for (j = 0; j < SPOTTER_NB; ++j) {
+            if ((s != RULE_ALL_SPOTTERS) && (s != j)) {
+                continue;
+            }
+            if (r->nb[j] >= RULES_PER_SPOTTER) {
+                err = -1;
+                continue;
+            }
+            r->table[j][r->nb[j]++] = r->pending[i];
+        }
+        if ((s != RULE_ALL_SPOTTERS) && ((s < 0) || (s >= SPOTTER_NB))) {
+            err = -1; /* no such spotter */
+        }
+    }
+
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void pkt_rules_prefilter(const struct pkt_rules_s *r, struct pkt_filter_s *f) {
+    uint8_t st = 0, mod = 0, bw = 0, sf = 0, cr = 0;
+    const struct pkt_rule_s *rule;
+    int i, j, b;
+
+    /* union of the allowed sets of every rule: a packet outside it matches nothing */
+    for (i = 0; i < SPOTTER_NB; ++i) {
+        for (j = 0; j < r->nb[i]; ++j) {
+            rule = &r->table[i][j];
+            if (rule->outputs == 0) {
+                continue;
+            }
+            st |= rule->status_mask;
+            mod |= rule->mod_mask;
+            bw |= rule->bw_mask;
+            sf |= rule->sf_mask;
+            cr |= rule->cr_mask;
+        }
+    }
+
+    /* only single values can be tested by the vector equality filter */
+    memset(f, 0, sizeof *f);
+    switch (st) {
+        case RULE_STAT_CRC_OK:      pkt_filter_set(f, PKT_FIELD_STATUS, STAT_CRC_OK); break;
+        case RULE_STAT_CRC_BAD:     pkt_filter_set(f, PKT_FIELD_STATUS, STAT_CRC_BAD); break;
+        case RULE_STAT_NO_CRC:      pkt_filter_set(f, PKT_FIELD_STATUS, STAT_NO_CRC); break;
+        case RULE_STAT_UNDEFINED:   pkt_filter_set(f, PKT_FIELD_STATUS, STAT_UNDEFINED); break;
+    }
+    if ((b = single_bit(mod)) >= 0) {
+        pkt_filter_set(f, PKT_FIELD_MODULATION, (uint8_t)((1U << b) << 4));
+    }
+    if ((b = single_bit(bw)) >= 0) {
+        pkt_filter_set(f, PKT_FIELD_BANDWIDTH, (uint8_t)b);
+    }
+    if (((b = single_bit(sf)) >= 0) && (mod == RULE_MOD_BIT(MOD_LORA))) {
+        pkt_filter_set(f, PKT_FIELD_DATARATE, (uint8_t)(1U << b));
+    }
+    if (((b = single_bit(cr)) >= 0) && (mod == RULE_MOD_BIT(MOD_LORA))) {
+        pkt_filter_set(f, PKT_FIELD_CODERATE, (uint8_t)b);
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,95 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Per spotter packet and noise statistics.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* snprintf */
+#include <string.h>     /* memset */
+
+#include "pkt_stats.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void pkt_stats_init(struct pkt_stats_s *s) {
+    memset(s, 0, sizeof *s);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void pkt_stats_add(struct pkt_stats_s *s, int spotn, const struct lgw_pkt_meta_s *m) {
+    struct pkt_stats_chan_s *c;
+
+    if ((spotn < 0) || (spotn >= SPOTTER_NB)) {
+        return;
+    }
+    c = &s->chan[spotn];
+    c->nb_rx++;
+    if (m->status == STAT_CRC_OK) {
+        c->nb_crc_ok++;
+    } else if (m->status == STAT_CRC_BAD) {
+        c->nb_crc_bad++;
+    }
+    c->rssi_sum_x16 += m->rssi_x16;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void pkt_stats_noise(struct pkt_stats_s *s, int spotn, float noise_dbm, float occupancy) {
+    if ((spotn < 0) || (spotn >= SPOTTER_NB)) {
+        return;
+    }
+    s->chan[spotn].noise_valid = true;
+    s->chan[spotn].noise_dbm = noise_dbm;
+    s->chan[spotn].occupancy = occupancy;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int pkt_stats_format(const struct pkt_stats_s *s, int spotn, char *buf, int len) {
+    const struct pkt_stats_chan_s *c = &s->chan[spotn];
+    char rssi[16] = "";
+    char noise[32] = ",";
+    int n;
+
+    /* empty fields when nothing was measured */
+    if (c->nb_rx > 0) {
+        snprintf(rssi, sizeof rssi, "%.1f", c->rssi_sum_x16 / 16.0 / c->nb_rx);
+    }
+    if (c->noise_valid == true) {
+        snprintf(noise, sizeof noise, "%.1f,%.1f", c->noise_dbm, 100.0 * c->occupancy);
+    }
+    n = snprintf(buf, len, "$STAT,%d,%u,%u,%u,%s,%s\n", spotn, c->nb_rx, c->nb_crc_ok, c->nb_crc_bad, rssi, noise);
+    return ((n < 0) || (n >= len)) ? len - 1 : n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void pkt_stats_period(struct pkt_stats_s *s) {
+    int i;
+
+    for (i = 0; i < SPOTTER_NB; ++i) {
+        s->chan[i].nb_rx = 0;
+        s->chan[i].nb_crc_ok = 0;
+        s->chan[i].nb_crc_bad = 0;
+        s->chan[i].rssi_sum_x16 = 0;
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
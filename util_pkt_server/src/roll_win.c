@@ -0,0 +1,80 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Rolling window of fixed buckets, shared by the loss and airtime counters
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <string.h>     /* memset */
+
+#include "roll_win.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* move a window to a bucket, the buckets left behind are cleared */
+static void move_to(struct roll_win_s *w, uint64_t b) {
+    int k;
+
+    if (b >= w->bucket + ROLL_WIN_BUCKETS) {
+        memset(w, 0, sizeof *w);
+        w->bucket = b;
+    } else {
+        while (w->bucket < b) {
+            k = (int)(++w->bucket % ROLL_WIN_BUCKETS);
+            w->sum -= w->val[k];
+            w->val[k] = 0;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void roll_win_add(struct roll_win_s *w, uint64_t b, uint32_t n) {
+    move_to(w, b);
+    w->val[w->bucket % ROLL_WIN_BUCKETS] += n;
+    w->sum += n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+bool roll_win_take(struct roll_win_s *w) {
+    int k;
+
+    if (w->sum == 0) {
+        return false;
+    }
+    for (k = (int)(w->bucket % ROLL_WIN_BUCKETS); w->val[k] == 0; k = (k + ROLL_WIN_BUCKETS - 1) % ROLL_WIN_BUCKETS);
+    w->val[k]--;
+    w->sum--;
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint64_t roll_win_sum_from(const struct roll_win_s *w, uint64_t from) {
+    uint64_t sum = 0;
+    int k;
+
+    for (k = 0; (k < ROLL_WIN_BUCKETS) && ((uint64_t)k <= w->bucket) && (w->bucket - k >= from); ++k) {
+        sum += w->val[(w->bucket - k) % ROLL_WIN_BUCKETS];
+    }
+    return sum;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,136 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Optional real-time mode of the acquisition path
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#define _GNU_SOURCE     /* needed for cpu_set_t and pthread_setaffinity_np to be defined */
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <string.h>     /* memset */
+#include <sched.h>      /* sched_param CPU_SET */
+#include <unistd.h>     /* sysconf */
+#include <sys/mman.h>   /* mlockall */
+#include <pthread.h>
+
+#include "rt_sched.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* touch the stack below the caller, one write per page, so that its deepest use does not fault later */
+static __attribute__((noinline)) void prefault_stack(void) {
+    volatile uint8_t stack[RT_STACK_PREFAULT];
+    long page = sysconf(_SC_PAGESIZE);
+    unsigned i;
+
+    if (page <= 0) {
+        page = 4096;
+    }
+    for (i = 0; i < sizeof stack; i += (unsigned)page) {
+        stack[i] = 0;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void rt_conf_default(struct rt_conf_s *conf) {
+    memset(conf, 0, sizeof *conf);
+    conf->enable = false;
+    conf->priority = 80;
+    conf->cpu = -1;
+    conf->lock_memory = true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int rt_lock_memory(const struct rt_conf_s *conf) {
+    if ((conf->enable == false) || (conf->lock_memory == false)) {
+        return RT_SCHED_SUCCESS;
+    }
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        return RT_SCHED_ERROR;
+    }
+    return RT_SCHED_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int rt_thread_attr(pthread_attr_t *attr) {
+    if (pthread_attr_init(attr) != 0) {
+        return RT_SCHED_ERROR;
+    }
+    /* the default stack is several MB, all of it would be locked */
+    if (pthread_attr_setstacksize(attr, RT_STACK_SIZE) != 0) {
+        pthread_attr_destroy(attr);
+        return RT_SCHED_ERROR;
+    }
+    return RT_SCHED_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int rt_sched_acq(const struct rt_conf_s *conf) {
+    struct sched_param param;
+    cpu_set_t set;
+    int err = 0;
+
+    if (conf->enable == false) {
+        return RT_SCHED_SUCCESS;
+    }
+
+    if (conf->cpu >= 0) {
+        CPU_ZERO(&set);
+        CPU_SET(conf->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof set, &set) != 0) {
+            err++;
+        }
+    }
+
+    memset(&param, 0, sizeof param);
+    param.sched_priority = conf->priority;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+        err++;
+    }
+
+    prefault_stack();
+    return (err == 0) ? RT_SCHED_SUCCESS : RT_SCHED_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int rt_sched_other(const struct rt_conf_s *conf) {
+    cpu_set_t set;
+
+    if ((conf->enable == false) || (conf->cpu < 0)) {
+        return RT_SCHED_SUCCESS;
+    }
+
+    if (sched_getaffinity(0, sizeof set, &set) != 0) {
+        return RT_SCHED_ERROR;
+    }
+    CPU_CLR(conf->cpu, &set);
+    if (CPU_COUNT(&set) == 0) {
+        return RT_SCHED_ERROR; /* no other CPU to run on */
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof set, &set) != 0) {
+        return RT_SCHED_ERROR;
+    }
+    return RT_SCHED_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,158 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Airtime, utilisation and overlapping receptions of each spotter channel.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* snprintf */
+#include <string.h>     /* memset */
+
+#include "rx_airtime.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int rx_airtime_init(struct rx_airtime_s *a, int preamble, const uint32_t *win_s, int nb_win) {
+    int sf, size, de, num;
+    int i;
+
+    if ((preamble < 6) || (preamble > 1000) || (nb_win < 0) || (nb_win > RX_AIRTIME_WINDOW_MAX)) {
+        return RX_AIRTIME_ERROR;
+    }
+    for (i = 0; i < nb_win; ++i) {
+        if ((win_s[i] == 0) || (win_s[i] > RX_AIRTIME_WINDOW_S_MAX)) {
+            return RX_AIRTIME_ERROR;
+        }
+    }
+    memset(a, 0, sizeof *a);
+    a->nb_win = nb_win;
+    for (i = 0; i < nb_win; ++i) {
+        a->win_s[i] = win_s[i];
+    }
+
+    /* preamble, 4.25 symbols of sync word and the 8 symbols of the header block */
+    a->pre_x4 = (uint16_t)(4 * preamble + 17 + 4 * 8);
+
+    /* payload and CRC blocks, as lgw_time_on_air: low datarate optimisation from SF11 */
+    for (sf = 7; sf <= 12; ++sf) {
+        de = (sf >= 11) ? 1 : 0;
+        for (size = 0; size < 256; ++size) {
+            num = 8 * size - 4 * sf + 28 + 16;
+            a->blocks[sf - 7][size] = (num > 0) ? (uint8_t)((num + 4 * (sf - 2 * de) - 1) / (4 * (sf - 2 * de))) : 0;
+        }
+    }
+    return RX_AIRTIME_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint32_t rx_airtime_packet(const struct rx_airtime_s *a, const struct lgw_pkt_meta_s *m) {
+    uint32_t sym_x4;
+    int sf;
+
+    if ((m->modulation != MOD_LORA) || (m->datarate < DR_LORA_SF7) || (m->datarate > DR_LORA_SF12) || ((m->datarate & (m->datarate - 1)) != 0) ||
+        (m->bandwidth < BW_500KHZ) || (m->bandwidth > BW_7K8HZ) || (m->coderate < CR_LORA_4_5) || (m->coderate > CR_LORA_4_8)) {
+        return 0;
+    }
+    sf = __builtin_ctz(m->datarate) + 6; /* DR_LORA_SF7 is bit 1 */
+    sym_x4 = a->pre_x4 + 4 * (uint32_t)a->blocks[sf - 7][m->size] * (m->coderate + 4);
+
+    /* a quarter of a symbol is 2^SF / 4 us at 1 MHz, each BW code halves the bandwidth from 500 kHz */
+    return sym_x4 << (sf + m->bandwidth - 2);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void rx_airtime_add(struct rx_airtime_s *a, int spotn, const struct lgw_pkt_meta_s *m) {
+    struct rx_airtime_chan_s *c;
+    uint64_t end = m->count_us64;
+    uint32_t air;
+    int i;
+
+    if ((spotn < 0) || (spotn >= SPOTTER_NB)) {
+        return;
+    }
+    air = rx_airtime_packet(a, m);
+    if (air == 0) {
+        return;
+    }
+    c = &a->chan[spotn];
+    c->nb_rx++;
+    c->air_us += air;
+    if ((c->nb_rx > 1) && (end < c->end_us + air)) {
+        c->nb_overlap++; /* started before the end of the former packet */
+        if (m->status == STAT_CRC_BAD) {
+            c->nb_overlap_bad++;
+        }
+    }
+    if (end > c->end_us) {
+        c->end_us = end;
+    }
+    if (a->start_us == 0) {
+        a->start_us = end;
+    }
+    if (end > a->last_us) {
+        a->last_us = end;
+    }
+    for (i = 0; i < a->nb_win; ++i) {
+        roll_win_add(&c->win[i], end / (a->win_s[i] * (100000ULL * 10 / ROLL_WIN_BUCKETS)), air);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int rx_airtime_format(const struct rx_airtime_s *a, int spotn, uint64_t now_us, char *buf, int len) {
+    const struct rx_airtime_chan_s *c = &a->chan[spotn];
+    uint64_t blen, nb, first, lo, sum;
+    char mean[16] = "";
+    int n, i;
+
+    if (now_us < a->last_us) {
+        now_us = a->last_us;
+    }
+
+    /* empty fields while unknown */
+    if (c->nb_rx > 0) {
+        snprintf(mean, sizeof mean, "%.1f", c->air_us / 1000.0 / c->nb_rx);
+    }
+    n = snprintf(buf, len, "$AIR,%d,%u,%s,%u,%u", spotn, c->nb_rx, mean, c->nb_overlap, c->nb_overlap_bad);
+    for (i = 0; (n > 0) && (n < len) && (i < a->nb_win); ++i) {
+        blen = a->win_s[i] * (100000ULL * 10 / ROLL_WIN_BUCKETS);
+        nb = now_us / blen;
+
+        /* the latest buckets up to now, the current one partly elapsed */
+        first = (nb >= ROLL_WIN_BUCKETS - 1) ? nb - (ROLL_WIN_BUCKETS - 1) : 0;
+        lo = first * blen;
+        if (lo < a->start_us) {
+            lo = a->start_us;
+        }
+        sum = roll_win_sum_from(&c->win[i], first);
+        if ((a->start_us > 0) && (now_us > lo)) {
+            n += snprintf(buf + n, len - n, ",%.1f", 100.0 * sum / (now_us - lo));
+        } else {
+            n += snprintf(buf + n, len - n, ",");
+        }
+    }
+    if ((n > 0) && (n < len - 1)) {
+        buf[n++] = '\n';
+        buf[n] = '\0';
+    }
+    return ((n < 0) || (n >= len)) ? len - 1 : n;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
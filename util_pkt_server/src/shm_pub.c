@@ -0,0 +1,92 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Publication of the lines sent to the client in a POSIX shared memory ring
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <string.h>     /* memset strncpy */
+#include <unistd.h>     /* ftruncate close */
+#include <fcntl.h>      /* O_CREAT O_RDWR */
+#include <sys/mman.h>   /* shm_open mmap */
+
+#include "shm_pub.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int shm_pub_open(struct shm_pub_s *p, const char *name) {
+    void *m;
+    int fd;
+
+    memset(p, 0, sizeof *p);
+    strncpy(p->name, name, sizeof p->name - 1);
+    p->size = shm_ring_size(SHM_RING_NB_SLOT);
+
+    /* readers map it read-only, the ring of a former run is taken over */
+    fd = shm_open(p->name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        return SHM_PUB_ERROR;
+    }
+    if (ftruncate(fd, p->size) != 0) {
+        close(fd);
+        return SHM_PUB_ERROR;
+    }
+    m = mmap(NULL, p->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        return SHM_PUB_ERROR;
+    }
+    p->ring = m;
+    shm_ring_init(p->ring, SHM_RING_NB_SLOT);
+    return SHM_PUB_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void shm_pub_send(struct shm_pub_s *p, const struct iovec *lines, int nb) {
+    size_t len;
+    int i;
+
+    for (i = 0; i < nb; ++i) {
+        len = lines[i].iov_len;
+        if ((len > 0) && (((const char *)lines[i].iov_base)[len - 1] == '\n')) {
+            --len;
+        }
+        shm_ring_put(p->ring, lines[i].iov_base, len);
+    }
+    p->nb_line += nb;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void shm_pub_close(struct shm_pub_s *p) {
+    if (p->ring != NULL) {
+        shm_ring_stop(p->ring);
+        munmap(p->ring, p->size);
+        shm_unlink(p->name);
+        p->ring = NULL;
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,84 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Decoding of the spotter payloads and formatting of the lines sent to the
+    network client.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdio.h>      /* snprintf */
+
+#include "spotter.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static inline uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int spotter_decode(const uint8_t *payload, uint16_t size, struct spotter_data_s *d) {
+    if ((payload == NULL) || (d == NULL) || (size < SPOTTER_PAYLOAD_SIZE)) {
+        return -1;
+    }
+
+    d->type = payload[0];
+    d->timestamp = get_u32(&payload[1]);
+    d->timestamp_f = payload[5];
+    d->X = (int32_t)get_u32(&payload[6]);
+    d->Y = (int32_t)get_u32(&payload[10]);
+    d->Z = (int32_t)get_u32(&payload[14]);
+    d->LATD = (char)payload[18];
+    d->LATM = (int32_t)get_u32(&payload[19]);
+    d->LOND = (int32_t)get_u32(&payload[23]);
+    d->LONM = (int32_t)get_u32(&payload[27]);
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint64_t spotter_tenths(const struct spotter_data_s *d) {
+    // Resulting timestamp will be in tenths of a second since epoch, the fractional part limited
+    return (uint64_t)d->timestamp * 10 + ((d->timestamp_f > 9) ? 9 : d->timestamp_f);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int spotter_format(const struct spotter_data_s *d, int spotn, char *buf, size_t len) {
+    unsigned long long int extended_timestamp;
+    float latitude, longitude;
+
+    extended_timestamp = (unsigned long long int)spotter_tenths(d);
+
+    // Convert deg & min back to decimal degrees before sending
+    latitude = d->LATD + (d->LATM / 6000000.0);
+    longitude = d->LOND + (d->LONM / 6000000.0);
+
+    return snprintf(buf, len, "#%d,%hhu,%llu,%ld,%ld,%ld,%.9f,%.9f\n", spotn,
+                                                          d->type,
+                                                          extended_timestamp,
+                                                          (long int)d->X,
+                                                          (long int)d->Y,
+                                                          (long int)d->Z,
+                                                          latitude,
+                                                          longitude);
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,67 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    GPS time reference shared between the time-sync thread and the packet
+    processing loop, published under a seqlock.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <string.h>     /* memset */
+#include <time.h>       /* time */
+
+#include "time_ref.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void time_ref_init(struct time_ref_s *t) {
+    memset(t, 0, sizeof *t);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void time_ref_publish(struct time_ref_s *t, const struct tref *ref) {
+    uint32_t s = __atomic_load_n(&t->seq, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&t->seq, s + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    t->ref = *ref;
+    __atomic_store_n(&t->seq, s + 2, __ATOMIC_RELEASE);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int time_ref_cnt2utc(const struct time_ref_s *t, uint32_t count_us, struct timespec *utc) {
+    struct tref ref;
+
+    time_ref_get(t, &ref);
+    if ((ref.systime == 0) || ((time(NULL) - ref.systime) > TIME_REF_MAX_AGE)) {
+        return TIME_REF_ERROR;
+    }
+    if (lgw_cnt2utc(ref, count_us, utc) != LGW_GPS_SUCCESS) {
+        return TIME_REF_ERROR;
+    }
+    return TIME_REF_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,157 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Batched writes of the line ring to the client socket
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <string.h>     /* memset */
+#include <errno.h>      /* EINTR */
+#include <time.h>       /* clock_gettime */
+#include <sys/select.h> /* pselect */
+#include <sys/socket.h> /* sendmsg */
+
+#include "tx_batch.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* point the free iovecs to the lines not gathered yet */
+static void gather(struct tx_batch_s *b, struct line_ring_s *r) {
+    const char *line;
+    int len;
+
+    while ((b->nb < TX_BATCH_MAX) && ((line = line_ring_peek_at(r, b->nb, &len)) != NULL)) {
+        b->iov[b->nb].iov_base = (void *)line;
+        b->iov[b->nb].iov_len = len;
+        b->nb++;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void tx_batch_init(struct tx_batch_s *b) {
+    b->nb = 0;
+    b->nb_send = 0;
+    b->nb_write = 0;
+    b->nb_line = 0;
+    b->nb_byte = 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int tx_batch_collect(struct tx_batch_s *b, struct line_ring_s *r, uint32_t bound_us) {
+    struct timespec now, end, left;
+    fd_set fds;
+
+    gather(b, r);
+    if ((b->nb == 0) || (bound_us == 0)) {
+        b->nb_send = b->nb;
+        return b->nb;
+    }
+
+    /* the producer notifies once per FIFO drain, wait for the next ones until the bound */
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    end.tv_sec += bound_us / 1000000;
+    end.tv_nsec += (long)(bound_us % 1000000) * 1000;
+    if (end.tv_nsec >= 1000000000) {
+        end.tv_nsec -= 1000000000;
+        end.tv_sec++;
+    }
+    while (b->nb < TX_BATCH_MAX) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        left.tv_sec = end.tv_sec - now.tv_sec;
+        left.tv_nsec = end.tv_nsec - now.tv_nsec;
+        if (left.tv_nsec < 0) {
+            left.tv_nsec += 1000000000;
+            left.tv_sec--;
+        }
+        if (left.tv_sec < 0) {
+            break;
+        }
+        FD_ZERO(&fds);
+        FD_SET(r->fd[0], &fds);
+        if (pselect(r->fd[0] + 1, &fds, NULL, NULL, &left, NULL) <= 0) {
+            break; /* bound reached, or signal to handle */
+        }
+        line_ring_ack(r);
+        gather(b, r);
+    }
+    b->nb_send = b->nb;
+    return b->nb;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int tx_batch_send(struct tx_batch_s *b, struct line_ring_s *r, int fd) {
+    struct msghdr msg;
+    struct iovec *iov = b->iov;
+    int nb = b->nb_send;
+    ssize_t n;
+    int err = TX_BATCH_SUCCESS;
+
+    memset(&msg, 0, sizeof msg);
+    while (nb > 0) {
+        msg.msg_iov = iov;
+        msg.msg_iovlen = nb;
+        n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            err = TX_BATCH_ERROR;
+            break;
+        }
+        b->nb_write++;
+        b->nb_byte += n;
+
+        /* partial write, interrupted by a signal: skip what was sent */
+        while ((nb > 0) && ((size_t)n >= iov->iov_len)) {
+            n -= iov->iov_len;
+            ++iov;
+            --nb;
+        }
+        if (nb > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    if (err == TX_BATCH_SUCCESS) {
+        b->nb_line += b->nb_send;
+    }
+    line_ring_pop_n(r, b->nb);
+    b->nb = 0;
+    b->nb_send = 0;
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void tx_batch_release(struct tx_batch_s *b, struct line_ring_s *r) {
+    line_ring_pop_n(r, b->nb);
+    b->nb = 0;
+    b->nb_send = 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
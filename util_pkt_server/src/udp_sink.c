@@ -0,0 +1,137 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Multicast UDP output of the lines sent to the client
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdio.h>      /* snprintf */
+#include <string.h>     /* memset strncpy */
+#include <unistd.h>     /* close */
+#include <fcntl.h>      /* fcntl O_NONBLOCK */
+#include <sys/socket.h>
+#include <arpa/inet.h>  /* inet_pton htons */
+
+#include "udp_sink.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void udp_sink_conf_default(struct udp_sink_conf_s *conf) {
+    memset(conf, 0, sizeof *conf);
+    conf->enable = false;
+    strncpy(conf->group, UDP_SINK_GROUP, sizeof conf->group - 1);
+    conf->port = UDP_SINK_PORT;
+    conf->ttl = 1;
+    conf->mtu = UDP_SINK_MTU;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int udp_sink_open(struct udp_sink_s *u, const struct udp_sink_conf_s *conf, const char *id) {
+    struct in_addr ifaddr;
+    unsigned char ttl = conf->ttl;
+    unsigned char loop = 1; /* listeners on the gateway itself */
+    int one = 1;
+    int ttl_int = conf->ttl;
+
+    memset(u, 0, sizeof *u);
+    u->fd = -1;
+    u->dst.sin_family = AF_INET;
+    u->dst.sin_port = htons(conf->port);
+    if (inet_pton(AF_INET, conf->group, &u->dst.sin_addr) != 1) {
+        return UDP_SINK_ERROR;
+    }
+    if ((conf->iface[0] != '\0') && (inet_pton(AF_INET, conf->iface, &ifaddr) != 1)) {
+        return UDP_SINK_ERROR;
+    }
+    u->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (u->fd < 0) {
+        return UDP_SINK_ERROR;
+    }
+    fcntl(u->fd, F_SETFL, fcntl(u->fd, F_GETFL) | O_NONBLOCK);
+
+    if ((ntohl(u->dst.sin_addr.s_addr) & 0xF0000000) == 0xE0000000) {
+        if ((setsockopt(u->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof ttl) != 0) ||
+            (setsockopt(u->fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof loop) != 0) ||
+            ((conf->iface[0] != '\0') && (setsockopt(u->fd, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof ifaddr) != 0))) {
+            udp_sink_close(u);
+            return UDP_SINK_ERROR;
+        }
+    } else {
+        /* unicast or broadcast, e.g. a network without multicast routing */
+        setsockopt(u->fd, SOL_SOCKET, SO_BROADCAST, &one, sizeof one);
+        setsockopt(u->fd, IPPROTO_IP, IP_TTL, &ttl_int, sizeof ttl_int);
+    }
+
+    u->payload_max = ((conf->mtu < UDP_SINK_MTU_MIN) ? UDP_SINK_MTU_MIN : conf->mtu) - UDP_SINK_HDR_IP;
+    strncpy(u->id, id, sizeof u->id - 1);
+    return UDP_SINK_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int udp_sink_send(struct udp_sink_s *u, const struct iovec *lines, int nb) {
+    struct iovec iov[UDP_SINK_IOV_MAX + 1];
+    struct msghdr msg;
+    char hdr[UDP_SINK_HDR_MAX];
+    size_t size;
+    int i = 0, k;
+    int nb_lost = 0;
+
+    memset(&msg, 0, sizeof msg);
+    msg.msg_name = &u->dst;
+    msg.msg_namelen = sizeof u->dst;
+    msg.msg_iov = iov;
+    while (i < nb) {
+        /* header, then as many whole lines as the MTU allows */
+        iov[0].iov_base = hdr;
+        iov[0].iov_len = snprintf(hdr, sizeof hdr, "$SEQ,%s,%u\n", u->id, u->seq);
+        size = iov[0].iov_len;
+        for (k = 1; (i < nb) && (k <= UDP_SINK_IOV_MAX) && (size + lines[i].iov_len <= u->payload_max); ++k, ++i) {
+            iov[k] = lines[i];
+            size += lines[i].iov_len;
+        }
+        msg.msg_iovlen = k;
+        if (sendmsg(u->fd, &msg, 0) < 0) {
+            nb_lost++;
+            u->nb_lost++;
+        } else {
+            u->nb_datagram++;
+            u->nb_line += k - 1;
+        }
+        u->seq++;
+    }
+    return nb_lost;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void udp_sink_close(struct udp_sink_s *u) {
+    if (u->fd >= 0) {
+        close(u->fd);
+        u->fd = -1;
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -25,6 +25,7 @@ Maintainer: Sylvain Miermont
 #endif
 
 #include <stdint.h>     /* C99 types */
+#include <inttypes.h>   /* PRIu64 */
 #include <stdbool.h>    /* bool type */
 #include <stdio.h>      /* printf fprintf sprintf fopen fputs */
 
@@ -37,9 +38,36 @@ Maintainer: Sylvain Miermont
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h> /* TCP_NODELAY */
+#include <poll.h>
+#include <pthread.h>
 
 #include "parson.h"
+#include "gw_conf.h"
 #include "loragw_hal.h"
+#include "loragw_aux.h"
+#include "loragw_gpio.h"
+#include "loragw_pool.h"
+#include "spotter.h"
+#include "pkt_filter.h"
+#include "pkt_rules.h"
+#include "loragw_gps.h"
+#include "loragw_scan.h"
+#include "time_ref.h"
+#include "pkt_stats.h"
+#include "rt_sched.h"
+#include "line_ring.h"
+#include "tx_batch.h"
+#include "udp_sink.h"
+#include "shm_pub.h"
+#include "client_sub.h"
+#include "client_cmd.h"
+#include "lora_frame.h"
+#include "spot_codec.h"
+#include "wave_spec.h"
+#include "pkt_loss.h"
+#include "rx_airtime.h"
+#include "live_conf.h"
 #include "errno.h"      /* network socket error handling */
 
 /* -------------------------------------------------------------------------- */
@@ -52,31 +80,182 @@ Maintainer: Sylvain Miermont
 /* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
 
 /* signal handling variables */
-struct sigaction sigact; /* SIGQUIT&SIGINT&SIGTERM signal handling */
+struct sigaction sigact; /* SIGQUIT&SIGINT&SIGTERM&SIGHUP signal handling */
 static int exit_sig = 0; /* 1 -> application terminates cleanly (shut down hardware, close open files, etc) */
 static int quit_sig = 0; /* 1 -> application terminates without shutting down the hardware */
+static int reload_sig = 0; /* 1 -> configuration file must be reloaded */
 
 /* configuration variables needed by the application  */
 uint64_t lgwm = 0; /* LoRa gateway MAC address */
 char lgwm_str[17];
+static const char *conf_fname; /* file reloaded on SIGHUP or RELOAD command */
+static struct gw_conf_s radioconf; /* concentrator configuration running, a reload changing it restarts the concentrator */
+
+/* settings only read at startup, a reload changing them is warned about and needs a restart of the program */
+static const char *restart_keys[][2] = {
+    { NULL, "rx_irq" }, { NULL, "realtime" }, { NULL, "gps_tty_path" }, { NULL, "gps_family" },
+    { NULL, "wave" }, { NULL, "loss_windows_s" }, { NULL, "airtime" },
+    { "spectral_scan", "enable" }, { "spectral_scan", "interval_s" }, { "spectral_scan", "nb_read" },
+    { "spectral_scan", "rssi_offset" }, { "spectral_scan", "chunk_size" }
+};
+static uint32_t restart_hash[ARRAY_SIZE(restart_keys)]; /* of the settings running */
 
 int32_t radio_freqs[2];
 int32_t chan_if_hz[2][4];
 
+/* RX-ready GPIO notification, packets are fetched on edges instead of polling the FIFO */
+bool rxirq_enable = false;
+char rxirq_chip[64] = "/dev/gpiochip0";
+uint32_t rxirq_line = 0;
+int rxirq_poll_ms = 100; /* fallback fetch period if no edge is seen, -1 to wait forever */
+
+/* GPS time sync, packets are stamped with the gateway-receive UTC time if enabled */
+char gps_tty_path[64] = ""; /* no GPS if empty */
+char gps_family[16] = "ubx7";
+static int gps_tty_fd = -1;
+static struct lgw_clk_model_s gps_clk; /* owned by the GPS thread, fitted on PPS captures */
+static struct tref gps_ref; /* current state of gps_clk, published to timeref */
+static int clk_reset = 0; /* 1 -> concentrator restarted, gps_clk must be fitted again */
+struct time_ref_s timeref; /* latest counter <-> UTC reference, read without lock */
+
+/* spotter frequencies, packet rules, filter and reports, reloaded without stopping the acquisition thread */
+static struct live_s live;
+
+/* per spotter statistics, with the noise measured by a background spectral scan if enabled */
+struct pkt_stats_s pktstats;
+bool scan_enable = false;
+struct lgw_conf_scan_s scanconf; /* channels are the spotter frequencies */
+static bool scan_active = false;
+static int scan_spotn[LGW_SCAN_CHAN_MAX]; /* spotter number of each scanned channel */
+
+/* live packet loss of each spotter, kept by the acquisition thread from the timestamps of the samples */
+uint32_t loss_win_s[PKT_LOSS_WINDOW_MAX] = {PKT_LOSS_WINDOW_S, 600}; /* rolling windows, seconds */
+int loss_nb_win = 2;
+static struct pkt_loss_s pktloss;
+static int loss_req = 0; /* 1 -> the client asked for the loss of all spotters, answered on the next drain */
+
+/* airtime of the packets received on each spotter channel, for its utilisation and the overlapping receptions */
+int air_preamble = RX_AIRTIME_PREAMBLE;
+uint32_t air_win_s[RX_AIRTIME_WINDOW_MAX] = {60, 600}; /* rolling windows, seconds */
+int air_nb_win = 2;
+static struct rx_airtime_s rxair;
+
+/* acquisition thread, optionally real-time, handing the lines over to the network thread */
+struct rt_conf_s rtconf;
+static struct line_ring_s txring; /* lines for the client, formatted in place by the acquisition thread */
+static int client_on = 0; /* 1 while a client is connected or another output is on, lines are only formatted then */
+static struct tx_batch_s txbatch; /* lines of the ring sent to the client in a single write */
+static struct client_sub_s clientsub; /* lines the client subscribed to, everything until it sends a SUB command */
+static int stream_enc = 0; /* keyframe interval once the client asked for delta encoded frames, 0 for text lines */
+static int enc_reset = 0; /* 1 -> the acquisition thread starts each spotter over with a keyframe */
+static int enc_rekey = 0; /* bit n set -> the next frame of spotter n is a keyframe, one was dropped for the client */
+static struct iovec sinkiov[TX_BATCH_MAX]; /* text lines of the batch, for the outputs that do not take frames */
+
+/* multicast output of the same lines, for any number of listeners on the LAN */
+struct udp_sink_conf_s udpconf;
+static struct udp_sink_s udpsink;
+static bool udp_active = false;
+
+/* shared memory ring of the same lines, for the consumers running on the gateway */
+bool shm_enable = false;
+char shm_name[64] = SHM_RING_NAME;
+static struct shm_pub_s shmpub;
+static bool shm_active = false;
+static bool sink_on = false; /* an output takes the lines even while no client is connected */
+static bool acq_error = false; /* the acquisition thread stopped on a concentrator error */
+static int acq_stop = 0; /* 1 -> acquisition thread must return, the concentrator is restarted */
+static int acq_done = 0; /* 1 once the acquisition thread returned */
+static bool acq_started = false; /* acquisition thread created and not joined yet */
+static int rxirq_fd = -1; /* RX-ready GPIO event source, -1 when the FIFO is polled */
+
+/* wave spectra computed on the gateway, from the samples kept by the acquisition thread */
+bool wave_enable = false;
+int wave_window = WAVE_SPEC_WINDOW;
+int wave_segment = WAVE_SPEC_SEGMENT;
+int wave_interval_s = WAVE_SPEC_INTERVAL;
+bool wave_raw = true; /* false to send the spectra only, not the packets */
+static struct wave_spec_s wavespec;
+static bool wave_active = false;
+static char wavelines[2 * SPOTTER_NB][WAVE_SPEC_LINE_MAX]; /* '$WAVE' and '$WSPEC' lines of the latest spectra */
+static int wavelen[2 * SPOTTER_NB];
+static int wave_nb = 0; /* lines of the spectra not yet taken by the acquisition thread, 0 once taken */
+
 /* -------------------------------------------------------------------------- */
 /* --- Custom Constants ----------------------------------------------------- */
 #define INT32MAX 0x7FFFFFFF
-#define RXBUFLEN 1024
+#define SCAN_POLL_MS 5 /* longest sleep while the spectral scan is running */
+#define FETCH_SLEEP_MS 10 /* pause after an empty fetch when the FIFO is polled */
+#define WAKEUP_MS 1000 /* longest wait of each thread before checking the exit conditions */
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
 static void sig_handler(int sigio);
 
-int parse_SX1301_configuration(const char * conf_file);
+static void save_spotter_freqs(const struct gw_conf_s *conf);
+
+static void parse_output_configuration(JSON_Object *conf, struct udp_sink_conf_s *udp, bool *shm_on, char *shm, size_t shm_len);
+
+static int parse_gateway_configuration(JSON_Object *conf);
+
+static int parse_live_configuration(JSON_Object *conf, struct live_conf_s *lc);
+
+static void hash_restart_settings(JSON_Object *conf, uint32_t *hash);
+
+static int build_spotters(struct live_conf_s *lc);
+
+static void start_scan(const struct live_conf_s *lc);
+
+static int start_acq(pthread_t *thrid);
+
+static int restart_concentrator(const struct gw_conf_s *conf, pthread_t *thrid_acq);
+
+static int open_udp_sink(void);
+
+static int open_shm_pub(void);
+
+static void close_udp_sink(void);
+
+static void close_shm_pub(void);
+
+static void reload_outputs(const struct udp_sink_conf_s *udp, bool shm_on, const char *shm);
+
+static int reload_configuration(pthread_t *thrid_acq);
+
+static int parse_field_value(int field, JSON_Value *val);
+
+static int parse_filter_field(JSON_Object *filter, const char *name, int field, struct pkt_filter_s *f);
+
+static int parse_rule_field(JSON_Object *obj, const char *name, int field, uint8_t *mask);
+
+static int parse_rules(JSON_Array *arr, struct pkt_rules_s *r);
 
 int cmpfunc (const void * a, const void * b);
 
+static void release_batch(struct lgw_pkt_meta_s *meta, int nb);
+
+static int format_diag(const struct lgw_pkt_meta_s *m, int spotn, char *buf, int len);
+
+static int append_rx_utc(char *buf, int line_len, int len, uint32_t count_us);
+
+static int format_frame(struct spot_codec_s *enc, const struct spotter_data_s *d, int spotn, bool rx_utc, uint32_t count_us, char *buf);
+
+static void gps_process_frame(enum gps_msg msg, const char *frame, size_t size, void *arg);
+
+static void *thread_gps(void *arg);
+
+static void *thread_acq(void *arg);
+
+static void *thread_wave(void *arg);
+
+static void send_sinks(void);
+
+static void set_stream_enc(int key_interval);
+
+static int parse_enc(const char *cmd);
+
+static void select_client_lines(void);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -85,249 +264,1263 @@ int cmpfunc (const void * a, const void * b) {
    return ( *(int*)a - *(int*)b );
 }
 
+// Give back to the HAL pool a batch of packets that will not be processed.
+static void release_batch(struct lgw_pkt_meta_s *meta, int nb) {
+    for (int k=0; k < nb; k++) {
+        lgw_pool_release(lgw_pool_slot(meta[k].slot));
+    }
+}
+
+// Format the metadata of one packet as a diagnostic line, payload not decoded.
+static int format_diag(const struct lgw_pkt_meta_s *m, int spotn, char *buf, int len) {
+    const char *st;
+    int sf = 0;
+    int n;
+
+    switch (m->status) {
+        case STAT_CRC_OK:   st = "CRC_OK";  break;
+        case STAT_CRC_BAD:  st = "CRC_BAD"; break;
+        case STAT_NO_CRC:   st = "NO_CRC";  break;
+        default:            st = "UNDEF";
+    }
+    if ((m->modulation == MOD_LORA) && (m->datarate != DR_UNDEFINED)) {
+        sf = __builtin_ctz(m->datarate) + 6; /* DR_LORA_SF7 is bit 1 */
+    }
+    n = snprintf(buf, len, "$DIAG,%d,%" PRIu64 ",%u,%s,%d,%d,%.1f,%.2f,%u\n", spotn, m->count_us64, m->freq_hz, st, sf,
+                 (m->coderate != CR_UNDEFINED) ? 4 + m->coderate : 0, m->rssi_x16 / 16.0, m->snr_x4 / 4.0, m->size);
+    return ((n < 0) || (n >= len)) ? len - 1 : n;
+}
+
+// Replace the newline ending a line by the gateway-receive UTC time of the packet (empty if not synchronized).
+static int append_rx_utc(char *buf, int line_len, int len, uint32_t count_us) {
+    struct timespec utc;
+    int n;
+
+    if ((line_len < 1) || (buf[line_len - 1] != '\n')) {
+        return line_len;
+    }
+    if (time_ref_cnt2utc(&timeref, count_us, &utc) == TIME_REF_SUCCESS) {
+        n = snprintf(buf + line_len - 1, len - line_len + 1, ",%lld.%06ld\n", (long long)utc.tv_sec, utc.tv_nsec / 1000);
+    } else {
+        n = snprintf(buf + line_len - 1, len - line_len + 1, ",\n");
+    }
+    if ((n < 0) || (n >= (len - line_len + 1))) {
+        buf[line_len - 1] = '\n'; /* no room, keep the line as it was */
+        return line_len;
+    }
+    return line_len - 1 + n;
+}
+
+// Encode a decoded spotter payload as a LORA_FRAME_SPOT frame, against the former samples of the spotter.
+static int format_frame(struct spot_codec_s *enc, const struct spotter_data_s *d, int spotn, bool rx_utc, uint32_t count_us, char *buf) {
+    struct spot_codec_rec_s r;
+    struct timespec utc;
+    int len;
+
+    r.spotn = (uint8_t)spotn;
+    r.type = d->type;
+    r.tenths = spotter_tenths(d); /* as in the text line */
+    r.X = d->X;
+    r.Y = d->Y;
+    r.Z = d->Z;
+    r.LATD = (int8_t)d->LATD;
+    r.LATM = d->LATM;
+    r.LOND = d->LOND;
+    r.LONM = d->LONM;
+    r.has_utc = (rx_utc == true) && (time_ref_cnt2utc(&timeref, count_us, &utc) == TIME_REF_SUCCESS);
+    r.utc_us = (r.has_utc == true) ? (int64_t)utc.tv_sec * 1000000 + utc.tv_nsec / 1000 : 0;
+    len = spot_codec_encode(enc, &r, (uint8_t *)buf + LORA_FRAME_HDR_SIZE);
+    lora_frame_header((uint8_t *)buf, LORA_FRAME_SPOT, (uint16_t)len);
+    return LORA_FRAME_HDR_SIZE + len;
+}
+
+// Refresh the time reference on each GPS time solution, the counter was latched by the PPS preceding it.
+static void gps_process_frame(enum gps_msg msg, const char *frame, size_t size, void *arg) {
+    struct timespec utc, gps_time;
+    uint32_t trig_cnt;
+    int i;
+
+    (void)frame;
+    (void)size;
+    (void)arg;
+
+    /* the counter restarted with the concentrator, the former fit means nothing any more */
+    if (__atomic_exchange_n(&clk_reset, 0, __ATOMIC_ACQ_REL) == 1) {
+        lgw_clk_init(&gps_clk);
+        memset(&gps_ref, 0, sizeof gps_ref);
+        time_ref_publish(&timeref, &gps_ref);
+    }
+    if (msg != UBX_NAV_TIMEGPS) {
+        return;
+    }
+    if (lgw_gps_get(&utc, &gps_time, NULL, NULL) != LGW_GPS_SUCCESS) {
+        return; /* no fix yet */
+    }
+    i = lgw_get_trigcnt(&trig_cnt);
+    if (i != LGW_HAL_SUCCESS) {
+        MSG("WARNING: failed to read concentrator timestamp for GPS sync\n");
+        return;
+    }
+    if ((lgw_clk_update(&gps_clk, trig_cnt, utc, gps_time) == LGW_GPS_SUCCESS) &&
+        (lgw_clk_get_tref(&gps_clk, &gps_ref) == LGW_GPS_SUCCESS)) {
+        time_ref_publish(&timeref, &gps_ref);
+    }
+}
+
+// Read the GPS serial port, frames are parsed as they arrive and handled by gps_process_frame.
+static void *thread_gps(void *arg) {
+    struct lgw_gps_stream_s gps_stream;
+
+    (void)arg;
+    lgw_gps_stream_init(&gps_stream, gps_process_frame, NULL);
+    while ((quit_sig != 1) && (exit_sig != 1)) {
+        if (lgw_gps_stream_read(&gps_stream, gps_tty_fd) < 0) {
+            MSG("WARNING: failed to read GPS serial port\n");
+            sleep(1);
+        }
+    }
+    return NULL;
+}
+
+// Fetch packets as soon as they reach the RX FIFO and format the lines for the client, never waiting for the network.
+static void *thread_acq(void *arg) {
+    /* packet fetching and processing, packets are read in place into buffers of the HAL pool */
+    struct lgw_pkt_meta_s rxmeta[16]; /* array containing up to 16 inbound packets compact metadata */
+    int nb_pkt;
+    struct pkt_batch_s batch; /* same packets, one column per filtered field */
+    uint16_t fwd_mask; /* bit i set if packet i is to be forwarded */
+    uint16_t diag_mask; /* bit i set if the metadata of packet i are to be sent */
+    int spotn[PKT_BATCH_SIZE];
+    /* Fields decoded from the spotter payloads */
+    struct spotter_data_s spotterdata[PKT_BATCH_SIZE];
+
+    /* statistics and spectral scan */
+    struct lgw_scan_result_s scanres;
+    float noise_dbm, occupancy;
+    time_t next_stat;
+    time_t now;
+    uint64_t now_us;
+    uint64_t last_us = 0; /* counter of the latest packet, 64 bits, 0 before the first one */
+    uint64_t last_ms = 0; /* monotonic time it was fetched at */
+
+    /* lines handed to the network thread */
+    char *line;
+    int len;
+    int nb_line;
+    int nb_wave;
+    int online;
+    uint16_t line_mask; /* bit i set if packet i is sent as a line or a frame */
+
+    const struct live_conf_s *lc; /* reloadable settings */
+    struct spot_codec_s spotenc; /* predictors of the spotter frames */
+    int enc; /* keyframe interval while the client takes frames, 0 for text lines */
+    int rekey; /* spotters starting over with a keyframe */
+    bool text; /* packets formatted as text lines, for the client or the other outputs */
+    struct pollfd pfd;
+    bool pkt_pending = false; /* FIFO may still hold packets, fetch again without waiting */
+    int i;
+
+    (void)arg;
+    if (rt_sched_acq(&rtconf) != RT_SCHED_SUCCESS) {
+        MSG("WARNING: failed to set real-time priority %d or CPU %d of the acquisition thread\n", rtconf.priority, rtconf.cpu);
+    }
+    lc = live_read(&live);
+    next_stat = time(NULL) + lc->stat_interval;
+    spot_codec_reset(&spotenc, SPOT_CODEC_KEY_INTERVAL);
+
+    while ((quit_sig != 1) && (exit_sig != 1) && (__atomic_load_n(&acq_stop, __ATOMIC_ACQUIRE) == 0)) {
+        /* Sleep until the concentrator signals packets */
+        if ((rxirq_fd >= 0) && (pkt_pending == false)) {
+            pfd.fd = rxirq_fd;
+            pfd.events = POLLIN;
+            int poll_ms = rxirq_poll_ms;
+            if ((poll_ms < 0) || (poll_ms > WAKEUP_MS)) {
+                poll_ms = WAKEUP_MS;
+            }
+            if ((scan_active == true) && (poll_ms > SCAN_POLL_MS)) {
+                poll_ms = SCAN_POLL_MS; /* keep the scan going when no packet comes */
+            }
+            i = poll(&pfd, 1, poll_ms); /* timeouts fetch anyway */
+            if (i < 0) {
+                if (errno == EINTR) {
+                    continue; /* signal received, re-check exit conditions */
+                }
+                MSG("ERROR: poll reported error code: %s\n", strerror(errno));
+                acq_error = true;
+                break;
+            }
+            if (pfd.revents & POLLIN) {
+                lgw_gpio_rx_ack(rxirq_fd, NULL);
+            }
+        }
+
+        /* Fetch packets from the concentrator */
+        nb_pkt = lgw_receive_meta(ARRAY_SIZE(rxmeta), rxmeta);
+        if (nb_pkt == LGW_HAL_ERROR) {
+            MSG("ERROR: failed packet fetch, exiting\n");
+            acq_error = true;
+            break;
+        }
+
+        /* A full batch or a line still up means the FIFO was not emptied, no new edge will come */
+        if (rxirq_fd >= 0) {
+            bool level = false;
+            lgw_gpio_rx_level(rxirq_fd, &level);
+            pkt_pending = (nb_pkt == (int)ARRAY_SIZE(rxmeta)) || (level == true);
+        } else if (nb_pkt == 0) {
+            wait_ms(FETCH_SLEEP_MS); /* polling an empty FIFO */
+        }
+
+        /* process packets, the whole batch at once */
+        pkt_batch_load(&batch, rxmeta, nb_pkt);
+
+        // Settings in use until the end of this drain, a reload publishes new ones meanwhile.
+        lc = live_read(&live);
+
+        // Drop at once the packets no rule can match.
+        fwd_mask = pkt_filter_run(&lc->filter, &batch);
+
+        // Turn the frequency into the spotter number [0-8], then select the outputs of each packet
+        diag_mask = 0;
+        for (i=0; i < nb_pkt; ++i) {
+            spotn[i] = -1;
+            for (unsigned int l=0; l < ARRAY_SIZE(lc->chanlist); l++) {
+                if ((int64_t)lc->chanlist[l] == (int64_t)batch.freq_hz[i]) spotn[i] = l;
+            }
+            pkt_stats_add(&pktstats, spotn[i], &rxmeta[i]);
+            rx_airtime_add(&rxair, spotn[i], &rxmeta[i]);
+            if (rxmeta[i].count_us64 > last_us) {
+                last_us = rxmeta[i].count_us64;
+                last_ms = lgw_mono_ms();
+            }
+            if ((fwd_mask & (1U << i)) == 0) continue;
+            if (spotn[i] == -1) {
+                MSG("INFO: Somehow received packet on unknown frequency (%u Hz)!?\n", batch.freq_hz[i]);
+                fwd_mask &= ~(1U << i); // Skip the rest of the steps to process this packet.
+                continue;
+            }
+            uint8_t out = pkt_rules_eval(&lc->rules, spotn[i], &rxmeta[i]);
+            if ((out & RULE_OUT_SPOTTER) == 0) fwd_mask &= ~(1U << i);
+            if (out & RULE_OUT_DIAG) diag_mask |= (1U << i);
+        }
+
+        // Nobody to send the lines to, only the statistics, the loss and the samples of the wave spectra are kept.
+        online = __atomic_load_n(&client_on, __ATOMIC_ACQUIRE);
+        if (online == 0) {
+            diag_mask = 0;
+        }
+        line_mask = ((online != 0) && (wave_raw == true)) ? fwd_mask : 0;
+        if (__atomic_exchange_n(&enc_reset, 0, __ATOMIC_ACQ_REL) == 1) {
+            spot_codec_reset(&spotenc, (uint16_t)__atomic_load_n(&stream_enc, __ATOMIC_ACQUIRE));
+        }
+        rekey = __atomic_exchange_n(&enc_rekey, 0, __ATOMIC_ACQ_REL);
+        for (i=0; rekey != 0; ++i, rekey >>= 1) {
+            if (rekey & 1) {
+                spot_codec_forget(&spotenc, (uint8_t)i);
+            }
+        }
+        enc = __atomic_load_n(&stream_enc, __ATOMIC_ACQUIRE);
+        text = (enc == 0) || (__atomic_load_n(&sink_on, __ATOMIC_ACQUIRE) == true);
+        nb_line = 0;
+
+        // Diagnostic lines carry the metadata only, whatever the payload.
+        for (i=0; i < nb_pkt; ++i) {
+            if ((diag_mask & (1U << i)) && ((line = line_ring_reserve(&txring)) != NULL)) {
+                line_ring_commit(&txring, format_diag(&rxmeta[i], spotn[i], line, SPOTTER_LINE_MAX));
+                nb_line++;
+            }
+        }
+
+        // Decode the fields of all accepted packets straight from the packet buffers.
+        uint16_t decoded = pkt_batch_decode(&batch, fwd_mask, spotterdata);
+        for (i=0; i < nb_pkt; ++i) {
+            if (fwd_mask & ~decoded & (1U << i)) {
+                MSG("INFO: Packet from spotter %d too short (%u bytes), dropped\n", spotn[i], batch.size[i]);
+            }
+        }
+
+        // Build the ascii strings in place, the network thread sends them out to the client.
+        for (i=0; (text == true) && (i < nb_pkt); ++i) {
+            if ((decoded & line_mask & (1U << i)) && ((line = line_ring_reserve(&txring)) != NULL)) {
+                len = spotter_format(&spotterdata[i], spotn[i], line, SPOTTER_LINE_MAX);
+                if (lc->rx_utc == true) {
+                    len = append_rx_utc(line, len, SPOTTER_LINE_MAX, LGW_META_COUNT_US(&rxmeta[i]));
+                }
+                line_ring_commit(&txring, len);
+                nb_line++;
+            }
+        }
+
+        // Or frames for a client that asked for them, the other outputs still get the lines.
+        for (i=0; (enc > 0) && (i < nb_pkt); ++i) {
+            if ((decoded & line_mask & (1U << i)) && ((line = line_ring_reserve(&txring)) != NULL)) {
+                line_ring_commit(&txring, format_frame(&spotenc, &spotterdata[i], spotn[i], lc->rx_utc, LGW_META_COUNT_US(&rxmeta[i]), line));
+                nb_line++;
+            }
+        }
+
+        // Samples missing from each spotter, counted whether a client is connected or not.
+        now = time(NULL);
+        for (i=0; i < nb_pkt; ++i) {
+            if (decoded & (1U << i)) {
+                pkt_loss_add(&pktloss, spotn[i], spotter_tenths(&spotterdata[i]), now);
+            }
+        }
+
+        // Vertical displacement of each spotter for the wave thread, a copy of a few bytes.
+        for (i=0; (wave_active == true) && (i < nb_pkt); ++i) {
+            if (decoded & (1U << i)) {
+                wave_spec_push(&wavespec, spotn[i], spotter_tenths(&spotterdata[i]), spotterdata[i].Z);
+            }
+        }
+        release_batch(rxmeta, nb_pkt);
+
+        // Let the spectral scan use the bus for a bounded time, only once the FIFO was emptied.
+        if ((scan_active == true) && (pkt_pending == false) && (nb_pkt < (int)ARRAY_SIZE(rxmeta))) {
+            i = lgw_scan_step(lc->scan_budget_us, &scanres);
+            if (i == LGW_SCAN_ERROR) {
+                MSG("WARNING: spectral scan failed, stopped\n");
+                scan_active = false;
+            } else if ((i == 1) && (lgw_scan_analyze(&scanres, lc->scan_margin_db, &noise_dbm, &occupancy) == LGW_SCAN_SUCCESS)) {
+                pkt_stats_noise(&pktstats, scan_spotn[scanres.chan], noise_dbm, occupancy);
+            }
+        }
+
+        // Periodic report of the statistics, loss and airtime of each spotter, or at once if the client asked for it.
+        bool stat_due = (lc->stat_interval > 0) && (now >= next_stat);
+        bool loss_due = (__atomic_exchange_n(&loss_req, 0, __ATOMIC_ACQ_REL) == 1) || (stat_due == true);
+        /* counter now, from the latest packet and the time elapsed since, no SPI access and no latched value */
+        now_us = (last_us > 0) ? last_us + (lgw_mono_ms() - last_ms) * 1000 : 0;
+        for (unsigned int k=0; (online != 0) && (loss_due == true) && (k < ARRAY_SIZE(lc->chanlist)); k++) {
+            if (lc->chanlist[k] == INT32MAX) continue;
+            if ((stat_due == true) && ((line = line_ring_reserve(&txring)) != NULL)) {
+                line_ring_commit(&txring, pkt_stats_format(&pktstats, k, line, SPOTTER_LINE_MAX));
+                nb_line++;
+            }
+            if ((line = line_ring_reserve(&txring)) != NULL) {
+                line_ring_commit(&txring, pkt_loss_format(&pktloss, k, now, line, SPOTTER_LINE_MAX));
+                nb_line++;
+            }
+            if ((line = line_ring_reserve(&txring)) != NULL) {
+                line_ring_commit(&txring, rx_airtime_format(&rxair, k, now_us, line, SPOTTER_LINE_MAX));
+                nb_line++;
+            }
+        }
+        if (stat_due == true) {
+            pkt_stats_period(&pktstats);
+            next_stat = now + lc->stat_interval;
+        }
+
+        // Lines of the latest wave spectra, handed over by the wave thread.
+        nb_wave = __atomic_load_n(&wave_nb, __ATOMIC_ACQUIRE);
+        if (nb_wave > 0) {
+            for (i=0; (online != 0) && (i < nb_wave); ++i) {
+                if ((line = line_ring_reserve(&txring)) != NULL) {
+                    memcpy(line, wavelines[i], wavelen[i]);
+                    line_ring_commit(&txring, wavelen[i]);
+                    nb_line++;
+                }
+            }
+            __atomic_store_n(&wave_nb, 0, __ATOMIC_RELEASE);
+        }
+
+        if (nb_line > 0) {
+            line_ring_notify(&txring);
+        }
+        live_quiescent(&live); /* lc not used any more */
+    }
+
+    if (acq_error == true) {
+        quit_sig = 1; /* leave without shutting down the hardware */
+    }
+    __atomic_store_n(&acq_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Compute the wave spectra of the spotters every interval, at normal priority and off the acquisition CPU.
+static void *thread_wave(void *arg) {
+    struct wave_spec_res_s res;
+    int elapsed = 0;
+    int spotn, nb;
+
+    (void)arg;
+    while ((quit_sig != 1) && (exit_sig != 1)) {
+        sleep(1);
+        if ((++elapsed < wave_interval_s) || (__atomic_load_n(&wave_nb, __ATOMIC_ACQUIRE) != 0)) {
+            continue; /* not yet, or the former lines were not taken yet */
+        }
+        elapsed = 0;
+        for (spotn = 0, nb = 0; spotn < SPOTTER_NB; ++spotn) {
+            if (wave_spec_compute(&wavespec, spotn, &res) != WAVE_SPEC_SUCCESS) {
+                continue;
+            }
+            wavelen[nb] = wave_spec_format(&res, wavelines[nb], WAVE_SPEC_LINE_MAX);
+            nb++;
+            wavelen[nb] = wave_spec_format_bands(&res, wavelines[nb], WAVE_SPEC_LINE_MAX);
+            nb++;
+        }
+        __atomic_store_n(&wave_nb, nb, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
 static void sig_handler(int sigio) {
     if (sigio == SIGQUIT) {
         quit_sig = 1;
     } else if ((sigio == SIGINT) || (sigio == SIGTERM)) {
         exit_sig = 1;
+    } else if (sigio == SIGHUP) {
+        reload_sig = 1;
     }
 }
 
-int parse_SX1301_configuration(const char * conf_file) {
-    int i;
-    const char conf_obj[] = "SX1301_conf";
-    char param_name[32]; /* used to generate variable parameter names */
-    const char *str; /* used to store string value from JSON object */
-    struct lgw_conf_board_s boardconf;
-    struct lgw_conf_rxrf_s rfconf;
-    struct lgw_conf_rxif_s ifconf;
-    JSON_Value *root_val;
-    JSON_Object *root = NULL;
-    JSON_Object *conf = NULL;
-    JSON_Value *val;
-    uint32_t sf, bw;
+// Keep the radio center frequencies and the IF of the multi-SF channels, to convert packet freq back to spotter number.
+static void save_spotter_freqs(const struct gw_conf_s *conf) {
+    int i, j;
+    int nb[2] = {0, 0};
+    const struct lgw_conf_rxif_s *ifc;
 
     /* Fill the channel if array with a placeholder value to later determine if the json section was absent */
-    for (int i=0; i < 2; i++) {
-        for (int j=0; j < 4; j++) {
+    for (i = 0; i < 2; i++) {
+        radio_freqs[i] = conf->rf[i].enable ? (int32_t)conf->rf[i].freq_hz : 0;
+        for (j = 0; j < 4; j++) {
             chan_if_hz[i][j] = INT32MAX;
         }
     }
-    /* try to parse JSON */
-    root_val = json_parse_file_with_comments(conf_file);
-    root = json_value_get_object(root_val);
-    if (root == NULL) {
-        MSG("ERROR: %s id not a valid JSON file\n", conf_file);
-        exit(EXIT_FAILURE);
+    for (i = 0; i < LGW_MULTI_NB; ++i) {
+        ifc = &conf->ifc[i];
+        if ((conf->if_set[i] == false) || (ifc->enable == false) || (ifc->rf_chain > 1) || (nb[ifc->rf_chain] >= 4)) {
+            continue;
+        }
+        chan_if_hz[ifc->rf_chain][nb[ifc->rf_chain]++] = ifc->freq_hz;
+    }
+}
+
+// Turn one configuration value of a filtered field into its HAL constant, -1 if invalid.
+static int parse_field_value(int field, JSON_Value *val) {
+    const char *str = json_value_get_string(val);
+    int x = -1;
+
+    switch (field) {
+        case PKT_FIELD_STATUS:
+            if (str == NULL) break;
+            else if (!strcmp(str, "CRC_OK")) x = STAT_CRC_OK;
+            else if (!strcmp(str, "CRC_BAD")) x = STAT_CRC_BAD;
+            else if (!strcmp(str, "NO_CRC")) x = STAT_NO_CRC;
+            break;
+        case PKT_FIELD_MODULATION:
+            if (str == NULL) break;
+            else if (!strcmp(str, "LORA")) x = MOD_LORA;
+            else if (!strcmp(str, "FSK")) x = MOD_FSK;
+            break;
+        case PKT_FIELD_BANDWIDTH:
+            switch ((uint32_t)json_value_get_number(val)) {
+                case 500000: x = BW_500KHZ; break;
+                case 250000: x = BW_250KHZ; break;
+                case 125000: x = BW_125KHZ; break;
+            }
+            break;
+        case PKT_FIELD_DATARATE:
+            switch ((uint32_t)json_value_get_number(val)) {
+                case  7: x = DR_LORA_SF7;  break;
+                case  8: x = DR_LORA_SF8;  break;
+                case  9: x = DR_LORA_SF9;  break;
+                case 10: x = DR_LORA_SF10; break;
+                case 11: x = DR_LORA_SF11; break;
+                case 12: x = DR_LORA_SF12; break;
+            }
+            break;
+        case PKT_FIELD_CODERATE:
+            if (str == NULL) break;
+            else if (!strcmp(str, "4/5")) x = CR_LORA_4_5;
+            else if (!strcmp(str, "4/6")) x = CR_LORA_4_6;
+            else if (!strcmp(str, "4/7")) x = CR_LORA_4_7;
+            else if (!strcmp(str, "4/8")) x = CR_LORA_4_8;
+            break;
+    }
+    return x;
+}
+
+// Parse one field of the packet filter, a missing field keeps its default criteria.
+static int parse_filter_field(JSON_Object *filter, const char *name, int field, struct pkt_filter_s *f) {
+    JSON_Value *val;
+    const char *str;
+    int x;
+
+    val = json_object_get_value(filter, name);
+    if (val == NULL) {
+        return 0;
+    }
+    str = json_value_get_string(val);
+    if ((str != NULL) && !strcmp(str, "any")) {
+        pkt_filter_any(f, field);
+        MSG("INFO: filter accepts any %s\n", name);
+        return 0;
     }
-    conf = json_object_get_object(root, conf_obj);
-    if (conf == NULL) {
-        MSG("INFO: %s does not contain a JSON object named %s\n", conf_file, conf_obj);
+
+    x = parse_field_value(field, val);
+    if (x < 0) {
+        MSG("WARNING: invalid value for filter %s, keeping default\n", name);
         return -1;
-    } else {
-        MSG("INFO: %s does contain a JSON object named %s, parsing SX1301 parameters\n", conf_file, conf_obj);
     }
+    pkt_filter_set(f, field, (uint8_t)x);
+    return 0;
+}
+
+// Parse the set of values a rule allows for one field, a single value or an array, a missing field allows any.
+static int parse_rule_field(JSON_Object *obj, const char *name, int field, uint8_t *mask) {
+    JSON_Value *val;
+    JSON_Array *arr = NULL;
+    int nb = 1;
+    int j, x;
+
+    val = json_object_get_value(obj, name);
+    if (val == NULL) {
+        return 0;
+    }
+    if (json_value_get_type(val) == JSONArray) {
+        arr = json_value_get_array(val);
+        nb = (int)json_array_get_count(arr);
+    }
+    *mask = 0;
+    for (j = 0; j < nb; ++j) {
+        x = parse_field_value(field, (arr != NULL) ? json_array_get_value(arr, j) : val);
+        if (x < 0) {
+            MSG("WARNING: invalid value in rule field %s, ignored\n", name);
+            continue;
+        }
+        switch (field) {
+            case PKT_FIELD_STATUS:      *mask |= RULE_STAT_BIT(x); break;
+            case PKT_FIELD_MODULATION:  *mask |= RULE_MOD_BIT(x); break;
+            case PKT_FIELD_DATARATE:    *mask |= (uint8_t)x; break;
+            default:                    *mask |= (uint8_t)(1U << x); break;
+        }
+    }
+    return (*mask != 0) ? 0 : -1;
+}
 
-    /* set board configuration */
-    memset(&boardconf, 0, sizeof boardconf); /* initialize configuration structure */
-    val = json_object_get_value(conf, "lorawan_public"); /* fetch value (if possible) */
+// Parse the forwarding rules, collected here and compiled once the spotter frequencies are known.
+static int parse_rules(JSON_Array *arr, struct pkt_rules_s *r) {
+    struct pkt_rule_s rule;
+    JSON_Object *obj;
+    JSON_Array *outs;
+    JSON_Value *val;
+    const char *str;
+    int spotn;
+    uint32_t freq_hz;
+    double x; /* threshold in the fixed point of the metadata, checked before the cast */
+    unsigned int k, j;
+
+    for (k = 0; k < json_array_get_count(arr); ++k) {
+        obj = json_array_get_object(arr, k);
+        if (obj == NULL) {
+            MSG("WARNING: rule %u is not an object, ignored\n", k);
+            continue;
+        }
+        pkt_rule_any(&rule);
+        spotn = RULE_ALL_SPOTTERS;
+        freq_hz = 0;
+
+        val = json_object_get_value(obj, "spotter");
+        if (json_value_get_type(val) == JSONNumber) {
+            spotn = (int)json_value_get_number(val);
+        }
+        val = json_object_get_value(obj, "freq");
+        if (json_value_get_type(val) == JSONNumber) {
+            freq_hz = (uint32_t)json_value_get_number(val);
+        }
+        if ((parse_rule_field(obj, "status", PKT_FIELD_STATUS, &rule.status_mask) != 0) ||
+            (parse_rule_field(obj, "modulation", PKT_FIELD_MODULATION, &rule.mod_mask) != 0) ||
+            (parse_rule_field(obj, "bandwidth", PKT_FIELD_BANDWIDTH, &rule.bw_mask) != 0) ||
+            (parse_rule_field(obj, "spread_factor", PKT_FIELD_DATARATE, &rule.sf_mask) != 0) ||
+            (parse_rule_field(obj, "coderate", PKT_FIELD_CODERATE, &rule.cr_mask) != 0)) {
+            MSG("WARNING: rule %u allows no value for some field, ignored\n", k);
+            continue;
+        }
+        /* thresholds beyond what the metadata can hold would wrap around */
+        val = json_object_get_value(obj, "min_rssi");
+        if (json_value_get_type(val) == JSONNumber) {
+            x = json_value_get_number(val) * 16;
+            if (!((x > INT16_MIN) && (x <= INT16_MAX))) {
+                MSG("WARNING: min_rssi of rule %u out of [%d, %d] dBm, ignored\n", k, INT16_MIN / 16 + 1, INT16_MAX / 16);
+                continue;
+            }
+            rule.min_rssi_x16 = (int16_t)x;
+        }
+        val = json_object_get_value(obj, "min_snr");
+        if (json_value_get_type(val) == JSONNumber) {
+            x = json_value_get_number(val) * 4;
+            if (!((x > INT8_MIN) && (x <= INT8_MAX))) {
+                MSG("WARNING: min_snr of rule %u out of [%d, %d] dB, ignored\n", k, INT8_MIN / 4 + 1, INT8_MAX / 4);
+                continue;
+            }
+            rule.min_snr_x4 = (int8_t)x;
+        }
+        outs = json_object_get_array(obj, "outputs");
+        for (j = 0; j < json_array_get_count(outs); ++j) {
+            str = json_array_get_string(outs, j);
+            if (str == NULL) continue;
+            else if (!strcmp(str, "spotter")) rule.outputs |= RULE_OUT_SPOTTER;
+            else if (!strcmp(str, "diag")) rule.outputs |= RULE_OUT_DIAG;
+            else MSG("WARNING: unknown output %s in rule %u\n", str, k);
+        }
+        if (pkt_rules_add(r, spotn, freq_hz, &rule) != 0) {
+            MSG("WARNING: too many rules, rule %u ignored\n", k);
+            continue;
+        }
+        MSG("INFO: rule %u for %s %d, status %02X, SF %02X, CR %02X, outputs %02X\n", k, (freq_hz != 0) ? "freq" : "spotter", (freq_hz != 0) ? (int)freq_hz : spotn, rule.status_mask, rule.sf_mask, rule.cr_mask, rule.outputs);
+    }
+    return 0;
+}
+
+// Parse the multicast and shared memory outputs, both off when absent.
+static void parse_output_configuration(JSON_Object *conf, struct udp_sink_conf_s *udp, bool *shm_on, char *shm, size_t shm_len) {
+    JSON_Object *obj;
+    JSON_Value *val;
+    const char *str;
+
+    /* multicast output */
+    udp_sink_conf_default(udp);
+    obj = json_object_get_object(conf, "udp_sink");
+    val = json_object_get_value(obj, "enable");
     if (json_value_get_type(val) == JSONBoolean) {
-        boardconf.lorawan_public = (bool)json_value_get_boolean(val);
-    } else {
-        MSG("WARNING: Data type for lorawan_public seems wrong, please check\n");
-        boardconf.lorawan_public = false;
+        udp->enable = (bool)json_value_get_boolean(val);
     }
-    val = json_object_get_value(conf, "clksrc"); /* fetch value (if possible) */
-    if (json_value_get_type(val) == JSONNumber) {
-        boardconf.clksrc = (uint8_t)json_value_get_number(val);
+    if (udp->enable == true) {
+        str = json_object_get_string(obj, "group");
+        if (str != NULL) {
+            strncpy(udp->group, str, sizeof udp->group - 1);
+        }
+        str = json_object_get_string(obj, "interface");
+        if (str != NULL) {
+            strncpy(udp->iface, str, sizeof udp->iface - 1);
+        }
+        val = json_object_get_value(obj, "port");
+        if (json_value_get_type(val) == JSONNumber) {
+            udp->port = (uint16_t)json_value_get_number(val);
+        }
+        val = json_object_get_value(obj, "ttl");
+        if (json_value_get_type(val) == JSONNumber) {
+            udp->ttl = (uint8_t)json_value_get_number(val);
+        }
+        val = json_object_get_value(obj, "mtu");
+        if (json_value_get_type(val) == JSONNumber) {
+            udp->mtu = (uint16_t)json_value_get_number(val);
+        }
+        MSG("INFO: lines also sent to %s:%u, TTL %u, MTU %u\n", udp->group, udp->port, udp->ttl, udp->mtu);
+    }
+
+    /* shared memory ring */
+    *shm_on = false;
+    memset(shm, 0, shm_len);
+    strncpy(shm, SHM_RING_NAME, shm_len - 1);
+    obj = json_object_get_object(conf, "shm_ring");
+    val = json_object_get_value(obj, "enable");
+    if (json_value_get_type(val) == JSONBoolean) {
+        *shm_on = (bool)json_value_get_boolean(val);
+    }
+    if (*shm_on == true) {
+        str = json_object_get_string(obj, "name");
+        if (str != NULL) {
+            strncpy(shm, str, shm_len - 1);
+        }
+        MSG("INFO: lines also published in shared memory %s\n", shm);
+    }
+}
+
+static int parse_gateway_configuration(JSON_Object *conf) {
+    struct lgw_conf_rxirq_s rxirqconf;
+    JSON_Object *obj;
+    JSON_Array *arr;
+    JSON_Value *val;
+    const char *str; /* pointer to sub-strings in the JSON data */
+    int i, n;
+
+    /* RX-ready GPIO notification (optional, board dependent) */
+    memset(&rxirqconf, 0, sizeof rxirqconf);
+    obj = json_object_get_object(conf, "rx_irq");
+    val = json_object_get_value(obj, "enable");
+    if (json_value_get_type(val) == JSONBoolean) {
+        rxirqconf.enable = (bool)json_value_get_boolean(val);
+    }
+    if (rxirqconf.enable == true) {
+        str = json_object_get_string(obj, "gpio_chip");
+        if (str != NULL) {
+            strncpy(rxirq_chip, str, sizeof rxirq_chip - 1);
+        }
+        rxirq_line = (uint32_t)json_object_get_number(obj, "gpio_line");
+        rxirqconf.gpio_select = (uint8_t)json_object_get_number(obj, "select_output");
+        val = json_object_get_value(obj, "poll_ms");
+        if (json_value_get_type(val) == JSONNumber) {
+            rxirq_poll_ms = (int)json_value_get_number(val);
+        }
+        MSG("INFO: RX-ready notification on %s line %u, GPIO select %u, fallback poll %d ms\n", rxirq_chip, rxirq_line, rxirqconf.gpio_select, rxirq_poll_ms);
     } else {
-        MSG("WARNING: Data type for clksrc seems wrong, please check\n");
-        boardconf.clksrc = 0;
+        MSG("INFO: RX-ready notification disabled, polling the RX FIFO\n");
     }
-    MSG("INFO: lorawan_public %d, clksrc %d\n", boardconf.lorawan_public, boardconf.clksrc);
-    /* all parameters parsed, submitting configuration to the HAL */
-    if (lgw_board_setconf(boardconf) != LGW_HAL_SUCCESS) {
-        MSG("ERROR: Failed to configure board\n");
+    if (lgw_rxirq_setconf(rxirqconf) != LGW_HAL_SUCCESS) {
+        MSG("ERROR: invalid configuration for RX-ready notification\n");
         return -1;
     }
+    rxirq_enable = rxirqconf.enable;
 
-    /* set configuration for RF chains */
-    for (i = 0; i < LGW_RF_CHAIN_NB; ++i) {
-        memset(&rfconf, 0, sizeof(rfconf)); /* initialize configuration structure */
-        sprintf(param_name, "radio_%i", i); /* compose parameter path inside JSON structure */
-        val = json_object_get_value(conf, param_name); /* fetch value (if possible) */
-        if (json_value_get_type(val) != JSONObject) {
-            MSG("INFO: no configuration for radio %i\n", i);
-            continue;
+    /* real-time acquisition thread (optional) */
+    obj = json_object_get_object(conf, "realtime");
+    val = json_object_get_value(obj, "enable");
+    if (json_value_get_type(val) == JSONBoolean) {
+        rtconf.enable = (bool)json_value_get_boolean(val);
+    }
+    if (rtconf.enable == true) {
+        val = json_object_get_value(obj, "priority");
+        if (json_value_get_type(val) == JSONNumber) {
+            rtconf.priority = (int)json_value_get_number(val);
+        }
+        val = json_object_get_value(obj, "cpu");
+        if (json_value_get_type(val) == JSONNumber) {
+            rtconf.cpu = (int)json_value_get_number(val);
         }
-        /* there is an object to configure that radio, let's parse it */
-        sprintf(param_name, "radio_%i.enable", i);
-        val = json_object_dotget_value(conf, param_name);
+        val = json_object_get_value(obj, "lock_memory");
         if (json_value_get_type(val) == JSONBoolean) {
-            rfconf.enable = (bool)json_value_get_boolean(val);
-        } else {
-            rfconf.enable = false;
-        }
-        if (rfconf.enable == false) { /* radio disabled, nothing else to parse */
-            MSG("INFO: radio %i disabled\n", i);
-        } else  { /* radio enabled, will parse the other parameters */
-            snprintf(param_name, sizeof param_name, "radio_%i.freq", i);
-            rfconf.freq_hz = (uint32_t)json_object_dotget_number(conf, param_name);
-            snprintf(param_name, sizeof param_name, "radio_%i.rssi_offset", i);
-            rfconf.rssi_offset = (float)json_object_dotget_number(conf, param_name);
-            snprintf(param_name, sizeof param_name, "radio_%i.type", i);
-            str = json_object_dotget_string(conf, param_name);
-            if (!strncmp(str, "SX1255", 6)) {
-                rfconf.type = LGW_RADIO_TYPE_SX1255;
-            } else if (!strncmp(str, "SX1257", 6)) {
-                rfconf.type = LGW_RADIO_TYPE_SX1257;
-            } else {
-                MSG("WARNING: invalid radio type: %s (should be SX1255 or SX1257)\n", str);
-            }
-            snprintf(param_name, sizeof param_name, "radio_%i.tx_enable", i);
-            val = json_object_dotget_value(conf, param_name);
-            if (json_value_get_type(val) == JSONBoolean) {
-                rfconf.tx_enable = (bool)json_value_get_boolean(val);
-                if (rfconf.tx_enable == true) {
-                    /* tx notch filter frequency to be set */
-                    snprintf(param_name, sizeof param_name, "radio_%i.tx_notch_freq", i);
-                    rfconf.tx_notch_freq = (uint32_t)json_object_dotget_number(conf, param_name);
-                }
-            } else {
-                rfconf.tx_enable = false;
-            }
-            radio_freqs[i] = rfconf.freq_hz; // Save the radio center frequencies to global for later use converting packet freq back to spotter number.
-            MSG("INFO: radio %i enabled (type %s), center frequency %u, RSSI offset %f, tx enabled %d, tx_notch_freq %u\n", i, str, rfconf.freq_hz, rfconf.rssi_offset, rfconf.tx_enable, rfconf.tx_notch_freq);
+            rtconf.lock_memory = (bool)json_value_get_boolean(val);
         }
-        /* all parameters parsed, submitting configuration to the HAL */
-        if (lgw_rxrf_setconf(i, rfconf) != LGW_HAL_SUCCESS) {
-            MSG("ERROR: invalid configuration for radio %i\n", i);
-            return -1;
+        MSG("INFO: acquisition thread SCHED_FIFO priority %d, CPU %d, memory %s\n", rtconf.priority, rtconf.cpu, (rtconf.lock_memory == true) ? "locked" : "not locked");
+    }
+
+    /* GPS time sync (optional) */
+    str = json_object_get_string(conf, "gps_tty_path");
+    if (str != NULL) {
+        strncpy(gps_tty_path, str, sizeof gps_tty_path - 1);
+        str = json_object_get_string(conf, "gps_family");
+        if (str != NULL) {
+            strncpy(gps_family, str, sizeof gps_family - 1);
         }
+        MSG("INFO: GPS %s on %s\n", gps_family, gps_tty_path);
+    } else {
+        MSG("INFO: no GPS configured, packets are not stamped with UTC time\n");
     }
-    
-    uint8_t r0ch = 0;
-    uint8_t r1ch = 0;
-    /* set configuration for LoRa multi-SF channels (bandwidth cannot be set) */
-    for (i = 0; i < LGW_MULTI_NB; ++i) {
-        memset(&ifconf, 0, sizeof(ifconf)); /* initialize configuration structure */
-        sprintf(param_name, "chan_multiSF_%i", i); /* compose parameter path inside JSON structure */
-        val = json_object_get_value(conf, param_name); /* fetch value (if possible) */
-        if (json_value_get_type(val) != JSONObject) {
-            MSG("INFO: no configuration for LoRa multi-SF channel %i\n", i);
-            continue;
+
+    /* multicast and shared memory outputs (optional), in addition to the TCP client */
+    parse_output_configuration(conf, &udpconf, &shm_enable, shm_name, sizeof shm_name);
+
+    /* wave spectra (optional), sent every interval_s with or without the packets */
+    obj = json_object_get_object(conf, "wave");
+    val = json_object_get_value(obj, "enable");
+    if (json_value_get_type(val) == JSONBoolean) {
+        wave_enable = (bool)json_value_get_boolean(val);
+    }
+    if (wave_enable == true) {
+        val = json_object_get_value(obj, "window");
+        if (json_value_get_type(val) == JSONNumber) {
+            wave_window = (int)json_value_get_number(val);
+        }
+        val = json_object_get_value(obj, "segment");
+        if (json_value_get_type(val) == JSONNumber) {
+            wave_segment = (int)json_value_get_number(val);
         }
-        /* there is an object to configure that LoRa multi-SF channel, let's parse it */
-        sprintf(param_name, "chan_multiSF_%i.enable", i);
-        val = json_object_dotget_value(conf, param_name);
+        val = json_object_get_value(obj, "interval_s");
+        if (json_value_get_type(val) == JSONNumber) {
+            wave_interval_s = (int)json_value_get_number(val);
+        }
+        val = json_object_get_value(obj, "raw");
         if (json_value_get_type(val) == JSONBoolean) {
-            ifconf.enable = (bool)json_value_get_boolean(val);
+            wave_raw = (bool)json_value_get_boolean(val);
+        }
+        MSG("INFO: wave spectra of %d samples every %d s%s\n", wave_window, wave_interval_s, (wave_raw == true) ? "" : ", packets not sent");
+    }
+
+    /* rolling windows of the packet loss of each spotter (optional, 40 s and 10 min by default) */
+    arr = json_object_get_array(conf, "loss_windows_s");
+    if (arr != NULL) {
+        n = (int)json_array_get_count(arr);
+        for (i = 0; (i < n) && (i < PKT_LOSS_WINDOW_MAX) && (json_array_get_number(arr, i) >= 1); ++i);
+        if (i == n) {
+            for (i = 0; i < n; ++i) {
+                loss_win_s[i] = (uint32_t)json_array_get_number(arr, i);
+            }
+            loss_nb_win = n;
         } else {
-            ifconf.enable = false;
-        }
-        if (ifconf.enable == false) { /* LoRa multi-SF channel disabled, nothing else to parse */
-            MSG("INFO: LoRa multi-SF channel %i disabled\n", i);
-        } else  { /* LoRa multi-SF channel enabled, will parse the other parameters */
-            sprintf(param_name, "chan_multiSF_%i.radio", i);
-            ifconf.rf_chain = (uint32_t)json_object_dotget_number(conf, param_name);
-            sprintf(param_name, "chan_multiSF_%i.if", i);
-            ifconf.freq_hz = (int32_t)json_object_dotget_number(conf, param_name);
-            // TODO: handle individual SF enabling and disabling (spread_factor)
-            // Save the intermediate frequencies to global for later use converting packet freq back to spotter number.
-            if (ifconf.rf_chain == 0) {
-                chan_if_hz[0][r0ch++] = ifconf.freq_hz;
-            } else if (ifconf.rf_chain == 1) {
-                chan_if_hz[1][r1ch++] = ifconf.freq_hz;
-            }
-            MSG("INFO: LoRa multi-SF channel %i enabled, radio %i selected, IF %i Hz, 125 kHz bandwidth, SF 7 to 12\n", i, ifconf.rf_chain, ifconf.freq_hz);
-        }
-        /* all parameters parsed, submitting configuration to the HAL */
-        if (lgw_rxif_setconf(i, ifconf) != LGW_HAL_SUCCESS) {
-            MSG("ERROR: invalid configuration for Lora multi-SF channel %i\n", i);
-            return -1;
+            MSG("WARNING: loss_windows_s must hold up to %d durations of 1 s or more, default kept\n", PKT_LOSS_WINDOW_MAX);
         }
     }
 
-    /* set configuration for LoRa standard channel */
-    memset(&ifconf, 0, sizeof(ifconf)); /* initialize configuration structure */
-    val = json_object_get_value(conf, "chan_Lora_std"); /* fetch value (if possible) */
-    if (json_value_get_type(val) != JSONObject) {
-        MSG("INFO: no configuration for LoRa standard channel\n");
-    } else {
-        val = json_object_dotget_value(conf, "chan_Lora_std.enable");
-        if (json_value_get_type(val) == JSONBoolean) {
-            ifconf.enable = (bool)json_value_get_boolean(val);
+    /* airtime of the received packets (optional), preamble of the spotters and rolling windows of the utilisation */
+    obj = json_object_get_object(conf, "airtime");
+    val = json_object_get_value(obj, "preamble");
+    if (json_value_get_type(val) == JSONNumber) {
+        air_preamble = (int)json_value_get_number(val);
+    }
+    arr = json_object_get_array(obj, "windows_s");
+    if (arr != NULL) {
+        n = (int)json_array_get_count(arr);
+        for (i = 0; (i < n) && (i < RX_AIRTIME_WINDOW_MAX); ++i) {
+            air_win_s[i] = (uint32_t)json_array_get_number(arr, i);
+        }
+        air_nb_win = n;
+    }
+    if (rx_airtime_init(&rxair, air_preamble, air_win_s, air_nb_win) != RX_AIRTIME_SUCCESS) {
+        MSG("WARNING: airtime needs a preamble of 6 symbols or more and up to %d windows of 1 to %d s, default kept\n", RX_AIRTIME_WINDOW_MAX, RX_AIRTIME_WINDOW_S_MAX);
+        air_preamble = RX_AIRTIME_PREAMBLE;
+        air_win_s[0] = 60;
+        air_win_s[1] = 600;
+        air_nb_win = 2;
+    }
+
+    /* spectral scan (optional), its channels are the spotter frequencies */
+    memset(&scanconf, 0, sizeof scanconf);
+    scanconf.nb_read = 2000;
+    scanconf.interval_ms = 60000;
+    obj = json_object_get_object(conf, "spectral_scan");
+    val = json_object_get_value(obj, "enable");
+    if (json_value_get_type(val) == JSONBoolean) {
+        scan_enable = (bool)json_value_get_boolean(val);
+    }
+    if (scan_enable == true) {
+        val = json_object_get_value(obj, "nb_read");
+        if (json_value_get_type(val) == JSONNumber) {
+            scanconf.nb_read = (uint16_t)json_value_get_number(val);
+        }
+        val = json_object_get_value(obj, "interval_s");
+        if (json_value_get_type(val) == JSONNumber) {
+            scanconf.interval_ms = (uint32_t)(json_value_get_number(val) * 1000);
+        }
+        val = json_object_get_value(obj, "rssi_offset");
+        if (json_value_get_type(val) == JSONNumber) {
+            scanconf.rssi_offset = (int8_t)json_value_get_number(val);
+        }
+        val = json_object_get_value(obj, "chunk_size");
+        if (json_value_get_type(val) == JSONNumber) {
+            scanconf.chunk_size = (uint16_t)json_value_get_number(val);
+        }
+        MSG("INFO: spectral scan every %u ms, %u reads per channel\n", scanconf.interval_ms, scanconf.nb_read);
+    }
+
+    return 0;
+}
+
+// Hash each setting read only at startup, 0 when it is absent.
+static void hash_restart_settings(JSON_Object *conf, uint32_t *hash) {
+    JSON_Value *val;
+    char *str;
+    unsigned i;
+    int j;
+
+    for (i = 0; i < ARRAY_SIZE(restart_keys); ++i) {
+        if (restart_keys[i][0] != NULL) {
+            val = json_object_get_value(json_object_get_object(conf, restart_keys[i][0]), restart_keys[i][1]);
         } else {
-            ifconf.enable = false;
-        }
-        if (ifconf.enable == false) {
-            MSG("INFO: LoRa standard channel %i disabled\n", i);
-        } else  {
-            ifconf.rf_chain = (uint32_t)json_object_dotget_number(conf, "chan_Lora_std.radio");
-            ifconf.freq_hz = (int32_t)json_object_dotget_number(conf, "chan_Lora_std.if");
-            bw = (uint32_t)json_object_dotget_number(conf, "chan_Lora_std.bandwidth");
-            switch(bw) {
-                case 500000: ifconf.bandwidth = BW_500KHZ; break;
-                case 250000: ifconf.bandwidth = BW_250KHZ; break;
-                case 125000: ifconf.bandwidth = BW_125KHZ; break;
-                default: ifconf.bandwidth = BW_UNDEFINED;
-            }
-            sf = (uint32_t)json_object_dotget_number(conf, "chan_Lora_std.spread_factor");
-            switch(sf) {
-                case  7: ifconf.datarate = DR_LORA_SF7;  break;
-                case  8: ifconf.datarate = DR_LORA_SF8;  break;
-                case  9: ifconf.datarate = DR_LORA_SF9;  break;
-                case 10: ifconf.datarate = DR_LORA_SF10; break;
-                case 11: ifconf.datarate = DR_LORA_SF11; break;
-                case 12: ifconf.datarate = DR_LORA_SF12; break;
-                default: ifconf.datarate = DR_UNDEFINED;
-            }
-            MSG("INFO: LoRa standard channel enabled, radio %i selected, IF %i Hz, %u Hz bandwidth, SF %u\n", ifconf.rf_chain, ifconf.freq_hz, bw, sf);
-        }
-        if (lgw_rxif_setconf(8, ifconf) != LGW_HAL_SUCCESS) {
-            MSG("ERROR: invalid configuration for Lora standard channel\n");
+            val = json_object_get_value(conf, restart_keys[i][1]);
+        }
+        hash[i] = 0;
+        str = (val != NULL) ? json_serialize_to_string(val) : NULL;
+        if (str != NULL) {
+            hash[i] = 2166136261U; /* FNV-1a of the compact JSON text */
+            for (j = 0; str[j] != '\0'; ++j) {
+                hash[i] = (hash[i] ^ (uint8_t)str[j]) * 16777619U;
+            }
+            json_free_serialized_string(str);
+        }
+    }
+}
+
+// Parse the settings that can be reloaded while running, conf may be NULL to get the defaults.
+static int parse_live_configuration(JSON_Object *conf, struct live_conf_s *lc) {
+    JSON_Object *obj;
+    JSON_Value *val;
+
+    pkt_filter_default(&lc->filter);
+    pkt_rules_init(&lc->rules);
+    lc->stat_interval = 0;
+    lc->rx_utc = false;
+    lc->scan_budget_us = 200;
+    lc->scan_margin_db = 6;
+    lc->tx_flush_us = 0;
+
+    /* receive UTC time, when a GPS is configured */
+    val = json_object_get_value(conf, "rx_utc");
+    if (json_value_get_type(val) == JSONBoolean) {
+        lc->rx_utc = (bool)json_value_get_boolean(val);
+    }
+    if (gps_tty_path[0] != '\0') {
+        MSG("INFO: receive UTC time %s\n", (lc->rx_utc == true) ? "appended to spotter lines" : "not sent");
+    }
+
+    /* statistics report and SPI share of the spectral scan */
+    val = json_object_get_value(conf, "stat_interval");
+    if (json_value_get_type(val) == JSONNumber) {
+        lc->stat_interval = (int)json_value_get_number(val);
+    }
+    if (lc->stat_interval > 0) {
+        MSG("INFO: statistics sent every %d s\n", lc->stat_interval);
+    }
+    obj = json_object_get_object(conf, "spectral_scan");
+    val = json_object_get_value(obj, "budget_us");
+    if (json_value_get_type(val) == JSONNumber) {
+        lc->scan_budget_us = (uint32_t)json_value_get_number(val);
+    }
+    val = json_object_get_value(obj, "margin_db");
+    if (json_value_get_type(val) == JSONNumber) {
+        lc->scan_margin_db = (float)json_value_get_number(val);
+    }
+    if (scan_enable == true) {
+        MSG("INFO: spectral scan %u us SPI budget per step, %.1f dB occupancy margin\n", lc->scan_budget_us, lc->scan_margin_db);
+    }
+
+    /* lines of the next FIFO drains sent along with the current ones, within a latency bound */
+    val = json_object_get_value(conf, "tx_flush_us");
+    if (json_value_get_type(val) == JSONNumber) {
+        lc->tx_flush_us = (uint32_t)json_value_get_number(val);
+    }
+    if (lc->tx_flush_us > TX_FLUSH_MAX_US) {
+        MSG("WARNING: tx_flush_us limited to %u us\n", TX_FLUSH_MAX_US);
+        lc->tx_flush_us = TX_FLUSH_MAX_US;
+    }
+    if (lc->tx_flush_us > 0) {
+        MSG("INFO: lines sent to the client at most %u us after the first one\n", lc->tx_flush_us);
+    }
+
+    /* packet filter, fields not given keep the default criteria */
+    obj = json_object_get_object(conf, "filter");
+    parse_filter_field(obj, "status", PKT_FIELD_STATUS, &lc->filter);
+    parse_filter_field(obj, "modulation", PKT_FIELD_MODULATION, &lc->filter);
+    parse_filter_field(obj, "bandwidth", PKT_FIELD_BANDWIDTH, &lc->filter);
+    parse_filter_field(obj, "spread_factor", PKT_FIELD_DATARATE, &lc->filter);
+    parse_filter_field(obj, "coderate", PKT_FIELD_CODERATE, &lc->filter);
+
+    /* forwarding rules, without them the filter alone selects the spotter lines */
+    val = json_object_get_value(conf, "rules");
+    if (json_value_get_type(val) == JSONArray) {
+        parse_rules(json_value_get_array(val), &lc->rules);
+    }
+    if (lc->rules.nb_pending == 0) {
+        struct pkt_rule_s rule;
+        pkt_rule_from_filter(&rule, &lc->filter, RULE_OUT_SPOTTER);
+        pkt_rules_add(&lc->rules, RULE_ALL_SPOTTERS, 0, &rule);
+        MSG("INFO: no forwarding rules, spotter lines are sent for packets accepted by the filter\n");
+    }
+
+    return 0;
+}
+
+// Turn the radio and multi-SF channel frequencies into the spotter list, then compile the rules against it.
+static int build_spotters(struct live_conf_s *lc) {
+    const uint8_t radio_channels = 4;
+
+    /* Calculate the packet rx frequencies we expect */
+    memset(lc->chanlist, 0, sizeof(lc->chanlist));
+    for (unsigned int k=0; k < ARRAY_SIZE(lc->chanlist); k++) {
+        uint8_t radion = (k / radio_channels);
+        uint8_t rchannel = (k % radio_channels);
+        int32_t cfreq = radio_freqs[radion];
+        int32_t ifreq = chan_if_hz[radion][rchannel];
+        if (cfreq == 0) {
+            MSG("ERROR: Radio %d frequency not set!", radion);
             return -1;
         }
+        if (ifreq == INT32MAX) {
+            MSG("INFO: Radio %d has a missing chan_multiSF_ section in the json file.", radion);
+            lc->chanlist[k] = INT32MAX;
+        } else {
+            lc->chanlist[k] = cfreq + ifreq;
+            MSG("INFO: Spotter %d: LoRa receiver set to %dHz.\n", k, lc->chanlist[k]);
+        }
+    }
+
+    // Sort our channel list
+    qsort(lc->chanlist, ARRAY_SIZE(lc->chanlist), sizeof(int32_t), cmpfunc);
+
+    /* spotter numbers are now known, build the rules table and the prefilter matching it */
+    if (pkt_rules_compile(&lc->rules, lc->chanlist, ARRAY_SIZE(lc->chanlist)) != 0) {
+        MSG("WARNING: some forwarding rules target no spotter or exceed %d rules per spotter, ignored\n", RULES_PER_SPOTTER);
+    }
+    pkt_rules_prefilter(&lc->rules, &lc->filter);
+    return 0;
+}
+
+// Start the spectral scan over the spotter channels.
+static void start_scan(const struct live_conf_s *lc) {
+    scanconf.nb_channel = 0;
+    for (unsigned int k=0; k < ARRAY_SIZE(lc->chanlist); k++) {
+        if (lc->chanlist[k] != INT32MAX) {
+            scan_spotn[scanconf.nb_channel] = k;
+            scanconf.freq_hz[scanconf.nb_channel++] = lc->chanlist[k];
+        }
+    }
+    if ((lgw_scan_setconf(&scanconf) == LGW_SCAN_SUCCESS) && (lgw_scan_start() == LGW_SCAN_SUCCESS)) {
+        scan_active = true;
+    }
+    if (scan_active == false) {
+        MSG("WARNING: failed to start the spectral scan, no noise measurement\n");
+    }
+}
+
+// Start the acquisition thread, the only one reading the concentrator from then on.
+static int start_acq(pthread_t *thrid) {
+    pthread_attr_t attr;
+
+    __atomic_store_n(&acq_stop, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&acq_done, 0, __ATOMIC_RELEASE);
+    if (rt_thread_attr(&attr) != RT_SCHED_SUCCESS) {
+        return -1;
+    }
+    if (pthread_create(thrid, &attr, thread_acq, NULL) != 0) {
+        pthread_attr_destroy(&attr);
+        return -1;
+    }
+    pthread_attr_destroy(&attr);
+    acq_started = true;
+    return 0;
+}
+
+// Stop the acquisition thread and restart the concentrator with a new radio configuration, 1 if it was refused.
+static int restart_concentrator(const struct gw_conf_s *conf, pthread_t *thrid_acq) {
+    int refused = 0;
+    int i;
+
+    __atomic_store_n(&acq_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(*thrid_acq, NULL);
+    acq_started = false;
+    if (scan_active == true) {
+        lgw_scan_stop();
+        scan_active = false;
     }
+    lgw_stop();
+    MSG("INFO: concentrator stopped, restarting it with the new radio configuration\n");
 
-    /* set configuration for FSK channel */
-    memset(&ifconf, 0, sizeof(ifconf)); /* initialize configuration structure */
-    val = json_object_get_value(conf, "chan_FSK"); /* fetch value (if possible) */
-    if (json_value_get_type(val) != JSONObject) {
-        MSG("INFO: no configuration for FSK channel\n");
+    /* no warm restart in the HAL, the SX1301 is reset and its firmwares loaded again */
+    if (gw_conf_apply(conf) == GW_CONF_SUCCESS) {
+        radioconf = *conf;
     } else {
-        val = json_object_dotget_value(conf, "chan_FSK.enable");
-        if (json_value_get_type(val) == JSONBoolean) {
-            ifconf.enable = (bool)json_value_get_boolean(val);
-        } else {
-            ifconf.enable = false;
-        }
-        if (ifconf.enable == false) {
-            MSG("INFO: FSK channel %i disabled\n", i);
-        } else  {
-            ifconf.rf_chain = (uint32_t)json_object_dotget_number(conf, "chan_FSK.radio");
-            ifconf.freq_hz = (int32_t)json_object_dotget_number(conf, "chan_FSK.if");
-            bw = (uint32_t)json_object_dotget_number(conf, "chan_FSK.bandwidth");
-            if      (bw <= 7800)   ifconf.bandwidth = BW_7K8HZ;
-            else if (bw <= 15600)  ifconf.bandwidth = BW_15K6HZ;
-            else if (bw <= 31200)  ifconf.bandwidth = BW_31K2HZ;
-            else if (bw <= 62500)  ifconf.bandwidth = BW_62K5HZ;
-            else if (bw <= 125000) ifconf.bandwidth = BW_125KHZ;
-            else if (bw <= 250000) ifconf.bandwidth = BW_250KHZ;
-            else if (bw <= 500000) ifconf.bandwidth = BW_500KHZ;
-            else ifconf.bandwidth = BW_UNDEFINED;
-            ifconf.datarate = (uint32_t)json_object_dotget_number(conf, "chan_FSK.datarate");
-            MSG("INFO: FSK channel enabled, radio %i selected, IF %i Hz, %u Hz bandwidth, %u bps datarate\n", ifconf.rf_chain, ifconf.freq_hz, bw, ifconf.datarate);
-        }
-        if (lgw_rxif_setconf(9, ifconf) != LGW_HAL_SUCCESS) {
-            MSG("ERROR: invalid configuration for FSK channel\n");
-            return -1;
+        MSG("WARNING: new radio configuration refused, restarting with the former one\n");
+        gw_conf_apply(&radioconf);
+        refused = 1;
+    }
+    if (lgw_start() != LGW_HAL_SUCCESS) {
+        MSG("ERROR: failed to restart the concentrator\n");
+        return -1;
+    }
+    MSG("INFO: concentrator restarted\n");
+
+    /* stamping resumes once the GPS thread dropped the fit of the former counter */
+    if (gps_tty_fd >= 0) {
+        __atomic_store_n(&clk_reset, 1, __ATOMIC_RELEASE);
+        for (i = 0; (i < 2000) && (__atomic_load_n(&clk_reset, __ATOMIC_ACQUIRE) == 1); ++i) {
+            wait_ms(1);
         }
     }
-    json_value_free(root_val);
+    return refused;
+}
+
+// Open the multicast output of udpconf.
+static int open_udp_sink(void) {
+    if (udp_sink_open(&udpsink, &udpconf, lgwm_str) != UDP_SINK_SUCCESS) {
+        MSG("ERROR: failed to open the multicast output to %s on interface '%s'\n", udpconf.group, udpconf.iface);
+        return -1;
+    }
+    udp_active = true;
+    return 0;
+}
+
+// Create the shared memory ring of shm_name.
+static int open_shm_pub(void) {
+    if (shm_pub_open(&shmpub, shm_name) != SHM_PUB_SUCCESS) {
+        MSG("ERROR: failed to create the shared memory %s\n", shm_name);
+        return -1;
+    }
+    shm_active = true;
     return 0;
 }
 
+// Close the multicast output if it is open, with its counters.
+static void close_udp_sink(void) {
+    if (udp_active == true) {
+        MSG("INFO: %" PRIu64 " lines sent to the multicast group in %" PRIu64 " datagrams, %" PRIu64 " datagrams lost\n", udpsink.nb_line, udpsink.nb_datagram, udpsink.nb_lost);
+        udp_sink_close(&udpsink);
+        udp_active = false;
+    }
+}
+
+// Remove the shared memory ring if it is open, with its counters.
+static void close_shm_pub(void) {
+    if (shm_active == true) {
+        MSG("INFO: %" PRIu64 " lines published in shared memory\n", shmpub.nb_line);
+        shm_pub_close(&shmpub);
+        shm_active = false;
+    }
+}
+
+// Reopen the outputs whose settings changed, the main thread is the only one using them.
+static void reload_outputs(const struct udp_sink_conf_s *udp, bool shm_on, const char *shm) {
+    bool was_on = sink_on;
+
+    if (memcmp(udp, &udpconf, sizeof udpconf) != 0) {
+        close_udp_sink();
+        udpconf = *udp;
+        if ((udpconf.enable == true) && (open_udp_sink() != 0)) {
+            MSG("WARNING: multicast output off until the next reload\n");
+        }
+    }
+    if ((shm_on != shm_enable) || (strcmp(shm, shm_name) != 0)) {
+        close_shm_pub();
+        shm_enable = shm_on;
+        strncpy(shm_name, shm, sizeof shm_name - 1);
+        if ((shm_enable == true) && (open_shm_pub() != 0)) {
+            MSG("WARNING: shared memory output off until the next reload\n");
+        }
+    }
+
+    /* the acquisition thread formats the text lines of the packets for the outputs, even for a client taking frames */
+    __atomic_store_n(&sink_on, (udp_active == true) || (shm_active == true), __ATOMIC_RELEASE);
+    if (sink_on != was_on) {
+        set_stream_enc(stream_enc);
+    }
+}
+
+// Reload the configuration file, the settings of the acquisition thread are swapped without stopping it.
+static int reload_configuration(pthread_t *thrid_acq) {
+    struct gw_conf_s conf;
+    struct live_conf_s *lc;
+    int32_t freqs[2];
+    int32_t ifs[2][4];
+    uint32_t hash[ARRAY_SIZE(restart_keys)];
+    struct udp_sink_conf_s udp;
+    bool shm_on;
+    char shm[sizeof shm_name];
+    int i;
+
+    MSG("INFO: reloading configuration file %s\n", conf_fname);
+    gw_conf_init(&conf);
+    if (gw_conf_load(&conf, conf_fname) != GW_CONF_SUCCESS) {
+        MSG("WARNING: reload failed, keeping the current configuration\n");
+        return -1;
+    }
+    lc = live_spare(&live);
+    parse_live_configuration(conf.gateway, lc);
+    parse_output_configuration(conf.gateway, &udp, &shm_on, shm, sizeof shm);
+    hash_restart_settings(conf.gateway, hash);
+    gw_conf_release(&conf);
+    for (i = 0; i < (int)ARRAY_SIZE(restart_keys); ++i) {
+        if (hash[i] != restart_hash[i]) {
+            MSG("WARNING: %s%s%s changed, still running with the former value until the program is restarted\n", (restart_keys[i][0] != NULL) ? restart_keys[i][0] : "", (restart_keys[i][0] != NULL) ? "." : "", restart_keys[i][1]);
+        }
+    }
+
+    /* same radios, the new settings are swapped in between two RX FIFO drains */
+    if (gw_conf_same_radio(&conf, &radioconf) == true) {
+        build_spotters(lc);
+        if (live_publish(&live, &acq_done) != LIVE_CONF_SUCCESS) {
+            return -1; /* acquisition thread gone, exiting anyway */
+        }
+        reload_outputs(&udp, shm_on, shm);
+        MSG("INFO: configuration reloaded without restarting the concentrator\n");
+        return 0;
+    }
+
+    /* new radios, their spotters are checked before stopping anything */
+    memcpy(freqs, radio_freqs, sizeof freqs);
+    memcpy(ifs, chan_if_hz, sizeof ifs);
+    save_spotter_freqs(&conf);
+    if (build_spotters(lc) != 0) {
+        memcpy(radio_freqs, freqs, sizeof freqs);
+        memcpy(chan_if_hz, ifs, sizeof ifs);
+        MSG("WARNING: reload failed, keeping the current configuration\n");
+        return -1;
+    }
+    i = restart_concentrator(&conf, thrid_acq);
+    if (i < 0) {
+        acq_error = true;
+        quit_sig = 1;
+        return -1;
+    } else if (i == 1) {
+        memcpy(radio_freqs, freqs, sizeof freqs);
+        memcpy(chan_if_hz, ifs, sizeof ifs);
+        build_spotters(lc);
+    }
+    pkt_stats_init(&pktstats); /* spotter numbers may have changed */
+    pkt_loss_init(&pktloss, loss_win_s, loss_nb_win);
+    rx_airtime_init(&rxair, air_preamble, air_win_s, air_nb_win);
+    live_swap(&live); /* the acquisition thread is stopped, no grace period */
+    if (scan_enable == true) {
+        start_scan(lc);
+    }
+    if (start_acq(thrid_acq) != 0) {
+        MSG("ERROR: failed to restart the acquisition thread\n");
+        acq_error = true;
+        quit_sig = 1;
+        return -1;
+    }
+    if (i == 1) {
+        return -1; /* former radios back, the former outputs too */
+    }
+    reload_outputs(&udp, shm_on, shm);
+    MSG("INFO: configuration reloaded, concentrator restarted\n");
+    return 1;
+}
+
+// Hand the lines gathered for the client to the other outputs, none of them may block.
+static void send_sinks(void) {
+    const struct iovec *iov = txbatch.iov;
+    int nb = txbatch.nb;
+    int i;
+
+    if (sink_on == false) {
+        return;
+    }
+    if (stream_enc > 0) {
+        // The frames of the client are skipped, the text lines of the same packets are in the batch too.
+        for (i = 0, nb = 0; i < txbatch.nb; ++i) {
+            if (((const uint8_t *)txbatch.iov[i].iov_base)[0] != LORA_FRAME_MAGIC) {
+                sinkiov[nb++] = txbatch.iov[i];
+            }
+        }
+        iov = sinkiov;
+    }
+    if (udp_active == true) {
+        udp_sink_send(&udpsink, iov, nb);
+    }
+    if (shm_active == true) {
+        shm_pub_send(&shmpub, iov, nb);
+    }
+}
+
+// Switch the packets of the client between text lines and frames, the frames start with a keyframe of each spotter.
+static void set_stream_enc(int key_interval) {
+    client_sub_frames(&clientsub, (key_interval > 0) && (sink_on == true));
+    __atomic_store_n(&stream_enc, key_interval, __ATOMIC_RELEASE);
+    __atomic_store_n(&enc_reset, 1, __ATOMIC_RELEASE);
+}
+
+// Keyframe interval of an ENC command, 'ENC delta [key=N]' or 'ENC text', -1 if invalid.
+static int parse_enc(const char *cmd) {
+    int key = SPOT_CODEC_KEY_INTERVAL;
+    int n = 0;
+
+    if (strncmp(cmd, "ENC text", 8) == 0) {
+        return 0;
+    } else if (strncmp(cmd, "ENC delta", 9) != 0) {
+        return -1;
+    }
+    cmd += 9;
+    if ((strncmp(cmd, " key=", 5) == 0) && ((sscanf(cmd + 5, "%d%n", &key, &n) != 1) || (key < 1) || (key > 1000))) {
+        return -1;
+    }
+    return key;
+}
+
+// Keep only the lines the client subscribed to, the other outputs already got all of them.
+static void select_client_lines(void) {
+    struct timespec now;
+    uint16_t rekey;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    txbatch.nb_send = client_sub_filter(&clientsub, txbatch.iov, txbatch.nb, (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+
+    /* a spotter whose frame was dropped starts over with a keyframe, the client decodes it again from there */
+    rekey = client_sub_rekey(&clientsub);
+    if (rekey != 0) {
+        __atomic_fetch_or(&enc_rekey, (int)rekey, __ATOMIC_RELEASE);
+    }
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- MAIN FUNCTION -------------------------------------------------------- */
 
@@ -351,36 +1544,23 @@ int main(int argc, char *argv[])
     char *global_conf_fname = argv[1];
     //const char global_conf_fname[] = "global_conf.json"; /* contain global (typ. network-wide) configuration */
     const char local_conf_fname[] = "local_conf.json"; /* contain node specific configuration, overwrite global parameters for parameters that are defined in both */
+    struct gw_conf_s gwconf;
+    struct live_conf_s *lc;
 
-    /* allocate memory for packet fetching and processing */
-    struct lgw_pkt_rx_s rxpkt[16]; /* array containing up to 16 inbound packets metadata */
-    struct lgw_pkt_rx_s *p; /* pointer on a RX packet */
-    int nb_pkt;
+    /* network output, lines are formatted by the acquisition thread */
+    int len;
+    struct pollfd pfds[2];
+    pthread_t thrid_acq;
+    pthread_attr_t attr;
 
-    /* buffer for each message to be sent to the client */
-    char tx_msg[100];
-    /* Struct to hold data from the spotters */
-    union spotterdata_u {
-        uint8_t bytes[55];
-        struct  {
-            unsigned char type __attribute__((__packed__));
-            unsigned long int timestamp __attribute__((__packed__));
-            unsigned char timestamp_f __attribute__((__packed__));
-            long int X __attribute__((__packed__));
-            long int Y __attribute__((__packed__));
-            long int Z __attribute__((__packed__));
-            char LATD __attribute__((__packed__));
-            long int LATM __attribute__((__packed__));
-            int LOND __attribute__((__packed__));
-            long int LONM __attribute__((__packed__));
-        } d;
-    } spotterdata;
-
-    /* Network receive buffer */
-    char rx_msg[RXBUFLEN];
+    /* Commands of the client, kept until their line is complete */
+    struct client_cmd_s clientcmd;
+    const char *cmd;
 
     /* Keep track of our connection status */
     int connected = 0;
+    bool waiting = false;
+    int clientsock = -1;
 
     /* configure signal handling */
     sigemptyset(&sigact.sa_mask);
@@ -389,20 +1569,51 @@ int main(int argc, char *argv[])
     sigaction(SIGQUIT, &sigact, NULL);
     sigaction(SIGINT, &sigact, NULL);
     sigaction(SIGTERM, &sigact, NULL);
+    sigaction(SIGHUP, &sigact, NULL);
+
+    /* default real-time settings, may be overridden by the configuration */
+    rt_conf_default(&rtconf);
 
     /* configuration files management */
+    gw_conf_init(&gwconf);
     if (access(global_conf_fname, R_OK) == 0) {
     /* if there is a global conf, parse it */
         MSG("INFO: found global configuration file %s, trying to parse it\n", global_conf_fname);
-        parse_SX1301_configuration(global_conf_fname);
+        i = gw_conf_load(&gwconf, global_conf_fname);
+        conf_fname = global_conf_fname;
     } else if (access(local_conf_fname, R_OK) == 0) {
     /* if there is only a local conf, parse it and that's all */
         MSG("INFO: found local configuration file %s, trying to parse it\n", local_conf_fname);
-        parse_SX1301_configuration(local_conf_fname);
+        i = gw_conf_load(&gwconf, local_conf_fname);
+        conf_fname = local_conf_fname;
     } else {
         MSG("ERROR: failed to find any configuration file named %s, or %s\n", global_conf_fname, local_conf_fname);
         return EXIT_FAILURE;
     }
+    if (i != GW_CONF_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    gw_conf_apply(&gwconf);
+    save_spotter_freqs(&gwconf);
+    if (gwconf.gateway_id_set == true) {
+        lgwm = gwconf.gateway_id;
+    }
+    if (gwconf.gateway != NULL) {
+        parse_gateway_configuration(gwconf.gateway);
+    }
+    lc = live_init(&live);
+    parse_live_configuration(gwconf.gateway, lc);
+    hash_restart_settings(gwconf.gateway, restart_hash);
+    gw_conf_release(&gwconf);
+    radioconf = gwconf;
+
+    /* lock the memory and keep this thread, and the ones it creates, off the acquisition CPU */
+    if (rt_lock_memory(&rtconf) != RT_SCHED_SUCCESS) {
+        MSG("WARNING: failed to lock memory: %s\n", strerror(errno));
+    }
+    if (rt_sched_other(&rtconf) != RT_SCHED_SUCCESS) {
+        MSG("WARNING: failed to keep other threads off CPU %d\n", rtconf.cpu);
+    }
 
     /* starting the concentrator */
     i = lgw_start();
@@ -414,11 +1625,46 @@ int main(int argc, char *argv[])
         //#warning Uncomment the above line before actually building this!!
     }
 
+    /* get notified of packets in the RX FIFO, if configured */
+    if (rxirq_enable == true) {
+        if (lgw_gpio_rx_open(rxirq_chip, rxirq_line, &rxirq_fd) != LGW_GPIO_SUCCESS) {
+            MSG("WARNING: failed to open RX-ready GPIO %s line %u, falling back to polling\n", rxirq_chip, rxirq_line);
+            rxirq_fd = -1;
+        }
+    }
+
+    /* keep the counter <-> UTC reference up to date from the GPS, if configured */
+    pthread_t thrid_gps;
+    bool gps_active = false;
+    time_ref_init(&timeref);
+    lgw_clk_init(&gps_clk);
+    if (gps_tty_path[0] != '\0') {
+        if (lgw_gps_enable(gps_tty_path, gps_family, 0, &gps_tty_fd) != LGW_GPS_SUCCESS) {
+            MSG("WARNING: failed to open GPS on %s, packets will not be stamped with UTC time\n", gps_tty_path);
+        } else if ((rt_thread_attr(&attr) != RT_SCHED_SUCCESS) || (pthread_create(&thrid_gps, &attr, thread_gps, NULL) != 0)) {
+            MSG("WARNING: failed to start GPS thread\n");
+            lgw_gps_disable(gps_tty_fd);
+        } else {
+            pthread_attr_destroy(&attr);
+            gps_active = true;
+        }
+    }
+
     /* transform the MAC address into a string */
     sprintf(lgwm_str, "%08X%08X", (uint32_t)(lgwm >> 32), (uint32_t)(lgwm & 0xFFFFFFFF));
 
+    /* multicast and shared memory outputs, lines are formatted for them from the start */
+    if ((udpconf.enable == true) && (open_udp_sink() != 0)) {
+        return EXIT_FAILURE;
+    }
+    if ((shm_enable == true) && (open_shm_pub() != 0)) {
+        return EXIT_FAILURE;
+    }
+    sink_on = (udp_active == true) || (shm_active == true);
+    client_on = (int)sink_on;
+
     /* Set things up to serve data over the network */
-    int serversock, clientsock;
+    int serversock;
     struct sockaddr_in loraserver, loraclient;
 
     if ((serversock = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) {
@@ -441,37 +1687,81 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    /* Calculate the packet rx frequencies we expect */
-    int32_t chanlist[8];
-    const uint8_t radio_channels = 4;
-    memset(chanlist, 0, sizeof(chanlist));
-    for (unsigned int k=0; k < ARRAY_SIZE(chanlist); k++) {
-        uint8_t radion = (k / radio_channels);
-        uint8_t rchannel = (k % radio_channels);
-        int32_t cfreq = radio_freqs[radion];
-        int32_t ifreq = chan_if_hz[radion][rchannel];
-        if (cfreq == 0) {
-            MSG("ERROR: Radio %d frequency not set!", radion);
-            return EXIT_FAILURE;
-        }
-        if (ifreq == INT32MAX) {
-            MSG("INFO: Radio %d has a missing chan_multiSF_ section in the json file.", radion);
-            chanlist[k] = INT32MAX;
+    /* spotter numbers are now known, build the rules table and the prefilter matching it */
+    if (build_spotters(lc) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    /* sweep the spotter channels in the background, if configured */
+    pkt_stats_init(&pktstats);
+    pkt_loss_init(&pktloss, loss_win_s, loss_nb_win);
+    rx_airtime_init(&rxair, air_preamble, air_win_s, air_nb_win);
+    if (scan_enable == true) {
+        start_scan(lc);
+    }
+    /* wave spectra of the spotters (optional), computed by their own thread from the samples of the acquisition thread */
+    pthread_t thrid_wave;
+    if (wave_enable == true) {
+        if (wave_spec_init(&wavespec, wave_window, wave_segment) != WAVE_SPEC_SUCCESS) {
+            MSG("WARNING: invalid wave window %d or segment %d, no wave spectra\n", wave_window, wave_segment);
+        } else if ((rt_thread_attr(&attr) != RT_SCHED_SUCCESS) || (pthread_create(&thrid_wave, &attr, thread_wave, NULL) != 0)) {
+            MSG("WARNING: failed to start the wave thread, no wave spectra\n");
         } else {
-            chanlist[k] = cfreq + ifreq;
-            MSG("INFO: Spotter %d: LoRa receiver set to %dHz.\n", k, chanlist[k]);
+            pthread_attr_destroy(&attr);
+            wave_active = true;
         }
     }
+    if (wave_active == false) {
+        wave_raw = true; /* the packets are all there is */
+    }
 
-    // Sort our channel list
-    qsort(chanlist, ARRAY_SIZE(chanlist), sizeof(int32_t), cmpfunc);
+    /* from now on the concentrator is read by the acquisition thread only, this thread serves the client */
+    if (line_ring_init(&txring) != LINE_RING_SUCCESS) {
+        MSG("ERROR: failed to create the line ring, exiting\n");
+        return EXIT_FAILURE;
+    }
+    if (start_acq(&thrid_acq) != 0) {
+        MSG("ERROR: failed to start the acquisition thread, exiting\n");
+        return EXIT_FAILURE;
+    }
 
     /* main loop */
-    /* While a client is connected keep forwarding packets from the RAK module to the client. */
+    /* While a client is connected keep forwarding the lines of the acquisition thread to the client. */
     while ((quit_sig != 1) && (exit_sig != 1)) {
+        if (reload_sig == 1) {
+            reload_sig = 0;
+            reload_configuration(&thrid_acq);
+            if (connected == 0) {
+                __atomic_store_n(&client_on, (int)sink_on, __ATOMIC_RELEASE); /* an output may have been turned on or off */
+            }
+            continue;
+        }
         if (connected == 0) {
-            // Wait for a new client to connect.
-            MSG("INFO: Waiting for a client to connect.\n");
+            // Wait for a new client to connect, checking the exit conditions from time to time.
+            if (waiting == false) {
+                MSG("INFO: Waiting for a client to connect.\n");
+                waiting = true;
+                set_stream_enc(0);
+            }
+            pfds[0].fd = serversock;
+            pfds[0].events = POLLIN;
+            pfds[1].fd = (sink_on == true) ? txring.fd[0] : -1;
+            pfds[1].events = POLLIN;
+            i = poll(pfds, ARRAY_SIZE(pfds), WAKEUP_MS);
+            if ((i == 0) || ((i < 0) && (errno == EINTR))) {
+                continue;
+            }
+            // Only the multicast and shared memory outputs get the lines until a client connects.
+            if (pfds[1].revents & POLLIN) {
+                line_ring_ack(&txring);
+                if (tx_batch_collect(&txbatch, &txring, live_read(&live)->tx_flush_us) > 0) {
+                    send_sinks();
+                    tx_batch_release(&txbatch, &txring);
+                }
+            }
+            if ((pfds[0].revents & POLLIN) == 0) {
+                continue;
+            }
             unsigned int clientlen = sizeof(loraclient);
             /* Wait for client connection */
             if ((clientsock = accept(serversock, (struct sockaddr *) &loraclient, &clientlen)) < 0) {
@@ -481,29 +1771,67 @@ int main(int argc, char *argv[])
             /* A client is now connected */
             MSG("INFO: Client connected: %s\n", inet_ntoa(loraclient.sin_addr));
 
+            /* lines are already coalesced by tx_batch, do not let Nagle hold them beyond the latency bound */
+            i = 1;
+            if (setsockopt(clientsock, IPPROTO_TCP, TCP_NODELAY, &i, sizeof i) != 0) {
+                MSG("WARNING: failed to set TCP_NODELAY on the client socket\n");
+            }
+
             char hellomsg[] = "Connected...\n";
             send(clientsock, hellomsg, strlen(hellomsg), 0);
             connected = 1;
+            waiting = false;
 
-            /* Clear the buffer out right after we connect so we don't send old packets to the client */
-            nb_pkt = lgw_receive(ARRAY_SIZE(rxpkt), rxpkt);
-            if (nb_pkt == LGW_HAL_ERROR) {
-                MSG("ERROR: failed packet fetch, exiting\n");
-                return EXIT_FAILURE;
+            /* Drop the lines formatted for the previous client so we don't send old packets to this one */
+            if (sink_on == false) {
+                line_ring_ack(&txring);
+                while (line_ring_peek(&txring, &len) != NULL) {
+                    line_ring_pop(&txring);
+                }
             }
+            tx_batch_init(&txbatch);
+            client_sub_init(&clientsub);
+            client_cmd_init(&clientcmd);
+            set_stream_enc(0);
+            __atomic_store_n(&client_on, 1, __ATOMIC_RELEASE);
         }
-        /* Fetch packets from the concentrator */
-        nb_pkt = lgw_receive(ARRAY_SIZE(rxpkt), rxpkt);
-        if (nb_pkt == LGW_HAL_ERROR) {
-            MSG("ERROR: failed packet fetch, exiting\n");
+
+        /* Sleep until the acquisition thread has lines or the client sends something */
+        pfds[0].fd = txring.fd[0];
+        pfds[0].events = POLLIN;
+        pfds[1].fd = clientsock;
+        pfds[1].events = POLLIN;
+        i = poll(pfds, ARRAY_SIZE(pfds), WAKEUP_MS);
+        if (i < 0) {
+            if (errno == EINTR) {
+                continue; /* signal received, re-check exit conditions */
+            }
+            MSG("ERROR: poll reported error code: %s\n", strerror(errno));
             return EXIT_FAILURE;
         }
+        if (pfds[0].revents & POLLIN) {
+            line_ring_ack(&txring);
+        }
+
+        // Send out every line available in one write, the acquisition thread drops lines rather than waiting for us.
+        if (tx_batch_collect(&txbatch, &txring, live_read(&live)->tx_flush_us) > 0) {
+            send_sinks();
+            select_client_lines();
+            if (tx_batch_send(&txbatch, &txring, clientsock) != TX_BATCH_SUCCESS) {
+                MSG("INFO: Client lost: %s\n", strerror(errno));
+                close(clientsock);
+                connected = 0;
+                __atomic_store_n(&client_on, (int)sink_on, __ATOMIC_RELEASE);
+                continue;
+            }
+        }
 
         // Check if the client is still connected.
         int received = -1;
-        if ((received = recv(clientsock, rx_msg, RXBUFLEN, MSG_DONTWAIT)) < 0) {
+        if ((received = (int)client_cmd_recv(&clientcmd, clientsock)) < 0) {
             if (errno == EBADF) {
                 connected = 0;
+                __atomic_store_n(&client_on, (int)sink_on, __ATOMIC_RELEASE);
                 continue; // Break out of the packet processing loop to reconnect to a client.
             } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
                 // No data was in the buffer so keep working on other stuff.
@@ -516,61 +1844,80 @@ int main(int argc, char *argv[])
             // The client disconnected!
             close(clientsock); // Don't forget to close the socket when the remote end disconnects!
             connected = 0;
+            __atomic_store_n(&client_on, (int)sink_on, __ATOMIC_RELEASE);
+            if (txbatch.nb_write > 0) {
+                MSG("INFO: %" PRIu64 " lines sent in %" PRIu64 " writes, %.1f lines per write\n", txbatch.nb_line, txbatch.nb_write, (double)txbatch.nb_line / txbatch.nb_write);
+            }
+            if ((clientsub.nb_skip > 0) || (clientsub.nb_limit > 0)) {
+                MSG("INFO: %" PRIu64 " lines not subscribed and %" PRIu64 " over the rate were not sent\n", clientsub.nb_skip, clientsub.nb_limit);
+            }
+            if (__atomic_load_n(&txring.nb_drop, __ATOMIC_RELAXED) > 0) {
+                MSG("INFO: %u lines dropped so far, the client did not keep up\n", __atomic_load_n(&txring.nb_drop, __ATOMIC_RELAXED));
+            }
             continue;
         }
 
-        /* process packets */
-        for (i=0; i < nb_pkt; ++i) {
-            p = &rxpkt[i];
-
-            // Only process and forward packets that meet our criteria.
-            if ((p->status == STAT_CRC_OK) && (p->modulation == MOD_LORA) &&
-               (p->bandwidth == BW_125KHZ) && (p->datarate == DR_LORA_SF7) &&
-               (p->coderate == CR_LORA_4_5)) {
-                // Packet meets all our criteria. Time to forward it to the network.
-                int spotn = -1;
-
-                // Turn the frequency into the spotter number [0-8]
-                for (unsigned int l=0; l < ARRAY_SIZE(chanlist); l++) {
-                    if ((int64_t)chanlist[l] == (int64_t)p->freq_hz) spotn = l;
+        // Every complete line is a command, an unfinished one waits for the next read.
+        while ((connected == 1) && ((cmd = client_cmd_next(&clientcmd)) != NULL)) {
+            if (strncmp(cmd, "RELOAD", 6) == 0) {
+                // Same as SIGHUP, the client is told the outcome.
+                i = reload_configuration(&thrid_acq);
+                const char *reply = (i == 0) ? "$RELOAD,ok\n" : (i == 1) ? "$RELOAD,restarted\n" : "$RELOAD,failed\n";
+                send(clientsock, reply, strlen(reply), 0);
+            } else if (strncmp(cmd, "SUB", 3) == 0) {
+                // New subscription of the client, it is told the one in force.
+                char reply[64];
+                if (client_sub_parse(&clientsub, cmd) == CLIENT_SUB_SUCCESS) {
+                    len = client_sub_format(&clientsub, reply, sizeof reply);
+                    MSG("INFO: Client subscription: %s", reply);
+                } else {
+                    len = sprintf(reply, "$SUB,failed\n");
                 }
-
-                if (spotn == -1) {
-                    MSG("INFO: Somehow received packet on unknown frequency (%d Hz)!?\n", p->freq_hz);
-                    continue; // Skip the rest of the steps to process this packet.
+                send(clientsock, reply, len, 0);
+            } else if (strncmp(cmd, "ENC", 3) == 0) {
+                // Packets as text lines or delta encoded frames, decoded by libloraclient.
+                char reply[64];
+                i = parse_enc(cmd);
+                if (i == 0) {
+                    len = sprintf(reply, "$ENC,text\n");
+                } else if (i > 0) {
+                    len = sprintf(reply, "$ENC,delta,%d\n", i);
+                } else {
+                    len = sprintf(reply, "$ENC,failed\n");
+                }
+                if (i >= 0) {
+                    set_stream_enc(i);
+                    MSG("INFO: Client encoding: %s", reply);
                 }
-                
-                // Copy the received data into a union/struct to unpack the values.
-                memcpy(spotterdata.bytes, p->payload, p->size);
-                
-                // Resulting timestamp will be in tenths of a second since epoch
-                unsigned long long int extended_timestamp = (unsigned long long int)spotterdata.d.timestamp * 10;
-                
-                // Limit the fractional timestamp part
-                if(spotterdata.d.timestamp_f > 9) spotterdata.d.timestamp_f = 9;
-                
-                // Combine the timestamp in seconds with the fractional part (tenths of a second)
-                extended_timestamp += (unsigned long long int)spotterdata.d.timestamp_f;
-                
-		// Convert deg & min back to decimal degrees before sending
-		float latitude = spotterdata.d.LATD + (spotterdata.d.LATM / 6000000.0);
-		float longitude = spotterdata.d.LOND + (spotterdata.d.LONM / 6000000.0);
-
-                // Build the ascii string using sprintf to convert and format the variables.
-                sprintf(tx_msg, "#%d,%hhu,%llu,%ld,%ld,%ld,%.9f,%.9f\n", spotn, \
-                                                          spotterdata.d.type, \
-                                                          extended_timestamp, \
-                                                          spotterdata.d.X, \
-                                                          spotterdata.d.Y, \
-                                                          spotterdata.d.Z, \
-                                                          latitude, \
-							  longitude);
-                // Send the formatted data out to the client.
-                send(clientsock, tx_msg, strlen(tx_msg), 0);
+                send(clientsock, reply, len, 0);
+            } else if (strncmp(cmd, "STATUS", 6) == 0) {
+                // Loss and airtime of all spotters, sent in the stream by the acquisition thread once its drain is done.
+                __atomic_store_n(&loss_req, 1, __ATOMIC_RELEASE);
             }
         }
     }
 
+    /* the acquisition thread checks the exit conditions at least every WAKEUP_MS */
+    if (acq_started == true) {
+        pthread_join(thrid_acq, NULL);
+    }
+    if (wave_active == true) {
+        pthread_join(thrid_wave, NULL); /* checks the exit conditions every second */
+    }
+    line_ring_close(&txring);
+    close_udp_sink();
+    close_shm_pub();
+
+    if (scan_active == true) {
+        lgw_scan_stop();
+    }
+
+    if (gps_active == true) {
+        pthread_cancel(thrid_gps); /* blocked in read() most of the time */
+        pthread_join(thrid_gps, NULL);
+        lgw_gps_disable(gps_tty_fd);
+    }
+
     if (exit_sig == 1) {
         /* clean up before leaving */
         i = lgw_stop();
@@ -593,8 +1940,12 @@ int main(int argc, char *argv[])
         close(serversock);
     }
 
+    if (rxirq_fd >= 0) {
+        lgw_gpio_rx_close(rxirq_fd);
+    }
+
     MSG("INFO: Exiting packet server program\n");
-    return EXIT_SUCCESS;
+    return (acq_error == true) ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 /* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,397 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Wave spectrum of each spotter, Welch average of real FFTs. The real FFT of
+    N samples is a complex FFT of N/2 points (even samples as real parts, odd
+    ones as imaginary parts) split into the N/2+1 bins, the complex FFT is an
+    iterative radix-2 one on separate real and imaginary arrays, with the
+    twiddles of each stage contiguous so that the butterflies of a stage are
+    a plain loop over restrict pointers. GCC 12 vectorizes it, and the split
+    and Welch loops, with -ftree-vectorize -fvect-cost-model=dynamic as set
+    in the Makefile; -O2 alone leaves them scalar (check with -fopt-info-vec).
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* snprintf */
+#include <string.h>     /* memset */
+#include <math.h>       /* cos sin sqrt */
+
+#include "wave_spec.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define RING_MASK       (WAVE_SPEC_RING_SIZE - 1)
+#define READ_TRIES      4       /* copies of a window overwritten meanwhile before giving up */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static bool is_pow2(int n) {
+    return (n > 0) && ((n & (n - 1)) == 0);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* complex FFT of m points in place, input in bit reversed order */
+static void fft(const struct wave_spec_s *w, float *re, float *im, int m) {
+    float tr, ti;
+    int h, s, j;
+
+    for (h = 1; h < m; h <<= 1) {
+        const float *restrict wr = w->tw_re + h - 1;
+        const float *restrict wi = w->tw_im + h - 1;
+        for (s = 0; s < m; s += 2 * h) {
+            /* halves of a block, never overlapping, so that the loop needs no aliasing check */
+            float *restrict ar = re + s;
+            float *restrict ai = im + s;
+            float *restrict br = re + s + h;
+            float *restrict bi = im + s + h;
+            for (j = 0; j < h; ++j) {
+                tr = br[j] * wr[j] - bi[j] * wi[j];
+                ti = br[j] * wi[j] + bi[j] * wr[j];
+                br[j] = ar[j] - tr;
+                bi[j] = ai[j] - ti;
+                ar[j] += tr;
+                ai[j] += ti;
+            }
+        }
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* copy the latest window of a spotter, in meters, false if it was overwritten while being copied */
+static bool read_window(struct wave_spec_s *w, struct wave_spec_ring_s *g, uint32_t wr) {
+    uint32_t start = wr - (uint32_t)w->window;
+    int k;
+
+    for (k = 0; k < w->window; ++k) {
+        w->t[k] = g->tenths[(start + k) & RING_MASK];
+        w->z[k] = (float)g->z[(start + k) & RING_MASK] * 0.001f;
+    }
+    /* the writer stores slot wr before publishing wr+1, so the unpublished slot must stay clear of the window */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (__atomic_load_n(&g->wr, __ATOMIC_RELAXED) - start) < WAVE_SPEC_RING_SIZE - 1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* cadence of the window in tenths, mean of the steps up to 1.5 times the median one, the longer ones are gaps */
+static float cadence(const struct wave_spec_s *w) {
+    uint16_t nb[WAVE_SPEC_STEP_MAX + 1];
+    uint64_t step;
+    int k, med, n = 0, sum = 0;
+
+    memset(nb, 0, sizeof nb);
+    for (k = 1; k < w->window; ++k) {
+        step = w->t[k] - w->t[k - 1];
+        if (step <= WAVE_SPEC_STEP_MAX) {
+            nb[step]++;
+            n++;
+        }
+    }
+    for (med = 1; (med <= WAVE_SPEC_STEP_MAX) && (2 * sum < n); ++med) {
+        sum += nb[med];
+    }
+    med--;
+    for (k = 1, n = 0, sum = 0; (k <= WAVE_SPEC_STEP_MAX) && (2 * k <= 3 * med); ++k) {
+        n += nb[k];
+        sum += k * nb[k];
+    }
+    return (n > 0) ? (float)sum / (float)n : 0.0f;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* samples of the window at the cadence, ending at the latest one, returns how many were lost and filled */
+static int resample(struct wave_spec_s *w, float period) {
+    uint64_t t0 = w->t[0];
+    float span = (float)(w->t[w->window - 1] - t0);
+    float t, a;
+    int k, j = 0, nb_rx = 0;
+
+    for (k = 0; k < w->window; ++k) {
+        t = span - (float)(w->window - 1 - k) * period;
+        if (t < 0.0f) {
+            w->x[k] = w->z[0]; /* cadence a little longer than the steps received */
+            continue;
+        }
+        while ((j < w->window - 2) && ((float)(w->t[j + 1] - t0) < t)) {
+            j++;
+        }
+        a = (t - (float)(w->t[j] - t0)) / (float)(w->t[j + 1] - w->t[j]);
+        w->x[k] = w->z[j] + a * (w->z[j + 1] - w->z[j]); /* straight across a gap */
+    }
+
+    /* samples received over the span of the window, the others were lost */
+    for (k = 0; k < w->window; ++k) {
+        if ((float)(w->t[k] - t0) > span - ((float)w->window - 0.5f) * period) {
+            nb_rx++;
+        }
+    }
+    return w->window - nb_rx;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int wave_spec_init(struct wave_spec_s *w, int window, int segment) {
+    int m = segment / 2;
+    int bits, h, j, k, r;
+
+    if ((is_pow2(segment) == false) || (segment < WAVE_SPEC_SEG_MIN) || (segment > WAVE_SPEC_SEG_MAX) ||
+        (window < segment) || (window > WAVE_SPEC_WINDOW_MAX) || ((window % m) != 0)) {
+        return WAVE_SPEC_ERROR;
+    }
+    memset(w, 0, sizeof *w);
+    w->window = window;
+    w->segment = segment;
+
+    /* periodic Hann window, the segments overlap by half */
+    for (k = 0; k < segment; ++k) {
+        w->hann[k] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * k / segment));
+        w->hann_pow += w->hann[k] * w->hann[k];
+    }
+
+    /* complex FFT of m points */
+    for (bits = 0; (1 << bits) < m; ++bits);
+    for (k = 0; k < m; ++k) {
+        for (j = 0, r = 0; j < bits; ++j) {
+            r |= ((k >> j) & 1) << (bits - 1 - j);
+        }
+        w->rev[k] = (uint16_t)r;
+    }
+    for (h = 1; h < m; h <<= 1) {
+        for (j = 0; j < h; ++j) {
+            w->tw_re[h - 1 + j] = (float)cos(-M_PI * j / h);
+            w->tw_im[h - 1 + j] = (float)sin(-M_PI * j / h);
+        }
+    }
+
+    /* split into the bins of the real FFT */
+    for (k = 0; k <= m / 2; ++k) {
+        w->sp_re[k] = (float)cos(-2.0 * M_PI * k / segment);
+        w->sp_im[k] = (float)sin(-2.0 * M_PI * k / segment);
+    }
+    return WAVE_SPEC_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void wave_spec_push(struct wave_spec_s *w, int spotn, uint64_t tenths, int32_t z) {
+    struct wave_spec_ring_s *g;
+    uint32_t wr;
+
+    if ((spotn < 0) || (spotn >= SPOTTER_NB)) {
+        return;
+    }
+    g = &w->ring[spotn];
+    wr = g->wr; /* only written by this thread */
+    if ((wr > 0) && (tenths <= g->tenths[(wr - 1) & RING_MASK])) {
+        return; /* duplicate or late, the window must be in time order */
+    }
+    g->tenths[wr & RING_MASK] = tenths;
+    g->z[wr & RING_MASK] = z;
+    __atomic_store_n(&g->wr, wr + 1, __ATOMIC_RELEASE);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void wave_spec_rfft(const struct wave_spec_s *w, const float *restrict in, float *restrict re, float *restrict im) {
+    int m = w->segment / 2;
+    float zr, zi, cr, ci, er, ei, orr, oi, tr, ti;
+    int k;
+
+    /* even samples as real parts, odd samples as imaginary parts */
+    for (k = 0; k < m; ++k) {
+        re[w->rev[k]] = in[2 * k];
+        im[w->rev[k]] = in[2 * k + 1];
+    }
+    fft(w, re, im, m);
+
+    /* X[k] = E[k] + W^k O[k], with E and O the spectra of the even and odd samples */
+    zr = re[0];
+    zi = im[0];
+    re[0] = zr + zi;
+    im[0] = 0.0f;
+    re[m] = zr - zi;
+    im[m] = 0.0f;
+    for (k = 1; k <= m / 2; ++k) {
+        zr = re[k];
+        zi = im[k];
+        cr = re[m - k];
+        ci = -im[m - k];
+        er = 0.5f * (zr + cr);
+        ei = 0.5f * (zi + ci);
+        orr = 0.5f * (zi - ci);
+        oi = -0.5f * (zr - cr);
+        tr = w->sp_re[k] * orr - w->sp_im[k] * oi;
+        ti = w->sp_re[k] * oi + w->sp_im[k] * orr;
+        re[m - k] = er - tr; /* X[m-k] = conj(E[k] - W^k O[k]) */
+        im[m - k] = -(ei - ti);
+        re[k] = er + tr;
+        im[k] = ei + ti;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int wave_spec_compute(struct wave_spec_s *w, int spotn, struct wave_spec_res_s *r) {
+    struct wave_spec_ring_s *g;
+    uint32_t wr;
+    int half = w->segment / 2;
+    int nb_seg = (w->window - w->segment) / half + 1;
+    float period, mean, df, f, fmax, p, m0 = 0.0f, m2 = 0.0f, pmax = 0.0f;
+    int k, s, kp = 0, b, tries, nb_fill;
+
+    if ((spotn < 0) || (spotn >= SPOTTER_NB)) {
+        return WAVE_SPEC_NODATA;
+    }
+    g = &w->ring[spotn];
+    for (tries = 0; tries < READ_TRIES; ++tries) {
+        wr = __atomic_load_n(&g->wr, __ATOMIC_ACQUIRE);
+        if ((wr < (uint32_t)w->window) || (wr == g->done)) {
+            return WAVE_SPEC_NODATA;
+        }
+        if (read_window(w, g, wr) == true) {
+            break;
+        }
+    }
+    if (tries == READ_TRIES) {
+        return WAVE_SPEC_NODATA;
+    }
+    g->done = wr;
+
+    /* the lost samples would shift the frequencies if the window was taken as evenly spaced */
+    period = cadence(w);
+    if (period <= 0.0f) {
+        return WAVE_SPEC_NODATA;
+    }
+    nb_fill = resample(w, period);
+    if (nb_fill * 100 > w->window * WAVE_SPEC_LOSS_PCT) {
+        return WAVE_SPEC_NODATA;
+    }
+
+    memset(r, 0, sizeof *r);
+    r->spotn = spotn;
+    r->tenths = w->t[w->window - 1];
+    r->nb = w->window - nb_fill;
+    r->fs = 10.0f / period;
+
+    /* Welch: segments overlapping by half, each without its mean and Hann windowed */
+    memset(w->psd, 0, sizeof w->psd);
+    for (s = 0; s < nb_seg; ++s) {
+        const float *restrict x = w->x + s * half;
+        const float *restrict hann = w->hann;
+        float *restrict seg = w->seg;
+        float *restrict psd = w->psd;
+        float *restrict re = w->re;
+        float *restrict im = w->im;
+        for (k = 0, mean = 0.0f; k < w->segment; ++k) {
+            mean += x[k];
+        }
+        mean /= (float)w->segment;
+        for (k = 0; k < w->segment; ++k) {
+            seg[k] = (x[k] - mean) * hann[k];
+        }
+        wave_spec_rfft(w, seg, re, im);
+        for (k = 0; k <= half; ++k) {
+            psd[k] += re[k] * re[k] + im[k] * im[k];
+        }
+    }
+
+    /* one-sided density, then the moments over the wave band */
+    df = r->fs / (float)w->segment;
+    fmax = WAVE_SPEC_FMIN + WAVE_SPEC_BANDS * WAVE_SPEC_DF_BAND;
+    if (fmax > r->fs / 2.0f) {
+        fmax = r->fs / 2.0f;
+    }
+    for (k = 1; k < half; ++k) {
+        w->psd[k] *= 2.0f / ((float)nb_seg * r->fs * w->hann_pow);
+    }
+    for (k = 1; k < half; ++k) {
+        f = k * df;
+        if ((f < WAVE_SPEC_FMIN) || (f >= fmax)) {
+            continue;
+        }
+        p = w->psd[k] * df;
+        m0 += p;
+        m2 += p * f * f;
+        b = (int)((f - WAVE_SPEC_FMIN) / WAVE_SPEC_DF_BAND);
+        r->band[(b < WAVE_SPEC_BANDS) ? b : WAVE_SPEC_BANDS - 1] += p;
+        if (w->psd[k] > pmax) {
+            pmax = w->psd[k];
+            kp = k;
+        }
+    }
+    if ((m0 <= 0.0f) || (m2 <= 0.0f)) {
+        return WAVE_SPEC_SUCCESS; /* flat sea, or no sample in the band */
+    }
+    r->hs = 4.0f * sqrtf(m0);
+    r->tm02 = sqrtf(m0 / m2);
+    for (b = 0; b < WAVE_SPEC_BANDS; ++b) {
+        r->band[b] /= m0;
+    }
+
+    /* peak between bins, fitting a parabola on the largest bin and its neighbours */
+    f = (float)kp;
+    if ((kp > 1) && (kp < half - 1)) {
+        p = w->psd[kp - 1] - 2.0f * pmax + w->psd[kp + 1];
+        if (p < 0.0f) {
+            f += 0.5f * (w->psd[kp - 1] - w->psd[kp + 1]) / p;
+        }
+    }
+    r->tp = 1.0f / (f * df);
+    return WAVE_SPEC_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int wave_spec_format(const struct wave_spec_res_s *r, char *buf, int len) {
+    int n;
+
+    n = snprintf(buf, len, "$WAVE,%d,%llu,%.2f,%.1f,%.1f,%.2f,%d\n", r->spotn, (unsigned long long)r->tenths, r->hs, r->tp, r->tm02, r->fs, r->nb);
+    return ((n < 0) || (n >= len)) ? len - 1 : n;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int wave_spec_format_bands(const struct wave_spec_res_s *r, char *buf, int len) {
+    int n, b;
+
+    n = snprintf(buf, len, "$WSPEC,%d,%d,%d", r->spotn, (int)(WAVE_SPEC_FMIN * 1000.0f + 0.5f), (int)(WAVE_SPEC_DF_BAND * 1000.0f + 0.5f));
+    for (b = 0; (n > 0) && (n < len) && (b < WAVE_SPEC_BANDS); ++b) {
+        n += snprintf(buf + n, len - n, ",%d", (int)(r->band[b] * 1000.0f + 0.5f));
+    }
+    if ((n > 0) && (n < len - 1)) {
+        buf[n++] = '\n';
+        buf[n] = '\0';
+    }
+    return ((n < 0) || (n >= len)) ? len - 1 : n;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,132 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check the commands of the client read from a socket pair: two commands
+    sent in a single write, as two back-to-back lc_send calls do, a command
+    split over two writes, a line too long and a client disconnecting.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>     /* EXIT_SUCCESS */
+#include <string.h>     /* strcmp memset */
+#include <errno.h>
+#include <unistd.h>     /* write close */
+#include <sys/socket.h> /* socketpair */
+
+#include "client_cmd.h"
+#include "client_sub.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct client_cmd_s cmd;
+static int sv[2];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* write what the client sends, read it on the server side, then check the lines against the expected ones */
+static int check(const char *name, const char *sent, const char **expect, int nb_expect) {
+    const char *line;
+    int nb = 0, nb_err = 0;
+
+    if ((sent != NULL) && (write(sv[1], sent, strlen(sent)) != (ssize_t)strlen(sent))) {
+        printf("ERROR: %s, write failed\n", name);
+        return 1;
+    }
+    while (client_cmd_recv(&cmd, sv[0]) > 0);
+    while ((line = client_cmd_next(&cmd)) != NULL) {
+        printf("%s: \"%s\"\n", name, line);
+        if ((nb >= nb_expect) || (strcmp(line, expect[nb]) != 0)) {
+            nb_err = 1;
+        }
+        nb++;
+    }
+    if ((nb_err != 0) || (nb != nb_expect)) {
+        printf("ERROR: %s, %d lines instead of %d, or not the ones sent\n", name, nb, nb_expect);
+        return 1;
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    static const char *two[] = { "SUB spot=2,5 kind=PKT", "ENC delta" };
+    static const char *status[] = { "STATUS" };
+    static const char *reload[] = { "RELOAD" };
+    static char longline[3 * CLIENT_CMD_BUF_SIZE];
+    struct client_sub_s sub;
+    int nb_err = 0;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        printf("ERROR: no socket pair\n");
+        return EXIT_FAILURE;
+    }
+    client_cmd_init(&cmd);
+
+    /* nothing sent yet */
+    if ((client_cmd_recv(&cmd, sv[0]) != -1) || ((errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+        printf("ERROR: empty socket not reported as EAGAIN\n");
+        ++nb_err;
+    }
+
+    /* two commands in a single write, both handled and the subscription compiled from the first one */
+    nb_err += check("one write", "SUB spot=2,5 kind=PKT\nENC delta\n", two, 2);
+    client_sub_init(&sub);
+    if ((client_sub_parse(&sub, two[0]) != CLIENT_SUB_SUCCESS) || (sub.spot_mask != 0x0024) || (sub.kind_mask != CLIENT_SUB_PKT)) {
+        printf("ERROR: subscription of a line without its '\\n'\n");
+        ++nb_err;
+    }
+
+    /* a command split over two writes, with a CR LF end */
+    nb_err += check("first half", "STA", NULL, 0);
+    nb_err += check("second half", "TUS\r\n", status, 1);
+
+    /* a line longer than the buffer is dropped, the next one is kept */
+    memset(longline, 'x', sizeof longline - 1);
+    nb_err += check("long line", longline, NULL, 0);
+    nb_err += check("after a long line", "\nRELOAD\n", reload, 1);
+    if (cmd.nb_drop != 1) {
+        printf("ERROR: %u lines dropped instead of 1\n", cmd.nb_drop);
+        ++nb_err;
+    }
+
+    /* an unfinished line is not handled when the client leaves */
+    nb_err += check("unfinished", "RELO", NULL, 0);
+    close(sv[1]);
+    if (client_cmd_recv(&cmd, sv[0]) != 0) {
+        printf("ERROR: disconnection not reported\n");
+        ++nb_err;
+    }
+    close(sv[0]);
+
+    printf("%s: %d error(s)\n", (nb_err == 0) ? "PASS" : "FAIL", nb_err);
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,305 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check the parsing of SUB commands and the lines kept for a subscription
+    against a plain per-line check, then measure the bytes saved for a
+    client of two spotters, the rate limit and the filter cost per line.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>     /* rand */
+#include <string.h>     /* strlen */
+#include <time.h>       /* clock_gettime */
+
+#include "client_sub.h"
+#include "lora_frame.h"
+#include "spot_codec.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_LINE         4096    /* lines of the stream, about one write each */
+#define LINE_MAX_LEN    128
+#define NB_SPOT         8
+#define NB_REPEAT       200
+#define NB_FRAME        400     /* frames of 2 spotters at 20 per second, for a rate of 10 */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static char text[NB_LINE][LINE_MAX_LEN];
+static int kind[NB_LINE];       /* CLIENT_SUB_xxx */
+static int spot[NB_LINE];       /* -1 if none */
+static struct iovec lines[NB_LINE];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static double elapsed_ns(struct timespec *t0, struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+/* mostly packets, as the server sends them */
+static void make_stream(void) {
+    int i, s, r;
+
+    for (i = 0; i < NB_LINE; ++i) {
+        s = rand() % NB_SPOT;
+        r = rand() % 100;
+        if (r < 80) {
+            kind[i] = CLIENT_SUB_PKT;
+            spot[i] = s;
+            sprintf(text[i], "#%d,%d,%d,%d,%d,%d,%.9f,%.9f\n", s, rand() % 256, 1500000000 + i, rand() % 1000, -rand() % 1000, rand() % 100, 46.0 + rand() / 1e10, 7.0 + rand() / 1e10);
+        } else if (r < 92) {
+            kind[i] = CLIENT_SUB_DIAG;
+            spot[i] = s;
+            sprintf(text[i], "$DIAG,%d,%d,868100000,CRC_OK,7,5,-80.0,9.50,23\n", s, 1000 * i);
+        } else if (r < 97) {
+            kind[i] = CLIENT_SUB_STAT;
+            spot[i] = s;
+            if ((i % 3) == 0) {
+                sprintf(text[i], "$STAT,%d,120,118,2,-85.3,\n", s);
+            } else if ((i % 3) == 1) {
+                sprintf(text[i], "$LOSS,%d,0.40,91833,8169,433,1,0,7,23.9,7.5\n", s);
+            } else {
+                sprintf(text[i], "$AIR,%d,330,192.7,30,15,53.2,53.1\n", s);
+            }
+        } else if (r < 98) {
+            kind[i] = CLIENT_SUB_WAVE;
+            spot[i] = s;
+            if (i & 1) {
+                sprintf(text[i], "$WAVE,%d,16000005115,2.83,9.9,10.0,2.00,1024\n", s);
+            } else {
+                sprintf(text[i], "$WSPEC,%d,40,30,0,283,717,0,0,0,0,0,0,0,0,0,0,0,0,0\n", s);
+            }
+        } else {
+            kind[i] = CLIENT_SUB_OTHER;
+            spot[i] = -1;
+            sprintf(text[i], "$RELOAD,ok\n");
+        }
+    }
+}
+
+static void load_lines(void) {
+    int i;
+
+    for (i = 0; i < NB_LINE; ++i) {
+        lines[i].iov_base = text[i];
+        lines[i].iov_len = strlen(text[i]);
+    }
+}
+
+/* lines kept must be those a per-line check keeps, in order */
+static int check(const char *cmd, uint16_t spot_mask, uint8_t kind_mask) {
+    struct client_sub_s s;
+    int i, j = 0, nb;
+
+    client_sub_init(&s);
+    if (client_sub_parse(&s, cmd) != CLIENT_SUB_SUCCESS) {
+        printf("ERROR: '%s' rejected\n", cmd);
+        return 1;
+    }
+    load_lines();
+    nb = client_sub_filter(&s, lines, NB_LINE, 1);
+    for (i = 0; i < NB_LINE; ++i) {
+        if (((kind[i] & kind_mask) == 0) || ((spot[i] >= 0) && ((spot_mask & (1U << spot[i])) == 0))) {
+            continue;
+        }
+        if ((j >= nb) || (lines[j].iov_base != text[i])) {
+            printf("ERROR: '%s', line %d not kept\n", cmd, i);
+            return 1;
+        }
+        ++j;
+    }
+    if (j != nb) {
+        printf("ERROR: '%s', %d lines kept instead of %d\n", cmd, nb, j);
+        return 1;
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    static const char *bad[] = { "SUBX", "SUB spot=", "SUB spot=16", "SUB spot=2,", "SUB spot=2;5", "SUB kind=FOO",
+                                 "SUB rate=-1", "SUB rate=fast", "SUB foo=1", "SUB spot=2kind=PKT" };
+    struct client_sub_s s;
+    struct timespec t0, t1;
+    uint64_t bytes_all = 0, bytes_sub = 0;
+    uint8_t frame[LORA_FRAME_HDR_SIZE + 4] = { 0, 0, 0, 0, 5, 0x07, 1, 0 };
+    struct iovec mixed[3];
+    char reply[64];
+    struct spot_codec_s enc, dec;
+    struct spot_codec_rec_s r, d;
+    uint8_t buf[LORA_FRAME_HDR_SIZE + SPOT_CODEC_PAYLOAD_MAX];
+    uint16_t rekey;
+    int nb_ok = 0, nb_resync = 0, nb_kept = 0;
+    int i, k, nb;
+    int nb_err = 0;
+
+    srand(1);
+    make_stream();
+
+    /* commands */
+    client_sub_init(&s);
+    for (i = 0; i < (int)(sizeof bad / sizeof bad[0]); ++i) {
+        if (client_sub_parse(&s, bad[i]) != CLIENT_SUB_ERROR) {
+            printf("ERROR: '%s' accepted\n", bad[i]);
+            ++nb_err;
+        }
+    }
+    if (s.all == false) {
+        printf("ERROR: subscription changed by an invalid command\n");
+        ++nb_err;
+    }
+    client_sub_parse(&s, "SUB spot=2,5 kind=PKT,STAT rate=20\r\n");
+    client_sub_format(&s, reply, sizeof reply);
+    if (strcmp(reply, "$SUB,0024,5,20\n") != 0) {
+        printf("ERROR: reply %s", reply);
+        ++nb_err;
+    }
+    client_sub_parse(&s, "SUB");
+    if (s.all == false) {
+        printf("ERROR: 'SUB' alone does not subscribe to everything\n");
+        ++nb_err;
+    }
+
+    /* lines kept */
+    nb_err += check("SUB", 0xFFFF, CLIENT_SUB_ALL);
+    nb_err += check("SUB spot=2,5", 0x0024, CLIENT_SUB_ALL);
+    nb_err += check("SUB kind=PKT", 0xFFFF, CLIENT_SUB_PKT);
+    nb_err += check("SUB spot=0,7 kind=DIAG,OTHER", 0x0081, CLIENT_SUB_DIAG | CLIENT_SUB_OTHER);
+    nb_err += check("SUB  kind=all  spot=3 ", 0x0008, CLIENT_SUB_ALL);
+    nb_err += check("SUB spot=1,6 kind=WAVE", 0x0042, CLIENT_SUB_WAVE);
+
+    /* packets as frames, their text lines are skipped */
+    lora_frame_header(frame, LORA_FRAME_SPOT, 4);
+    for (k = 0; k < 2; ++k) {
+        mixed[0].iov_base = "$STAT,5,120,118,2,-85.3,\n";
+        mixed[0].iov_len = strlen(mixed[0].iov_base);
+        mixed[1].iov_base = frame;
+        mixed[1].iov_len = sizeof frame;
+        mixed[2].iov_base = "#5,2,1,2,3,4,45.0,-1.0\n";
+        mixed[2].iov_len = strlen(mixed[2].iov_base);
+        client_sub_init(&s);
+        client_sub_frames(&s, true);
+        client_sub_parse(&s, (k == 0) ? "SUB spot=5" : "SUB spot=0,1,2,3,4,6,7");
+        nb = client_sub_filter(&s, mixed, 3, 1);
+        if ((k == 0) && ((nb != 2) || (mixed[1].iov_base != frame))) {
+            printf("ERROR: frame of spotter 5 not kept, or its text line kept\n");
+            ++nb_err;
+        } else if ((k == 1) && (nb != 0)) {
+            printf("ERROR: lines of spotter 5 kept\n");
+            ++nb_err;
+        }
+    }
+
+    /* frames over the rate: the deltas after a dropped frame are dropped too until the keyframe it asks for */
+    spot_codec_reset(&enc, SPOT_CODEC_KEY_INTERVAL);
+    spot_codec_reset(&dec, 0);
+    memset(&r, 0, sizeof r);
+    client_sub_init(&s);
+    client_sub_frames(&s, true);
+    client_sub_parse(&s, "SUB rate=10");
+    for (k = 0; k < NB_FRAME; ++k) {
+        rekey = client_sub_rekey(&s); /* as the acquisition thread gets it */
+        for (i = 0; rekey != 0; ++i, rekey >>= 1) {
+            if (rekey & 1) {
+                spot_codec_forget(&enc, (uint8_t)i);
+            }
+        }
+        r.spotn = (uint8_t)(k % 2);
+        r.tenths = 17000000000ULL + (uint64_t)k;
+        r.Z = (k * 37) % 500;
+        nb = spot_codec_encode(&enc, &r, buf + LORA_FRAME_HDR_SIZE);
+        lora_frame_header(buf, LORA_FRAME_SPOT, (uint16_t)nb);
+        mixed[0].iov_base = buf;
+        mixed[0].iov_len = LORA_FRAME_HDR_SIZE + nb;
+        if (client_sub_filter(&s, mixed, 1, 1000000 + (uint64_t)k * 50000) == 1) {
+            nb_kept++;
+            i = spot_codec_decode(&dec, buf + LORA_FRAME_HDR_SIZE, nb, &d);
+            nb_ok += ((i == SPOT_CODEC_OK) && (d.Z == r.Z)) ? 1 : 0;
+            nb_resync += (i == SPOT_CODEC_RESYNC) ? 1 : 0;
+        }
+    }
+    printf("rate=10 on frames: %d of %d frames kept, %d decoded, %d waiting for a keyframe\n", nb_kept, NB_FRAME, nb_ok, nb_resync);
+    if ((nb_resync != 0) || (nb_ok != nb_kept) || (nb_kept < NB_FRAME / 4)) {
+        printf("ERROR: frames kept that the client cannot decode\n");
+        ++nb_err;
+    }
+    client_sub_init(&s);
+
+    /* bytes left for a client of 2 spotters out of 8 */
+    client_sub_parse(&s, "SUB spot=2,5");
+    load_lines();
+    nb = client_sub_filter(&s, lines, NB_LINE, 1);
+    for (i = 0; i < NB_LINE; ++i) {
+        bytes_all += strlen(text[i]);
+    }
+    for (i = 0; i < nb; ++i) {
+        bytes_sub += lines[i].iov_len;
+    }
+    printf("spot=2,5: %d of %d lines, %llu of %llu bytes (%.1f%%)\n", nb, NB_LINE, (unsigned long long)bytes_sub, (unsigned long long)bytes_all, 100.0 * bytes_sub / bytes_all);
+
+    /* rate limit: a second of burst, then the rate */
+    client_sub_parse(&s, "SUB rate=100");
+    load_lines();
+    nb = client_sub_filter(&s, lines, 1000, 1000000);
+    k = nb;
+    for (i = 1; i <= 10; ++i) {
+        load_lines();
+        k += client_sub_filter(&s, lines, 1000, 1000000 + i * 100000); /* 10 lines each 0.1 s */
+    }
+    printf("rate=100: %d lines of a burst of 1000, %d over the next second\n", nb, k - nb);
+    if ((nb != 100) || (k - nb != 100) || (s.nb_limit != 11000 - 200)) {
+        printf("ERROR: rate not enforced\n");
+        ++nb_err;
+    }
+
+    /* cost, whole stream per call as in the largest writes */
+    client_sub_parse(&s, "SUB spot=2,5 kind=PKT,STAT");
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (k = 0; k < NB_REPEAT; ++k) {
+        load_lines();
+        nb = client_sub_filter(&s, lines, NB_LINE, 1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("filter: %.1f ns per line (including the reload of the iovecs)\n", elapsed_ns(&t0, &t1) / NB_REPEAT / NB_LINE);
+    client_sub_init(&s);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (k = 0; k < NB_REPEAT; ++k) {
+        load_lines();
+        nb = client_sub_filter(&s, lines, NB_LINE, 1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("no subscription: %.1f ns per line (reload of the iovecs only)\n", elapsed_ns(&t0, &t1) / NB_REPEAT / NB_LINE);
+
+    printf("%s: %d error(s)\n", (nb_err == 0) ? "PASS" : "FAIL", nb_err);
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
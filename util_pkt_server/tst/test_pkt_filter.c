@@ -0,0 +1,232 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check the vector batch filter against the scalar one on random batches,
+    then measure the filter and decode cost per packet, compared to the
+    original packet-at-a-time code.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>     /* rand */
+#include <string.h>     /* memcpy */
+#include <time.h>       /* clock_gettime */
+
+#include "loragw_hal.h"
+#include "loragw_pool.h"
+#include "spotter.h"
+#include "pkt_filter.h"
+#include "pkt_rules.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_BATCH        4096
+#define NB_REPEAT       50
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct lgw_pkt_meta_s meta[NB_BATCH][PKT_BATCH_SIZE];
+static int nb_meta[NB_BATCH];
+static volatile uint32_t sink; /* keeps the compiler from removing the timed code */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static double elapsed_ns(struct timespec *t0, struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+/* pick the expected value most of the time, so that about half the packets pass */
+static uint8_t pick(uint8_t good, uint8_t bad) {
+    return ((rand() % 8) != 0) ? good : bad;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    int i, j, k;
+    struct lgw_pkt_buf_s *buf[PKT_BATCH_SIZE];
+    struct pkt_batch_s batch;
+    struct pkt_filter_s filt[3];
+    struct pkt_rules_s rules;
+    struct pkt_rule_s rule;
+    int32_t chanlist[SPOTTER_NB] = {0};
+    struct spotter_data_s d[PKT_BATCH_SIZE];
+    struct timespec t0, t1;
+    uint16_t m_vec, m_ref;
+    uint32_t acc = 0;
+    long nb_pkt = 0;
+    int err = 0;
+    double t;
+
+    printf("Beginning of test for pkt_filter.c (%s implementation)\n", pkt_filter_impl());
+
+    /* payloads, one pool buffer per lane */
+    for (i = 0; i < PKT_BATCH_SIZE; ++i) {
+        buf[i] = lgw_pool_get();
+        if (buf[i] == NULL) {
+            printf("ERROR: RX pool exhausted\n");
+            return EXIT_FAILURE;
+        }
+        for (j = 0; j < SPOTTER_PAYLOAD_SIZE; ++j) {
+            buf[i]->data[j] = (uint8_t)rand();
+        }
+    }
+
+    /* random batches, partly filled */
+    srand(1);
+    for (k = 0; k < NB_BATCH; ++k) {
+        nb_meta[k] = 1 + rand() % PKT_BATCH_SIZE;
+        for (i = 0; i < nb_meta[k]; ++i) {
+            struct lgw_pkt_meta_s *p = &meta[k][i];
+            memset(p, 0, sizeof *p);
+            p->status = pick(STAT_CRC_OK, STAT_CRC_BAD);
+            p->modulation = pick(MOD_LORA, MOD_FSK);
+            p->bandwidth = pick(BW_125KHZ, BW_250KHZ);
+            p->datarate = pick(DR_LORA_SF7, DR_LORA_SF9);
+            p->coderate = pick(CR_LORA_4_5, CR_LORA_4_8);
+            p->size = (rand() % 16) ? SPOTTER_PAYLOAD_SIZE : 10;
+            p->slot = buf[i]->meta.slot;
+            nb_pkt++;
+        }
+    }
+
+    /* filters: default, one field relaxed, everything accepted */
+    memset(filt, 0, sizeof filt);
+    pkt_filter_default(&filt[0]);
+    pkt_filter_default(&filt[1]);
+    pkt_filter_any(&filt[1], PKT_FIELD_CODERATE);
+    pkt_filter_set(&filt[1], PKT_FIELD_BANDWIDTH, BW_250KHZ);
+
+    /* correctness: vector and scalar masks must match */
+    for (j = 0; j < 3; ++j) {
+        for (k = 0; k < NB_BATCH; ++k) {
+            pkt_batch_load(&batch, meta[k], nb_meta[k]);
+            m_vec = pkt_filter_run(&filt[j], &batch);
+            m_ref = pkt_filter_run_scalar(&filt[j], &batch);
+            if (m_vec != m_ref) {
+                printf("ERROR: filter %d batch %d: mask %04X, expected %04X\n", j, k, m_vec, m_ref);
+                err++;
+            }
+        }
+    }
+    if (err != 0) {
+        return EXIT_FAILURE;
+    }
+    printf("vector and scalar masks match on %d batches x 3 filters\n", NB_BATCH);
+
+    /* correctness: a rule compiled from a filter selects the same packets */
+    for (j = 0; j < 3; ++j) {
+        pkt_rules_init(&rules);
+        pkt_rule_from_filter(&rule, &filt[j], RULE_OUT_SPOTTER);
+        pkt_rules_add(&rules, RULE_ALL_SPOTTERS, 0, &rule);
+        pkt_rules_compile(&rules, chanlist, SPOTTER_NB);
+        for (k = 0; k < NB_BATCH; ++k) {
+            pkt_batch_load(&batch, meta[k], nb_meta[k]);
+            m_ref = pkt_filter_run_scalar(&filt[j], &batch);
+            for (i = 0; i < nb_meta[k]; ++i) {
+                if ((pkt_rules_eval(&rules, i % SPOTTER_NB, &meta[k][i]) != 0) != ((m_ref >> i) & 1)) {
+                    printf("ERROR: filter %d batch %d packet %d: rule and filter disagree\n", j, k, i);
+                    err++;
+                }
+            }
+        }
+    }
+    if (err != 0) {
+        return EXIT_FAILURE;
+    }
+    printf("compiled rules match the filters on %d batches x 3 filters\n", NB_BATCH);
+
+    /* timing: original code, one packet at a time, copy then decode */
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (j = 0; j < NB_REPEAT; ++j) {
+        for (k = 0; k < NB_BATCH; ++k) {
+            for (i = 0; i < nb_meta[k]; ++i) {
+                const struct lgw_pkt_meta_s *p = &meta[k][i];
+                uint8_t copy[256];
+                if ((p->status == STAT_CRC_OK) && (p->modulation == MOD_LORA) &&
+                   (p->bandwidth == BW_125KHZ) && (p->datarate == DR_LORA_SF7) &&
+                   (p->coderate == CR_LORA_4_5)) {
+                    memcpy(copy, lgw_pool_slot(p->slot)->data, p->size);
+                    if (spotter_decode(copy, p->size, &d[i]) == 0) {
+                        acc += d[i].timestamp;
+                    }
+                }
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    t = elapsed_ns(&t0, &t1) / ((double)nb_pkt * NB_REPEAT);
+    printf("per packet, branchy filter + copy + decode : %6.2f ns/pkt\n", t);
+
+    /* timing: filter only, scalar then vector */
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (j = 0; j < NB_REPEAT; ++j) {
+        for (k = 0; k < NB_BATCH; ++k) {
+            pkt_batch_load(&batch, meta[k], nb_meta[k]);
+            acc += pkt_filter_run_scalar(&filt[0], &batch);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    t = elapsed_ns(&t0, &t1) / ((double)nb_pkt * NB_REPEAT);
+    printf("batch load + scalar filter                 : %6.2f ns/pkt\n", t);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (j = 0; j < NB_REPEAT; ++j) {
+        for (k = 0; k < NB_BATCH; ++k) {
+            pkt_batch_load(&batch, meta[k], nb_meta[k]);
+            acc += pkt_filter_run(&filt[0], &batch);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    t = elapsed_ns(&t0, &t1) / ((double)nb_pkt * NB_REPEAT);
+    printf("batch load + %-6s filter                 : %6.2f ns/pkt\n", pkt_filter_impl(), t);
+
+    /* timing: whole batch stage, filter + in place decode */
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (j = 0; j < NB_REPEAT; ++j) {
+        for (k = 0; k < NB_BATCH; ++k) {
+            pkt_batch_load(&batch, meta[k], nb_meta[k]);
+            m_vec = pkt_batch_decode(&batch, pkt_filter_run(&filt[0], &batch), d);
+            acc += m_vec;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    t = elapsed_ns(&t0, &t1) / ((double)nb_pkt * NB_REPEAT);
+    printf("batch load + %-6s filter + decode        : %6.2f ns/pkt\n", pkt_filter_impl(), t);
+
+    sink = acc;
+    for (i = 0; i < PKT_BATCH_SIZE; ++i) {
+        lgw_pool_release(buf[i]);
+    }
+    printf("End of test for pkt_filter.c\n");
+
+    return EXIT_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,188 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Feed the loss tracker with the samples of spotters at 2.5 Hz and 4 Hz,
+    some lost alone or in bursts, some duplicated, one late and sent again
+    with an older one, then a clock jump, and check the samples counted lost
+    and the rate of each window against the samples actually dropped. Measures the cost per sample.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>     /* rand */
+#include <string.h>     /* memset */
+#include <math.h>       /* fabs */
+#include <time.h>       /* clock_gettime */
+
+#include "pkt_loss.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define T0              16000000000ULL  /* tenths of a second since epoch */
+#define NB_SAMPLE       100000
+#define BUCKET_MAX      200000          /* buckets of the shortest window over the run */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct pkt_loss_s loss;
+static const uint32_t win_s[2] = { PKT_LOSS_WINDOW_S, 600 };
+static uint32_t rx_at[2][BUCKET_MAX]; /* samples received and lost in each bucket of each window, as expected */
+static uint32_t lost_at[2][BUCKET_MAX];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static double elapsed_ns(struct timespec *t0, struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+/* timestamp of sample n of a spotter sending rate_x10 samples per 10 s */
+static uint64_t stamp(unsigned n, int rate_x10) {
+    return T0 + (uint64_t)n * 100 / rate_x10;
+}
+
+/* samples of a spotter, a few lost, some in bursts, some sent twice, then the counters checked */
+static int run(int spotn, int rate_x10) {
+    const struct pkt_loss_chan_s *c = &loss.chan[spotn];
+    char line[PKT_LOSS_LINE_MAX];
+    uint32_t lost = 0, dup = 0, gap = 0, rx, lo;
+    uint64_t t, t_rx = 0, b;
+    unsigned n, burst = 0;
+    int i, k, nb_err = 0;
+
+    memset(rx_at, 0, sizeof rx_at);
+    memset(lost_at, 0, sizeof lost_at);
+    for (n = 0; n < NB_SAMPLE; ++n) {
+        t = stamp(n, rate_x10);
+        if ((burst == 0) && (n > 2) && ((rand() % 1000) < 3)) {
+            burst = 1 + rand() % 20;
+        }
+        if ((burst > 0) || ((n > 2) && ((rand() % 100) < 5))) {
+            burst -= (burst > 0) ? 1 : 0;
+            ++lost;
+            ++gap;
+            continue;
+        }
+        pkt_loss_add(&loss, spotn, t, 0);
+        t_rx = t;
+        for (i = 0; i < 2; ++i) {
+            rx_at[i][t / win_s[i] - T0 / win_s[i]]++;
+            lost_at[i][t / win_s[i] - T0 / win_s[i]] += gap;
+        }
+        gap = 0;
+        if ((rand() % 200) == 0) {
+            pkt_loss_add(&loss, spotn, t, 0);
+            ++dup;
+        }
+    }
+
+    /* a sample sent after the next one fills the gap counted */
+    t = stamp(n + 1, rate_x10);
+    pkt_loss_add(&loss, spotn, t, 0);
+    pkt_loss_add(&loss, spotn, stamp(n, rate_x10), 0);
+    for (i = 0; i < 2; ++i) {
+        rx_at[i][t / win_s[i] - T0 / win_s[i]] += 2; /* the late one counted with the latest */
+        lost_at[i][t / win_s[i] - T0 / win_s[i]] += gap;
+    }
+
+    /* older samples sent again are duplicates, not late ones */
+    pkt_loss_add(&loss, spotn, stamp(n, rate_x10), 0);
+    pkt_loss_add(&loss, spotn, t_rx, 0);
+    dup += 2;
+
+    pkt_loss_format(&loss, spotn, 7, line, sizeof line);
+    printf("%.1f Hz: %s", rate_x10 / 10.0, line);
+    if ((c->nb_lost != lost) || (c->nb_dup != dup) || (c->nb_late != 1) || (c->nb_rx != NB_SAMPLE - lost + 2) || (c->nb_resync != 0) ||
+        (fabs(c->period_x256 / 2560.0 - 10.0 / rate_x10) > 0.01)) {
+        printf("ERROR: %u lost, %u duplicates expected\n", lost, dup);
+        ++nb_err;
+    }
+
+    /* the windows cover the latest buckets */
+    for (i = 0; i < 2; ++i) {
+        b = t / win_s[i] - T0 / win_s[i];
+        for (k = 0, rx = 0, lo = 0; k < ROLL_WIN_BUCKETS; ++k) {
+            rx += rx_at[i][b - k];
+            lo += lost_at[i][b - k];
+        }
+        if ((c->rx[i].sum != rx) || (c->lost[i].sum != lo)) {
+            printf("ERROR: window of %u s, %u received and %u lost instead of %u and %u\n", win_s[i], c->rx[i].sum, c->lost[i].sum, rx, lo);
+            ++nb_err;
+        }
+    }
+
+    /* the spotter restarts with another clock */
+    pkt_loss_add(&loss, spotn, t + 36000, 0);
+    pkt_loss_add(&loss, spotn, t + 36000 + 100 / rate_x10, 0);
+    if ((c->nb_resync != 1) || (c->nb_lost != lost)) {
+        printf("ERROR: clock jump counted as lost samples\n");
+        ++nb_err;
+    }
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    static const uint32_t bad[4] = { 40, 0, 600, 3600 };
+    struct timespec t0, t1;
+    char line[PKT_LOSS_LINE_MAX];
+    unsigned n;
+    int nb_err = 0;
+
+    srand(1);
+    if ((pkt_loss_init(&loss, bad, 2) != PKT_LOSS_ERROR) || (pkt_loss_init(&loss, bad + 2, 2) != PKT_LOSS_SUCCESS) ||
+        (pkt_loss_init(&loss, bad, 4) != PKT_LOSS_ERROR)) {
+        printf("ERROR: windows not checked\n");
+        ++nb_err;
+    }
+    pkt_loss_format(&loss, 3, 0, line, sizeof line);
+    printf("no sample: %s", line);
+    if (strcmp(line, "$LOSS,3,,0,0,0,0,0,,,\n") != 0) {
+        printf("ERROR: fields of a spotter without sample\n");
+        ++nb_err;
+    }
+
+    pkt_loss_init(&loss, win_s, 2);
+    nb_err += run(0, 25);
+    nb_err += run(5, 40);
+
+    /* cost */
+    pkt_loss_init(&loss, win_s, 2);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < 1000000; ++n) {
+        pkt_loss_add(&loss, n & 7, stamp(n >> 3, 25) + ((n % 97) == 0 ? 4 : 0), 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("add: %.1f ns per sample, %u bytes per spotter\n", elapsed_ns(&t0, &t1) / 1000000, (unsigned)sizeof(struct pkt_loss_chan_s));
+
+    printf("%s: %d error(s)\n", (nb_err == 0) ? "PASS" : "FAIL", nb_err);
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
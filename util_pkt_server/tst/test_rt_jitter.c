@@ -0,0 +1,341 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Latency of the acquisition path, in the way of cyclictest: a simulated
+    RX-ready edge is raised periodically, the acquisition thread wakes up,
+    drains a simulated FIFO and hands a line over to a network thread through
+    the line ring. The time from the edge to the end of the drain is measured
+    with the default scheduling, then with the real-time mode, both under CPU
+    and I/O stress.
+    No concentrator is needed. Setting a SCHED_FIFO priority and locking
+    memory need root or CAP_SYS_NICE and CAP_IPC_LOCK.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf snprintf */
+#include <stdlib.h>     /* atoi EXIT_SUCCESS */
+#include <string.h>     /* memcpy memset */
+#include <time.h>       /* clock_gettime clock_nanosleep */
+#include <unistd.h>     /* getopt pipe read write fsync sysconf */
+#include <fcntl.h>      /* open */
+#include <poll.h>
+#include <pthread.h>
+
+#include "rt_sched.h"
+#include "line_ring.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define HISTO_US        10000       /* latencies above are counted in the last bin */
+#define FIFO_PKT        16          /* packets drained per edge */
+#define PKT_SIZE        256
+#define IO_BLOCK        (64 * 1024)
+#define IO_FILE         "/tmp/test_rt_jitter.tmp"
+#define MAX_STRESS      16
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static int nb_loop = 10000;
+static int interval_us = 1000;
+
+static struct rt_conf_s rtconf;
+static struct line_ring_s ring;
+static int edge_fd[2]; /* simulated RX-ready GPIO */
+static uint64_t edge_us; /* time the last edge was raised */
+static volatile bool stop = false;
+
+static uint32_t histo[HISTO_US + 1];
+static uint64_t lat_min, lat_max, lat_sum;
+static int nb_lat;
+static bool rt_ok;
+
+static uint8_t fifo[FIFO_PKT][PKT_SIZE];
+static volatile uint32_t sink; /* keeps the compiler from removing the stress code */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static uint64_t now_us(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + (uint64_t)(t.tv_nsec / 1000);
+}
+
+static void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -n <int> number of edges per pass, default 10000\n");
+    printf(" -t <int> interval between two edges in us, default 1000\n");
+    printf(" -c <int> CPU stress threads, default one per CPU\n");
+    printf(" -i <int> I/O stress threads, default 1\n");
+    printf(" -p <int> SCHED_FIFO priority of the real-time pass, default 80\n");
+    printf(" -a <int> CPU of the acquisition thread in the real-time pass, default not pinned\n");
+}
+
+/* simulated concentrator: raise an edge periodically */
+static void *thread_edge(void *arg) {
+    struct timespec next;
+    uint64_t t;
+    char c = 0;
+    int i;
+
+    (void)arg;
+    rt_sched_acq(&rtconf); /* the edge is raised by hardware, it must not be delayed by the stress */
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (i = 0; (i < nb_loop) && (stop == false); ++i) {
+        next.tv_nsec += interval_us * 1000;
+        while (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        t = now_us();
+        __atomic_store_n(&edge_us, t, __ATOMIC_RELEASE);
+        if (write(edge_fd[1], &c, 1) < 0) {
+            break;
+        }
+    }
+    stop = true;
+    return NULL;
+}
+
+/* acquisition thread: wait for the edge, drain the FIFO, hand a line over */
+static void *thread_acq(void *arg) {
+    uint8_t pkt[FIFO_PKT][PKT_SIZE];
+    struct pollfd pfd;
+    char buf[64];
+    char *line;
+    uint64_t t0, lat;
+    int i;
+
+    (void)arg;
+    rt_ok = (rt_sched_acq(&rtconf) == RT_SCHED_SUCCESS);
+    pfd.fd = edge_fd[0];
+    pfd.events = POLLIN;
+    while (stop == false) {
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        while (read(edge_fd[0], buf, sizeof buf) > 0);
+        t0 = __atomic_load_n(&edge_us, __ATOMIC_ACQUIRE);
+        for (i = 0; i < FIFO_PKT; ++i) {
+            memcpy(pkt[i], fifo[i], PKT_SIZE);
+        }
+        if ((line = line_ring_reserve(&ring)) != NULL) {
+            line_ring_commit(&ring, snprintf(line, SPOTTER_LINE_MAX, "$1,%u,%u\n", pkt[0][0], pkt[FIFO_PKT - 1][PKT_SIZE - 1]));
+            line_ring_notify(&ring);
+        }
+        lat = now_us() - t0;
+        histo[(lat < HISTO_US) ? lat : HISTO_US]++;
+        lat_min = (lat < lat_min) ? lat : lat_min;
+        lat_max = (lat > lat_max) ? lat : lat_max;
+        lat_sum += lat;
+        nb_lat++;
+    }
+    return NULL;
+}
+
+/* network thread: send the lines out */
+static void *thread_net(void *arg) {
+    struct pollfd pfd;
+    const char *line;
+    int fd, len;
+
+    (void)arg;
+    fd = open("/dev/null", O_WRONLY);
+    pfd.fd = ring.fd[0];
+    pfd.events = POLLIN;
+    while (stop == false) {
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        line_ring_ack(&ring);
+        while ((line = line_ring_peek(&ring, &len)) != NULL) {
+            if (write(fd, line, len) < 0) {
+                break;
+            }
+            line_ring_pop(&ring);
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static void *thread_cpu_stress(void *arg) {
+    static uint32_t mem[256 * 1024]; /* larger than the caches of the target */
+    uint32_t x = (uint32_t)(uintptr_t)arg + 1;
+
+    while (stop == false) {
+        x = x * 1664525 + 1013904223;
+        mem[x % ARRAY_SIZE(mem)] += x;
+    }
+    sink = x;
+    return NULL;
+}
+
+static void *thread_io_stress(void *arg) {
+    static char block[IO_BLOCK];
+    int fd;
+    int i = 0;
+
+    (void)arg;
+    fd = open(IO_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+    while (stop == false) {
+        memset(block, i++, sizeof block);
+        if (write(fd, block, sizeof block) < 0) {
+            break;
+        }
+        fsync(fd);
+        if ((i % 256) == 0) {
+            ftruncate(fd, 0);
+            lseek(fd, 0, SEEK_SET);
+        }
+    }
+    close(fd);
+    unlink(IO_FILE);
+    return NULL;
+}
+
+static int run_pass(const char *name, int nb_cpu_stress, int nb_io_stress) {
+    pthread_t thr_edge, thr_acq, thr_net, thr_stress[2 * MAX_STRESS];
+    pthread_attr_t attr;
+    uint32_t n;
+    uint64_t p50 = 0, p99 = 0, p999 = 0;
+    int nb_stress = 0;
+    int i;
+
+    memset(histo, 0, sizeof histo);
+    lat_min = UINT64_MAX;
+    lat_max = lat_sum = 0;
+    nb_lat = 0;
+    stop = false;
+    if ((line_ring_init(&ring) != LINE_RING_SUCCESS) || (pipe(edge_fd) != 0)) {
+        printf("ERROR: failed to create pipes\n");
+        return -1;
+    }
+    fcntl(edge_fd[0], F_SETFL, fcntl(edge_fd[0], F_GETFL) | O_NONBLOCK);
+
+    if (rt_lock_memory(&rtconf) != RT_SCHED_SUCCESS) {
+        printf("WARNING: failed to lock memory\n");
+    }
+    if (rt_sched_other(&rtconf) != RT_SCHED_SUCCESS) {
+        printf("WARNING: failed to keep other threads off CPU %d\n", rtconf.cpu);
+    }
+
+    /* stress, network and acquisition threads, then the edges */
+    for (i = 0; i < nb_cpu_stress; ++i) {
+        pthread_create(&thr_stress[nb_stress++], NULL, thread_cpu_stress, (void *)(uintptr_t)i);
+    }
+    for (i = 0; i < nb_io_stress; ++i) {
+        pthread_create(&thr_stress[nb_stress++], NULL, thread_io_stress, NULL);
+    }
+    rt_thread_attr(&attr);
+    pthread_create(&thr_net, &attr, thread_net, NULL);
+    pthread_create(&thr_acq, &attr, thread_acq, NULL);
+    pthread_create(&thr_edge, &attr, thread_edge, NULL);
+    pthread_attr_destroy(&attr);
+
+    pthread_join(thr_edge, NULL);
+    pthread_join(thr_acq, NULL);
+    pthread_join(thr_net, NULL);
+    for (i = 0; i < nb_stress; ++i) {
+        pthread_join(thr_stress[i], NULL);
+    }
+    line_ring_close(&ring);
+    close(edge_fd[0]);
+    close(edge_fd[1]);
+
+    /* percentiles from the histogram */
+    n = 0;
+    for (i = 0; i <= HISTO_US; ++i) {
+        n += histo[i];
+        if ((p50 == 0) && (n * 2 >= (uint32_t)nb_lat)) p50 = i;
+        if ((p99 == 0) && (n * 100 >= (uint32_t)nb_lat * 99)) p99 = i;
+        if ((p999 == 0) && (n * 1000 >= (uint32_t)nb_lat * 999)) p999 = i;
+    }
+    if (nb_lat == 0) {
+        printf("%-28s: no edge drained\n", name);
+        return -1;
+    }
+    printf("%-28s: %6d edges, min %4llu us, avg %6.1f us, p50 %4llu us, p99 %5llu us, p99.9 %5llu us, max %6llu us, %u lines dropped%s\n",
+           name, nb_lat, (unsigned long long)lat_min, (double)lat_sum / nb_lat, (unsigned long long)p50, (unsigned long long)p99,
+           (unsigned long long)p999, (unsigned long long)lat_max, ring.nb_drop, (rt_ok == true) ? "" : " (real-time settings refused)");
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    int nb_cpu_stress = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int nb_io_stress = 1;
+    int priority = 80;
+    int cpu = -1;
+    int i;
+    int err = 0;
+
+    while ((i = getopt(argc, argv, "hn:t:c:i:p:a:")) != -1) {
+        switch (i) {
+            case 'h': usage(); return EXIT_SUCCESS;
+            case 'n': nb_loop = atoi(optarg); break;
+            case 't': interval_us = atoi(optarg); break;
+            case 'c': nb_cpu_stress = atoi(optarg); break;
+            case 'i': nb_io_stress = atoi(optarg); break;
+            case 'p': priority = atoi(optarg); break;
+            case 'a': cpu = atoi(optarg); break;
+            default: usage(); return EXIT_FAILURE;
+        }
+    }
+    nb_cpu_stress = (nb_cpu_stress < 0) ? 0 : (nb_cpu_stress > MAX_STRESS) ? MAX_STRESS : nb_cpu_stress;
+    nb_io_stress = (nb_io_stress < 0) ? 0 : (nb_io_stress > MAX_STRESS) ? MAX_STRESS : nb_io_stress;
+
+    printf("Beginning of test for the acquisition path latency, %d edges every %d us, %d CPU and %d I/O stress threads\n",
+           nb_loop, interval_us, nb_cpu_stress, nb_io_stress);
+
+    /* default scheduling first, memory stays locked after the real-time pass */
+    rt_conf_default(&rtconf);
+    err += run_pass("SCHED_OTHER", nb_cpu_stress, nb_io_stress);
+
+    rtconf.enable = true;
+    rtconf.priority = priority;
+    rtconf.cpu = cpu;
+    err += run_pass("SCHED_FIFO, memory locked", nb_cpu_stress, nb_io_stress);
+
+    printf("End of test for the acquisition path latency\n");
+    return (err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,200 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check the airtime of every SF, bandwidth, coderate and size against
+    lgw_time_on_air, then the utilisation of a channel and the overlapping
+    receptions counted on another one, and measure the cost per packet.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>     /* EXIT_SUCCESS */
+#include <string.h>     /* memset */
+#include <math.h>       /* fabs */
+#include <time.h>       /* clock_gettime */
+
+#include "loragw_hal.h"
+#include "rx_airtime.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define T0              1000000000ULL   /* concentrator counter at the start, us */
+#define PERIOD_US       400000          /* spotters at 2.5 Hz */
+#define NB_PKT          300             /* two minutes */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct rx_airtime_s air;
+static const uint32_t win_s[2] = { 60, 600 };
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static double elapsed_ns(struct timespec *t0, struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+static void make_meta(struct lgw_pkt_meta_s *m, uint64_t end_us, uint8_t dr, uint8_t bw, uint8_t cr, uint8_t size) {
+    memset(m, 0, sizeof *m);
+    m->count_us64 = end_us;
+    m->modulation = MOD_LORA;
+    m->datarate = dr;
+    m->bandwidth = bw;
+    m->coderate = cr;
+    m->size = size;
+    m->status = STAT_CRC_OK;
+}
+
+/* every combination against the HAL, which truncates to the millisecond */
+static int check_table(void) {
+    static const uint8_t bws[3] = { BW_125KHZ, BW_250KHZ, BW_500KHZ };
+    struct lgw_pkt_meta_s m;
+    struct lgw_pkt_tx_s tx;
+    uint32_t us, ms;
+    int sf, b, cr, size, nb = 0, nb_err = 0;
+
+    memset(&tx, 0, sizeof tx);
+    tx.modulation = MOD_LORA;
+    tx.preamble = RX_AIRTIME_PREAMBLE;
+    for (sf = 7; sf <= 12; ++sf) {
+        for (b = 0; b < 3; ++b) {
+            for (cr = CR_LORA_4_5; cr <= CR_LORA_4_8; ++cr) {
+                for (size = 0; size < 256; ++size) {
+                    make_meta(&m, T0, (uint8_t)(1 << (sf - 6)), bws[b], (uint8_t)cr, (uint8_t)size);
+                    tx.datarate = m.datarate;
+                    tx.bandwidth = m.bandwidth;
+                    tx.coderate = m.coderate;
+                    tx.size = m.size;
+                    us = rx_airtime_packet(&air, &m);
+                    ms = lgw_time_on_air(&tx);
+                    if ((us / 1000 != ms) && ((us % 1000 != 0) || (us / 1000 != ms + 1))) {
+                        if (nb_err++ < 5) {
+                            printf("ERROR: SF%d BW code %u CR 4/%d %d bytes: %u us, %u ms for the HAL\n", sf, bws[b], cr + 4, size, us, ms);
+                        }
+                    }
+                    ++nb;
+                }
+            }
+        }
+    }
+    printf("airtime of %d combinations checked against lgw_time_on_air\n", nb);
+
+    /* no airtime for what the table does not cover */
+    make_meta(&m, T0, DR_LORA_MULTI, BW_125KHZ, CR_LORA_4_5, 20);
+    nb_err += (rx_airtime_packet(&air, &m) != 0) ? 1 : 0;
+    make_meta(&m, T0, DR_LORA_SF7, BW_UNDEFINED, CR_LORA_4_5, 20);
+    nb_err += (rx_airtime_packet(&air, &m) != 0) ? 1 : 0;
+    make_meta(&m, T0, DR_LORA_SF7, BW_125KHZ, CR_LORA_4_5, 20);
+    m.modulation = MOD_FSK;
+    nb_err += (rx_airtime_packet(&air, &m) != 0) ? 1 : 0;
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    static const uint32_t bad[3] = { 60, 0, 7200 };
+    struct lgw_pkt_meta_s m;
+    struct timespec t0, t1;
+    char line[RX_AIRTIME_LINE_MAX];
+    uint64_t end = 0;
+    uint32_t a7, a9;
+    double util, expect;
+    unsigned nb_overlap = 0, nb_bad = 0;
+    int n;
+    int nb_err = 0;
+
+    if ((rx_airtime_init(&air, RX_AIRTIME_PREAMBLE, bad, 2) != RX_AIRTIME_ERROR) ||
+        (rx_airtime_init(&air, RX_AIRTIME_PREAMBLE, bad + 2, 1) != RX_AIRTIME_ERROR) ||
+        (rx_airtime_init(&air, 4, win_s, 2) != RX_AIRTIME_ERROR) ||
+        (rx_airtime_init(&air, RX_AIRTIME_PREAMBLE, win_s, 2) != RX_AIRTIME_SUCCESS)) {
+        printf("ERROR: settings not checked\n");
+        ++nb_err;
+    }
+    nb_err += check_table();
+    rx_airtime_format(&air, 3, 0, line, sizeof line);
+    printf("no packet: %s", line);
+    if (strcmp(line, "$AIR,3,0,,0,0,,\n") != 0) {
+        printf("ERROR: fields of a channel without packet\n");
+        ++nb_err;
+    }
+
+    /* channel 0: SF7 packets of 24 bytes at 2.5 Hz; channel 1: SF9 at 2.5 Hz and every tenth an SF7 packet while it is sent */
+    make_meta(&m, 0, DR_LORA_SF7, BW_125KHZ, CR_LORA_4_5, 24);
+    a7 = rx_airtime_packet(&air, &m);
+    make_meta(&m, 0, DR_LORA_SF9, BW_125KHZ, CR_LORA_4_5, 24);
+    a9 = rx_airtime_packet(&air, &m);
+    for (n = 0; n < NB_PKT; ++n) {
+        end = T0 + (uint64_t)n * PERIOD_US;
+        make_meta(&m, end, DR_LORA_SF7, BW_125KHZ, CR_LORA_4_5, 24);
+        rx_airtime_add(&air, 0, &m);
+        make_meta(&m, end, DR_LORA_SF9, BW_125KHZ, CR_LORA_4_5, 24);
+        rx_airtime_add(&air, 1, &m);
+        if ((n % 10) == 5) {
+            make_meta(&m, end + a7 / 2, DR_LORA_SF7, BW_125KHZ, CR_LORA_4_5, 24);
+            m.status = ((n % 20) == 5) ? STAT_CRC_BAD : STAT_CRC_OK;
+            rx_airtime_add(&air, 1, &m);
+            nb_overlap++;
+            nb_bad += ((n % 20) == 5) ? 1 : 0;
+        }
+    }
+    rx_airtime_format(&air, 0, end + PERIOD_US / 2, line, sizeof line);
+    printf("channel 0: %s", line);
+    util = 0.0;
+    sscanf(line, "$AIR,%*d,%*u,%*f,%*u,%*u,%lf", &util);
+    rx_airtime_format(&air, 1, end + PERIOD_US / 2, line, sizeof line);
+    printf("channel 1: %s", line);
+    expect = 100.0 * a7 / PERIOD_US;
+    printf("airtime SF7 %u us, SF9 %u us, channel 0 used %.1f %% of the time\n", a7, a9, expect);
+    if ((air.chan[0].nb_overlap != 0) || (air.chan[1].nb_overlap != nb_overlap) || (air.chan[1].nb_overlap_bad != nb_bad) ||
+        (air.chan[0].nb_rx != NB_PKT)) {
+        printf("ERROR: %u overlaps, %u with a wrong CRC expected\n", nb_overlap, nb_bad);
+        ++nb_err;
+    }
+    if (fabs(util - expect) > 0.1 * expect) {
+        printf("ERROR: utilisation of channel 0 over the window %.1f %%\n", util);
+        ++nb_err;
+    }
+
+    /* cost */
+    rx_airtime_init(&air, RX_AIRTIME_PREAMBLE, win_s, 2);
+    make_meta(&m, T0, DR_LORA_SF7, BW_125KHZ, CR_LORA_4_5, 24);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (n = 0; n < 1000000; ++n) {
+        m.count_us64 = T0 + (uint64_t)(n >> 3) * PERIOD_US;
+        m.size = (uint8_t)(16 + (n & 15));
+        rx_airtime_add(&air, n & 7, &m);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("add: %.1f ns per packet, %u bytes per channel\n", elapsed_ns(&t0, &t1) / 1000000, (unsigned)sizeof(struct rx_airtime_chan_s));
+
+    printf("%s: %d error(s)\n", (nb_err == 0) ? "PASS" : "FAIL", nb_err);
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
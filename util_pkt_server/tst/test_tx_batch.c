@@ -0,0 +1,291 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Writes of the network thread to a client on the loopback interface: a
+    simulated acquisition thread puts bursts of lines in the line ring, as
+    one RX FIFO drain would, and the lines are sent one send() per line as
+    the server used to, then one write per drain, then with a latency bound
+    spanning several drains. For each pass, the write calls and TCP segments
+    per line, and the latency from the line ring to the client.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf snprintf */
+#include <stdlib.h>     /* atoi EXIT_SUCCESS */
+#include <string.h>     /* memset memchr memmove */
+#include <time.h>       /* clock_gettime clock_nanosleep */
+#include <unistd.h>     /* getopt close usleep */
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/tcp.h>  /* TCP_NODELAY TCP_INFO, struct tcp_info is hidden by netinet/tcp.h in strict POSIX mode */
+
+#include "line_ring.h"
+#include "tx_batch.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define HISTO_US        20000       /* latencies above are counted in the last bin */
+#define FIFO_PKT        16          /* lines per drain, a full RX FIFO */
+#define BOUND_PER_LINE  -1          /* the loop of the server before batching */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static int nb_drain = 2000;
+static int interval_us = 1000;
+
+static struct line_ring_s ring;
+static struct tx_batch_s batch;
+static int tx_fd, rx_fd;
+static volatile bool stop = false;
+
+static uint32_t histo[HISTO_US + 1];
+static uint64_t lat_max;
+static uint32_t nb_rx, nb_bad, next_seq;
+static uint64_t nb_call;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static uint64_t now_us(void) {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + (uint64_t)(t.tv_nsec / 1000);
+}
+
+static void usage(void) {
+    printf("Available options:\n");
+    printf(" -h print this help\n");
+    printf(" -n <int> number of FIFO drains per pass, default 2000\n");
+    printf(" -t <int> interval between two drains in us, default 1000\n");
+    printf(" -b <int> latency bound of the last pass in us, default 1500\n");
+}
+
+/* simulated acquisition thread: a burst of spotter-sized lines per drain, stamped with the time they are ready */
+static void *thread_acq(void *arg) {
+    struct timespec next;
+    char *line;
+    uint32_t seq = 0;
+    int i, j;
+
+    (void)arg;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (i = 0; i < nb_drain; ++i) {
+        next.tv_nsec += interval_us * 1000;
+        while (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        for (j = 0; j < FIFO_PKT; ++j) {
+            if ((line = line_ring_reserve(&ring)) != NULL) {
+                line_ring_commit(&ring, snprintf(line, SPOTTER_LINE_MAX, "#%u,2,%llu,-695,743,-16,45.123456789,-1.500000000\n", seq, (unsigned long long)now_us()));
+            }
+            ++seq;
+        }
+        line_ring_notify(&ring);
+    }
+    return NULL;
+}
+
+/* network thread: one send() per line, or the batches */
+static void *thread_net(void *arg) {
+    int bound = *(int *)arg;
+    struct pollfd pfd;
+    const char *line;
+    int len;
+
+    pfd.fd = ring.fd[0];
+    pfd.events = POLLIN;
+    while (stop == false) {
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        line_ring_ack(&ring);
+        if (bound == BOUND_PER_LINE) {
+            while ((line = line_ring_peek(&ring, &len)) != NULL) {
+                send(tx_fd, line, len, 0);
+                nb_call++;
+                line_ring_pop(&ring);
+            }
+        } else if (tx_batch_collect(&batch, &ring, (uint32_t)bound) > 0) {
+            tx_batch_send(&batch, &ring, tx_fd);
+            nb_call = batch.nb_write;
+        }
+    }
+    return NULL;
+}
+
+/* client: split the lines, check their sequence and measure their latency */
+static void *thread_client(void *arg) {
+    static char buf[64 * 1024];
+    uint64_t t, stamp, lat;
+    unsigned seq;
+    size_t fill = 0;
+    char *p, *eol;
+    ssize_t n;
+
+    (void)arg;
+    while ((n = recv(rx_fd, buf + fill, sizeof buf - fill, 0)) > 0) {
+        t = now_us();
+        fill += n;
+        p = buf;
+        while ((eol = memchr(p, '\n', fill - (p - buf))) != NULL) {
+            /* lines dropped by a full ring leave gaps, never reorder */
+            if ((sscanf(p, "#%u,2,%llu,", &seq, (unsigned long long *)&stamp) != 2) || (seq < next_seq)) {
+                nb_bad++;
+            }
+            next_seq = seq + 1;
+            lat = t - stamp;
+            histo[(lat < HISTO_US) ? lat : HISTO_US]++;
+            lat_max = (lat > lat_max) ? lat : lat_max;
+            nb_rx++;
+            p = eol + 1;
+        }
+        fill -= p - buf;
+        memmove(buf, p, fill);
+    }
+    return NULL;
+}
+
+static int run_pass(const char *name, int lsock, bool nodelay, int bound) {
+    pthread_t thr_acq, thr_net, thr_client;
+    struct tcp_info info;
+    socklen_t ilen = sizeof info;
+    struct sockaddr_in addr;
+    socklen_t alen = sizeof addr;
+    uint32_t n, nb_line = (uint32_t)nb_drain * FIFO_PKT;
+    uint64_t p50 = 0, p99 = 0, t0;
+    int i;
+
+    memset(histo, 0, sizeof histo);
+    lat_max = 0;
+    nb_rx = nb_bad = next_seq = 0;
+    nb_call = 0;
+    stop = false;
+    tx_batch_init(&batch);
+    if (line_ring_init(&ring) != LINE_RING_SUCCESS) {
+        printf("ERROR: failed to create the line ring\n");
+        return -1;
+    }
+
+    /* the server side of the connection is the sender */
+    getsockname(lsock, (struct sockaddr *)&addr, &alen);
+    rx_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if ((rx_fd < 0) || (connect(rx_fd, (struct sockaddr *)&addr, alen) != 0) || ((tx_fd = accept(lsock, NULL, NULL)) < 0)) {
+        printf("ERROR: failed to connect on the loopback interface\n");
+        return -1;
+    }
+    i = (nodelay == true) ? 1 : 0;
+    setsockopt(tx_fd, IPPROTO_TCP, TCP_NODELAY, &i, sizeof i);
+
+    pthread_create(&thr_client, NULL, thread_client, NULL);
+    pthread_create(&thr_net, NULL, thread_net, &bound);
+    pthread_create(&thr_acq, NULL, thread_acq, NULL);
+    pthread_join(thr_acq, NULL);
+
+    /* let the last lines through */
+    t0 = now_us();
+    while ((__atomic_load_n(&nb_rx, __ATOMIC_RELAXED) < nb_line - ring.nb_drop) && (now_us() - t0 < 1000000)) {
+        usleep(1000);
+    }
+    stop = true;
+    pthread_join(thr_net, NULL);
+    memset(&info, 0, sizeof info);
+    getsockopt(tx_fd, IPPROTO_TCP, TCP_INFO, &info, &ilen);
+    close(tx_fd);
+    pthread_join(thr_client, NULL);
+    close(rx_fd);
+    line_ring_close(&ring);
+
+    /* percentiles from the histogram */
+    n = 0;
+    for (i = 0; i <= HISTO_US; ++i) {
+        n += histo[i];
+        if ((p50 == 0) && (n * 2 >= nb_rx)) p50 = i;
+        if ((p99 == 0) && (n * 100 >= nb_rx * 99)) p99 = i;
+    }
+    printf("%-34s: %6u lines, %.3f writes/line, %.3f segments/line, latency p50 %4llu us, p99 %5llu us, max %6llu us, %u lines dropped\n",
+           name, nb_rx, (double)nb_call / nb_rx, (double)info.tcpi_data_segs_out / nb_rx,
+           (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)lat_max, ring.nb_drop);
+    if ((nb_rx + ring.nb_drop != nb_line) || (nb_bad != 0)) {
+        printf("ERROR: %u lines of %u received, %u out of sequence\n", nb_rx, nb_line, nb_bad);
+        return -1;
+    }
+    if ((bound != BOUND_PER_LINE) && ((ring.nb_drop != 0) || (batch.nb_line != nb_line))) {
+        printf("ERROR: %u lines dropped, %llu lines counted in the batches\n", ring.nb_drop, (unsigned long long)batch.nb_line);
+        return -1;
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    struct sockaddr_in addr;
+    char name[64];
+    int bound_us = 1500;
+    int lsock, i;
+    int err = 0;
+
+    while ((i = getopt(argc, argv, "hn:t:b:")) != -1) {
+        switch (i) {
+            case 'h': usage(); return EXIT_SUCCESS;
+            case 'n': nb_drain = atoi(optarg); break;
+            case 't': interval_us = atoi(optarg); break;
+            case 'b': bound_us = atoi(optarg); break;
+            default: usage(); return EXIT_FAILURE;
+        }
+    }
+    bound_us = (bound_us < 0) ? 0 : (bound_us > TX_FLUSH_MAX_US) ? TX_FLUSH_MAX_US : bound_us;
+
+    lsock = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(lsock, (struct sockaddr *)&addr, sizeof addr) != 0) || (listen(lsock, 1) != 0)) {
+        printf("ERROR: impossible to listen on the loopback interface\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("Beginning of test for the writes to the client, %d drains of %d lines every %d us\n", nb_drain, FIFO_PKT, interval_us);
+    err += run_pass("send() per line", lsock, false, BOUND_PER_LINE);
+    err += run_pass("send() per line, TCP_NODELAY", lsock, true, BOUND_PER_LINE);
+    err += run_pass("one write per drain, TCP_NODELAY", lsock, true, 0);
+    snprintf(name, sizeof name, "bound %d us, TCP_NODELAY", bound_us);
+    err += run_pass(name, lsock, true, bound_us);
+    close(lsock);
+
+    printf("End of test for the writes to the client\n");
+    return (err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,219 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Multicast output over the loopback interface: batches of lines of random
+    length are sent to a group joined by two listeners, which check the
+    datagram size, the gateway ID, the sequence numbers and that every line
+    arrives whole and in order, with an Ethernet MTU then the smallest one.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+#define _DEFAULT_SOURCE /* struct ip_mreq, to join the group */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+#include <stdio.h>      /* printf snprintf sscanf */
+#include <stdlib.h>     /* rand EXIT_SUCCESS */
+#include <string.h>     /* memset memcmp memchr */
+#include <unistd.h>     /* close */
+#include <poll.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "udp_sink.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define NB_BATCH        2000
+#define BATCH_MAX       64          /* lines per batch */
+#define LINE_MAX_LEN    128         /* SPOTTER_LINE_MAX */
+#define NB_LISTENER     2
+
+static const char gw_id[] = "AA555A0000000101";
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct listener_s {
+    int         fd;
+    uint32_t    seq;        /* next sequence number expected */
+    uint32_t    line;       /* next line expected */
+    uint32_t    nb_dgram;
+    int         nb_err;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static char lines[BATCH_MAX][LINE_MAX_LEN];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* line number n, its length drawn from n so that listeners can check it */
+static int format_line(char *buf, uint32_t n) {
+    int len = 24 + (int)((n * 2654435761u) % (LINE_MAX_LEN - 24));
+    int i;
+
+    i = snprintf(buf, LINE_MAX_LEN, "#%u,", n);
+    while (i < len - 1) {
+        buf[i] = 'a' + (n + i) % 26;
+        ++i;
+    }
+    buf[i++] = '\n';
+    return i;
+}
+
+static int open_listener(uint16_t *port) {
+    struct sockaddr_in addr;
+    socklen_t alen = sizeof addr;
+    struct ip_mreq mreq;
+    int one = 1;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(*port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    inet_pton(AF_INET, UDP_SINK_GROUP, &mreq.imr_multiaddr);
+    inet_pton(AF_INET, "127.0.0.1", &mreq.imr_interface);
+    if ((bind(fd, (struct sockaddr *)&addr, sizeof addr) != 0) || (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof mreq) != 0)) {
+        close(fd);
+        return -1;
+    }
+    getsockname(fd, (struct sockaddr *)&addr, &alen);
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+/* read the datagrams sent so far, check them against the lines sent */
+static void drain(struct listener_s *l, uint16_t payload_max, uint64_t nb_sent) {
+    char dgram[2048], expect[LINE_MAX_LEN], id[32];
+    struct pollfd pfd;
+    uint32_t seq;
+    char *p, *eol, *end;
+    ssize_t n;
+    int len;
+
+    pfd.fd = l->fd;
+    pfd.events = POLLIN;
+    while ((l->nb_dgram < nb_sent) && (poll(&pfd, 1, 1000) > 0) && ((n = recv(l->fd, dgram, sizeof dgram, 0)) > 0)) {
+        l->nb_dgram++;
+        end = dgram + n;
+        if (n > payload_max) {
+            printf("ERROR: datagram of %zd bytes, more than %u\n", n, payload_max);
+            l->nb_err++;
+        }
+        if ((sscanf(dgram, "$SEQ,%31[^,],%u\n", id, &seq) != 2) || (strcmp(id, gw_id) != 0) || (seq != l->seq)) {
+            printf("ERROR: header '%.40s' instead of sequence %u\n", dgram, l->seq);
+            l->nb_err++;
+        }
+        l->seq = seq + 1;
+        p = memchr(dgram, '\n', n) + 1;
+        for (; (p < end) && ((eol = memchr(p, '\n', end - p)) != NULL); p = eol + 1) {
+            len = format_line(expect, l->line);
+            if ((eol + 1 - p != len) || (memcmp(p, expect, len) != 0)) {
+                printf("ERROR: line %u is '%.*s'\n", l->line, (int)(eol - p), p);
+                l->nb_err++;
+            }
+            l->line++;
+        }
+        if (p != end) {
+            printf("ERROR: datagram %u ends with a partial line\n", seq);
+            l->nb_err++;
+        }
+    }
+}
+
+static int run_pass(uint16_t mtu) {
+    struct udp_sink_conf_s conf;
+    struct udp_sink_s sink;
+    struct listener_s lst[NB_LISTENER];
+    struct iovec iov[BATCH_MAX];
+    uint32_t nb_line = 0;
+    uint16_t port = 0;
+    int i, j, nb;
+    int nb_err = 0;
+
+    memset(lst, 0, sizeof lst);
+    for (i = 0; i < NB_LISTENER; ++i) {
+        if ((lst[i].fd = open_listener(&port)) < 0) {
+            printf("ERROR: failed to join %s on the loopback interface\n", UDP_SINK_GROUP);
+            return -1;
+        }
+    }
+    udp_sink_conf_default(&conf);
+    conf.enable = true;
+    conf.port = port;
+    conf.mtu = mtu;
+    strcpy(conf.iface, "127.0.0.1");
+    if (udp_sink_open(&sink, &conf, gw_id) != UDP_SINK_SUCCESS) {
+        printf("ERROR: failed to open the multicast output\n");
+        return -1;
+    }
+
+    for (i = 0; i < NB_BATCH; ++i) {
+        nb = 1 + rand() % BATCH_MAX;
+        for (j = 0; j < nb; ++j) {
+            iov[j].iov_base = lines[j];
+            iov[j].iov_len = format_line(lines[j], nb_line++);
+        }
+        if (udp_sink_send(&sink, iov, nb) != 0) {
+            printf("ERROR: datagram refused by the socket\n");
+            ++nb_err;
+        }
+        for (j = 0; j < NB_LISTENER; ++j) {
+            drain(&lst[j], sink.payload_max, sink.nb_datagram);
+        }
+    }
+
+    for (i = 0; i < NB_LISTENER; ++i) {
+        nb_err += lst[i].nb_err;
+        if ((lst[i].line != nb_line) || (lst[i].nb_dgram != sink.nb_datagram)) {
+            printf("ERROR: listener %d got %u lines of %u, %u datagrams of %llu\n", i, lst[i].line, nb_line, lst[i].nb_dgram, (unsigned long long)sink.nb_datagram);
+            ++nb_err;
+        }
+        close(lst[i].fd);
+    }
+    printf("MTU %4u: %u lines in %llu datagrams, %.1f lines per datagram, %d listeners, %llu lost\n", mtu, nb_line,
+           (unsigned long long)sink.nb_datagram, (double)nb_line / sink.nb_datagram, NB_LISTENER, (unsigned long long)sink.nb_lost);
+    udp_sink_close(&sink);
+    return nb_err;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    int nb_err = 0;
+
+    printf("Beginning of test for the multicast output\n");
+    nb_err += run_pass(UDP_SINK_MTU);
+    nb_err += run_pass(UDP_SINK_MTU_MIN);
+    printf("%s: %d error(s)\n", (nb_err == 0) ? "PASS" : "FAIL", nb_err);
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,251 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    Check the real FFT against a plain DFT, then the wave height and periods
+    of a swell and of a random sea of known spectrum, also with 10 % of the
+    samples lost, duplicated or late, and measure the cost of adding a sample
+    (acquisition thread) and of a spectrum (spectrum thread).
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>     /* rand */
+#include <string.h>     /* strlen */
+#include <math.h>       /* sin sqrt */
+#include <time.h>       /* clock_gettime */
+
+#include "wave_spec.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define T0              16000000000ULL  /* tenths of a second since epoch */
+#define NB_WAVE         200             /* components of the random sea */
+#define NB_REPEAT       200
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct wave_spec_s ws;
+static double amp[NB_WAVE], freq[NB_WAVE], phase[NB_WAVE];
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static double elapsed_ns(struct timespec *t0, struct timespec *t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+/* largest difference to a plain DFT, relative to the largest bin */
+static double check_rfft(int n) {
+    static float in[WAVE_SPEC_SEG_MAX], re[WAVE_SPEC_SEG_MAX / 2 + 1], im[WAVE_SPEC_SEG_MAX / 2 + 1];
+    double dr, di, err = 0.0, mag = 0.0;
+    int i, k;
+
+    wave_spec_init(&ws, n, n);
+    for (i = 0; i < n; ++i) {
+        in[i] = (float)(rand() % 2001 - 1000) / 1000.0f;
+    }
+    wave_spec_rfft(&ws, in, re, im);
+    for (k = 0; k <= n / 2; ++k) {
+        dr = 0.0;
+        di = 0.0;
+        for (i = 0; i < n; ++i) {
+            dr += in[i] * cos(2.0 * M_PI * k * i / n);
+            di -= in[i] * sin(2.0 * M_PI * k * i / n);
+        }
+        err = fmax(err, hypot(dr - re[k], di - im[k]));
+        mag = fmax(mag, hypot(dr, di));
+    }
+    return err / mag;
+}
+
+/* Pierson-Moskowitz sea of peak period tp, height 4 * sqrt(sum a^2 / 2) of the components in the band */
+static double make_sea(double hs, double tp, double fmin, double fmax) {
+    double fp = 1.0 / tp, df = (0.5 - 0.03) / NB_WAVE, s, m0 = 0.0, m0_band = 0.0;
+    int i;
+
+    for (i = 0; i < NB_WAVE; ++i) {
+        freq[i] = 0.03 + (i + (double)rand() / RAND_MAX) * df;
+        s = 5.0 / 16.0 * hs * hs * pow(fp, 4) / pow(freq[i], 5) * exp(-1.25 * pow(fp / freq[i], 4));
+        amp[i] = sqrt(2.0 * s * df);
+        phase[i] = 2.0 * M_PI * rand() / RAND_MAX;
+        m0 += amp[i] * amp[i] / 2.0;
+        if ((freq[i] >= fmin) && (freq[i] < fmax)) {
+            m0_band += amp[i] * amp[i] / 2.0;
+        }
+    }
+    return 4.0 * sqrt(m0_band);
+}
+
+/* samples at fs Hz from t seconds, timestamps in tenths as the spotters send them, loss_pct % of them lost */
+static void push_sea(int spotn, int nb, double fs, double t, int nb_wave, int loss_pct) {
+    double z;
+    int n, i;
+
+    for (n = 0; n < nb; ++n, t += 1.0 / fs) {
+        if ((loss_pct > 0) && (rand() % 100 < loss_pct)) {
+            continue;
+        }
+        for (i = 0, z = 0.0; i < nb_wave; ++i) {
+            z += amp[i] * sin(2.0 * M_PI * freq[i] * t + phase[i]);
+        }
+        wave_spec_push(&ws, spotn, T0 + (uint64_t)(t * 10.0), (int32_t)lrint(z * 1000.0));
+    }
+}
+
+static int check_res(const char *name, const struct wave_spec_res_s *r, double hs, double tp, double tol_hs, double tol_tp) {
+    char line[WAVE_SPEC_LINE_MAX];
+
+    wave_spec_format(r, line, sizeof line);
+    printf("%s: %s", name, line);
+    wave_spec_format_bands(r, line, sizeof line);
+    printf("%s: %s", name, line);
+    if ((fabs(r->hs - hs) > tol_hs * hs) || (fabs(r->tp - tp) > tol_tp * tp)) {
+        printf("ERROR: %s, Hs %.2f m and Tp %.1f s expected\n", name, hs, tp);
+        return 1;
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(void)
+{
+    static const int bad[][2] = { {1024, 100}, {1024, 8}, {4096, 256}, {128, 256}, {1000, 256} };
+    struct wave_spec_res_s res;
+    struct timespec t0, t1;
+    double err, hs;
+    int i, k;
+    int nb_err = 0;
+
+    srand(1);
+
+    /* sizes */
+    for (i = 0; i < (int)(sizeof bad / sizeof bad[0]); ++i) {
+        if (wave_spec_init(&ws, bad[i][0], bad[i][1]) != WAVE_SPEC_ERROR) {
+            printf("ERROR: window %d and segment %d accepted\n", bad[i][0], bad[i][1]);
+            ++nb_err;
+        }
+    }
+
+    /* real FFT */
+    for (k = WAVE_SPEC_SEG_MIN; k <= WAVE_SPEC_SEG_MAX; k *= 4) {
+        err = check_rfft(k);
+        printf("real FFT of %d samples: %.1e relative error\n", k, err);
+        if (err > 1e-5) {
+            printf("ERROR: real FFT of %d samples wrong\n", k);
+            ++nb_err;
+        }
+    }
+
+    /* swell of 1 m amplitude and 10 s period, 2 Hz, Hs = 4 * sqrt(1 / 2) */
+    wave_spec_init(&ws, WAVE_SPEC_WINDOW, WAVE_SPEC_SEGMENT);
+    amp[0] = 1.0;
+    freq[0] = 0.1;
+    phase[0] = 0.3;
+    push_sea(3, WAVE_SPEC_WINDOW - 1, 2.0, 0.0, 1, 0);
+    if (wave_spec_compute(&ws, 3, &res) != WAVE_SPEC_NODATA) {
+        printf("ERROR: spectrum of less than a window\n");
+        ++nb_err;
+    }
+    push_sea(3, 1, 2.0, (WAVE_SPEC_WINDOW - 1) / 2.0, 1, 0);
+    if (wave_spec_compute(&ws, 3, &res) != WAVE_SPEC_SUCCESS) {
+        printf("ERROR: no spectrum of a full window\n");
+        ++nb_err;
+    } else {
+        nb_err += check_res("swell", &res, 4.0 * sqrt(0.5), 10.0, 0.03, 0.02);
+    }
+    if (wave_spec_compute(&ws, 3, &res) != WAVE_SPEC_NODATA) {
+        printf("ERROR: spectrum again without new sample\n");
+        ++nb_err;
+    }
+
+    /* random sea, Hs 3 m and Tp 8 s at 2 Hz, then Hs 1.5 m and Tp 5 s at 4 Hz over the largest window */
+    hs = make_sea(3.0, 8.0, WAVE_SPEC_FMIN, WAVE_SPEC_FMIN + WAVE_SPEC_BANDS * WAVE_SPEC_DF_BAND);
+    push_sea(5, WAVE_SPEC_WINDOW, 2.0, 1000.0, NB_WAVE, 0);
+    if (wave_spec_compute(&ws, 5, &res) != WAVE_SPEC_SUCCESS) {
+        printf("ERROR: no spectrum of the random sea\n");
+        ++nb_err;
+    } else {
+        nb_err += check_res("sea 2 Hz", &res, hs, 8.0, 0.10, 0.15);
+    }
+    wave_spec_init(&ws, WAVE_SPEC_WINDOW_MAX, WAVE_SPEC_SEGMENT);
+    hs = make_sea(1.5, 5.0, WAVE_SPEC_FMIN, WAVE_SPEC_FMIN + WAVE_SPEC_BANDS * WAVE_SPEC_DF_BAND);
+    push_sea(0, WAVE_SPEC_WINDOW_MAX + 100, 4.0, 0.0, NB_WAVE, 0);
+    if ((wave_spec_compute(&ws, 0, &res) != WAVE_SPEC_SUCCESS) || (fabs(res.fs - 4.0) > 0.01)) {
+        printf("ERROR: no spectrum of the random sea, or sample rate wrong\n");
+        ++nb_err;
+    } else {
+        nb_err += check_res("sea 4 Hz", &res, hs, 5.0, 0.10, 0.15);
+    }
+
+    /* same sea at 2 Hz with 10 % of the samples lost, a few duplicated and late ones dropped */
+    wave_spec_init(&ws, WAVE_SPEC_WINDOW, WAVE_SPEC_SEGMENT);
+    hs = make_sea(3.0, 8.0, WAVE_SPEC_FMIN, WAVE_SPEC_FMIN + WAVE_SPEC_BANDS * WAVE_SPEC_DF_BAND);
+    push_sea(6, WAVE_SPEC_WINDOW + WAVE_SPEC_WINDOW / 4, 2.0, 0.0, NB_WAVE, 10);
+    k = (int)ws.ring[6].wr;
+    wave_spec_push(&ws, 6, ws.ring[6].tenths[(k - 1) % WAVE_SPEC_RING_SIZE], 0);
+    wave_spec_push(&ws, 6, ws.ring[6].tenths[(k - 1) % WAVE_SPEC_RING_SIZE] - 7, 0);
+    if (ws.ring[6].wr != (uint32_t)k) {
+        printf("ERROR: duplicated or late sample taken\n");
+        ++nb_err;
+    }
+    if ((wave_spec_compute(&ws, 6, &res) != WAVE_SPEC_SUCCESS) || (fabs(res.fs - 2.0) > 0.01) || (res.nb >= WAVE_SPEC_WINDOW)) {
+        printf("ERROR: no spectrum with 10 %% loss, or sample rate wrong\n");
+        ++nb_err;
+    } else {
+        nb_err += check_res("sea 2 Hz 10% loss", &res, hs, 8.0, 0.10, 0.15);
+    }
+
+    /* a window with a third of its samples lost is skipped */
+    push_sea(7, 2 * WAVE_SPEC_WINDOW, 2.0, 0.0, NB_WAVE, 33);
+    if (wave_spec_compute(&ws, 7, &res) != WAVE_SPEC_NODATA) {
+        printf("ERROR: spectrum with 33 %% loss\n");
+        ++nb_err;
+    }
+
+    /* cost */
+    wave_spec_init(&ws, WAVE_SPEC_WINDOW, WAVE_SPEC_SEGMENT);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (k = 0; k < 1000000; ++k) {
+        wave_spec_push(&ws, k & 7, T0 + 5 * (k >> 3), (k % 3001) - 1500);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("push: %.1f ns per sample (acquisition thread)\n", elapsed_ns(&t0, &t1) / 1000000);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (k = 0; k < NB_REPEAT; ++k) {
+        ws.ring[k & 7].done = 0;
+        wave_spec_compute(&ws, k & 7, &res);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("spectrum of %d samples, %d segments of %d: %.1f us per spotter (spectrum thread)\n", WAVE_SPEC_WINDOW,
+           2 * WAVE_SPEC_WINDOW / WAVE_SPEC_SEGMENT - 1, WAVE_SPEC_SEGMENT, elapsed_ns(&t0, &t1) / NB_REPEAT / 1000);
+
+    printf("%s: %d error(s)\n", (nb_err == 0) ? "PASS" : "FAIL", nb_err);
+    return (nb_err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */